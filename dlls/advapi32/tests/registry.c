@@ -2321,17 +2321,95 @@ static void test_rw_order(void)
     ok(strcmp(value_buf, "A") == 0, "Expected name \"A\", got %s\n", value_buf);
     value_len = 2;
     ok(!RegEnumValueA(hKey, 1, value_buf, &value_len, NULL, NULL, NULL, NULL), "RegEnumValueA failed\n");
-    todo_wine ok(strcmp(value_buf, "C") == 0, "Expected name \"C\", got %s\n", value_buf);
+    ok(strcmp(value_buf, "C") == 0, "Expected name \"C\", got %s\n", value_buf);
     value_len = 2;
     ok(!RegEnumValueA(hKey, 2, value_buf, &value_len, NULL, NULL, NULL, NULL), "RegEnumValueA failed\n");
-    todo_wine ok(strcmp(value_buf, "D") == 0, "Expected name \"D\", got %s\n", value_buf);
+    ok(strcmp(value_buf, "D") == 0, "Expected name \"D\", got %s\n", value_buf);
     value_len = 2;
     ok(!RegEnumValueA(hKey, 3, value_buf, &value_len, NULL, NULL, NULL, NULL), "RegEnumValueA failed\n");
-    todo_wine ok(strcmp(value_buf, "B") == 0, "Expected name \"B\", got %s\n", value_buf);
+    ok(strcmp(value_buf, "B") == 0, "Expected name \"B\", got %s\n", value_buf);
 
     ok(!RegDeleteKeyA(HKEY_CURRENT_USER, keyname), "Failed to delete key\n");
 }
 
+static void test_many_entries(void)
+{
+    char name[32], prev[32];
+    DWORD i, count, len;
+    HKEY hkey, subkey;
+    LONG ret;
+
+    ret = RegCreateKeyA(hkey_main, "many_entries", &hkey);
+    ok(ret == ERROR_SUCCESS, "RegCreateKeyA failed: %ld\n", ret);
+
+    /* create subkeys out of order, enumeration is still sorted case-insensitively */
+    for (i = 0; i < 500; i++)
+    {
+        sprintf(name, (i % 3) ? "subkey%03lu" : "SubKey%03lu", (i * 7) % 500);
+        ret = RegCreateKeyA(hkey, name, &subkey);
+        ok(ret == ERROR_SUCCESS, "RegCreateKeyA %s failed: %ld\n", name, ret);
+        RegCloseKey(subkey);
+    }
+    for (i = 0; i < 500; i++)
+    {
+        sprintf(name, "SUBKEY%03lu", i);
+        ret = RegOpenKeyA(hkey, name, &subkey);
+        ok(ret == ERROR_SUCCESS, "RegOpenKeyA %s failed: %ld\n", name, ret);
+        RegCloseKey(subkey);
+    }
+    ret = RegOpenKeyA(hkey, "subkey500", &subkey);
+    ok(ret == ERROR_FILE_NOT_FOUND, "RegOpenKeyA returned %ld\n", ret);
+
+    ret = RegDeleteKeyA(hkey, "subKEY123");
+    ok(ret == ERROR_SUCCESS, "RegDeleteKeyA failed: %ld\n", ret);
+    ret = RegCreateKeyA(hkey, "Subkey123a", &subkey);
+    ok(ret == ERROR_SUCCESS, "RegCreateKeyA failed: %ld\n", ret);
+    RegCloseKey(subkey);
+
+    prev[0] = 0;
+    for (count = 0; ; count++)
+    {
+        len = sizeof(name);
+        if (RegEnumKeyExA(hkey, count, name, &len, NULL, NULL, NULL, NULL)) break;
+        ok(lstrcmpiA(prev, name) < 0, "%lu: %s enumerated after %s\n", count, name, prev);
+        strcpy(prev, name);
+    }
+    ok(count == 500, "got %lu subkeys\n", count);
+
+    /* values are enumerated in creation order */
+    for (i = 0; i < 500; i++)
+    {
+        sprintf(name, "Value%03lu", (i * 7) % 500);
+        ret = RegSetValueExA(hkey, name, 0, REG_DWORD, (BYTE *)&i, sizeof(i));
+        ok(ret == ERROR_SUCCESS, "RegSetValueExA %s failed: %ld\n", name, ret);
+    }
+    ret = RegDeleteValueA(hkey, "VALUE007");
+    ok(ret == ERROR_SUCCESS, "RegDeleteValueA failed: %ld\n", ret);
+    for (i = 0, count = 0; i < 500; i++)
+    {
+        DWORD data, data_len = sizeof(data);
+
+        if (i == 1) continue;
+        sprintf(prev, "Value%03lu", (i * 7) % 500);
+        len = sizeof(name);
+        ret = RegEnumValueA(hkey, count++, name, &len, NULL, NULL, (BYTE *)&data, &data_len);
+        ok(ret == ERROR_SUCCESS, "RegEnumValueA failed: %ld\n", ret);
+        ok(!strcmp(name, prev), "expected %s, got %s\n", prev, name);
+        ok(data == i, "%s: got data %lu\n", name, data);
+
+        CharUpperA(prev);
+        data_len = sizeof(data);
+        ret = RegQueryValueExA(hkey, prev, NULL, NULL, (BYTE *)&data, &data_len);
+        ok(ret == ERROR_SUCCESS, "RegQueryValueExA %s failed: %ld\n", prev, ret);
+        ok(data == i, "%s: got data %lu\n", prev, data);
+    }
+    ret = RegQueryValueExA(hkey, "Value007", NULL, NULL, NULL, NULL);
+    ok(ret == ERROR_FILE_NOT_FOUND, "RegQueryValueExA returned %ld\n", ret);
+
+    delete_key(hkey);
+    RegCloseKey(hkey);
+}
+
 static void test_symlinks(void)
 {
     static const WCHAR targetW[] = L"\\Software\\Wine\\Test\\target";
@@ -3380,6 +3458,205 @@ static void test_delete_value(void)
     ok(res == ERROR_FILE_NOT_FOUND, "expected ERROR_FILE_NOT_FOUND, got %ld\n", res);
 }
 
+static void test_query_value_after_change(void)
+{
+    HKEY key, key2;
+    HANDLE event;
+    DWORD size, type, i;
+    char buffer[32];
+    LONG res;
+
+    res = RegCreateKeyExA( hkey_main, "query_change", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, NULL );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    res = RegOpenKeyExA( hkey_main, "query_change", 0, KEY_ALL_ACCESS, &key2 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+
+    res = RegSetValueExA( key, "test", 0, REG_SZ, (const BYTE *)"old", 4 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+
+    /* watching attributes only must not be affected by value changes */
+    event = CreateEventA( NULL, TRUE, FALSE, NULL );
+    res = RegNotifyChangeKeyValue( key, FALSE, REG_NOTIFY_CHANGE_ATTRIBUTES, event, TRUE );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+
+    for (i = 0; i < 3; i++)
+    {
+        size = sizeof(buffer);
+        res = RegQueryValueExA( key, "test", NULL, &type, (BYTE *)buffer, &size );
+        ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+        ok(type == REG_SZ, "got type %lu\n", type);
+        ok(size == 4 && !strcmp( buffer, "old" ), "got %lu %s\n", size, buffer);
+    }
+
+    res = RegSetValueExA( key2, "test", 0, REG_DWORD, (const BYTE *)&i, sizeof(i) );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+
+    size = sizeof(buffer);
+    res = RegQueryValueExA( key, "test", NULL, &type, (BYTE *)buffer, &size );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    ok(type == REG_DWORD, "got type %lu\n", type);
+    ok(size == sizeof(i) && *(DWORD *)buffer == 3, "got %lu %lu\n", size, *(DWORD *)buffer);
+    ok(WaitForSingleObject( event, 0 ) == WAIT_TIMEOUT, "event signaled\n");
+
+    res = RegDeleteValueA( key2, "test" );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+
+    size = sizeof(buffer);
+    res = RegQueryValueExA( key, "test", NULL, &type, (BYTE *)buffer, &size );
+    ok(res == ERROR_FILE_NOT_FOUND, "expected ERROR_FILE_NOT_FOUND, got %ld\n", res);
+
+    res = RegSetValueExA( key2, "test", 0, REG_SZ, (const BYTE *)"new", 4 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+
+    size = sizeof(buffer);
+    res = RegQueryValueExA( key, "test", NULL, &type, (BYTE *)buffer, &size );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    ok(size == 4 && !strcmp( buffer, "new" ), "got %lu %s\n", size, buffer);
+
+    RegCloseKey( key2 );
+
+    /* deleting the key signals the notifications on the key itself */
+    res = RegNotifyChangeKeyValue( key, FALSE, REG_NOTIFY_CHANGE_NAME, event, TRUE );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    ok(WaitForSingleObject( event, 0 ) == WAIT_TIMEOUT, "event signaled\n");
+    res = RegDeleteKeyA( key, "" );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    ok(!WaitForSingleObject( event, 0 ), "event not signaled\n");
+    RegCloseKey( key );
+    CloseHandle( event );
+}
+
+static void check_reg_cache_value_( int line, HKEY key, const char *name, LONG expect_res, const char *expect )
+{
+    char buffer[32];
+    DWORD size = sizeof(buffer), type;
+    LONG res;
+
+    memset( buffer, 0, sizeof(buffer) );
+    res = RegQueryValueExA( key, name, NULL, &type, (BYTE *)buffer, &size );
+    ok_(__FILE__, line)(res == expect_res, "expected %ld, got %ld\n", expect_res, res);
+    if (res || expect_res) return;
+    ok_(__FILE__, line)(type == REG_SZ, "got type %lu\n", type);
+    ok_(__FILE__, line)(size == strlen( expect ) + 1 && !strcmp( buffer, expect ),
+                        "got %lu %s\n", size, debugstr_a(buffer));
+}
+#define check_reg_cache_value(a,b,c,d) check_reg_cache_value_(__LINE__,a,b,c,d)
+
+/* runs with WINEREGCACHE enabled for the current user */
+static void test_reg_cache_child(void)
+{
+    HKEY parent, key, key2, key3;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name;
+    NTSTATUS status;
+    DWORD i;
+    LONG res;
+
+    res = RegOpenKeyExA( HKEY_CURRENT_USER, "Software\\Wine\\Test", 0, KEY_ALL_ACCESS, &parent );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    res = RegCreateKeyExA( parent, "regcache", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, NULL );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    res = RegSetValueExA( key, "test", 0, REG_SZ, (const BYTE *)"one", 4 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    RegCloseKey( key );
+
+    /* handles opened in sequence share the cached values */
+    for (i = 0; i < 3; i++)
+    {
+        res = RegOpenKeyExA( parent, i ? "RegCache" : "regcache", 0, KEY_READ, &key );
+        ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+        check_reg_cache_value( key, "test", ERROR_SUCCESS, "one" );
+        check_reg_cache_value( key, "missing", ERROR_FILE_NOT_FOUND, NULL );
+        RegCloseKey( key );
+    }
+    res = RegOpenKeyExA( HKEY_CURRENT_USER, "Software\\Wine\\Test\\regcache", 0, KEY_READ, &key );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    check_reg_cache_value( key, "test", ERROR_SUCCESS, "one" );
+
+    /* changes made through another handle are seen by all handles */
+    res = RegOpenKeyExA( parent, "regcache", 0, KEY_ALL_ACCESS, &key2 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    res = RegSetValueExA( key2, "test", 0, REG_SZ, (const BYTE *)"two", 4 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    res = RegSetValueExA( key2, "missing", 0, REG_SZ, (const BYTE *)"new", 4 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    check_reg_cache_value( key, "test", ERROR_SUCCESS, "two" );
+    check_reg_cache_value( key, "missing", ERROR_SUCCESS, "new" );
+    check_reg_cache_value( key2, "test", ERROR_SUCCESS, "two" );
+
+    /* a cached value must not be returned through a handle without query access */
+    res = RegOpenKeyExA( parent, "regcache", 0, KEY_SET_VALUE, &key3 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    check_reg_cache_value( key3, "test", ERROR_ACCESS_DENIED, NULL );
+    RegCloseKey( key3 );
+
+    /* a deleted key is not confused with a new key of the same name */
+    res = RegDeleteKeyA( parent, "regcache" );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    check_reg_cache_value( key, "test", ERROR_KEY_DELETED, NULL );
+    res = RegCreateKeyExA( parent, "regcache", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key3, NULL );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    res = RegSetValueExA( key3, "test", 0, REG_SZ, (const BYTE *)"three", 6 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    RegCloseKey( key3 );
+    res = RegOpenKeyExA( parent, "regcache", 0, KEY_READ, &key3 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    check_reg_cache_value( key3, "test", ERROR_SUCCESS, "three" );
+    check_reg_cache_value( key3, "missing", ERROR_FILE_NOT_FOUND, NULL );
+    check_reg_cache_value( key, "test", ERROR_KEY_DELETED, NULL );
+    check_reg_cache_value( key2, "test", ERROR_KEY_DELETED, NULL );
+    RegCloseKey( key2 );
+    RegCloseKey( key );
+
+    /* the handle value of a key closed with CloseHandle may be reused for another key */
+    CloseHandle( key3 );
+    res = RegCreateKeyExA( parent, "other", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, NULL );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    res = RegSetValueExA( key, "test", 0, REG_SZ, (const BYTE *)"four", 5 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    check_reg_cache_value( key, "test", ERROR_SUCCESS, "four" );
+
+    /* same thing with NtClose and NtOpenKey, which the cache doesn't see */
+    res = RegOpenKeyExA( parent, "regcache", 0, KEY_READ, &key2 );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    check_reg_cache_value( key2, "test", ERROR_SUCCESS, "three" );
+    NtClose( key2 );
+    RtlInitUnicodeString( &name, L"other" );
+    InitializeObjectAttributes( &attr, &name, OBJ_CASE_INSENSITIVE, parent, NULL );
+    status = NtOpenKey( (HANDLE *)&key2, KEY_READ, &attr );
+    ok(!status, "got %#lx\n", status);
+    check_reg_cache_value( key2, "test", ERROR_SUCCESS, "four" );
+    NtClose( key2 );
+
+    RegDeleteKeyA( key, "" );
+    RegCloseKey( key );
+
+    res = RegDeleteKeyA( parent, "regcache" );
+    ok(res == ERROR_SUCCESS, "expected ERROR_SUCCESS, got %ld\n", res);
+    RegCloseKey( parent );
+}
+
+static void test_reg_cache(void)
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char buffer[MAX_PATH + 32];
+    char **argv;
+
+    winetest_get_mainargs( &argv );
+    sprintf( buffer, "\"%s\" registry regcache", argv[0] );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+
+    SetEnvironmentVariableA( "WINEREGCACHE", "\\Registry\\User" );
+    ok(CreateProcessA( NULL, buffer, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info ),
+       "CreateProcess failed, error %lu\n", GetLastError());
+    SetEnvironmentVariableA( "WINEREGCACHE", NULL );
+    wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+}
+
 static void test_delete_key_value(void)
 {
     HKEY subkey;
@@ -4477,9 +4754,19 @@ static void test_EnumDynamicTimeZoneInformation(void)
 
 START_TEST(registry)
 {
+    char **argv;
+    int argc;
+
     /* Load pointers for functions that are not available in all Windows versions */
     InitFunctionPtrs();
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc > 2 && !strcmp( argv[2], "regcache" ))
+    {
+        test_reg_cache_child();
+        return;
+    }
+
     setup_main_key();
     check_user_privs();
     test_set_value();
@@ -4505,8 +4792,11 @@ START_TEST(registry)
     test_reg_copy_tree();
     test_reg_delete_tree();
     test_rw_order();
+    test_many_entries();
     test_deleted_key();
     test_delete_value();
+    test_query_value_after_change();
+    test_reg_cache();
     test_delete_key_value();
     test_RegOpenCurrentUser();
     test_RegNotifyChangeKeyValue();
@@ -5455,10 +5455,10 @@ static void test_GetFileAttributesExW(void)
 static void test_post_completion(void)
 {
     OVERLAPPED ovl, ovl2, *povl;
-    OVERLAPPED_ENTRY entries[2];
+    OVERLAPPED_ENTRY entries[2], many_entries[128];
     ULONG_PTR key;
     HANDLE port;
-    ULONG count;
+    ULONG count, i, j;
     DWORD size;
     BOOL ret;
 
@@ -5557,6 +5557,30 @@ static void test_post_completion(void)
 
     SleepEx(0, TRUE);
 
+    /* more packets than fit in a single server request */
+    for (i = 0; i < 300; i++)
+    {
+        ret = PostQueuedCompletionStatus( port, i, 1000 + i, NULL );
+        ok(ret, "PostQueuedCompletionStatus failed: %u\n", GetLastError());
+    }
+    for (i = 0; i < 300; i += count)
+    {
+        count = 0xdeadbeef;
+        ret = pGetQueuedCompletionStatusEx( port, many_entries, ARRAY_SIZE(many_entries), &count, 0, FALSE );
+        ok(ret, "GetQueuedCompletionStatusEx failed\n");
+        ok(count == min( 300 - i, ARRAY_SIZE(many_entries) ), "wrong count %u\n", count);
+        if (!ret) break;
+        for (j = 0; j < count; j++)
+        {
+            ok(many_entries[j].lpCompletionKey == 1000 + i + j, "wrong key %lu\n", many_entries[j].lpCompletionKey);
+            ok(many_entries[j].dwNumberOfBytesTransferred == i + j, "wrong size %u\n",
+               many_entries[j].dwNumberOfBytesTransferred);
+        }
+    }
+    ret = pGetQueuedCompletionStatusEx( port, many_entries, ARRAY_SIZE(many_entries), &count, 0, FALSE );
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "wrong error %u\n", GetLastError());
+
     CloseHandle( port );
 }
 
@@ -5624,6 +5648,152 @@ static void test_overlapped_read(void)
     ok(ret, "Unexpected error %u.\n", GetLastError());
 }
 
+static void test_overlapped_queue(void)
+{
+    static unsigned char buffers[16][4096];
+    static const char prefix[] = "pfx";
+    char temp_path[MAX_PATH], file_name[MAX_PATH];
+    OVERLAPPED ovs[16], ov, *povl;
+    HANDLE hfile, port;
+    unsigned char *mem;
+    ULONG_PTR key;
+    DWORD size;
+    BOOL ret;
+    int i, j;
+
+    ret = GetTempPathA(MAX_PATH, temp_path);
+    ok(ret, "Unexpected error %u.\n", GetLastError());
+    ret = GetTempFileNameA(temp_path, prefix, 0, file_name);
+    ok(ret, "Unexpected error %u.\n", GetLastError());
+
+    hfile = CreateFileA(file_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    ok(hfile != INVALID_HANDLE_VALUE, "Failed to create file, error %u.\n", GetLastError());
+
+    /* keep several writes in flight at once */
+    for (i = 0; i < ARRAY_SIZE(ovs); i++)
+    {
+        memset(buffers[i], 'a' + i, sizeof(buffers[i]));
+        memset(&ovs[i], 0, sizeof(ovs[i]));
+        ovs[i].Offset = i * sizeof(buffers[i]);
+        ovs[i].hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        ret = WriteFile(hfile, buffers[i], sizeof(buffers[i]), NULL, &ovs[i]);
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "%d: WriteFile failed, error %u.\n", i, GetLastError());
+    }
+    for (i = 0; i < ARRAY_SIZE(ovs); i++)
+    {
+        ret = GetOverlappedResult(hfile, &ovs[i], &size, TRUE);
+        ok(ret, "%d: GetOverlappedResult failed, error %u.\n", i, GetLastError());
+        ok(size == sizeof(buffers[i]), "%d: got size %u.\n", i, size);
+        ResetEvent(ovs[i].hEvent);
+    }
+
+    /* read them back in reverse order */
+    memset(buffers, 0, sizeof(buffers));
+    for (i = 0; i < ARRAY_SIZE(ovs); i++)
+    {
+        ovs[i].Offset = (ARRAY_SIZE(ovs) - 1 - i) * sizeof(buffers[i]);
+        ret = ReadFile(hfile, buffers[i], sizeof(buffers[i]), NULL, &ovs[i]);
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "%d: ReadFile failed, error %u.\n", i, GetLastError());
+    }
+
+    for (i = 0; i < ARRAY_SIZE(ovs); i++)
+    {
+        ret = GetOverlappedResult(hfile, &ovs[i], &size, TRUE);
+        ok(ret, "%d: GetOverlappedResult failed, error %u.\n", i, GetLastError());
+        ok(size == sizeof(buffers[i]), "%d: got size %u.\n", i, size);
+        for (j = 0; j < sizeof(buffers[i]); j++)
+            if (buffers[i][j] != 'a' + ARRAY_SIZE(ovs) - 1 - i) break;
+        ok(j == sizeof(buffers[i]), "%d: wrong data %#x at %d.\n", i, buffers[i][j], j);
+    }
+
+    ResetEvent(ovs[0].hEvent);
+    ovs[0].Offset = ARRAY_SIZE(ovs) * sizeof(buffers[0]);
+    ret = ReadFile(hfile, buffers[0], sizeof(buffers[0]), NULL, &ovs[0]);
+    ok(!ret, "ReadFile succeeded.\n");
+    ok(GetLastError() == ERROR_IO_PENDING || broken(GetLastError() == ERROR_HANDLE_EOF),
+       "ReadFile failed, error %u.\n", GetLastError());
+    ret = GetOverlappedResult(hfile, &ovs[0], &size, TRUE);
+    ok(!ret && GetLastError() == ERROR_HANDLE_EOF, "Unexpected result %d, error %u.\n", ret, GetLastError());
+    ok(!size, "got size %u.\n", size);
+
+    /* write watches in the buffer must not cause short reads */
+    mem = VirtualAlloc(NULL, sizeof(buffers), MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH, PAGE_READWRITE);
+    ok(!!mem, "VirtualAlloc failed, error %u.\n", GetLastError());
+    ResetEvent(ovs[0].hEvent);
+    ovs[0].Offset = 0;
+    ret = ReadFile(hfile, mem, sizeof(buffers), NULL, &ovs[0]);
+    ok(ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed, error %u.\n", GetLastError());
+    ret = GetOverlappedResult(hfile, &ovs[0], &size, TRUE);
+    ok(ret, "GetOverlappedResult failed, error %u.\n", GetLastError());
+    ok(size == sizeof(buffers), "got size %u.\n", size);
+    ok(mem[0] == 'a' && mem[sizeof(buffers) - 1] == 'a' + ARRAY_SIZE(ovs) - 1,
+       "wrong data %#x %#x.\n", mem[0], mem[sizeof(buffers) - 1]);
+    VirtualFree(mem, 0, MEM_RELEASE);
+
+    /* a completed request can no longer be canceled */
+    ResetEvent(ovs[0].hEvent);
+    ret = ReadFile(hfile, buffers[0], sizeof(buffers[0]), NULL, &ovs[0]);
+    ok(ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed, error %u.\n", GetLastError());
+    ret = GetOverlappedResult(hfile, &ovs[0], &size, TRUE);
+    ok(ret, "GetOverlappedResult failed, error %u.\n", GetLastError());
+    SetLastError(0xdeadbeef);
+    ret = CancelIoEx(hfile, &ovs[0]);
+    ok(!ret && GetLastError() == ERROR_NOT_FOUND, "Unexpected result %d, error %u.\n", ret, GetLastError());
+
+    /* a request in flight either completes or gets aborted */
+    for (i = 0; i < ARRAY_SIZE(ovs); i++)
+    {
+        ResetEvent(ovs[i].hEvent);
+        ovs[i].Offset = i * sizeof(buffers[i]);
+        ret = ReadFile(hfile, buffers[i], sizeof(buffers[i]), NULL, &ovs[i]);
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "%d: ReadFile failed, error %u.\n", i, GetLastError());
+    }
+    ret = CancelIoEx(hfile, NULL);
+    ok(ret || GetLastError() == ERROR_NOT_FOUND, "CancelIoEx failed, error %u.\n", GetLastError());
+    for (i = 0; i < ARRAY_SIZE(ovs); i++)
+    {
+        ret = GetOverlappedResult(hfile, &ovs[i], &size, TRUE);
+        ok((ret && size == sizeof(buffers[i])) || (!ret && GetLastError() == ERROR_OPERATION_ABORTED),
+           "%d: unexpected result %d, size %u, error %u.\n", i, ret, size, GetLastError());
+    }
+
+    /* completions go to the port the file is bound to */
+    port = CreateIoCompletionPort(hfile, NULL, 0xdeadbeef, 0);
+    ok(!!port, "CreateIoCompletionPort failed, error %u.\n", GetLastError());
+    memset(&ov, 0, sizeof(ov));
+    ret = ReadFile(hfile, buffers[0], sizeof(buffers[0]), NULL, &ov);
+    ok(ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed, error %u.\n", GetLastError());
+    ret = GetQueuedCompletionStatus(port, &size, &key, &povl, 5000);
+    ok(ret, "GetQueuedCompletionStatus failed, error %u.\n", GetLastError());
+    ok(key == 0xdeadbeef, "got key %#lx.\n", key);
+    ok(povl == &ov, "got overlapped %p.\n", povl);
+    ok(size == sizeof(buffers[0]), "got size %u.\n", size);
+
+    for (i = 0; i < ARRAY_SIZE(ovs); i++) CloseHandle(ovs[i].hEvent);
+    CloseHandle(hfile);
+    CloseHandle(port);
+}
+
+static void test_overlapped_queue_uring(void)
+{
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION info;
+    char **argv, buf[MAX_PATH];
+    BOOL ret;
+
+    /* run the overlapped tests again with the io_uring path enabled */
+    SetEnvironmentVariableA("WINEIOURING", "1");
+    winetest_get_mainargs(&argv);
+    sprintf(buf, "\"%s\" file overlapped_queue", argv[0]);
+    ret = CreateProcessA(NULL, buf, NULL, NULL, FALSE, 0, NULL, NULL, &si, &info);
+    ok(ret, "CreateProcess failed, error %u.\n", GetLastError());
+    SetEnvironmentVariableA("WINEIOURING", NULL);
+    CloseHandle(info.hThread);
+    wait_child_process(info.hProcess);
+    CloseHandle(info.hProcess);
+}
+
 static void test_file_readonly_access(void)
 {
     static const DWORD default_sharing = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
@@ -6132,11 +6302,20 @@ static void test_eof(void)
 
 START_TEST(file)
 {
-    char temp_path[MAX_PATH];
+    char temp_path[MAX_PATH], **argv;
     DWORD ret;
+    int argc;
 
     InitFunctionPointers();
 
+    argc = winetest_get_mainargs(&argv);
+    if (argc >= 3 && !strcmp(argv[2], "overlapped_queue"))
+    {
+        test_overlapped_queue();
+    test_overlapped_queue_uring();
+        return;
+    }
+
     ret = GetTempPathA(MAX_PATH, temp_path);
     ok(ret != 0, "GetTempPath error %u\n", GetLastError());
     ret = GetTempFileNameA(temp_path, "tmp", 0, filename);
@@ -6201,6 +6380,7 @@ START_TEST(file)
     test_GetFileAttributesExW();
     test_post_completion();
     test_overlapped_read();
+    test_overlapped_queue();
     test_file_readonly_access();
     test_find_file_stream();
     test_SetFileTime();
@@ -42,6 +42,7 @@
 static LPVOID (WINAPI *pHeapAlloc)(HANDLE,DWORD,SIZE_T);
 static LPVOID (WINAPI *pHeapReAlloc)(HANDLE,DWORD,LPVOID,SIZE_T);
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static BOOL (WINAPI *pGetPhysicallyInstalledSystemMemory)(ULONGLONG *);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
@@ -889,6 +890,145 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+static void test_HeapSetInformation(void)
+{
+    HANDLE heap;
+    ULONG info;
+    BOOL ret;
+    BYTE *ptrs[64];
+    SIZE_T size;
+    int i, j;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapSetInformation || !pHeapQueryInformation)
+    {
+        win_skip("HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate( HEAP_NO_SERIALIZE, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !ret, "HeapSetInformation succeeded\n" );
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    ok( info == 0, "expected 0, got %u\n", info );
+    HeapDestroy( heap );
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( heap != NULL, "HeapCreate failed\n" );
+
+    info = 0;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) - 1 );
+    ok( !ret, "HeapSetInformation succeeded\n" );
+
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( ret, "HeapSetInformation error %u\n", GetLastError() );
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    ok( info == 2, "expected 2, got %u\n", info );
+
+    /* the low-fragmentation heap cannot be disabled */
+    info = 0;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !ret, "HeapSetInformation succeeded\n" );
+
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(ptrs); j++)
+        {
+            size = (j * 37 + i) % 0x300 + 1;
+            ptrs[j] = HeapAlloc( heap, (j & 1) ? HEAP_ZERO_MEMORY : 0, size );
+            ok( ptrs[j] != NULL, "HeapAlloc failed\n" );
+            ok( HeapSize( heap, 0, ptrs[j] ) == size, "wrong size %lu/%lu\n",
+                HeapSize( heap, 0, ptrs[j] ), size );
+            if (j & 1) ok( !ptrs[j][size - 1], "block not zeroed\n" );
+            memset( ptrs[j], 0xcc, size );
+        }
+        ret = HeapValidate( heap, 0, NULL );
+        ok( ret, "HeapValidate failed\n" );
+        for (j = 0; j < ARRAY_SIZE(ptrs); j++)
+        {
+            ret = HeapFree( heap, 0, ptrs[j] );
+            ok( ret, "HeapFree failed\n" );
+        }
+        ret = HeapValidate( heap, 0, NULL );
+        ok( ret, "HeapValidate failed\n" );
+    }
+
+    HeapDestroy( heap );
+}
+
+struct heap_thread_params
+{
+    HANDLE heap;
+    LONG   count;
+};
+
+static DWORD WINAPI heap_thread_proc( void *arg )
+{
+    struct heap_thread_params *params = arg;
+    BYTE *ptrs[16] = {0};
+    LONG i;
+
+    for (i = 0; i < params->count; i++)
+    {
+        unsigned int idx = (i * 7) % ARRAY_SIZE(ptrs);
+
+        if (ptrs[idx])
+        {
+            ok( ptrs[idx][0] == (BYTE)idx, "block %p overwritten\n", ptrs[idx] );
+            HeapFree( params->heap, 0, ptrs[idx] );
+        }
+        ptrs[idx] = HeapAlloc( params->heap, 0, (i * 13) % 0x200 + 1 );
+        ok( ptrs[idx] != NULL, "HeapAlloc failed\n" );
+        if (!ptrs[idx]) break;
+        ptrs[idx][0] = idx;
+    }
+    for (i = 0; i < ARRAY_SIZE(ptrs); i++) HeapFree( params->heap, 0, ptrs[i] );
+    return 0;
+}
+
+static void test_heap_threads(void)
+{
+    struct heap_thread_params params;
+    HANDLE threads[8];
+    DWORD start, elapsed;
+    ULONG info = 2;
+    unsigned int i, count;
+    BOOL ret;
+
+    params.heap = HeapCreate( 0, 0, 0 );
+    ok( params.heap != NULL, "HeapCreate failed\n" );
+    params.count = 10000;
+    if (pHeapSetInformation)
+        pHeapSetInformation( params.heap, HeapCompatibilityInformation, &info, sizeof(info) );
+
+    for (count = 1; count <= ARRAY_SIZE(threads); count *= 2)
+    {
+        start = GetTickCount();
+        for (i = 0; i < count; i++)
+        {
+            threads[i] = CreateThread( NULL, 0, heap_thread_proc, &params, 0, NULL );
+            ok( threads[i] != NULL, "CreateThread failed %u\n", GetLastError() );
+        }
+        WaitForMultipleObjects( count, threads, TRUE, INFINITE );
+        elapsed = max( GetTickCount() - start, 1 );
+        for (i = 0; i < count; i++) CloseHandle( threads[i] );
+
+        trace( "%u threads: %u alloc/free per second\n", count,
+               (DWORD)((ULONGLONG)count * params.count * 1000 / elapsed) );
+        ret = HeapValidate( params.heap, 0, NULL );
+        ok( ret, "HeapValidate failed\n" );
+    }
+
+    HeapDestroy( params.heap );
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -1296,6 +1436,8 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), 1);
 
     test_HeapQueryInformation();
+    test_HeapSetInformation();
+    test_heap_threads();
     test_GetPhysicallyInstalledSystemMemory();
     test_GlobalMemoryStatus();
 
@@ -4028,6 +4028,135 @@ static void test_LoadPackagedLibrary(void)
             h, GetLastError());
 }
 
+struct reloc_test_data
+{
+    ULONG_PTR            ptr;  /* points to str once relocated */
+    char                 str[16];
+    IMAGE_BASE_RELOCATION reloc;
+    USHORT               relocs[2];
+};
+
+static void write_reloc_test_dll( const char *dll_name, const char *str )
+{
+    struct reloc_test_data data;
+    IMAGE_SECTION_HEADER section;
+    IMAGE_NT_HEADERS nt;
+    DWORD dummy;
+    HANDLE hfile;
+
+#define DATA_RVA(ptr) (page_size + ((char *)(ptr) - (char *)&data))
+    nt = nt_header_template;
+    nt.FileHeader.NumberOfSections = 1;
+    nt.FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER);
+    nt.FileHeader.Characteristics = IMAGE_FILE_EXECUTABLE_IMAGE | IMAGE_FILE_32BIT_MACHINE | IMAGE_FILE_DLL;
+    nt.OptionalHeader.AddressOfEntryPoint = 0;
+    nt.OptionalHeader.SectionAlignment = page_size;
+    nt.OptionalHeader.FileAlignment = 0x200;
+    nt.OptionalHeader.ImageBase = 0x12340000;
+    nt.OptionalHeader.SizeOfImage = 3 * page_size;
+    nt.OptionalHeader.SizeOfHeaders = nt.OptionalHeader.FileAlignment;
+    nt.OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+    memset( nt.OptionalHeader.DataDirectory, 0, sizeof(nt.OptionalHeader.DataDirectory) );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress = DATA_RVA( &data.reloc );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].Size = sizeof(data.reloc) + sizeof(data.relocs);
+
+    memset( &data, 0, sizeof(data) );
+    data.ptr = nt.OptionalHeader.ImageBase + DATA_RVA( data.str );
+    strcpy( data.str, str );
+    data.reloc.VirtualAddress = page_size;
+    data.reloc.SizeOfBlock = sizeof(data.reloc) + sizeof(data.relocs);
+    data.relocs[0] = ((sizeof(void *) == 8 ? IMAGE_REL_BASED_DIR64 : IMAGE_REL_BASED_HIGHLOW) << 12) |
+                     offsetof( struct reloc_test_data, ptr );
+    data.relocs[1] = IMAGE_REL_BASED_ABSOLUTE << 12;
+
+    memset( &section, 0, sizeof(section) );
+    memcpy( section.Name, ".data", sizeof(".data") );
+    section.PointerToRawData = nt.OptionalHeader.FileAlignment;
+    section.VirtualAddress = nt.OptionalHeader.SectionAlignment;
+    section.Misc.VirtualSize = sizeof(data);
+    section.SizeOfRawData = sizeof(data);
+    section.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+
+    hfile = CreateFileA( dll_name, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, 0 );
+    ok( hfile != INVALID_HANDLE_VALUE, "creation failed err %u\n", GetLastError() );
+    WriteFile( hfile, &dos_header, sizeof(dos_header), &dummy, NULL );
+    WriteFile( hfile, &nt, sizeof(nt), &dummy, NULL );
+    WriteFile( hfile, &section, sizeof(section), &dummy, NULL );
+    SetFilePointer( hfile, section.PointerToRawData, NULL, SEEK_SET );
+    WriteFile( hfile, &data, sizeof(data), &dummy, NULL );
+    CloseHandle( hfile );
+#undef DATA_RVA
+}
+
+static void check_reloc_test_dll( const char *dll_name, const char *str )
+{
+    const struct reloc_test_data *data;
+    HMODULE mod;
+
+    mod = LoadLibraryA( dll_name );
+    ok( mod != NULL, "failed to load err %u\n", GetLastError() );
+    if (!mod) return;
+    ok( mod != (HMODULE)0x12340000, "dll loaded at its preferred base\n" );
+    data = (const struct reloc_test_data *)((char *)mod + page_size);
+    ok( data->ptr == (ULONG_PTR)data->str, "pointer %p, expected %p\n", (void *)data->ptr, data->str );
+    ok( !strcmp( data->str, str ), "got %s, expected %s\n", data->str, str );
+    FreeLibrary( mod );
+}
+
+/* runs with WINERELOCCACHE enabled */
+static void test_reloc_cache_child(void)
+{
+    char temp_path[MAX_PATH], dll_name[MAX_PATH];
+    FILETIME ctime, atime, mtime;
+    HANDLE hfile;
+    void *base;
+
+    base = VirtualAlloc( (void *)0x12340000, 3 * page_size, MEM_RESERVE, PAGE_NOACCESS );
+    ok( base != NULL, "failed to reserve the dll base err %u\n", GetLastError() );
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "ldr", 0, dll_name );
+    write_reloc_test_dll( dll_name, "hello" );
+
+    /* the second load maps the image saved by the first one if it ends up at the same address */
+    check_reloc_test_dll( dll_name, "hello" );
+    check_reloc_test_dll( dll_name, "hello" );
+
+    /* a modified file must not use the cached image, even with the same size and time */
+    hfile = CreateFileA( dll_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0 );
+    GetFileTime( hfile, &ctime, &atime, &mtime );
+    CloseHandle( hfile );
+    write_reloc_test_dll( dll_name, "world" );
+    hfile = CreateFileA( dll_name, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0 );
+    SetFileTime( hfile, &ctime, &atime, &mtime );
+    CloseHandle( hfile );
+    check_reloc_test_dll( dll_name, "world" );
+    check_reloc_test_dll( dll_name, "world" );
+
+    DeleteFileA( dll_name );
+    VirtualFree( base, 0, MEM_RELEASE );
+}
+
+static void test_reloc_cache(void)
+{
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    char cmdline[MAX_PATH + 32];
+    char **argv;
+    BOOL ret;
+
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" loader reloc_cache", argv[0] );
+    SetEnvironmentVariableA( "WINERELOCCACHE", "1" );
+    ret = CreateProcessA( argv[0], cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+    ok( ret, "CreateProcess(%s) error %u\n", cmdline, GetLastError() );
+    SetEnvironmentVariableA( "WINERELOCCACHE", NULL );
+    if (!ret) return;
+    wait_child_process( pi.hProcess );
+    CloseHandle( pi.hThread );
+    CloseHandle( pi.hProcess );
+}
+
 static void test_Wow64Transition(void)
 {
     char buffer[400];
@@ -4112,6 +4241,11 @@ START_TEST(loader)
         *child_failures = -1;
 
     argc = winetest_get_mainargs(&argv);
+    if (argc > 2 && !strcmp( argv[2], "reloc_cache" ))
+    {
+        test_reloc_cache_child();
+        return;
+    }
     if (argc > 4)
     {
         test_dll_phase = atoi(argv[4]);
@@ -4133,6 +4267,7 @@ START_TEST(loader)
     test_dll_file( "advapi32.dll" );
     test_dll_file( "user32.dll" );
     test_Wow64Transition();
+    test_reloc_cache();
     /* loader test must be last, it can corrupt the internal loader state on Windows */
     test_Loader();
 }
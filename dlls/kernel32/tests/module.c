@@ -323,6 +323,49 @@ static void testGetProcAddress_Wrong(void)
     ok( GetLastError() == ERROR_MOD_NOT_FOUND, "Expected ERROR_MOD_NOT_FOUND, got %d\n", GetLastError() );
 }
 
+static void testGetProcAddress_many(void)
+{
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    const IMAGE_NT_HEADERS *nt;
+    const DWORD *names;
+    HMODULE module;
+    FARPROC *procs;
+    const char *name = NULL;
+    char path[MAX_PATH], *p;
+    DWORD i, pass;
+
+    module = GetModuleHandleA( "ntdll.dll" );
+    ok( module != NULL, "ntdll.dll not loaded\n" );
+    ok( GetModuleHandleA( "NTDLL.DLL" ) == module, "wrong module for upper case name\n" );
+    GetModuleFileNameA( module, path, MAX_PATH );
+    ok( GetModuleHandleA( path ) == module, "wrong module for %s\n", path );
+    for (p = path; *p; p++) if (*p >= 'a' && *p <= 'z') *p += 'A' - 'a';
+    ok( GetModuleHandleA( path ) == module, "wrong module for %s\n", path );
+
+    nt = (const IMAGE_NT_HEADERS *)((const char *)module + ((const IMAGE_DOS_HEADER *)module)->e_lfanew);
+    exports = (const IMAGE_EXPORT_DIRECTORY *)((const char *)module +
+               nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress);
+    names = (const DWORD *)((const char *)module + exports->AddressOfNames);
+    procs = HeapAlloc( GetProcessHeap(), 0, exports->NumberOfNames * sizeof(*procs) );
+
+    /* the results must not depend on how often the module has been searched */
+    for (pass = 0; pass < 3; pass++)
+    {
+        for (i = 0; i < exports->NumberOfNames; i++)
+        {
+            FARPROC proc;
+
+            name = (const char *)module + names[i];
+            proc = GetProcAddress( module, name );
+            if (!pass) procs[i] = proc;
+            else if (proc != procs[i]) break;
+        }
+        ok( i == exports->NumberOfNames, "pass %u: got different address for %s\n", pass, name );
+        ok( !GetProcAddress( module, "non_ex_call" ), "non_ex_call should not be found\n" );
+    }
+    HeapFree( GetProcessHeap(), 0, procs );
+}
+
 static void testLoadLibraryEx(void)
 {
     CHAR path[MAX_PATH];
@@ -1635,6 +1678,7 @@ START_TEST(module)
     testNestedLoadLibraryA();
     testLoadLibraryA_Wrong();
     testGetProcAddress_Wrong();
+    testGetProcAddress_many();
     testLoadLibraryEx();
     test_LoadLibraryEx_search_flags();
     testGetModuleHandleEx();
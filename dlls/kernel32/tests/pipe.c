@@ -4202,6 +4202,100 @@ static void test_exit_process_async(void)
     CloseHandle(server);
 }
 
+/* byte mode pipes created with WINEDIRECTPIPES set pass their data through a socket pair on Wine */
+static void test_direct_pipe(void)
+{
+    char buf[1000], read_buf[1000];
+    HANDLE server, client, flush;
+    OVERLAPPED overlapped;
+    DWORD mode, size;
+    BOOL res;
+
+    memset(buf, 0xaa, sizeof(buf));
+    create_overlapped_pipe(PIPE_TYPE_BYTE, &client, &server);
+
+    overlapped_write_sync(client, buf, 10);
+    overlapped_read_sync(server, read_buf, sizeof(read_buf), 10, FALSE);
+    ok(!memcmp(buf, read_buf, 10), "got wrong data\n");
+
+    /* the flush completes once the other end read the data */
+    overlapped_write_sync(server, buf, 100);
+    flush = test_flush_async(server, ERROR_SUCCESS);
+    test_peek_pipe(client, 100, 100, 0);
+    overlapped_read_sync(client, read_buf, 60, 60, FALSE);
+    test_not_signaled(flush);
+    overlapped_read_sync(client, read_buf, sizeof(read_buf), 40, FALSE);
+    test_flush_done(flush);
+
+    /* the pipe keeps working in both directions after a flush */
+    overlapped_write_sync(server, buf, 20);
+    overlapped_write_sync(client, buf, 30);
+    overlapped_read_sync(client, read_buf, sizeof(read_buf), 20, FALSE);
+    overlapped_read_sync(server, read_buf, sizeof(read_buf), 30, FALSE);
+    test_flush_sync(server);
+    test_flush_sync(client);
+
+    /* switching to nonblocking mode keeps the buffered data */
+    overlapped_write_sync(client, buf, 50);
+    overlapped_write_sync(server, buf, 40);
+    mode = PIPE_READMODE_BYTE | PIPE_NOWAIT;
+    res = SetNamedPipeHandleState(client, &mode, NULL, NULL);
+    ok(res, "SetNamedPipeHandleState failed: %u\n", GetLastError());
+    overlapped_read_sync(client, read_buf, sizeof(read_buf), 40, FALSE);
+    overlapped_read_sync(server, read_buf, sizeof(read_buf), 50, FALSE);
+    memset(&overlapped, 0, sizeof(overlapped));
+    res = ReadFile(client, read_buf, sizeof(read_buf), &size, &overlapped);
+    ok(!res && GetLastError() == ERROR_NO_DATA, "ReadFile returned %x (%u)\n", res, GetLastError());
+    CloseHandle(client);
+
+    /* the server end gets a new socket when it's connected again */
+    res = DisconnectNamedPipe(server);
+    ok(res, "DisconnectNamedPipe failed: %u\n", GetLastError());
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    res = ConnectNamedPipe(server, &overlapped);
+    ok(!res && GetLastError() == ERROR_IO_PENDING, "ConnectNamedPipe returned %x (%u)\n", res, GetLastError());
+    client = CreateFileA(PIPENAME, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+    ok(client != INVALID_HANDLE_VALUE, "CreateFile failed: %u\n", GetLastError());
+    test_overlapped_result(server, &overlapped, 0, FALSE);
+    CloseHandle(overlapped.hEvent);
+
+    overlapped_write_sync(server, buf, 10);
+    overlapped_read_sync(client, read_buf, sizeof(read_buf), 10, FALSE);
+    overlapped_write_sync(client, buf, 20);
+    overlapped_read_sync(server, read_buf, sizeof(read_buf), 20, FALSE);
+
+    /* the other end reads the remaining data before the pipe is broken */
+    overlapped_write_sync(server, buf, 30);
+    CloseHandle(server);
+    overlapped_read_sync(client, read_buf, sizeof(read_buf), 30, FALSE);
+    memset(&overlapped, 0, sizeof(overlapped));
+    res = ReadFile(client, read_buf, sizeof(read_buf), &size, &overlapped);
+    ok(!res && GetLastError() == ERROR_BROKEN_PIPE, "ReadFile returned %x (%u)\n", res, GetLastError());
+    CloseHandle(client);
+}
+
+static void test_direct_pipes(void)
+{
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA si = {0};
+    char cmdline[300];
+    char **argv;
+    BOOL ret;
+
+    winetest_get_mainargs(&argv);
+
+    si.cb = sizeof(si);
+    SetEnvironmentVariableA("WINEDIRECTPIPES", "1");
+    sprintf(cmdline, "%s pipe direct", argv[0]);
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+    ok(ret, "got error %u\n", GetLastError());
+    SetEnvironmentVariableA("WINEDIRECTPIPES", NULL);
+    wait_child_process(pi.hProcess);
+    CloseHandle(pi.hThread);
+    CloseHandle(pi.hProcess);
+}
+
 START_TEST(pipe)
 {
     char **argv;
@@ -4220,6 +4314,11 @@ START_TEST(pipe)
 
     argc = winetest_get_mainargs(&argv);
 
+    if (argc > 2 && !strcmp(argv[2], "direct"))
+    {
+        test_direct_pipe();
+        return;
+    }
     if (argc > 3)
     {
         if (!strcmp(argv[2], "writepipe"))
@@ -4282,4 +4381,5 @@ START_TEST(pipe)
     test_nowait(PIPE_TYPE_MESSAGE);
     test_GetOverlappedResultEx();
     test_exit_process_async();
+    test_direct_pipes();
 }
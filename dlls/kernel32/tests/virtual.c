@@ -444,6 +444,103 @@ static void test_VirtualAlloc(void)
     ok(VirtualFree(addr1, 0, MEM_RELEASE), "VirtualFree failed\n");
 }
 
+static void test_VirtualAlloc_large_pages(void)
+{
+    SIZE_T size = GetLargePageMinimum();
+    char *p;
+
+    if (!size)
+    {
+        skip("large pages are not supported\n");
+        return;
+    }
+    ok(!(size & (size - 1)), "large page size %#lx is not a power of 2\n", size);
+
+    SetLastError(0xdeadbeef);
+    p = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(!p, "VirtualAlloc succeeded\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER || GetLastError() == ERROR_PRIVILEGE_NOT_HELD,
+       "got error %u\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    p = VirtualAlloc(NULL, size + 0x1000, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(!p, "VirtualAlloc succeeded\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER || GetLastError() == ERROR_PRIVILEGE_NOT_HELD,
+       "got error %u\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    p = VirtualAlloc(NULL, 2 * size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (!p)
+    {
+        /* SeLockMemoryPrivilege is needed on Windows */
+        ok(GetLastError() == ERROR_PRIVILEGE_NOT_HELD, "got error %u\n", GetLastError());
+        return;
+    }
+    ok(!((ULONG_PTR)p & (size - 1)), "got unaligned address %p\n", p);
+    p[0] = 1;
+    p[2 * size - 1] = 2;
+    ok(p[0] == 1 && p[2 * size - 1] == 2, "wrong data\n");
+    ok(VirtualFree(p, 0, MEM_RELEASE), "VirtualFree failed\n");
+}
+
+static DWORD WINAPI virtual_stress_thread(void *arg)
+{
+    HANDLE start = arg;
+    MEMORY_BASIC_INFORMATION info;
+    DWORD old_prot;
+    unsigned int i;
+    SIZE_T size;
+    char *p;
+    BOOL ret;
+
+    WaitForSingleObject(start, INFINITE);
+    for (i = 0; i < 500; i++)
+    {
+        p = VirtualAlloc(NULL, 0x10000, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        ok(p != NULL, "VirtualAlloc failed %u\n", GetLastError());
+        if (!p) break;
+        p[0x2000] = 1;
+
+        ok(VirtualFree(p + 0x8000, 0x1000, MEM_DECOMMIT), "VirtualFree failed %u\n", GetLastError());
+        ok(VirtualAlloc(p + 0x8000, 0x1000, MEM_COMMIT, PAGE_READWRITE) == p + 0x8000,
+           "VirtualAlloc failed %u\n", GetLastError());
+        p[0x8000] = 2;
+
+        ret = VirtualProtect(p + 0x1000, 0x2000, PAGE_READONLY, &old_prot);
+        ok(ret, "VirtualProtect failed %u\n", GetLastError());
+        ok(old_prot == PAGE_READWRITE, "got old prot %#x\n", old_prot);
+
+        size = VirtualQuery(p + 0x1000, &info, sizeof(info));
+        ok(size == sizeof(info), "VirtualQuery failed %u\n", GetLastError());
+        ok(info.AllocationBase == p, "got base %p, expected %p\n", info.AllocationBase, p);
+        ok(info.RegionSize == 0x2000, "got size %#lx\n", info.RegionSize);
+        ok(info.Protect == PAGE_READONLY, "got prot %#x\n", info.Protect);
+        ok(p[0x2000] == 1, "wrong data\n");
+        ok(p[0x8000] == 2, "wrong data\n");
+
+        ret = VirtualFree(p, 0, MEM_RELEASE);
+        ok(ret, "VirtualFree failed %u\n", GetLastError());
+    }
+    return 0;
+}
+
+static void test_VirtualAlloc_threads(void)
+{
+    HANDLE threads[NUM_THREADS], start;
+    unsigned int i;
+
+    start = CreateEventA(NULL, TRUE, FALSE, NULL);
+    for (i = 0; i < NUM_THREADS; i++)
+        threads[i] = CreateThread(NULL, 0, virtual_stress_thread, start, 0, NULL);
+    SetEvent(start);
+    for (i = 0; i < NUM_THREADS; i++)
+    {
+        ok(!WaitForSingleObject(threads[i], 60000), "wait failed\n");
+        CloseHandle(threads[i]);
+    }
+    CloseHandle(start);
+}
+
 static void test_VirtualAllocFromApp(void)
 {
     void *p;
@@ -4309,6 +4406,8 @@ START_TEST(virtual)
     test_VirtualProtect();
     test_VirtualAllocEx();
     test_VirtualAlloc();
+    test_VirtualAlloc_large_pages();
+    test_VirtualAlloc_threads();
     test_VirtualAllocFromApp();
     test_MapViewOfFile();
     test_NtAreMappedFilesTheSame();
@@ -409,6 +409,8 @@ BOOL WINAPI DECLSPEC_HOTPATCH CloseHandle( HANDLE handle )
         handle = InterlockedExchangePointer( &NtCurrentTeb()->Peb->ProcessParameters->hStdOutput, 0 );
     else if (handle == (HANDLE)STD_ERROR_HANDLE)
         handle = InterlockedExchangePointer( &NtCurrentTeb()->Peb->ProcessParameters->hStdError, 0 );
+    else
+        unmap_key_handle( handle );  /* registry keys may be closed with CloseHandle too */
 
     return set_ntstatus( NtClose( handle ));
 }
@@ -46,6 +46,7 @@
 #include "wine/list.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(reg);
+WINE_DECLARE_DEBUG_CHANNEL(regcache);
 
 #define HKEY_SPECIAL_ROOT_FIRST   HKEY_CLASSES_ROOT
 #define HKEY_SPECIAL_ROOT_LAST    HKEY_DYN_DATA
@@ -63,6 +64,7 @@ static const WCHAR * const root_key_names[] =
 
 static HKEY special_root_keys[ARRAY_SIZE(root_key_names)];
 static BOOL cache_disabled[ARRAY_SIZE(root_key_names)];
+static BOOL root_remapped[ARRAY_SIZE(root_key_names)];
 
 static CRITICAL_SECTION reg_mui_cs;
 static CRITICAL_SECTION_DEBUG reg_mui_cs_debug =
@@ -385,6 +387,7 @@ NTSTATUS WINAPI RemapPredefinedHandleInternal( HKEY hkey, HKEY override )
         if (status) return status;
     }
 
+    root_remapped[idx] = TRUE;
     old_key = InterlockedExchangePointer( (void **)&special_root_keys[idx], override );
     if (old_key) NtClose( old_key );
     return STATUS_SUCCESS;
@@ -414,6 +417,570 @@ NTSTATUS WINAPI DisablePredefinedHandleTableInternal( HKEY hkey )
 }
 
 
+/* Cache of the registry values queried through RegQueryValueEx, enabled
+ * with WINEREGCACHE. Cache entries are keyed by the full name of the key,
+ * which is computed from the parent name when the handle is opened through
+ * RegOpenKeyEx or RegCreateKeyEx, so that all the handles to a key share the
+ * same values. Each entry keeps its own handle to the key object with a
+ * change notification armed on it; the server signals the event when a value
+ * or subkey is modified, and when the key is deleted, so that checking the
+ * event is enough to know that the cached values are still current.
+ *
+ * A name may not always refer to the same key object, e.g. when a symlink is
+ * retargeted, and a handle closed with NtClose may be reused for another key
+ * without the cache knowing about it. So the first time an application handle
+ * is used, it is checked to be the same object as the cache entry, and a
+ * notification is armed on the handle itself; since the server never reports
+ * attribute changes, that event is only signaled when the handle is closed or
+ * the key is deleted, and the handle is no longer used with the cache then. */
+
+#define REG_CACHE_MAX_KEYS    256
+#define REG_CACHE_MAX_VALUES  64
+#define REG_CACHE_MAX_DATA    4096
+#define REG_CACHE_HANDLE_HASH 64
+#define REG_CACHE_MAX_EVENTS  16
+
+struct cached_value
+{
+    struct list  entry;
+    NTSTATUS     status;     /* STATUS_SUCCESS or STATUS_OBJECT_NAME_NOT_FOUND */
+    DWORD        type;
+    DWORD        name_len;   /* in bytes */
+    DWORD        data_len;
+    WCHAR       *name;
+    BYTE        *data;
+};
+
+struct cached_key
+{
+    struct list  entry;
+    HANDLE       hkey;       /* private handle to the key object */
+    HANDLE       event;      /* signaled on changes to the key, or when it is deleted */
+    unsigned int serial;     /* unique id, changed every time the cached values are discarded */
+    unsigned int value_count;
+    struct list  values;     /* MRU */
+    unsigned int hash;       /* hash of the key name */
+    DWORD        path_len;   /* in chars */
+    WCHAR        path[1];    /* full NT name of the key */
+};
+
+/* key handle opened by the application */
+struct key_handle
+{
+    struct list  entry;
+    HKEY         hkey;
+    HANDLE       event;      /* signaled when the handle is closed, 0 until it is checked */
+    unsigned int hash;       /* hash of the key name */
+    DWORD        path_len;   /* in chars */
+    WCHAR        path[1];    /* full NT name of the key */
+};
+
+static CRITICAL_SECTION reg_cache_cs;
+static CRITICAL_SECTION_DEBUG reg_cache_cs_debug =
+{
+    0, 0, &reg_cache_cs,
+    { &reg_cache_cs_debug.ProcessLocksList,
+      &reg_cache_cs_debug.ProcessLocksList },
+    0, 0, { (DWORD_PTR)(__FILE__ ": reg_cache_cs") }
+};
+static CRITICAL_SECTION reg_cache_cs = { &reg_cache_cs_debug, -1, 0, 0, 0, 0 };
+static struct list reg_cache_keys = LIST_INIT(reg_cache_keys); /* MRU */
+static struct list reg_cache_handles[REG_CACHE_HANDLE_HASH];
+static unsigned int reg_cache_key_count;
+static HANDLE reg_cache_events[REG_CACHE_MAX_EVENTS];  /* unused handle events */
+static unsigned int reg_cache_event_count;
+static int reg_cache_enabled = -1;
+static WCHAR *reg_cache_roots;  /* list of null-terminated key names, ending with an empty string */
+static UNICODE_STRING reg_cache_user_path;  /* name of the HKEY_CURRENT_USER key */
+static unsigned int reg_cache_serial;
+static unsigned int reg_cache_generation;  /* incremented every time a deleted key is found */
+static unsigned int reg_cache_hits, reg_cache_misses;
+
+static void trace_reg_cache_stats(void)
+{
+    if ((reg_cache_hits + reg_cache_misses) % 1024) return;
+    TRACE_(regcache)( "%u hits, %u misses, %u keys\n", reg_cache_hits, reg_cache_misses, reg_cache_key_count );
+}
+
+/* parse the WINEREGCACHE variable; must be called with reg_cache_cs held */
+static BOOL init_reg_cache(void)
+{
+    WCHAR *p, *q, *start, *buffer;
+    DWORD len;
+    unsigned int i;
+
+    if (reg_cache_enabled != -1) return reg_cache_enabled;
+    reg_cache_enabled = 0;
+
+    if (!(len = GetEnvironmentVariableW( L"WINEREGCACHE", NULL, 0 ))) return FALSE;
+    if (!(buffer = heap_alloc( (len + 1) * sizeof(WCHAR) ))) return FALSE;
+    GetEnvironmentVariableW( L"WINEREGCACHE", buffer, len );
+
+    if (buffer[0] != '\\')
+    {
+        /* a boolean value enables caching for HKEY_LOCAL_MACHINE */
+        BOOL enable = IS_OPTION_TRUE( buffer[0] );
+
+        heap_free( buffer );
+        if (!enable) return FALSE;
+        if (!(buffer = heap_alloc( sizeof(L"\\Registry\\Machine") + sizeof(WCHAR) ))) return FALSE;
+        lstrcpyW( buffer, L"\\Registry\\Machine" );
+        buffer[ARRAY_SIZE(L"\\Registry\\Machine")] = 0;
+    }
+    else
+    {
+        /* semicolon-separated list of key names, stored as a double null-terminated list */
+        for (p = q = start = buffer; ; p++)
+        {
+            if (*p && *p != ';')
+            {
+                *q++ = *p;
+                continue;
+            }
+            while (q > start && q[-1] == '\\') q--;
+            if (q > start)
+            {
+                *q++ = 0;
+                start = q;
+            }
+            if (!*p) break;
+        }
+        *q = 0;
+    }
+    for (i = 0; i < REG_CACHE_HANDLE_HASH; i++) list_init( &reg_cache_handles[i] );
+    if (RtlFormatCurrentUserKeyPath( &reg_cache_user_path )) reg_cache_user_path.Buffer = NULL;
+    reg_cache_roots = buffer;
+    reg_cache_enabled = 1;
+    for (p = reg_cache_roots; *p; p += lstrlenW( p ) + 1) TRACE( "caching values under %s\n", debugstr_w(p) );
+    return TRUE;
+}
+
+static unsigned int hash_key_path( const WCHAR *path, DWORD len )
+{
+    unsigned int hash = 0;
+
+    while (len--) hash = hash * 31 + towupper( *path++ );
+    return hash;
+}
+
+/* check if a key name is located under one of the cached subtrees */
+static BOOL is_cacheable_path( const WCHAR *path, DWORD len )
+{
+    const WCHAR *root;
+    DWORD root_len;
+
+    for (root = reg_cache_roots; *root; root += root_len + 1)
+    {
+        root_len = lstrlenW( root );
+        if (len < root_len || wcsnicmp( path, root, root_len )) continue;
+        if (len == root_len || path[root_len] == '\\') return TRUE;
+    }
+    return FALSE;
+}
+
+/* get the name of a predefined key, or of the handle it is mapped to */
+static BOOL get_root_key_path( HKEY hkey, const WCHAR **path, DWORD *len )
+{
+    unsigned int idx;
+
+    if ((HandleToUlong(hkey) >= HandleToUlong(HKEY_SPECIAL_ROOT_FIRST))
+            && (HandleToUlong(hkey) <= HandleToUlong(HKEY_SPECIAL_ROOT_LAST)))
+        idx = HandleToUlong(hkey) - HandleToUlong(HKEY_SPECIAL_ROOT_FIRST);
+    else
+    {
+        for (idx = 0; idx < ARRAY_SIZE(special_root_keys); idx++)
+            if (hkey && special_root_keys[idx] == hkey) break;
+        if (idx == ARRAY_SIZE(special_root_keys)) return FALSE;
+    }
+
+    /* an overridden root may point anywhere */
+    if (root_remapped[idx]) return FALSE;
+
+    if (idx == HandleToUlong(HKEY_CURRENT_USER) - HandleToUlong(HKEY_SPECIAL_ROOT_FIRST))
+    {
+        *path = reg_cache_user_path.Buffer;
+        *len = reg_cache_user_path.Length / sizeof(WCHAR);
+    }
+    else if ((*path = root_key_names[idx])) *len = lstrlenW( *path );
+    return *path != NULL;
+}
+
+static struct list *get_key_handle_bucket( HKEY hkey )
+{
+    return &reg_cache_handles[(HandleToUlong(hkey) >> 2) % REG_CACHE_HANDLE_HASH];
+}
+
+static struct key_handle *find_key_handle( HKEY hkey )
+{
+    struct key_handle *handle;
+
+    LIST_FOR_EACH_ENTRY( handle, get_key_handle_bucket( hkey ), struct key_handle, entry )
+        if (handle->hkey == hkey) return handle;
+    return NULL;
+}
+
+static void free_key_handle( struct key_handle *handle )
+{
+    list_remove( &handle->entry );
+    /* the event is reset when it's armed again, a late signal from the old handle only
+     * means that the next handle using it is not cached */
+    if (handle->event && reg_cache_event_count < REG_CACHE_MAX_EVENTS)
+        reg_cache_events[reg_cache_event_count++] = handle->event;
+    else if (handle->event) NtClose( handle->event );
+    heap_free( handle );
+}
+
+static unsigned int get_reg_cache_generation(void)
+{
+    return *(volatile unsigned int *)&reg_cache_generation;
+}
+
+/* remember the full name of a key handle opened by the application, without querying the server;
+ * generation must be retrieved before opening the key */
+static void map_key_handle( HKEY hkey, HKEY parent, const UNICODE_STRING *name, DWORD options,
+                            REGSAM access, unsigned int generation )
+{
+    struct key_handle *handle, *parent_handle;
+    const WCHAR *parent_path;
+    DWORD i, len, parent_len, name_len = name->Length / sizeof(WCHAR);
+
+    if (!reg_cache_enabled || is_perf_key( hkey )) return;
+    /* symlinks and Wow64 redirection would make the name ambiguous */
+    if (options & (REG_OPTION_OPEN_LINK | REG_OPTION_CREATE_LINK)) return;
+    if (access & (KEY_WOW64_32KEY | KEY_WOW64_64KEY)) return;
+    /* the cache must not allow queries that would fail on the handle */
+    if (!(access & (KEY_QUERY_VALUE | GENERIC_READ | GENERIC_ALL))) return;
+    /* closing the handle is detected with a notification */
+    if (!(access & (KEY_NOTIFY | GENERIC_READ | GENERIC_ALL))) return;
+    if (name_len && name->Buffer[0] == '\\') return;
+
+    EnterCriticalSection( &reg_cache_cs );
+    if (!init_reg_cache()) goto done;
+
+    /* a handle that was closed with NtClose may have been reused */
+    if ((handle = find_key_handle( hkey ))) free_key_handle( handle );
+
+    /* the key may have been deleted and recreated since it was opened */
+    if (generation != reg_cache_generation) goto done;
+
+    if (!get_root_key_path( parent, &parent_path, &parent_len ))
+    {
+        if (!(parent_handle = find_key_handle( parent ))) goto done;
+        parent_path = parent_handle->path;
+        parent_len = parent_handle->path_len;
+    }
+
+    if (!(handle = heap_alloc( offsetof( struct key_handle, path[parent_len + name_len + 1] )))) goto done;
+    memcpy( handle->path, parent_path, parent_len * sizeof(WCHAR) );
+    len = parent_len;
+
+    /* same parsing as the server, empty path elements are ignored */
+    for (i = 0; i < name_len; i++)
+    {
+        if (name->Buffer[i] == '\\') continue;
+        handle->path[len++] = '\\';
+        while (i < name_len && name->Buffer[i] != '\\') handle->path[len++] = name->Buffer[i++];
+    }
+
+    if (!is_cacheable_path( handle->path, len ))
+    {
+        heap_free( handle );
+        goto done;
+    }
+    handle->hkey = hkey;
+    handle->event = 0;
+    handle->path_len = len;
+    handle->hash = hash_key_path( handle->path, len );
+    list_add_head( get_key_handle_bucket( hkey ), &handle->entry );
+
+done:
+    LeaveCriticalSection( &reg_cache_cs );
+}
+
+/* forget about a key handle that is being closed */
+void unmap_key_handle( HANDLE hkey )
+{
+    struct key_handle *handle;
+
+    if (reg_cache_enabled != 1) return;
+
+    EnterCriticalSection( &reg_cache_cs );
+    if ((handle = find_key_handle( hkey ))) free_key_handle( handle );
+    LeaveCriticalSection( &reg_cache_cs );
+}
+
+/* forget about all the handles opened to a key that has been deleted */
+static void unmap_key_path( const struct cached_key *key )
+{
+    struct key_handle *handle, *next;
+    unsigned int i;
+
+    for (i = 0; i < REG_CACHE_HANDLE_HASH; i++)
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( handle, next, &reg_cache_handles[i], struct key_handle, entry )
+        {
+            if (handle->hash != key->hash || handle->path_len != key->path_len) continue;
+            if (wcsnicmp( handle->path, key->path, key->path_len )) continue;
+            free_key_handle( handle );
+        }
+    }
+}
+
+static void clear_cached_values( struct cached_key *key )
+{
+    struct cached_value *value, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( value, next, &key->values, struct cached_value, entry )
+    {
+        list_remove( &value->entry );
+        heap_free( value );
+    }
+    key->value_count = 0;
+    key->serial = ++reg_cache_serial;
+}
+
+static void free_cached_key( struct cached_key *key )
+{
+    list_remove( &key->entry );
+    clear_cached_values( key );
+    NtClose( key->event );
+    NtClose( key->hkey );
+    heap_free( key );
+    reg_cache_key_count--;
+}
+
+/* (re)arm the change notification, fails if the key has been deleted */
+static BOOL arm_cached_key( struct cached_key *key )
+{
+    IO_STATUS_BLOCK io;
+
+    return NtNotifyChangeKey( key->hkey, key->event, NULL, NULL, &io,
+                              REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET,
+                              FALSE, NULL, 0, TRUE ) == STATUS_PENDING;
+}
+
+/* open a private handle to the same key object as hkey, and start watching it */
+static BOOL open_cached_key( struct cached_key *key, HKEY hkey )
+{
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING nameW;
+    NTSTATUS status;
+
+    attr.Length = sizeof(attr);
+    attr.RootDirectory = hkey;
+    attr.ObjectName = &nameW;
+    attr.Attributes = OBJ_OPENLINK;
+    attr.SecurityDescriptor = NULL;
+    attr.SecurityQualityOfService = NULL;
+    RtlInitUnicodeString( &nameW, NULL );
+
+    status = NtOpenKeyEx( &key->hkey, KEY_NOTIFY | KEY_WOW64_64KEY, &attr, 0 );
+    if (status == STATUS_PREDEFINED_HANDLE) NtClose( key->hkey );
+    if (status) return FALSE;
+
+    if (!NtCreateEvent( &key->event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE ))
+    {
+        if (arm_cached_key( key )) return TRUE;
+        NtClose( key->event );
+    }
+    NtClose( key->hkey );
+    return FALSE;
+}
+
+/* find the cache entry for a key name, creating it from hkey if necessary;
+ * must be called with reg_cache_cs held */
+static struct cached_key *get_cached_key( HKEY hkey, const WCHAR *path, DWORD len, unsigned int hash,
+                                          BOOL *created )
+{
+    static const LARGE_INTEGER zero;
+    struct cached_key *key;
+
+    LIST_FOR_EACH_ENTRY( key, &reg_cache_keys, struct cached_key, entry )
+    {
+        if (key->hash != hash || key->path_len != len || wcsnicmp( key->path, path, len )) continue;
+        list_remove( &key->entry );
+        list_add_head( &reg_cache_keys, &key->entry );
+        *created = FALSE;
+        if (NtWaitForSingleObject( key->event, FALSE, &zero ) == STATUS_TIMEOUT) return key;
+
+        /* the key has been modified or deleted */
+        clear_cached_values( key );
+        if (arm_cached_key( key )) return key;
+
+        /* the name may now refer to a new key, so the existing handles can't be trusted */
+        TRACE_(regcache)( "%s deleted\n", debugstr_wn(key->path, key->path_len) );
+        unmap_key_path( key );
+        free_cached_key( key );
+        reg_cache_generation++;
+        return NULL;
+    }
+
+    if (!(key = heap_alloc_zero( offsetof( struct cached_key, path[len] )))) return NULL;
+    if (!open_cached_key( key, hkey ))
+    {
+        heap_free( key );
+        return NULL;
+    }
+    if (reg_cache_key_count >= REG_CACHE_MAX_KEYS)
+        free_cached_key( LIST_ENTRY( list_tail( &reg_cache_keys ), struct cached_key, entry ));
+
+    key->serial = ++reg_cache_serial;
+    key->hash = hash;
+    key->path_len = len;
+    memcpy( key->path, path, len * sizeof(WCHAR) );
+    list_init( &key->values );
+    list_add_head( &reg_cache_keys, &key->entry );
+    reg_cache_key_count++;
+    *created = TRUE;
+    return key;
+}
+
+/* check that an application handle refers to the object of a cache entry, and
+ * arm the notification that tells when the handle is closed */
+static BOOL watch_key_handle( struct key_handle *handle, const struct cached_key *key, BOOL created )
+{
+    IO_STATUS_BLOCK io;
+
+    if (!created && NtCompareObjects( handle->hkey, key->hkey )) return FALSE;
+
+    if (reg_cache_event_count) handle->event = reg_cache_events[--reg_cache_event_count];
+    else if (NtCreateEvent( &handle->event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE ))
+    {
+        handle->event = 0;
+        return FALSE;
+    }
+    return NtNotifyChangeKey( handle->hkey, handle->event, NULL, NULL, &io, REG_NOTIFY_CHANGE_ATTRIBUTES,
+                              FALSE, NULL, 0, TRUE ) == STATUS_PENDING;
+}
+
+/* find the cache entry for a key handle; must be called with reg_cache_cs held */
+static struct cached_key *get_cached_key_for_handle( HKEY hkey )
+{
+    static const LARGE_INTEGER zero;
+    struct key_handle *handle;
+    struct cached_key *key;
+    const WCHAR *path;
+    BOOL created;
+    DWORD len;
+
+    if ((handle = find_key_handle( hkey )))
+    {
+        if (!handle->event || NtWaitForSingleObject( handle->event, FALSE, &zero ) == STATUS_TIMEOUT)
+        {
+            /* this drops the handle if the key has been deleted */
+            if (!(key = get_cached_key( hkey, handle->path, handle->path_len, handle->hash, &created )))
+                return NULL;
+            if (handle->event || watch_key_handle( handle, key, created )) return key;
+            TRACE_(regcache)( "%p is not %s\n", hkey, debugstr_wn(key->path, key->path_len) );
+        }
+        /* the handle has been closed, or its name refers to another object now */
+        free_key_handle( handle );
+        return NULL;
+    }
+    if (get_root_key_path( hkey, &path, &len ) && is_cacheable_path( path, len ))
+        return get_cached_key( hkey, path, len, hash_key_path( path, len ), &created );
+    return NULL;
+}
+
+/* fill a KEY_VALUE_PARTIAL_INFORMATION buffer the same way NtQueryValueKey does */
+static NTSTATUS get_cached_value( const struct cached_value *value, KEY_VALUE_PARTIAL_INFORMATION *info,
+                                  DWORD length, DWORD *result_len )
+{
+    static const DWORD info_size = offsetof( KEY_VALUE_PARTIAL_INFORMATION, Data );
+    KEY_VALUE_PARTIAL_INFORMATION header;
+
+    if (value->status) return value->status;
+
+    header.TitleIndex = 0;
+    header.Type       = value->type;
+    header.DataLength = value->data_len;
+    memcpy( info, &header, min( length, info_size ));
+    if (length > info_size) memcpy( info->Data, value->data, min( length - info_size, value->data_len ));
+    *result_len = info_size + value->data_len;
+    if (length < info_size) return STATUS_BUFFER_TOO_SMALL;
+    if (length < *result_len) return STATUS_BUFFER_OVERFLOW;
+    return STATUS_SUCCESS;
+}
+
+static void add_cached_value( unsigned int serial, const UNICODE_STRING *name, NTSTATUS status,
+                              const KEY_VALUE_PARTIAL_INFORMATION *info )
+{
+    struct cached_key *key;
+    struct cached_value *value;
+    DWORD data_len = status ? 0 : info->DataLength;
+
+    if (data_len > REG_CACHE_MAX_DATA) return;
+
+    EnterCriticalSection( &reg_cache_cs );
+    /* don't store anything if the key has changed since the query was started */
+    LIST_FOR_EACH_ENTRY( key, &reg_cache_keys, struct cached_key, entry )
+    {
+        if (key->serial != serial) continue;
+
+        if (key->value_count >= REG_CACHE_MAX_VALUES)
+        {
+            value = LIST_ENTRY( list_tail( &key->values ), struct cached_value, entry );
+            list_remove( &value->entry );
+            heap_free( value );
+            key->value_count--;
+        }
+        if (!(value = heap_alloc( sizeof(*value) + name->Length + data_len ))) break;
+        value->status   = status;
+        value->type     = status ? REG_NONE : info->Type;
+        value->name_len = name->Length;
+        value->data_len = data_len;
+        value->name     = (WCHAR *)(value + 1);
+        value->data     = (BYTE *)value->name + name->Length;
+        memcpy( value->name, name->Buffer, name->Length );
+        if (data_len) memcpy( value->data, info->Data, data_len );
+        list_add_head( &key->values, &value->entry );
+        key->value_count++;
+        break;
+    }
+    LeaveCriticalSection( &reg_cache_cs );
+}
+
+/* same as NtQueryValueKey( KeyValuePartialInformation ), using the cache when possible */
+static NTSTATUS query_value_key( HKEY hkey, const UNICODE_STRING *name, KEY_VALUE_PARTIAL_INFORMATION *info,
+                                 DWORD length, DWORD *result_len )
+{
+    struct cached_key *key;
+    struct cached_value *value;
+    unsigned int serial = 0;
+    BOOL cacheable = FALSE;
+    NTSTATUS status;
+
+    if (!reg_cache_enabled) goto query;
+
+    EnterCriticalSection( &reg_cache_cs );
+    if (init_reg_cache() && (key = get_cached_key_for_handle( hkey )))
+    {
+        cacheable = TRUE;
+        serial = key->serial;
+        LIST_FOR_EACH_ENTRY( value, &key->values, struct cached_value, entry )
+        {
+            if (value->name_len != name->Length) continue;
+            if (wcsnicmp( value->name, name->Buffer, name->Length / sizeof(WCHAR) )) continue;
+            list_remove( &value->entry );
+            list_add_head( &key->values, &value->entry );
+            status = get_cached_value( value, info, length, result_len );
+            reg_cache_hits++;
+            trace_reg_cache_stats();
+            LeaveCriticalSection( &reg_cache_cs );
+            return status;
+        }
+        reg_cache_misses++;
+        trace_reg_cache_stats();
+    }
+    LeaveCriticalSection( &reg_cache_cs );
+
+query:
+    status = NtQueryValueKey( hkey, name, KeyValuePartialInformation, info, length, result_len );
+    if (cacheable && (!status || status == STATUS_OBJECT_NAME_NOT_FOUND))
+        add_cached_value( serial, name, status, info );
+    return status;
+}
+
 /******************************************************************************
  * RegCreateKeyExW   (kernelbase.@)
  *
@@ -425,6 +992,9 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegCreateKeyExW( HKEY hkey, LPCWSTR name, DWORD
 {
     OBJECT_ATTRIBUTES attr;
     UNICODE_STRING nameW, classW;
+    unsigned int generation = get_reg_cache_generation();
+    HKEY parent = hkey;
+    NTSTATUS status;
 
     if (reserved) return ERROR_INVALID_PARAMETER;
     if (!(hkey = get_special_root_hkey( hkey, access ))) return ERROR_INVALID_HANDLE;
@@ -439,7 +1009,9 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegCreateKeyExW( HKEY hkey, LPCWSTR name, DWORD
     RtlInitUnicodeString( &nameW, name );
     RtlInitUnicodeString( &classW, class );
 
-    return RtlNtStatusToDosError( create_key( retkey, access, &attr, &classW, options, dispos ) );
+    if (!(status = create_key( retkey, access, &attr, &classW, options, dispos )))
+        map_key_handle( *retkey, parent, &nameW, options, access, generation );
+    return RtlNtStatusToDosError( status );
 }
 
 
@@ -473,6 +1045,8 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegCreateKeyExA( HKEY hkey, LPCSTR name, DWORD
     OBJECT_ATTRIBUTES attr;
     UNICODE_STRING classW;
     ANSI_STRING nameA, classA;
+    unsigned int generation = get_reg_cache_generation();
+    HKEY parent = hkey;
     NTSTATUS status;
 
     if (reserved) return ERROR_INVALID_PARAMETER;
@@ -498,7 +1072,9 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegCreateKeyExA( HKEY hkey, LPCSTR name, DWORD
     {
         if (!(status = RtlAnsiStringToUnicodeString( &classW, &classA, TRUE )))
         {
-            status = create_key( retkey, access, &attr, &classW, options, dispos );
+            if (!(status = create_key( retkey, access, &attr, &classW, options, dispos )))
+                map_key_handle( *retkey, parent, &NtCurrentTeb()->StaticUnicodeString,
+                                options, access, generation );
             RtlFreeUnicodeString( &classW );
         }
     }
@@ -515,6 +1091,9 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegOpenKeyExW( HKEY hkey, LPCWSTR name, DWORD o
 {
     OBJECT_ATTRIBUTES attr;
     UNICODE_STRING nameW;
+    unsigned int generation = get_reg_cache_generation();
+    HKEY parent;
+    NTSTATUS status;
 
     if (retkey && (!name || !name[0]) &&
         (HandleToUlong(hkey) >= HandleToUlong(HKEY_SPECIAL_ROOT_FIRST)) &&
@@ -529,6 +1108,7 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegOpenKeyExW( HKEY hkey, LPCWSTR name, DWORD o
 
     if (!retkey) return ERROR_INVALID_PARAMETER;
     *retkey = NULL;
+    parent = hkey;
     if (!(hkey = get_special_root_hkey( hkey, access ))) return ERROR_INVALID_HANDLE;
 
     attr.Length = sizeof(attr);
@@ -538,7 +1118,9 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegOpenKeyExW( HKEY hkey, LPCWSTR name, DWORD o
     attr.SecurityDescriptor = NULL;
     attr.SecurityQualityOfService = NULL;
     RtlInitUnicodeString( &nameW, name );
-    return RtlNtStatusToDosError( open_key( retkey, options, access, &attr ) );
+    if (!(status = open_key( retkey, options, access, &attr )))
+        map_key_handle( *retkey, parent, &nameW, options, access, generation );
+    return RtlNtStatusToDosError( status );
 }
 
 
@@ -566,6 +1148,8 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegOpenKeyExA( HKEY hkey, LPCSTR name, DWORD op
 {
     OBJECT_ATTRIBUTES attr;
     STRING nameA;
+    unsigned int generation = get_reg_cache_generation();
+    HKEY parent;
     NTSTATUS status;
 
     if (retkey && (!name || !name[0]) &&
@@ -583,6 +1167,7 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegOpenKeyExA( HKEY hkey, LPCSTR name, DWORD op
         if (HandleToUlong(hkey) == HandleToUlong(HKEY_CLASSES_ROOT) && name && *name == '\\') name++;
     }
 
+    parent = hkey;
     if (!(hkey = get_special_root_hkey( hkey, access ))) return ERROR_INVALID_HANDLE;
 
     attr.Length = sizeof(attr);
@@ -596,7 +1181,9 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegOpenKeyExA( HKEY hkey, LPCSTR name, DWORD op
     if (!(status = RtlAnsiStringToUnicodeString( &NtCurrentTeb()->StaticUnicodeString,
                                                  &nameA, FALSE )))
     {
-        status = open_key( retkey, options, access, &attr );
+        if (!(status = open_key( retkey, options, access, &attr )))
+            map_key_handle( *retkey, parent, &NtCurrentTeb()->StaticUnicodeString,
+                            options, access, generation );
     }
     return RtlNtStatusToDosError( status );
 }
@@ -1014,6 +1601,7 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegCloseKey( HKEY hkey )
 {
     if (!hkey) return ERROR_INVALID_HANDLE;
     if (hkey >= (HKEY)0x80000000) return ERROR_SUCCESS;
+    unmap_key_handle( hkey );
     return RtlNtStatusToDosError( NtClose( hkey ) );
 }
 
@@ -1547,8 +2135,7 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegQueryValueExW( HKEY hkey, LPCWSTR name, LPDW
         if (count) *count = 0;
     }
 
-    status = NtQueryValueKey( hkey, &name_str, KeyValuePartialInformation,
-                              buffer, total_size, &total_size );
+    status = query_value_key( hkey, &name_str, info, total_size, &total_size );
     if (status && status != STATUS_BUFFER_OVERFLOW) goto done;
 
     if (data)
@@ -1560,8 +2147,7 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegQueryValueExW( HKEY hkey, LPCWSTR name, LPDW
             if (!(buf_ptr = heap_alloc( total_size )))
                 return ERROR_NOT_ENOUGH_MEMORY;
             info = (KEY_VALUE_PARTIAL_INFORMATION *)buf_ptr;
-            status = NtQueryValueKey( hkey, &name_str, KeyValuePartialInformation,
-                                      buf_ptr, total_size, &total_size );
+            status = query_value_key( hkey, &name_str, info, total_size, &total_size );
         }
 
         if (!status)
@@ -1646,8 +2232,7 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegQueryValueExA( HKEY hkey, LPCSTR name, LPDWO
         return ret;
     }
 
-    status = NtQueryValueKey( hkey, &nameW, KeyValuePartialInformation,
-                              buffer, sizeof(buffer), &total_size );
+    status = query_value_key( hkey, &nameW, info, sizeof(buffer), &total_size );
     if (status && status != STATUS_BUFFER_OVERFLOW) goto done;
 
     /* we need to fetch the contents for a string type even if not requested,
@@ -1664,8 +2249,7 @@ LSTATUS WINAPI DECLSPEC_HOTPATCH RegQueryValueExA( HKEY hkey, LPCSTR name, LPDWO
                 goto done;
             }
             info = (KEY_VALUE_PARTIAL_INFORMATION *)buf_ptr;
-            status = NtQueryValueKey( hkey, &nameW, KeyValuePartialInformation,
-                                      buf_ptr, total_size, &total_size );
+            status = query_value_key( hkey, &nameW, info, total_size, &total_size );
         }
 
         if (status) goto done;
@@ -532,13 +532,7 @@ static RUNTIME_FUNCTION *find_function_info( ULONG_PTR pc, ULONG_PTR base,
         int pos = (min + max) / 2;
         if (pc < base + func[pos].BeginAddress) max = pos - 1;
         else if (pc >= base + func[pos].EndAddress) min = pos + 1;
-        else
-        {
-            func += pos;
-            while (func->UnwindData & 1)  /* follow chained entry */
-                func = (RUNTIME_FUNCTION *)(base + (func->UnwindData & ~1));
-            return func;
-        }
+        else return func + pos;
 #elif defined(__arm__)
         int pos = (min + max) / 2;
         if (pc < base + (func[pos].BeginAddress & ~1)) max = pos - 1;
@@ -554,15 +548,79 @@ static RUNTIME_FUNCTION *find_function_info( ULONG_PTR pc, ULONG_PTR base,
     return NULL;
 }
 
+static RUNTIME_FUNCTION *follow_chained_entry( RUNTIME_FUNCTION *func, ULONG_PTR base )
+{
+#ifdef __x86_64__
+    while (func->UnwindData & 1)  /* follow chained entry */
+        func = (RUNTIME_FUNCTION *)(base + (func->UnwindData & ~1));
+#endif
+    return func;
+}
+
+static BOOL function_contains_pc( RUNTIME_FUNCTION *func, ULONG_PTR base, ULONG_PTR pc )
+{
+#ifdef __arm__
+    if (pc < base + (func->BeginAddress & ~1)) return FALSE;
+#else
+    if (pc < base + func->BeginAddress) return FALSE;
+#endif
+    return pc < base + get_runtime_function_end( func, base );
+}
+
+/* look for a function entry in the unwind history table; entries are stored before
+ * following chained entries, so that their range can be checked against the pc */
+static RUNTIME_FUNCTION *search_history_table( UNWIND_HISTORY_TABLE *table, ULONG_PTR pc, ULONG_PTR *base )
+{
+    ULONG i;
+
+    if (!table || !table->Count || table->Count > UNWIND_HISTORY_TABLE_SIZE) return NULL;
+    if (pc < table->LowAddress || pc >= table->HighAddress) return NULL;
+
+    for (i = 0; i < table->Count; i++)
+    {
+        UNWIND_HISTORY_TABLE_ENTRY *entry = &table->Entry[i];
+
+        if (!function_contains_pc( entry->FunctionEntry, entry->ImageBase, pc )) continue;
+        *base = entry->ImageBase;
+        return follow_chained_entry( entry->FunctionEntry, entry->ImageBase );
+    }
+    return NULL;
+}
+
+static void add_history_table_entry( UNWIND_HISTORY_TABLE *table, ULONG_PTR base, RUNTIME_FUNCTION *func )
+{
+#ifdef __arm__
+    ULONG_PTR start = base + (func->BeginAddress & ~1);
+#else
+    ULONG_PTR start = base + func->BeginAddress;
+#endif
+    ULONG_PTR end = base + get_runtime_function_end( func, base );
+
+    if (!table || table->Count >= UNWIND_HISTORY_TABLE_SIZE) return;
+
+    if (!table->Count || start < table->LowAddress) table->LowAddress = start;
+    if (!table->Count || end > table->HighAddress) table->HighAddress = end;
+    table->Entry[table->Count].ImageBase = base;
+    table->Entry[table->Count].FunctionEntry = func;
+    table->Count++;
+}
+
 /**********************************************************************
  *           lookup_function_info
+ *
+ * The module is only returned when no function entry is found; frames found
+ * in the history table don't need the module to be looked up.
  */
-RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_TABLE_ENTRY **module )
+RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_TABLE_ENTRY **module,
+                                        UNWIND_HISTORY_TABLE *table )
 {
     RUNTIME_FUNCTION *func = NULL;
     struct dynamic_unwind_entry *entry;
     ULONG size;
 
+    *module = NULL;
+    if ((func = search_history_table( table, pc, base ))) return func;
+
     /* PE module or wine module */
     if (!LdrFindEntryForAddress( (void *)pc, module ))
     {
@@ -571,7 +629,11 @@ RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_
                                                   IMAGE_DIRECTORY_ENTRY_EXCEPTION, &size )))
         {
             /* lookup in function table */
-            func = find_function_info( pc, (ULONG_PTR)(*module)->DllBase, func, size/sizeof(*func) );
+            if ((func = find_function_info( pc, *base, func, size/sizeof(*func) )))
+            {
+                add_history_table_entry( table, *base, func );
+                func = follow_chained_entry( func, *base );
+            }
         }
     }
     else
@@ -587,8 +649,11 @@ RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_
                 /* use callback or lookup in function table */
                 if (entry->callback)
                     func = entry->callback( pc, entry->context );
-                else
-                    func = find_function_info( pc, entry->base, entry->table, entry->count );
+                else if ((func = find_function_info( pc, entry->base, entry->table, entry->count )))
+                {
+                    add_history_table_entry( table, entry->base, func );
+                    func = follow_chained_entry( func, entry->base );
+                }
                 break;
             }
         }
@@ -607,9 +672,7 @@ PRUNTIME_FUNCTION WINAPI RtlLookupFunctionEntry( ULONG_PTR pc, ULONG_PTR *base,
     LDR_DATA_TABLE_ENTRY *module;
     RUNTIME_FUNCTION *func;
 
-    /* FIXME: should use the history table to make things faster */
-
-    if (!(func = lookup_function_info( pc, base, &module )))
+    if (!(func = lookup_function_info( pc, base, &module, table )))
     {
         *base = 0;
         WARN( "no exception table found for %lx\n", pc );
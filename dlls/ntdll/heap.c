@@ -78,6 +78,7 @@ typedef struct
 #define ARENA_PENDING_MAGIC    0xbedead
 #define ARENA_FREE_MAGIC       0x45455246
 #define ARENA_LARGE_MAGIC      0x6752614c
+#define ARENA_CACHED_MAGIC     0x48464c
 
 #define ARENA_INUSE_FILLER     0x55
 #define ARENA_TAIL_FILLER      0xab
@@ -125,6 +126,30 @@ typedef union
     void       *alignment[4];
 } FREE_LIST_ENTRY;
 
+/* Low-fragmentation front-end: freed blocks of the small size classes are kept
+ * in shards of block caches, which serve allocations and frees without the heap lock.
+ * Shards are picked by hashing the thread id, so a few threads may share one; the
+ * shard lock is never waited on, a thread that finds it busy uses the back-end instead.
+ * Once the front-end is enabled sub-heaps are never released, so that the list of
+ * sub-heaps can be walked without the heap lock when a block is freed. */
+#define LFH_NB_SHARDS      16
+#define LFH_MAX_SIZE       0x400   /* max size of the blocks handled by the front-end */
+#define LFH_NB_BINS        (((LFH_MAX_SIZE - HEAP_MIN_DATA_SIZE) / ALIGNMENT) + 1)
+#define LFH_BIN_MAX_BYTES  0x1000  /* max amount of memory kept in a single cache bin */
+#define LFH_REFILL_COUNT   8       /* number of blocks to add to an empty cache bin */
+
+struct lfh_bin
+{
+    ARENA_INUSE *head;              /* first cached block, linked through the block data */
+    DWORD        count;             /* number of cached blocks */
+};
+
+struct lfh_shard
+{
+    LONG           lock;            /* non-blocking lock for the bins */
+    struct lfh_bin bins[LFH_NB_BINS];
+};
+
 struct tagHEAP;
 
 typedef struct tagSUBHEAP
@@ -163,6 +188,7 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct lfh_shard *lfh;          /* Low-fragmentation front-end, if enabled */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -295,7 +321,8 @@ static void subheap_notify_free_all(SUBHEAP const *subheap)
         {
             ARENA_INUSE const *pArena = (ARENA_INUSE const *)ptr;
             if (pArena->magic == ARENA_INUSE_MAGIC) notify_free(pArena + 1);
-            else if (pArena->magic != ARENA_PENDING_MAGIC) ERR("bad inuse_magic @%p\n", pArena);
+            else if (pArena->magic != ARENA_PENDING_MAGIC && pArena->magic != ARENA_CACHED_MAGIC)
+                ERR("bad inuse_magic @%p\n", pArena);
             ptr += sizeof(*pArena) + (pArena->size & ARENA_SIZE_MASK);
         }
     }
@@ -667,10 +694,11 @@ static void HEAP_MakeInUseBlockFree( SUBHEAP *subheap, ARENA_INUSE *pArena )
     if ((char *)pFree + size < (char *)subheap->base + subheap->size)
         return;  /* Not the last block, so nothing more to do */
 
-    /* Free the whole sub-heap if it's empty and not the original one */
+    /* Free the whole sub-heap if it's empty and not the original one,
+     * unless the front-end may be looking it up without the heap lock */
 
     if (((char *)pFree == (char *)subheap->base + subheap->headerSize) &&
-        (subheap != &subheap->heap->subheap))
+        (subheap != &subheap->heap->subheap) && !subheap->heap->lfh)
     {
         void *addr = subheap->base;
 
@@ -914,7 +942,12 @@ static SUBHEAP *HEAP_CreateSubHeap( HEAP *heap, LPVOID address, DWORD flags,
         subheap->commitSize = commitSize;
         subheap->magic      = SUBHEAP_MAGIC;
         subheap->headerSize = ROUND_SIZE( sizeof(SUBHEAP) );
-        list_add_head( &heap->subheap_list, &subheap->entry );
+        /* the list can be walked without the heap lock by lfh_free, so
+         * make sure the new entry is complete before it's reachable */
+        subheap->entry.next = heap->subheap_list.next;
+        subheap->entry.prev = &heap->subheap_list;
+        heap->subheap_list.next->prev = &subheap->entry;
+        InterlockedExchangePointer( (void **)&heap->subheap_list.next, &subheap->entry );
     }
     else
     {
@@ -1057,6 +1090,38 @@ static ARENA_FREE *HEAP_FindFreeBlock( HEAP *heap, SIZE_T size,
 }
 
 
+/***********************************************************************
+ *           allocate_block
+ *
+ * Find a free block of the requested size and turn it into an in-use block.
+ */
+static ARENA_INUSE *allocate_block( HEAP *heap, SIZE_T rounded_size, SUBHEAP **subheap )
+{
+    ARENA_FREE *pArena;
+    ARENA_INUSE *pInUse;
+
+    if (!(pArena = HEAP_FindFreeBlock( heap, rounded_size, subheap ))) return NULL;
+
+    /* Remove the arena from the free list */
+
+    list_remove( &pArena->entry );
+
+    /* Build the in-use arena */
+
+    pInUse = (ARENA_INUSE *)pArena;
+
+    /* in-use arena is smaller than free arena,
+     * so we have to add the difference to the size */
+    pInUse->size  = (pInUse->size & ~ARENA_FLAG_FREE) + sizeof(ARENA_FREE) - sizeof(ARENA_INUSE);
+    pInUse->magic = ARENA_INUSE_MAGIC;
+
+    /* Shrink the block */
+
+    HEAP_ShrinkBlock( *subheap, pInUse, rounded_size );
+    return pInUse;
+}
+
+
 /***********************************************************************
  *           HEAP_IsValidArenaPtr
  *
@@ -1213,7 +1278,8 @@ static BOOL HEAP_ValidateInUseArena( const SUBHEAP *subheap, const ARENA_INUSE *
     }
 
     /* Check magic number */
-    if (pArena->magic != ARENA_INUSE_MAGIC && pArena->magic != ARENA_PENDING_MAGIC)
+    if (pArena->magic != ARENA_INUSE_MAGIC && pArena->magic != ARENA_PENDING_MAGIC &&
+        pArena->magic != ARENA_CACHED_MAGIC)
     {
         if (quiet == NOISY) {
             ERR("Heap %p: invalid in-use arena magic %08x for %p\n", subheap->heap, pArena->magic, pArena );
@@ -1419,7 +1485,7 @@ static BOOL validate_block_pointer( HEAP *heap, SUBHEAP **ret_subheap, const ARE
         ret = HEAP_ValidateInUseArena( subheap, arena, QUIET );
     else if ((ULONG_PTR)arena % ALIGNMENT != ARENA_OFFSET)
         WARN( "Heap %p: unaligned arena pointer %p\n", subheap->heap, arena );
-    else if (arena->magic == ARENA_PENDING_MAGIC)
+    else if (arena->magic == ARENA_PENDING_MAGIC || arena->magic == ARENA_CACHED_MAGIC)
         WARN( "Heap %p: block %p used after free\n", subheap->heap, arena + 1 );
     else if (arena->magic != ARENA_INUSE_MAGIC)
         WARN( "Heap %p: invalid in-use arena magic %08x for %p\n", subheap->heap, arena->magic, arena );
@@ -1515,6 +1581,190 @@ static void heap_set_debug_flags( HANDLE handle )
 }
 
 
+/* get the cache bin index for a given block size */
+static inline unsigned int lfh_bin_index( SIZE_T size )
+{
+    return (size - HEAP_MIN_DATA_SIZE) / ALIGNMENT;
+}
+
+/* max number of blocks to keep in a cache bin */
+static inline DWORD lfh_bin_depth( SIZE_T size )
+{
+    return LFH_BIN_MAX_BYTES / size;
+}
+
+/* lock the cache shard of the current thread; fails instead of waiting if it is busy */
+static struct lfh_shard *lfh_lock_shard( HEAP *heap )
+{
+    ULONG tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    struct lfh_shard *shard = heap->lfh + (tid >> 2) % LFH_NB_SHARDS;
+
+    if (InterlockedCompareExchange( &shard->lock, 1, 0 )) return NULL;
+    return shard;
+}
+
+static inline void lfh_unlock_shard( struct lfh_shard *shard )
+{
+    InterlockedExchange( &shard->lock, 0 );
+}
+
+static inline void lfh_push_block( struct lfh_bin *bin, ARENA_INUSE *arena )
+{
+    arena->magic = ARENA_CACHED_MAGIC;
+    *(ARENA_INUSE **)(arena + 1) = bin->head;
+    bin->head = arena;
+    bin->count++;
+}
+
+/***********************************************************************
+ *           lfh_alloc
+ *
+ * Allocate a block from the front-end caches, without taking the heap lock.
+ */
+static void *lfh_alloc( HEAP *heap, DWORD flags, SIZE_T size, SIZE_T rounded_size )
+{
+    struct lfh_shard *shard;
+    struct lfh_bin *bin;
+    ARENA_INUSE *arena;
+
+    if (!(shard = lfh_lock_shard( heap ))) return NULL;
+    bin = &shard->bins[lfh_bin_index( rounded_size )];
+    if ((arena = bin->head))
+    {
+        bin->head = *(ARENA_INUSE **)(arena + 1);
+        bin->count--;
+    }
+    lfh_unlock_shard( shard );
+    if (!arena) return NULL;
+
+    arena->magic = ARENA_INUSE_MAGIC;
+    arena->unused_bytes = (arena->size & ARENA_SIZE_MASK) - size;
+    notify_alloc( arena + 1, size, flags & HEAP_ZERO_MEMORY );
+    initialize_block( arena + 1, size, arena->unused_bytes, flags );
+    return arena + 1;
+}
+
+/***********************************************************************
+ *           lfh_free
+ *
+ * Return a block to the front-end caches, without taking the heap lock.
+ * The block is neither coalesced nor decommitted.
+ */
+static BOOL lfh_free( HEAP *heap, ARENA_INUSE *arena )
+{
+    struct lfh_shard *shard;
+    struct lfh_bin *bin;
+    SUBHEAP *subheap;
+    SIZE_T size;
+    BOOL valid;
+
+    if ((ULONG_PTR)arena % ALIGNMENT != ARENA_OFFSET) return FALSE;
+    if (arena->magic != ARENA_INUSE_MAGIC || (arena->size & ARENA_FLAG_FREE)) return FALSE;
+    if ((size = arena->size & ARENA_SIZE_MASK) > LFH_MAX_SIZE) return FALSE;
+
+    /* sub-heaps are only added to the list while the front-end is enabled,
+     * never removed, so it's safe to walk it without the heap lock */
+    valid = (subheap = HEAP_FindSubHeap( heap, arena )) &&
+            (char *)arena >= (char *)subheap->base + subheap->headerSize &&
+            (char *)(arena + 1) + size <= (char *)subheap->base + subheap->size;
+    if (!valid) return FALSE;
+
+    if (!(shard = lfh_lock_shard( heap ))) return FALSE;
+    bin = &shard->bins[lfh_bin_index( size )];
+    if (bin->count < lfh_bin_depth( size ))
+    {
+        lfh_push_block( bin, arena );
+        lfh_unlock_shard( shard );
+        return TRUE;
+    }
+    lfh_unlock_shard( shard );
+    return FALSE;
+}
+
+/***********************************************************************
+ *           lfh_refill
+ *
+ * Add a few blocks of the given size to the current thread cache.
+ * Must be called with the heap lock held.
+ */
+static void lfh_refill( HEAP *heap, SIZE_T rounded_size )
+{
+    struct lfh_shard *shard;
+    struct lfh_bin *bin;
+    ARENA_INUSE *arena;
+    SUBHEAP *subheap;
+    unsigned int i;
+
+    if (!(shard = lfh_lock_shard( heap ))) return;
+    bin = &shard->bins[lfh_bin_index( rounded_size )];
+    for (i = 0; i < LFH_REFILL_COUNT && bin->count < lfh_bin_depth( rounded_size ); i++)
+    {
+        if (!(arena = allocate_block( heap, rounded_size, &subheap ))) break;
+        if ((arena->size & ARENA_SIZE_MASK) != rounded_size)  /* couldn't be shrunk, give it back */
+        {
+            HEAP_MakeInUseBlockFree( subheap, arena );
+            break;
+        }
+        lfh_push_block( bin, arena );
+    }
+    lfh_unlock_shard( shard );
+}
+
+/***********************************************************************
+ *           lfh_flush
+ *
+ * Return all the cached blocks to the back-end. Must be called with the heap lock held.
+ */
+static void lfh_flush( HEAP *heap )
+{
+    ARENA_INUSE *arena, *next;
+    unsigned int i, j;
+
+    for (i = 0; i < LFH_NB_SHARDS; i++)
+    {
+        struct lfh_shard *shard = &heap->lfh[i];
+
+        while (InterlockedCompareExchange( &shard->lock, 1, 0 )) YieldProcessor();
+        for (j = 0; j < LFH_NB_BINS; j++)
+        {
+            for (arena = shard->bins[j].head; arena; arena = next)
+            {
+                next = *(ARENA_INUSE **)(arena + 1);
+                arena->magic = ARENA_INUSE_MAGIC;
+                HEAP_MakeInUseBlockFree( HEAP_FindSubHeap( heap, arena ), arena );
+            }
+            shard->bins[j].head = NULL;
+            shard->bins[j].count = 0;
+        }
+        lfh_unlock_shard( shard );
+    }
+}
+
+/***********************************************************************
+ *           heap_enable_lfh
+ */
+static NTSTATUS heap_enable_lfh( HEAP *heap )
+{
+    struct lfh_shard *lfh;
+
+    if (heap->lfh) return STATUS_SUCCESS;
+    if (!(heap->flags & HEAP_GROWABLE) || (heap->flags & (HEAP_NO_SERIALIZE | HEAP_SHARED)) ||
+        (heap->flags & (HEAP_VALIDATE | HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED)) ||
+        heap->pending_free || RUNNING_ON_VALGRIND)
+        return STATUS_UNSUCCESSFUL;
+
+    if (!(lfh = RtlAllocateHeap( heap, HEAP_ZERO_MEMORY, LFH_NB_SHARDS * sizeof(*lfh) )))
+        return STATUS_NO_MEMORY;
+    /* set it under the heap lock, so that no sub-heap is being released at the same time */
+    RtlEnterCriticalSection( &heap->critSection );
+    if (heap->lfh) RtlFreeHeap( heap, 0, lfh );
+    else InterlockedExchangePointer( (void **)&heap->lfh, lfh );
+    RtlLeaveCriticalSection( &heap->critSection );
+    TRACE( "enabled low-fragmentation front-end for heap %p\n", heap );
+    return STATUS_SUCCESS;
+}
+
+
 /***********************************************************************
  *           RtlCreateHeap   (NTDLL.@)
  *
@@ -1561,6 +1811,7 @@ HANDLE WINAPI RtlCreateHeap( ULONG flags, PVOID addr, SIZE_T totalSize, SIZE_T c
     {
         processHeap = subheap->heap;  /* assume the first heap we create is the process main heap */
         list_init( &processHeap->entry );
+        heap_enable_lfh( processHeap );
     }
 
     return subheap->heap;
@@ -1650,11 +1901,11 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
  */
 void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
 {
-    ARENA_FREE *pArena;
     ARENA_INUSE *pInUse;
     SUBHEAP *subheap;
     HEAP *heapPtr = HEAP_GetPtr( heap );
     SIZE_T rounded_size;
+    void *ret;
 
     /* Validate the parameters */
 
@@ -1669,11 +1920,18 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lfh && rounded_size <= LFH_MAX_SIZE &&
+        (ret = lfh_alloc( heapPtr, flags, size, rounded_size )))
+    {
+        TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
     {
-        void *ret = allocate_large_block( heap, flags, size );
+        ret = allocate_large_block( heap, flags, size );
         if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
         if (!ret && (flags & HEAP_GENERATE_EXCEPTIONS)) RtlRaiseStatus( STATUS_NO_MEMORY );
         TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
@@ -1682,36 +1940,27 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
 
     /* Locate a suitable free block */
 
-    if (!(pArena = HEAP_FindFreeBlock( heapPtr, rounded_size, &subheap )))
+    if (!(pInUse = allocate_block( heapPtr, rounded_size, &subheap )))
     {
-        TRACE("(%p,%08x,%08lx): returning NULL\n",
-                  heap, flags, size  );
-        if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
-        if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
-        return NULL;
+        /* give the cached blocks back before giving up */
+        if (heapPtr->lfh) lfh_flush( heapPtr );
+        if (!heapPtr->lfh || !(pInUse = allocate_block( heapPtr, rounded_size, &subheap )))
+        {
+            TRACE("(%p,%08x,%08lx): returning NULL\n",
+                      heap, flags, size  );
+            if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
+            if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
+            return NULL;
+        }
     }
 
-    /* Remove the arena from the free list */
-
-    list_remove( &pArena->entry );
-
-    /* Build the in-use arena */
-
-    pInUse = (ARENA_INUSE *)pArena;
-
-    /* in-use arena is smaller than free arena,
-     * so we have to add the difference to the size */
-    pInUse->size  = (pInUse->size & ~ARENA_FLAG_FREE) + sizeof(ARENA_FREE) - sizeof(ARENA_INUSE);
-    pInUse->magic = ARENA_INUSE_MAGIC;
-
-    /* Shrink the block */
-
-    HEAP_ShrinkBlock( subheap, pInUse, rounded_size );
     pInUse->unused_bytes = (pInUse->size & ARENA_SIZE_MASK) - size;
 
     notify_alloc( pInUse + 1, size, flags & HEAP_ZERO_MEMORY );
     initialize_block( pInUse + 1, size, pInUse->unused_bytes, flags );
 
+    if (heapPtr->lfh && rounded_size <= LFH_MAX_SIZE) lfh_refill( heapPtr, rounded_size );
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
 
     TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, pInUse + 1 );
@@ -1752,6 +2001,13 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE heap, ULONG flags, void *pt
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if (heapPtr->lfh && lfh_free( heapPtr, (ARENA_INUSE *)ptr - 1 ))
+    {
+        TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+        return TRUE;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     /* Inform valgrind we are trying to free memory, so it can throw up an error message */
@@ -1939,12 +2195,20 @@ error:
  *  The number of bytes compacted.
  *
  * NOTES
- *  This function is a harmless stub.
+ *  This function only returns the blocks cached by the low-fragmentation
+ *  front-end to the heap, so that empty sub-heaps can be released.
  */
 ULONG WINAPI RtlCompactHeap( HANDLE heap, ULONG flags )
 {
     static BOOL reported;
-    if (!reported++) FIXME( "(%p, 0x%x) stub\n", heap, flags );
+    HEAP *heapPtr = HEAP_GetPtr( heap );
+
+    if (!reported++) FIXME( "(%p, 0x%x) semi-stub\n", heap, flags );
+    if (!heapPtr || !heapPtr->lfh) return 0;
+
+    RtlEnterCriticalSection( &heapPtr->critSection );
+    lfh_flush( heapPtr );
+    RtlLeaveCriticalSection( &heapPtr->critSection );
     return 0;
 }
 
@@ -2119,7 +2383,8 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         }
 
         if (((ARENA_INUSE *)ptr - 1)->magic == ARENA_INUSE_MAGIC ||
-            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_PENDING_MAGIC)
+            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_PENDING_MAGIC ||
+            ((ARENA_INUSE *)ptr - 1)->magic == ARENA_CACHED_MAGIC)
         {
             ARENA_INUSE *pArena = (ARENA_INUSE *)ptr - 1;
             ptr += pArena->size & ARENA_SIZE_MASK;
@@ -2167,7 +2432,7 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         entry->lpData = pArena + 1;
         entry->cbData = pArena->size & ARENA_SIZE_MASK;
         entry->cbOverhead = sizeof(ARENA_INUSE);
-        entry->wFlags = (pArena->magic == ARENA_PENDING_MAGIC) ?
+        entry->wFlags = (pArena->magic == ARENA_PENDING_MAGIC || pArena->magic == ARENA_CACHED_MAGIC) ?
                         PROCESS_HEAP_UNCOMMITTED_RANGE : PROCESS_HEAP_ENTRY_BUSY;
         /* FIXME: can't handle PROCESS_HEAP_ENTRY_MOVEABLE
         and PROCESS_HEAP_ENTRY_DDESHARE yet */
@@ -2232,6 +2497,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2240,7 +2507,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_PARAMETER;
+        *(ULONG *)info = heapPtr->lfh ? 2 /* low-fragmentation heap */ : 0 /* standard heap */;
         return STATUS_SUCCESS;
 
     default:
@@ -2254,6 +2522,24 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    HEAP *heapPtr;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_PARAMETER;
+
+        TRACE("%p: compatibility mode %u\n", heap, *(ULONG *)info);
+        switch (*(ULONG *)info)
+        {
+        case 0: return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 2: return heap_enable_lfh( heapPtr );
+        default: return STATUS_UNSUCCESSFUL;
+        }
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
@@ -134,8 +134,28 @@ typedef struct _wine_modref
     struct file_id        id;
     ULONG                 CheckSum;
     BOOL                  system;
+    struct list           base_entry;       /* entry in the base address hash table */
+    struct list           fullname_entry;   /* entry in the full name hash table */
+    struct list           fileid_entry;     /* entry in the file id hash table */
+    ULONG                 fullname_hash;
+    unsigned int          export_lookups;   /* number of exports looked up by name */
+    const IMAGE_EXPORT_DIRECTORY *export_dir; /* export directory that export_hash was built for */
+    DWORD                *export_hash;      /* hash table of AddressOfNames indexes + 1 */
+    unsigned int          export_hash_size;
 } WINE_MODREF;
 
+/* hash tables for module lookups; the base name table uses the HashLinks
+ * field of the LDR_DATA_TABLE_ENTRY, like on Windows */
+#define MODULE_HASH_SIZE 64  /* must be a power of 2 */
+static LIST_ENTRY basename_hash_table[MODULE_HASH_SIZE];
+static struct list base_hash_table[MODULE_HASH_SIZE];
+static struct list fullname_hash_table[MODULE_HASH_SIZE];
+static struct list fileid_hash_table[MODULE_HASH_SIZE];
+static BOOL module_hash_initialized;
+
+/* number of lookups by name before building an export hash table for a module */
+#define EXPORT_HASH_MIN_LOOKUPS 16
+
 static UINT tls_module_count;      /* number of modules with TLS directory */
 static IMAGE_TLS_DIRECTORY *tls_dirs;  /* array of TLS directories */
 LIST_ENTRY tls_links = { &tls_links, &tls_links };
@@ -479,19 +499,79 @@ static void call_ldr_notifications( ULONG reason, LDR_DATA_TABLE_ENTRY *module )
  * Looks for the referenced HMODULE in the current process
  * The loader_section must be locked while calling this function.
  */
+static inline unsigned int hash_module_base( HMODULE module )
+{
+    return ((ULONG_PTR)module >> 16) & (MODULE_HASH_SIZE - 1);
+}
+
+static inline ULONG hash_module_name( const UNICODE_STRING *name )
+{
+    ULONG hash;
+
+    RtlHashUnicodeString( name, TRUE, HASH_STRING_ALGORITHM_X65599, &hash );
+    return hash;
+}
+
+static inline unsigned int hash_file_id( const struct file_id *id )
+{
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < sizeof(id->ObjectId); i++) hash = hash * 31 + id->ObjectId[i];
+    return hash & (MODULE_HASH_SIZE - 1);
+}
+
+/* add a module to the lookup hash tables */
+static void insert_module_hash( WINE_MODREF *wm )
+{
+    unsigned int i;
+
+    if (!module_hash_initialized)
+    {
+        for (i = 0; i < MODULE_HASH_SIZE; i++)
+        {
+            InitializeListHead( &basename_hash_table[i] );
+            list_init( &base_hash_table[i] );
+            list_init( &fullname_hash_table[i] );
+            list_init( &fileid_hash_table[i] );
+        }
+        module_hash_initialized = TRUE;
+    }
+
+    wm->ldr.BaseNameHashValue = hash_module_name( &wm->ldr.BaseDllName );
+    wm->fullname_hash = hash_module_name( &wm->ldr.FullDllName );
+    InsertTailList( &basename_hash_table[wm->ldr.BaseNameHashValue & (MODULE_HASH_SIZE - 1)],
+                    &wm->ldr.HashLinks );
+    list_add_tail( &base_hash_table[hash_module_base( wm->ldr.DllBase )], &wm->base_entry );
+    list_add_tail( &fullname_hash_table[wm->fullname_hash & (MODULE_HASH_SIZE - 1)], &wm->fullname_entry );
+    list_add_tail( &fileid_hash_table[hash_file_id( &wm->id )], &wm->fileid_entry );
+}
+
+/* remove a module from the lookup hash tables */
+static void remove_module_hash( WINE_MODREF *wm )
+{
+    RemoveEntryList( &wm->ldr.HashLinks );
+    list_remove( &wm->base_entry );
+    list_remove( &wm->fullname_entry );
+    list_remove( &wm->fileid_entry );
+}
+
+static void set_module_file_id( WINE_MODREF *wm, const struct file_id *id )
+{
+    wm->id = *id;
+    list_remove( &wm->fileid_entry );
+    list_add_tail( &fileid_hash_table[hash_file_id( &wm->id )], &wm->fileid_entry );
+}
+
 static WINE_MODREF *get_modref( HMODULE hmod )
 {
-    PLIST_ENTRY mark, entry;
-    PLDR_DATA_TABLE_ENTRY mod;
+    WINE_MODREF *wm;
 
     if (cached_modref && cached_modref->ldr.DllBase == hmod) return cached_modref;
+    if (!module_hash_initialized) return NULL;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    LIST_FOR_EACH_ENTRY( wm, &base_hash_table[hash_module_base( hmod )], WINE_MODREF, base_entry )
     {
-        mod = CONTAINING_RECORD(entry, LDR_DATA_TABLE_ENTRY, InMemoryOrderLinks);
-        if (mod->DllBase == hmod)
-            return cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
+        if (wm->ldr.DllBase == hmod) return cached_modref = wm;
     }
     return NULL;
 }
@@ -507,17 +587,21 @@ static WINE_MODREF *find_basename_module( LPCWSTR name )
 {
     PLIST_ENTRY mark, entry;
     UNICODE_STRING name_str;
+    ULONG hash;
 
     RtlInitUnicodeString( &name_str, name );
 
     if (cached_modref && RtlEqualUnicodeString( &name_str, &cached_modref->ldr.BaseDllName, TRUE ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    if (!module_hash_initialized) return NULL;
+    hash = hash_module_name( &name_str );
+    mark = &basename_hash_table[hash & (MODULE_HASH_SIZE - 1)];
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
-        WINE_MODREF *mod = CONTAINING_RECORD(entry, WINE_MODREF, ldr.InLoadOrderLinks);
-        if (RtlEqualUnicodeString( &name_str, &mod->ldr.BaseDllName, TRUE ) && !mod->system)
+        WINE_MODREF *mod = CONTAINING_RECORD(entry, WINE_MODREF, ldr.HashLinks);
+        if (mod->ldr.BaseNameHashValue == hash &&
+            RtlEqualUnicodeString( &name_str, &mod->ldr.BaseDllName, TRUE ) && !mod->system)
         {
             cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
             return cached_modref;
@@ -535,8 +619,9 @@ static WINE_MODREF *find_basename_module( LPCWSTR name )
  */
 static WINE_MODREF *find_fullname_module( const UNICODE_STRING *nt_name )
 {
-    PLIST_ENTRY mark, entry;
     UNICODE_STRING name = *nt_name;
+    WINE_MODREF *wm;
+    ULONG hash;
 
     if (name.Length <= 4 * sizeof(WCHAR)) return NULL;
     name.Length -= 4 * sizeof(WCHAR);  /* for \??\ prefix */
@@ -545,15 +630,12 @@ static WINE_MODREF *find_fullname_module( const UNICODE_STRING *nt_name )
     if (cached_modref && RtlEqualUnicodeString( &name, &cached_modref->ldr.FullDllName, TRUE ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    if (!module_hash_initialized) return NULL;
+    hash = hash_module_name( &name );
+    LIST_FOR_EACH_ENTRY( wm, &fullname_hash_table[hash & (MODULE_HASH_SIZE - 1)], WINE_MODREF, fullname_entry )
     {
-        LDR_DATA_TABLE_ENTRY *mod = CONTAINING_RECORD(entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks);
-        if (RtlEqualUnicodeString( &name, &mod->FullDllName, TRUE ))
-        {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
-        }
+        if (wm->fullname_hash == hash && RtlEqualUnicodeString( &name, &wm->ldr.FullDllName, TRUE ))
+            return cached_modref = wm;
     }
     return NULL;
 }
@@ -567,21 +649,14 @@ static WINE_MODREF *find_fullname_module( const UNICODE_STRING *nt_name )
  */
 static WINE_MODREF *find_fileid_module( const struct file_id *id )
 {
-    LIST_ENTRY *mark, *entry;
+    WINE_MODREF *wm;
 
     if (cached_modref && !memcmp( &cached_modref->id, id, sizeof(*id) )) return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    if (!module_hash_initialized) return NULL;
+    LIST_FOR_EACH_ENTRY( wm, &fileid_hash_table[hash_file_id( id )], WINE_MODREF, fileid_entry )
     {
-        LDR_DATA_TABLE_ENTRY *mod = CONTAINING_RECORD( entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks );
-        WINE_MODREF *wm = CONTAINING_RECORD( mod, WINE_MODREF, ldr );
-
-        if (!memcmp( &wm->id, id, sizeof(*id) ))
-        {
-            cached_modref = wm;
-            return wm;
-        }
+        if (!memcmp( &wm->id, id, sizeof(*id) )) return cached_modref = wm;
     }
     return NULL;
 }
@@ -955,6 +1030,74 @@ static int find_name_in_exports( HMODULE module, const IMAGE_EXPORT_DIRECTORY *e
 }
 
 
+static inline unsigned int hash_export_name( const char *name )
+{
+    unsigned int hash = 0;
+
+    while (*name) hash = hash * 65599 + (unsigned char)*name++;
+    return hash;
+}
+
+
+/*************************************************************************
+ *		build_export_hash
+ *
+ * Build a hash table of the exported names of a module.
+ * The loader_section must be locked while calling this function.
+ */
+static void build_export_hash( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports )
+{
+    const DWORD *names = get_rva( wm->ldr.DllBase, exports->AddressOfNames );
+    unsigned int i, pos, size = 16;
+
+    while (size < exports->NumberOfNames * 2) size *= 2;
+    if (!(wm->export_hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                             size * sizeof(*wm->export_hash) )))
+        return;
+
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        pos = hash_export_name( get_rva( wm->ldr.DllBase, names[i] )) & (size - 1);
+        while (wm->export_hash[pos]) pos = (pos + 1) & (size - 1);
+        wm->export_hash[pos] = i + 1;
+    }
+    wm->export_hash_size = size;
+    wm->export_dir = exports;
+}
+
+
+/*************************************************************************
+ *		find_name_in_export_hash
+ *
+ * Helper for find_named_export. Returns -2 if the hash table can't be used.
+ * The loader_section must be locked while calling this function.
+ */
+static int find_name_in_export_hash( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports, const char *name )
+{
+    const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
+    const DWORD *names = get_rva( module, exports->AddressOfNames );
+    WINE_MODREF *wm;
+    unsigned int pos, index;
+
+    if (!(wm = get_modref( module ))) return -2;
+    if (!wm->export_hash)
+    {
+        if (++wm->export_lookups < EXPORT_HASH_MIN_LOOKUPS) return -2;
+        if (wm->export_lookups == EXPORT_HASH_MIN_LOOKUPS) build_export_hash( wm, exports );
+        if (!wm->export_hash) return -2;
+    }
+    if (wm->export_dir != exports) return -2;
+
+    pos = hash_export_name( name ) & (wm->export_hash_size - 1);
+    while ((index = wm->export_hash[pos]))
+    {
+        if (!strcmp( get_rva( module, names[index - 1] ), name )) return ordinals[index - 1];
+        pos = (pos + 1) & (wm->export_hash_size - 1);
+    }
+    return -1;
+}
+
+
 /*************************************************************************
  *		find_named_export
  *
@@ -976,8 +1119,10 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
-    /* then do a binary search */
-    if ((ordinal = find_name_in_exports( module, exports, name )) == -1) return NULL;
+    /* then use the hash table for frequently used modules, or do a binary search */
+    if ((ordinal = find_name_in_export_hash( module, exports, name )) == -2)
+        ordinal = find_name_in_exports( module, exports, name );
+    if (ordinal == -1) return NULL;
     return find_ordinal_export( module, exports, exp_size, ordinal, load_path );
 
 }
@@ -1446,6 +1591,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name
                    &wm->ldr.InLoadOrderLinks);
     InsertTailList(&NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList,
                    &wm->ldr.InMemoryOrderLinks);
+    insert_module_hash( wm );
     /* wait until init is called for inserting into InInitializationOrderModuleList */
 
     if (!(nt->OptionalHeader.DllCharacteristics & IMAGE_DLLCHARACTERISTICS_NX_COMPAT))
@@ -2105,7 +2251,7 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
 
     if (!(wm = alloc_module( *module, nt_name, is_builtin ))) return STATUS_NO_MEMORY;
 
-    if (id) wm->id = *id;
+    if (id) set_module_file_id( wm, id );
     if (image_info->LoaderFlags) wm->ldr.Flags |= LDR_COR_IMAGE;
     if (image_info->u.s.ComPlusILOnly) wm->ldr.Flags |= LDR_COR_ILONLY;
     wm->system = system;
@@ -2127,6 +2273,7 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderLinks);
             RemoveEntryList(&wm->ldr.InMemoryOrderLinks);
+            remove_module_hash( wm );
 
             /* FIXME: there are several more dangling references
              * left. Including dlls loaded by this dll before the
@@ -3634,7 +3781,11 @@ void WINAPI LdrShutdownProcess(void)
 
     process_detaching = TRUE;
     if (!detaching)
+    {
         RtlProcessFlsData( NtCurrentTeb()->FlsSlots, 1 );
+        if (TRACE_ON(relay)) RELAY_DumpStats();
+        dump_critical_section_stats();
+    }
 
     process_detach();
 }
@@ -3707,6 +3858,7 @@ void WINAPI LdrShutdownThread(void)
     /* don't call DbgUiGetThreadDebugObject as some apps hook it and terminate if called */
     if (NtCurrentTeb()->DbgSsReserved[1]) NtClose( NtCurrentTeb()->DbgSsReserved[1] );
     RtlFreeThreadActivationContextStack();
+    if (TRACE_ON(relay)) RELAY_ThreadDetach();
 }
 
 
@@ -3723,6 +3875,7 @@ static void free_modref( WINE_MODREF *wm )
     RemoveEntryList(&wm->ldr.InMemoryOrderLinks);
     if (wm->ldr.InInitializationOrderLinks.Flink)
         RemoveEntryList(&wm->ldr.InInitializationOrderLinks);
+    remove_module_hash( wm );
 
     while ((entry = wm->ldr.DdagNode->Dependencies.Tail))
     {
@@ -3753,6 +3906,7 @@ static void free_modref( WINE_MODREF *wm )
     NtUnmapViewOfSection( NtCurrentProcess(), wm->ldr.DllBase );
     if (cached_modref == wm) cached_modref = NULL;
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_hash );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
 }
 
@@ -4603,12 +4757,38 @@ static LONGLONG WINAPI RtlGetSystemTimePrecise_fallback(void)
     return now.QuadPart;
 }
 
+static NTSTATUS CDECL fast_RtlWaitOnAddress_fallback( const void *addr, const void *cmp, SIZE_T size,
+                                                       const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static int CDECL fast_RtlWakeAddress_fallback( const void *addr, int count )
+{
+    return 0;
+}
+
+static NTSTATUS CDECL set_registry_value_fallback( const OBJECT_ATTRIBUTES *attr, const UNICODE_STRING *name,
+                                                    ULONG type, const void *data, ULONG count )
+{
+    HANDLE key;
+    NTSTATUS status;
+
+    if ((status = NtOpenKey( &key, KEY_SET_VALUE, attr ))) return status;
+    status = NtSetValueKey( key, name, 0, type, data, count );
+    NtClose( key );
+    return status;
+}
+
 static const struct unix_funcs unix_fallbacks =
 {
     load_so_dll_fallback,
     init_builtin_dll_fallback,
     unwind_builtin_dll_fallback,
     RtlGetSystemTimePrecise_fallback,
+    fast_RtlWaitOnAddress_fallback,
+    fast_RtlWakeAddress_fallback,
+    set_registry_value_fallback,
 };
 
 const struct unix_funcs *unix_funcs = &unix_fallbacks;
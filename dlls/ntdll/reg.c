@@ -746,9 +746,9 @@ NTSTATUS WINAPI RtlDeleteRegistryValue(IN ULONG RelativeTo, IN PCWSTR Path, IN P
 NTSTATUS WINAPI RtlWriteRegistryValue( ULONG RelativeTo, PCWSTR path, PCWSTR name,
                                        ULONG type, PVOID data, ULONG length )
 {
-    HANDLE hkey;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING str, keyname;
     NTSTATUS status;
-    UNICODE_STRING str;
 
     TRACE( "(%d, %s, %s) -> %d: %p [%d]\n", RelativeTo, debugstr_w(path), debugstr_w(name),
            type, data, length );
@@ -758,11 +758,11 @@ NTSTATUS WINAPI RtlWriteRegistryValue( ULONG RelativeTo, PCWSTR path, PCWSTR nam
     if (RelativeTo == RTL_REGISTRY_HANDLE)
         return NtSetValueKey( (HANDLE)path, &str, 0, type, data, length );
 
-    status = RTL_GetKeyHandle( RelativeTo, path, &hkey );
+    status = RTL_KeyHandleCreateObject( RelativeTo, path, &attr, &keyname );
     if (status != STATUS_SUCCESS) return status;
 
-    status = NtSetValueKey( hkey, &str, 0, type, data, length );
-    NtClose( hkey );
-
+    /* open, set and close in a single server round trip */
+    status = unix_funcs->set_registry_value( &attr, &str, type, data, length );
+    RtlFreeUnicodeString( &keyname );
     return status;
 }
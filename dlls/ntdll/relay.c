@@ -23,6 +23,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -30,6 +31,7 @@
 #include "winternl.h"
 #include "wine/exception.h"
 #include "ntdll_misc.h"
+#include "wine/list.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(relay);
@@ -61,11 +63,15 @@ struct relay_entry_point
 {
     void       *orig_func;    /* original entry point function */
     const char *name;         /* function name (if any) */
+    LONG        calls;        /* number of calls, in statistics mode */
+    LONGLONG    time;         /* inclusive time spent in the function, in statistics mode */
 };
 
 struct relay_private_data
 {
+    struct list              entry;             /* entry in the list of relayed dlls */
     HMODULE                  module;            /* module handle of this dll */
+    unsigned int             nb_entry_points;   /* number of entry points */
     unsigned int             base;              /* ordinal base */
     char                     dllname[40];       /* dll name (without .dll extension) */
     struct relay_entry_point entry_points[1];   /* list of dll entry points */
@@ -82,6 +88,38 @@ static const WCHAR **debug_from_snoop_includelist;
 
 static RTL_RUN_ONCE init_once = RTL_RUN_ONCE_INIT;
 
+/* In statistics mode, enabled with the RelayStats value, calls are counted and timed
+ * instead of being traced, and a summary is printed when the process exits. */
+
+#define RELAY_STATS_MAX_DEPTH 64
+
+struct relay_stats_frame
+{
+    struct relay_entry_point *entry_point;
+    LONGLONG                  start;
+};
+
+struct relay_stats_stack  /* per-thread stack of the calls being timed */
+{
+    unsigned int             depth;
+    struct relay_stats_frame frames[RELAY_STATS_MAX_DEPTH];
+};
+
+static BOOL relay_stats;
+static ULONG relay_stats_tls = ~0u;
+static struct list relay_dlls = LIST_INIT( relay_dlls );
+
+static RTL_CRITICAL_SECTION relay_section;
+static RTL_CRITICAL_SECTION_DEBUG relay_section_debug =
+{
+    0, 0, &relay_section,
+    { &relay_section_debug.ProcessLocksList, &relay_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": relay_section") }
+};
+static RTL_CRITICAL_SECTION relay_section = { &relay_section_debug, -1, 0, 0, 0, 0 };
+
+#define RELAY_TRACE(...) do { if (!relay_stats) TRACE( __VA_ARGS__ ); } while (0)
+
 /* compare an ASCII and a Unicode string without depending on the current codepage */
 static inline int strcmpAW( const char *strA, const WCHAR *strW )
 {
@@ -157,6 +195,26 @@ static const WCHAR **load_list( HKEY hkey, const WCHAR *value )
     return list;
 }
 
+/***********************************************************************
+ *           load_flag
+ *
+ * Load a boolean from a registry value, either a string or a DWORD.
+ */
+static BOOL load_flag( HKEY hkey, const WCHAR *value )
+{
+    char buffer[offsetof(KEY_VALUE_PARTIAL_INFORMATION, Data[32])];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+    UNICODE_STRING name;
+    DWORD count;
+
+    RtlInitUnicodeString( &name, value );
+    if (NtQueryValueKey( hkey, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &count ))
+        return FALSE;
+    if (info->Type == REG_DWORD && info->DataLength == sizeof(DWORD)) return *(DWORD *)info->Data != 0;
+    if (info->Type == REG_SZ) return wcstol( (WCHAR *)info->Data, NULL, 10 ) != 0;
+    return FALSE;
+}
+
 /***********************************************************************
  *           init_debug_lists
  *
@@ -191,6 +249,15 @@ static DWORD WINAPI init_debug_lists( RTL_RUN_ONCE *once, void *param, void **co
     debug_from_snoop_includelist = load_list( hkey, L"SnoopFromInclude" );
     debug_from_snoop_excludelist = load_list( hkey, L"SnoopFromExclude" );
 
+    if (load_flag( hkey, L"RelayStats" ))
+    {
+        RtlAcquirePebLock();
+        relay_stats_tls = RtlFindClearBitsAndSet( NtCurrentTeb()->Peb->TlsBitmap, 1, 1 );
+        RtlReleasePebLock();
+        relay_stats = (relay_stats_tls != ~0u);
+        TRACE( "statistics mode %s\n", relay_stats ? "enabled" : "not available" );
+    }
+
     NtClose( hkey );
     return TRUE;
 }
@@ -281,6 +348,47 @@ static BOOL is_ret_val( char type )
     return type >= 'A' && type <= 'Z';
 }
 
+static void relay_stats_enter( struct relay_entry_point *entry_point )
+{
+    struct relay_stats_stack *stack = NtCurrentTeb()->TlsSlots[relay_stats_tls];
+    LARGE_INTEGER counter;
+
+    InterlockedIncrement( &entry_point->calls );
+
+    if (!stack)
+    {
+        if (!(stack = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*stack) ))) return;
+        stack->depth = 0;
+        NtCurrentTeb()->TlsSlots[relay_stats_tls] = stack;
+    }
+    if (stack->depth >= RELAY_STATS_MAX_DEPTH) return;
+    RtlQueryPerformanceCounter( &counter );
+    stack->frames[stack->depth].entry_point = entry_point;
+    stack->frames[stack->depth].start = counter.QuadPart;
+    stack->depth++;
+}
+
+static void relay_stats_leave( struct relay_descr *descr, unsigned int idx )
+{
+    struct relay_private_data *data = descr->private;
+    struct relay_entry_point *entry_point = data->entry_points + LOWORD(idx);
+    struct relay_stats_stack *stack = NtCurrentTeb()->TlsSlots[relay_stats_tls];
+    LARGE_INTEGER counter;
+    unsigned int i;
+
+    if (!stack) return;
+
+    /* frames above the matching one were skipped by an exception */
+    for (i = stack->depth; i > 0; i--)
+    {
+        if (stack->frames[i - 1].entry_point != entry_point) continue;
+        RtlQueryPerformanceCounter( &counter );
+        InterlockedExchangeAdd64( &entry_point->time, counter.QuadPart - stack->frames[i - 1].start );
+        stack->depth = i - 1;
+        return;
+    }
+}
+
 static const char *func_name( struct relay_private_data *data, unsigned int ordinal )
 {
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
@@ -293,14 +401,14 @@ static const char *func_name( struct relay_private_data *data, unsigned int ordi
 
 static void trace_string_a( INT_PTR ptr )
 {
-    if (!IS_INTARG( ptr )) TRACE( "%08Ix %s", ptr, debugstr_a( (char *)ptr ));
-    else TRACE( "%08Ix", ptr );
+    if (!IS_INTARG( ptr )) RELAY_TRACE( "%08Ix %s", ptr, debugstr_a( (char *)ptr ));
+    else RELAY_TRACE( "%08Ix", ptr );
 }
 
 static void trace_string_w( INT_PTR ptr )
 {
-    if (!IS_INTARG( ptr )) TRACE( "%08Ix %s", ptr, debugstr_w( (WCHAR *)ptr ));
-    else TRACE( "%08Ix", ptr );
+    if (!IS_INTARG( ptr )) RELAY_TRACE( "%08Ix %s", ptr, debugstr_w( (WCHAR *)ptr ));
+    else RELAY_TRACE( "%08Ix", ptr );
 }
 
 #ifdef __i386__
@@ -317,18 +425,18 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
     unsigned int i, pos;
 
-    TRACE( "\1Call %s(", func_name( data, ordinal ));
+    RELAY_TRACE( "\1Call %s(", func_name( data, ordinal ));
 
     for (i = pos = 0; !is_ret_val( arg_types[i] ); i++)
     {
         switch (arg_types[i])
         {
         case 'j': /* int64 */
-            TRACE( "%x%08x", stack[pos+1], stack[pos] );
+            RELAY_TRACE( "%x%08x", stack[pos+1], stack[pos] );
             pos += 2;
             break;
         case 'k': /* int128 */
-            TRACE( "{%08x,%08x,%08x,%08x}", stack[pos], stack[pos+1], stack[pos+2], stack[pos+3] );
+            RELAY_TRACE( "{%08x,%08x,%08x,%08x}", stack[pos], stack[pos+1], stack[pos+2], stack[pos+3] );
             pos += 4;
             break;
         case 's': /* str */
@@ -338,18 +446,18 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
             trace_string_w( stack[pos++] );
             break;
         case 'f': /* float */
-            TRACE( "%g", *(const float *)&stack[pos++] );
+            RELAY_TRACE( "%g", *(const float *)&stack[pos++] );
             break;
         case 'd': /* double */
-            TRACE( "%g", *(const double *)&stack[pos] );
+            RELAY_TRACE( "%g", *(const double *)&stack[pos] );
             pos += 2;
             break;
         case 'i': /* long */
         default:
-            TRACE( "%08x", stack[pos++] );
+            RELAY_TRACE( "%08x", stack[pos++] );
             break;
         }
-        if (!is_ret_val( arg_types[i+1] )) TRACE( "," );
+        if (!is_ret_val( arg_types[i+1] )) RELAY_TRACE( "," );
     }
     *nb_args = pos;
     if (arg_types[0] == 't')
@@ -357,7 +465,8 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
         *nb_args |= 0x80000000;  /* thiscall/fastcall */
         if (arg_types[1] == 't') *nb_args |= 0x40000000;  /* fastcall */
     }
-    TRACE( ") ret=%08x\n", stack[-1] );
+    RELAY_TRACE( ") ret=%08x\n", stack[-1] );
+    if (relay_stats) relay_stats_enter( entry_point );
     return entry_point->orig_func;
 }
 
@@ -369,14 +478,20 @@ DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigne
 {
     const char *arg_types = descr->args_string + HIWORD(idx);
 
-    TRACE( "\1Ret  %s()", func_name( descr->private, LOWORD(idx) ));
+    if (relay_stats)
+    {
+        relay_stats_leave( descr, idx );
+        return;
+    }
+
+    RELAY_TRACE( "\1Ret  %s()", func_name( descr->private, LOWORD(idx) ));
 
     while (!is_ret_val( *arg_types )) arg_types++;
     if (*arg_types == 'J')  /* int64 return value */
-        TRACE( " retval=%08x%08x ret=%08x\n",
-               (UINT)(retval >> 32), (UINT)retval, (UINT)retaddr );
+        RELAY_TRACE( " retval=%08x%08x ret=%08x\n",
+                     (UINT)(retval >> 32), (UINT)retval, (UINT)retaddr );
     else
-        TRACE( " retval=%08x ret=%08x\n", (UINT)retval, (UINT)retaddr );
+        RELAY_TRACE( " retval=%08x ret=%08x\n", (UINT)retval, (UINT)retaddr );
 }
 
 extern LONGLONG WINAPI relay_call( struct relay_descr *descr, unsigned int idx );
@@ -460,7 +575,7 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     const union fpregs { float s[16]; double d[8]; } *fpstack = (const union fpregs *)stack - 1;
 #endif
 
-    TRACE( "\1Call %s(", func_name( data, ordinal ));
+    RELAY_TRACE( "\1Call %s(", func_name( data, ordinal ));
 
     for (i = pos = 0; !is_ret_val( arg_types[i] ); i++)
     {
@@ -468,11 +583,11 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
         {
         case 'j': /* int64 */
             pos = (pos + 1) & ~1;
-            TRACE( "%x%08x", stack[pos+1], stack[pos] );
+            RELAY_TRACE( "%x%08x", stack[pos+1], stack[pos] );
             pos += 2;
             break;
         case 'k': /* int128 */
-            TRACE( "{%08x,%08x,%08x,%08x}", stack[pos], stack[pos+1], stack[pos+2], stack[pos+3] );
+            RELAY_TRACE( "{%08x,%08x,%08x,%08x}", stack[pos], stack[pos+1], stack[pos+2], stack[pos+3] );
             pos += 4;
             break;
         case 's': /* str */
@@ -486,31 +601,31 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
             if (!(float_pos % 2)) float_pos = max( float_pos, double_pos * 2 );
             if (float_pos < 16)
             {
-                TRACE( "%g", fpstack->s[float_pos++] );
+                RELAY_TRACE( "%g", fpstack->s[float_pos++] );
                 break;
             }
 #endif
-            TRACE( "%g", *(const float *)&stack[pos++] );
+            RELAY_TRACE( "%g", *(const float *)&stack[pos++] );
             break;
         case 'd': /* double */
 #ifndef __SOFTFP__
             double_pos = max( (float_pos + 1) / 2, double_pos );
             if (double_pos < 8)
             {
-                TRACE( "%g", fpstack->d[double_pos++] );
+                RELAY_TRACE( "%g", fpstack->d[double_pos++] );
                 break;
             }
 #endif
             pos = (pos + 1) & ~1;
-            TRACE( "%g", *(const double *)&stack[pos] );
+            RELAY_TRACE( "%g", *(const double *)&stack[pos] );
             pos += 2;
             break;
         case 'i': /* long */
         default:
-            TRACE( "%08x", stack[pos++] );
+            RELAY_TRACE( "%08x", stack[pos++] );
             break;
         }
-        if (!is_ret_val( arg_types[i+1] )) TRACE( "," );
+        if (!is_ret_val( arg_types[i+1] )) RELAY_TRACE( "," );
     }
 
 #ifndef __SOFTFP__
@@ -521,7 +636,8 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     }
 #endif
     *nb_args = pos;
-    TRACE( ") ret=%08x\n", stack[-1] );
+    RELAY_TRACE( ") ret=%08x\n", stack[-1] );
+    if (relay_stats) relay_stats_enter( entry_point );
     return entry_point->orig_func;
 }
 
@@ -533,14 +649,20 @@ DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigne
 {
     const char *arg_types = descr->args_string + HIWORD(idx);
 
-    TRACE( "\1Ret  %s()", func_name( descr->private, LOWORD(idx) ));
+    if (relay_stats)
+    {
+        relay_stats_leave( descr, idx );
+        return;
+    }
+
+    RELAY_TRACE( "\1Ret  %s()", func_name( descr->private, LOWORD(idx) ));
 
     while (!is_ret_val( *arg_types )) arg_types++;
     if (*arg_types == 'J')  /* int64 return value */
-        TRACE( " retval=%08x%08x ret=%08x\n",
-               (UINT)(retval >> 32), (UINT)retval, retaddr );
+        RELAY_TRACE( " retval=%08x%08x ret=%08x\n",
+                     (UINT)(retval >> 32), (UINT)retval, retaddr );
     else
-        TRACE( " retval=%08x ret=%08x\n", (UINT)retval, retaddr );
+        RELAY_TRACE( " retval=%08x ret=%08x\n", (UINT)retval, retaddr );
 }
 
 extern LONGLONG WINAPI relay_call( struct relay_descr *descr, unsigned int idx, const DWORD *stack );
@@ -610,7 +732,7 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
     unsigned int i;
 
-    TRACE( "\1Call %s(", func_name( data, ordinal ));
+    RELAY_TRACE( "\1Call %s(", func_name( data, ordinal ));
 
     for (i = 0; !is_ret_val( arg_types[i] ); i++)
     {
@@ -624,13 +746,14 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
             break;
         case 'i': /* long */
         default:
-            TRACE( "%08zx", stack[i] );
+            RELAY_TRACE( "%08zx", stack[i] );
             break;
         }
-        if (!is_ret_val( arg_types[i + 1] )) TRACE( "," );
+        if (!is_ret_val( arg_types[i + 1] )) RELAY_TRACE( "," );
     }
     *nb_args = i;
-    TRACE( ") ret=%08zx\n", stack[-1] );
+    RELAY_TRACE( ") ret=%08zx\n", stack[-1] );
+    if (relay_stats) relay_stats_enter( entry_point );
     return entry_point->orig_func;
 }
 
@@ -640,8 +763,13 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
 DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigned int idx,
                                               INT_PTR retaddr, INT_PTR retval )
 {
-    TRACE( "\1Ret  %s() retval=%08zx ret=%08zx\n",
-           func_name( descr->private, LOWORD(idx) ), retval, retaddr );
+    if (relay_stats)
+    {
+        relay_stats_leave( descr, idx );
+        return;
+    }
+    RELAY_TRACE( "\1Ret  %s() retval=%08zx ret=%08zx\n",
+                 func_name( descr->private, LOWORD(idx) ), retval, retaddr );
 }
 
 extern LONGLONG CDECL call_entry_point( void *func, int nb_args, const INT_PTR *args );
@@ -710,7 +838,7 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
     struct relay_entry_point *entry_point = data->entry_points + ordinal;
     unsigned int i;
 
-    TRACE( "\1Call %s(", func_name( data, ordinal ));
+    RELAY_TRACE( "\1Call %s(", func_name( data, ordinal ));
 
     for (i = 0; !is_ret_val( arg_types[i] ); i++)
     {
@@ -723,20 +851,21 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
             trace_string_w( stack[i] );
             break;
         case 'f': /* float */
-            TRACE( "%g", *(const float *)&stack[i] );
+            RELAY_TRACE( "%g", *(const float *)&stack[i] );
             break;
         case 'd': /* double */
-            TRACE( "%g", *(const double *)&stack[i] );
+            RELAY_TRACE( "%g", *(const double *)&stack[i] );
             break;
         case 'i': /* long */
         default:
-            TRACE( "%08zx", stack[i] );
+            RELAY_TRACE( "%08zx", stack[i] );
             break;
         }
-        if (!is_ret_val( arg_types[i+1] )) TRACE( "," );
+        if (!is_ret_val( arg_types[i+1] )) RELAY_TRACE( "," );
     }
     *nb_args = i;
-    TRACE( ") ret=%08zx\n", stack[-1] );
+    RELAY_TRACE( ") ret=%08zx\n", stack[-1] );
+    if (relay_stats) relay_stats_enter( entry_point );
     return entry_point->orig_func;
 }
 
@@ -746,8 +875,13 @@ DECLSPEC_HIDDEN void * WINAPI relay_trace_entry( struct relay_descr *descr, unsi
 DECLSPEC_HIDDEN void WINAPI relay_trace_exit( struct relay_descr *descr, unsigned int idx,
                                               INT_PTR retaddr, INT_PTR retval )
 {
-    TRACE( "\1Ret  %s() retval=%08zx ret=%08zx\n",
-           func_name( descr->private, LOWORD(idx) ), retval, retaddr );
+    if (relay_stats)
+    {
+        relay_stats_leave( descr, idx );
+        return;
+    }
+    RELAY_TRACE( "\1Ret  %s() retval=%08zx ret=%08zx\n",
+                 func_name( descr->private, LOWORD(idx) ), retval, retaddr );
 }
 
 extern INT_PTR WINAPI relay_call( struct relay_descr *descr, unsigned int idx, const INT_PTR *stack );
@@ -877,7 +1011,8 @@ void RELAY_SetupDLL( HMODULE module )
     WCHAR dllnameW[sizeof(data->dllname)];
     const WORD *ordptr;
     void *func_base;
-    SIZE_T func_size;
+    SIZE_T func_size, names_size = 0;
+    char *names;
 
     RtlRunOnceExecuteOnce( &init_once, init_debug_lists, NULL, NULL );
 
@@ -886,15 +1021,24 @@ void RELAY_SetupDLL( HMODULE module )
 
     if (!(descr = get_relay_descr( module, exports, size ))) return;
 
+    /* statistics are printed at exit, possibly after the dll is unloaded, so keep a copy of the names */
+    if (relay_stats)
+    {
+        for (i = 0; i < exports->NumberOfNames; i++)
+            names_size += strlen( (char *)module + ((DWORD *)((char *)module + exports->AddressOfNames))[i] ) + 1;
+    }
+
     if (!(data = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*data) +
-                                  (exports->NumberOfFunctions-1) * sizeof(data->entry_points) )))
+                                  (exports->NumberOfFunctions-1) * sizeof(data->entry_points) + names_size )))
         return;
+    names = (char *)(data->entry_points + exports->NumberOfFunctions);
 
     descr->relay_call = relay_call;
     descr->private = data;
 
     data->module = module;
     data->base   = exports->Base;
+    data->nb_entry_points = exports->NumberOfFunctions;
     len = strlen( (char *)module + exports->Name );
     if (len > 4 && !_stricmp( (char *)module + exports->Name + len - 4, ".dll" )) len -= 4;
     len = min( len, sizeof(data->dllname) - 1 );
@@ -909,6 +1053,11 @@ void RELAY_SetupDLL( HMODULE module )
     {
         DWORD name_rva = ((DWORD*)((char *)module + exports->AddressOfNames))[i];
         data->entry_points[*ordptr].name = (const char *)module + name_rva;
+        if (!names_size) continue;
+        len = strlen( (const char *)module + name_rva ) + 1;
+        memcpy( names, (const char *)module + name_rva, len );
+        data->entry_points[*ordptr].name = names;
+        names += len;
     }
 
     /* patch the functions in the export table to point to the relay thunks */
@@ -930,6 +1079,91 @@ void RELAY_SetupDLL( HMODULE module )
     }
     if (old_prot != PAGE_READWRITE)
         NtProtectVirtualMemory( NtCurrentProcess(), &func_base, &func_size, old_prot, &old_prot );
+
+    if (!relay_stats) return;
+    /* unloaded dlls are kept in the list to report their statistics */
+    RtlEnterCriticalSection( &relay_section );
+    list_add_tail( &relay_dlls, &data->entry );
+    RtlLeaveCriticalSection( &relay_section );
+}
+
+
+/***********************************************************************
+ *           RELAY_ThreadDetach
+ *
+ * Free the statistics stack of the current thread.
+ */
+void RELAY_ThreadDetach(void)
+{
+    if (!relay_stats) return;
+    RtlFreeHeap( GetProcessHeap(), 0, NtCurrentTeb()->TlsSlots[relay_stats_tls] );
+    NtCurrentTeb()->TlsSlots[relay_stats_tls] = NULL;
+}
+
+
+struct relay_stats_entry
+{
+    struct relay_private_data *data;
+    unsigned int               ordinal;
+};
+
+static int __cdecl compare_relay_stats( const void *p1, const void *p2 )
+{
+    const struct relay_stats_entry *e1 = p1, *e2 = p2;
+    LONGLONG t1 = e1->data->entry_points[e1->ordinal].time;
+    LONGLONG t2 = e2->data->entry_points[e2->ordinal].time;
+
+    if (t1 != t2) return t1 > t2 ? -1 : 1;
+    return e2->data->entry_points[e2->ordinal].calls - e1->data->entry_points[e1->ordinal].calls;
+}
+
+/***********************************************************************
+ *           RELAY_DumpStats
+ *
+ * Print the call statistics gathered in statistics mode, sorted by inclusive time.
+ */
+void RELAY_DumpStats(void)
+{
+    struct relay_stats_entry *entries;
+    struct relay_private_data *data;
+    LARGE_INTEGER freq;
+    unsigned int i, count = 0, pos = 0;
+
+    if (!relay_stats) return;
+
+    RtlEnterCriticalSection( &relay_section );
+    LIST_FOR_EACH_ENTRY( data, &relay_dlls, struct relay_private_data, entry )
+        for (i = 0; i < data->nb_entry_points; i++) if (data->entry_points[i].calls) count++;
+
+    if (count && (entries = RtlAllocateHeap( GetProcessHeap(), 0, count * sizeof(*entries) )))
+    {
+        LIST_FOR_EACH_ENTRY( data, &relay_dlls, struct relay_private_data, entry )
+        {
+            for (i = 0; i < data->nb_entry_points && pos < count; i++)
+            {
+                if (!data->entry_points[i].calls) continue;
+                entries[pos].data = data;
+                entries[pos].ordinal = i;
+                pos++;
+            }
+        }
+        qsort( entries, pos, sizeof(*entries), compare_relay_stats );
+
+        RtlQueryPerformanceFrequency( &freq );
+        MESSAGE( "%04x: relay statistics, %u functions called\n", GetCurrentProcessId(), pos );
+        MESSAGE( "%12s %14s %12s  %s\n", "calls", "total (us)", "avg (us)", "function" );
+        for (i = 0; i < pos; i++)
+        {
+            struct relay_entry_point *entry_point = entries[i].data->entry_points + entries[i].ordinal;
+            ULONGLONG usecs = entry_point->time * 1000000 / freq.QuadPart;
+
+            MESSAGE( "%12u %14s %12s  %s\n", entry_point->calls, wine_dbgstr_longlong( usecs ),
+                     wine_dbgstr_longlong( usecs / entry_point->calls ),
+                     func_name( entries[i].data, entries[i].ordinal ));
+        }
+        RtlFreeHeap( GetProcessHeap(), 0, entries );
+    }
+    RtlLeaveCriticalSection( &relay_section );
 }
 
 #else  /* __i386__ || __x86_64__ || __arm__ || __aarch64__ */
@@ -944,6 +1178,14 @@ void RELAY_SetupDLL( HMODULE module )
 {
 }
 
+void RELAY_ThreadDetach(void)
+{
+}
+
+void RELAY_DumpStats(void)
+{
+}
+
 #endif  /* __i386__ || __x86_64__ || __arm__ || __aarch64__ */
 
 
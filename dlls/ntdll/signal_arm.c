@@ -148,7 +148,7 @@ static NTSTATUS virtual_unwind( ULONG type, DISPATCHER_CONTEXT *dispatch, CONTEX
 
     if ((dispatch->FunctionEntry = lookup_function_info(
              context->Pc - (dispatch->ControlPcIsUnwound ? 2 : 0),
-             (ULONG_PTR*)&dispatch->ImageBase, &module )))
+             (ULONG_PTR*)&dispatch->ImageBase, &module, NULL )))
     {
         dispatch->LanguageHandler = RtlVirtualUnwind( type, dispatch->ImageBase, context->Pc,
                                                       dispatch->FunctionEntry, context,
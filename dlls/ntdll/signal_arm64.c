@@ -180,7 +180,7 @@ static NTSTATUS virtual_unwind( ULONG type, DISPATCHER_CONTEXT *dispatch, CONTEX
 
     if ((dispatch->FunctionEntry = lookup_function_info(
              context->Pc - (dispatch->ControlPcIsUnwound ? 4 : 0),
-             &dispatch->ImageBase, &module )))
+             &dispatch->ImageBase, &module, NULL )))
     {
         dispatch->LanguageHandler = RtlVirtualUnwind( type, dispatch->ImageBase, context->Pc,
                                                       dispatch->FunctionEntry, context,
@@ -39,6 +39,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(sync);
 WINE_DECLARE_DEBUG_CHANNEL(relay);
+WINE_DECLARE_DEBUG_CHANNEL(critsec);
 
 static const char *debugstr_timeout( const LARGE_INTEGER *timeout )
 {
@@ -194,6 +195,198 @@ static inline NTSTATUS wait_semaphore( RTL_CRITICAL_SECTION *crit, int timeout )
     }
 }
 
+/* adaptive spinning: we keep a running average of the number of spins it took to
+ * acquire the section, and spin up to twice that. With RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN
+ * the average is in the low bits of SpinCount. Other sections keep it in the otherwise
+ * unused EntryCount of their debug info, 0 meaning no sample yet, and never spin more
+ * than SpinCount; sections without debug info always spin SpinCount times. */
+#define CRIT_SPIN_MAX 4000
+
+static inline ULONG get_spin_count( const RTL_CRITICAL_SECTION *crit )
+{
+    ULONG spin = crit->SpinCount, avg;
+
+    if (spin & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN)
+    {
+        spin &= ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS;
+        return min( spin * 2 + 16, CRIT_SPIN_MAX );
+    }
+    if (!crit_section_has_debuginfo( crit ) || !(avg = crit->DebugInfo->EntryCount)) return spin;
+    return min( avg * 2 + 16, spin );
+}
+
+static inline void update_spin_count( RTL_CRITICAL_SECTION *crit, ULONG spins )
+{
+    LONG avg = crit->SpinCount;
+
+    /* concurrent updates may get lost, that's fine */
+    if (avg & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN)
+    {
+        avg &= ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS;
+        avg += ((LONG)spins - avg) / 8;
+        crit->SpinCount = RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN | avg;
+    }
+    else if (crit_section_has_debuginfo( crit ))
+    {
+        if (!(avg = crit->DebugInfo->EntryCount)) avg = spins;
+        else avg += ((LONG)spins - avg) / 8;
+        crit->DebugInfo->EntryCount = max( avg, 1 );
+    }
+}
+
+/* contention profiling, enabled with WINEDEBUG=+critsec and dumped at process exit */
+
+struct crit_section_stats
+{
+    RTL_CRITICAL_SECTION *key;          /* NULL if free, deleted_crit_section once deleted */
+    RTL_CRITICAL_SECTION *crit;
+    LONG                  acquires;
+    LONG                  contentions;
+    LONGLONG              wait_time;
+    char                  name[64];
+};
+
+#define CRIT_STATS_SIZE 4096  /* must be a power of 2 */
+
+static struct crit_section_stats *crit_stats;
+static LONG crit_stats_dropped;
+static RTL_CRITICAL_SECTION * const deleted_crit_section = (RTL_CRITICAL_SECTION *)(ULONG_PTR)1;
+
+static struct crit_section_stats *init_crit_section_stats( struct crit_section_stats *entry,
+                                                          RTL_CRITICAL_SECTION *crit )
+{
+    const char *name = NULL;
+    unsigned int i;
+
+    entry->crit = crit;
+    entry->acquires = 0;
+    entry->contentions = 0;
+    entry->wait_time = 0;
+    if (crit_section_has_debuginfo( crit )) name = (const char *)crit->DebugInfo->Spare[0];
+    for (i = 0; name && i < sizeof(entry->name) - 1 && name[i]; i++) entry->name[i] = name[i];
+    entry->name[i] = 0;
+    return entry;
+}
+
+/* the table is lock-free and allocated directly from virtual memory, since
+ * the heap itself uses critical sections */
+static struct crit_section_stats *get_crit_section_stats( RTL_CRITICAL_SECTION *crit, BOOL create )
+{
+    struct crit_section_stats *stats = crit_stats, *entry, *deleted;
+    RTL_CRITICAL_SECTION *key;
+    unsigned int i, hash = ((ULONG_PTR)crit >> 4) * 0x9e3779b1;
+
+    if (!stats)
+    {
+        SIZE_T size = CRIT_STATS_SIZE * sizeof(*stats);
+        void *ptr = NULL;
+
+        if (!create) return NULL;
+        if (NtAllocateVirtualMemory( GetCurrentProcess(), &ptr, 0, &size, MEM_COMMIT, PAGE_READWRITE ))
+            return NULL;
+        if ((stats = InterlockedCompareExchangePointer( (void **)&crit_stats, ptr, NULL )))
+        {
+            size = 0;
+            NtFreeVirtualMemory( GetCurrentProcess(), &ptr, &size, MEM_RELEASE );
+        }
+        else stats = ptr;
+    }
+
+    for (;;)
+    {
+        deleted = NULL;
+        for (i = 0; i < CRIT_STATS_SIZE; i++)
+        {
+            entry = &stats[(hash + i) & (CRIT_STATS_SIZE - 1)];
+            if ((key = entry->key) == crit) return entry;
+            if (key == deleted_crit_section && !deleted) deleted = entry;
+            if (key) continue;
+            if (!create) return NULL;
+            if (!(key = InterlockedCompareExchangePointer( (void **)&entry->key, crit, NULL )))
+                return init_crit_section_stats( entry, crit );
+            if (key == crit) return entry;
+        }
+        if (!create) return NULL;
+        /* the table is full, the data of deleted sections is only kept until then */
+        if (!deleted) break;
+        if (InterlockedCompareExchangePointer( (void **)&deleted->key, crit,
+                                               deleted_crit_section ) == deleted_crit_section)
+            return init_crit_section_stats( deleted, crit );
+    }
+    InterlockedIncrement( &crit_stats_dropped );
+    return NULL;
+}
+
+static void record_crit_section_acquire( RTL_CRITICAL_SECTION *crit )
+{
+    struct crit_section_stats *stats;
+
+    if ((stats = get_crit_section_stats( crit, TRUE ))) InterlockedIncrement( &stats->acquires );
+}
+
+static void record_crit_section_wait( RTL_CRITICAL_SECTION *crit, LONGLONG time )
+{
+    struct crit_section_stats *stats;
+
+    if (!(stats = get_crit_section_stats( crit, TRUE ))) return;
+    InterlockedIncrement( &stats->contentions );
+    InterlockedExchangeAdd64( &stats->wait_time, time );
+}
+
+static void release_crit_section_stats( RTL_CRITICAL_SECTION *crit )
+{
+    struct crit_section_stats *stats;
+
+    /* keep the data until the table is full, but don't let a new section
+     * at the same address inherit it */
+    if ((stats = get_crit_section_stats( crit, FALSE )))
+        InterlockedCompareExchangePointer( (void **)&stats->key, deleted_crit_section, crit );
+}
+
+static int __cdecl compare_crit_section_stats( const void *p1, const void *p2 )
+{
+    const struct crit_section_stats *s1 = *(const struct crit_section_stats * const *)p1;
+    const struct crit_section_stats *s2 = *(const struct crit_section_stats * const *)p2;
+
+    if (s1->wait_time != s2->wait_time) return s1->wait_time < s2->wait_time ? 1 : -1;
+    if (s1->contentions != s2->contentions) return s1->contentions < s2->contentions ? 1 : -1;
+    return 0;
+}
+
+/***********************************************************************
+ *           dump_critical_section_stats
+ *
+ * Print the contention statistics collected with +critsec.
+ */
+void dump_critical_section_stats(void)
+{
+    struct crit_section_stats **sorted, *stats = crit_stats;
+    LARGE_INTEGER freq;
+    unsigned int i, count = 0;
+
+    if (!stats) return;
+    if (!(sorted = RtlAllocateHeap( GetProcessHeap(), 0, CRIT_STATS_SIZE * sizeof(*sorted) ))) return;
+
+    for (i = 0; i < CRIT_STATS_SIZE; i++)
+        if (stats[i].key && stats[i].contentions) sorted[count++] = &stats[i];
+    qsort( sorted, count, sizeof(*sorted), compare_crit_section_stats );
+    NtQueryPerformanceCounter( NULL, &freq );
+
+    MESSAGE( "%04x: %u contended critical sections\n", GetCurrentProcessId(), count );
+    MESSAGE( "%-16s %10s %10s %14s  %s\n", "section", "acquires", "contended", "wait (ms)", "name" );
+    for (i = 0; i < count; i++)
+    {
+        ULONGLONG usec = sorted[i]->wait_time * 1000000 / freq.QuadPart;
+
+        MESSAGE( "%16p %10u %10u %10u.%03u  %s%s\n", sorted[i]->crit, sorted[i]->acquires,
+                 sorted[i]->contentions, (ULONG)(usec / 1000), (ULONG)(usec % 1000),
+                 sorted[i]->name[0] ? sorted[i]->name : "?",
+                 sorted[i]->key == deleted_crit_section ? " (deleted)" : "" );
+    }
+    if (crit_stats_dropped) MESSAGE( "%u sections not recorded, table full\n", crit_stats_dropped );
+    RtlFreeHeap( GetProcessHeap(), 0, sorted );
+}
+
 /******************************************************************************
  *      RtlInitializeCriticalSection   (NTDLL.@)
  */
@@ -217,7 +410,7 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionAndSpinCount( RTL_CRITICAL_SECTION *
  */
 NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULONG spincount, ULONG flags )
 {
-    if (flags & (RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN|RTL_CRITICAL_SECTION_FLAG_STATIC_INIT))
+    if (flags & RTL_CRITICAL_SECTION_FLAG_STATIC_INIT)
         FIXME("(%p,%u,0x%08x) semi-stub\n", crit, spincount, flags);
 
     /* FIXME: if RTL_CRITICAL_SECTION_FLAG_STATIC_INIT is given, we should use
@@ -247,8 +440,12 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULON
     crit->RecursionCount = 0;
     crit->OwningThread   = 0;
     crit->LockSemaphore  = 0;
-    if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) spincount = 0;
-    crit->SpinCount = spincount & ~0x80000000;
+    if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) crit->SpinCount = 0;
+    else if (flags & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN)
+        crit->SpinCount = RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN |
+                          min( spincount & ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS, CRIT_SPIN_MAX );
+    else
+        crit->SpinCount = spincount & ~(0x80000000 | RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN);
     return STATUS_SUCCESS;
 }
 
@@ -259,7 +456,20 @@ NTSTATUS WINAPI RtlInitializeCriticalSectionEx( RTL_CRITICAL_SECTION *crit, ULON
 ULONG WINAPI RtlSetCriticalSectionSpinCount( RTL_CRITICAL_SECTION *crit, ULONG spincount )
 {
     ULONG oldspincount = crit->SpinCount;
+
     if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) spincount = 0;
+    /* restart the adaptation from the new value */
+    if (oldspincount & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN)
+    {
+        oldspincount &= ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS;
+        if (spincount) spincount = RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN |
+                                   min( spincount & ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS, CRIT_SPIN_MAX );
+    }
+    else
+    {
+        spincount &= ~RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN;
+        if (crit_section_has_debuginfo( crit )) crit->DebugInfo->EntryCount = 0;
+    }
     crit->SpinCount = spincount;
     return oldspincount;
 }
@@ -270,6 +480,7 @@ ULONG WINAPI RtlSetCriticalSectionSpinCount( RTL_CRITICAL_SECTION *crit, ULONG s
  */
 NTSTATUS WINAPI RtlDeleteCriticalSection( RTL_CRITICAL_SECTION *crit )
 {
+    if (TRACE_ON(critsec)) release_crit_section_stats( crit );
     crit->LockCount      = -1;
     crit->RecursionCount = 0;
     crit->OwningThread   = 0;
@@ -294,6 +505,7 @@ NTSTATUS WINAPI RtlDeleteCriticalSection( RTL_CRITICAL_SECTION *crit )
 NTSTATUS WINAPI RtlpWaitForCriticalSection( RTL_CRITICAL_SECTION *crit )
 {
     LONGLONG timeout = NtCurrentTeb()->Peb->CriticalSectionTimeout.QuadPart / -10000000;
+    LARGE_INTEGER start, end;
 
     /* Don't allow blocking on a critical section during process termination */
     if (RtlDllShutdownInProgress())
@@ -303,6 +515,8 @@ NTSTATUS WINAPI RtlpWaitForCriticalSection( RTL_CRITICAL_SECTION *crit )
         return STATUS_SUCCESS;
     }
 
+    if (TRACE_ON(critsec)) NtQueryPerformanceCounter( &start, NULL );
+
     for (;;)
     {
         EXCEPTION_RECORD rec;
@@ -344,6 +558,11 @@ NTSTATUS WINAPI RtlpWaitForCriticalSection( RTL_CRITICAL_SECTION *crit )
         RtlRaiseException( &rec );
     }
     if (crit_section_has_debuginfo( crit )) crit->DebugInfo->ContentionCount++;
+    if (TRACE_ON(critsec))
+    {
+        NtQueryPerformanceCounter( &end, NULL );
+        record_crit_section_wait( crit, end.QuadPart - start.QuadPart );
+    }
     return STATUS_SUCCESS;
 }
 
@@ -380,18 +599,23 @@ NTSTATUS WINAPI RtlEnterCriticalSection( RTL_CRITICAL_SECTION *crit )
 {
     if (crit->SpinCount)
     {
-        ULONG count;
+        ULONG spin, count;
 
         if (RtlTryEnterCriticalSection( crit )) return STATUS_SUCCESS;
-        for (count = crit->SpinCount; count > 0; count--)
+        for (count = spin = get_spin_count( crit ); count > 0; count--)
         {
             if (crit->LockCount > 0) break;  /* more than one waiter, don't bother spinning */
             if (crit->LockCount == -1)       /* try again */
             {
-                if (InterlockedCompareExchange( &crit->LockCount, 0, -1 ) == -1) goto done;
+                if (InterlockedCompareExchange( &crit->LockCount, 0, -1 ) == -1)
+                {
+                    update_spin_count( crit, spin - count );
+                    goto done;
+                }
             }
             YieldProcessor();
         }
+        update_spin_count( crit, spin - count );
     }
 
     if (InterlockedIncrement( &crit->LockCount ))
@@ -408,6 +632,7 @@ NTSTATUS WINAPI RtlEnterCriticalSection( RTL_CRITICAL_SECTION *crit )
 done:
     crit->OwningThread   = ULongToHandle(GetCurrentThreadId());
     crit->RecursionCount = 1;
+    if (TRACE_ON(critsec)) record_crit_section_acquire( crit );
     return STATUS_SUCCESS;
 }
 
@@ -422,6 +647,7 @@ BOOL WINAPI RtlTryEnterCriticalSection( RTL_CRITICAL_SECTION *crit )
     {
         crit->OwningThread   = ULongToHandle(GetCurrentThreadId());
         crit->RecursionCount = 1;
+        if (TRACE_ON(critsec)) record_crit_section_acquire( crit );
         ret = TRUE;
     }
     else if (crit->OwningThread == ULongToHandle(GetCurrentThreadId()))
@@ -842,6 +1068,14 @@ NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable,
  * NtWaitForAlertByThreadId, which manipulate a single flag (similar to an
  * auto-reset event) per thread. This can be tested by attempting to wake a
  * thread waiting in RtlWaitOnAddress() via NtAlertThreadByThreadId.
+ *
+ * Where the host supports it, waits on addresses contained in an aligned
+ * 32-bit word are done directly on a host futex instead, which also covers
+ * SRW locks and condition variables. The thread alert is waited on at the
+ * same time, so NtAlertThreadByThreadId still wakes such waiters. The queues
+ * below are then only used for the other waits, and to know whether any
+ * thread is waiting on a host futex, so that wakes don't need a system call
+ * when nobody is waiting.
  */
 
 struct futex_entry
@@ -855,6 +1089,7 @@ struct futex_queue
 {
     struct list queue;
     LONG lock;
+    LONG futex_waiters;  /* threads waiting on a host futex */
 };
 
 static struct futex_queue futex_queues[256];
@@ -877,6 +1112,15 @@ static void spin_unlock( LONG *lock )
     InterlockedExchange( lock, 0 );
 }
 
+/* wake threads waiting on a host futex, returns the number of threads woken */
+static int wake_futex_waiters( struct futex_queue *queue, const void *addr, int count )
+{
+    /* the caller has changed the value, this pairs with the increment in RtlWaitOnAddress() */
+    MemoryBarrier();
+    if (!queue->futex_waiters) return 0;
+    return unix_funcs->fast_RtlWakeAddress( addr, count );
+}
+
 static BOOL compare_addr( const void *addr, const void *cmp, SIZE_T size )
 {
     switch (size)
@@ -909,6 +1153,18 @@ NTSTATUS WINAPI RtlWaitOnAddress( const void *addr, const void *cmp, SIZE_T size
     if (size != 1 && size != 2 && size != 4 && size != 8)
         return STATUS_INVALID_PARAMETER;
 
+    if (((ULONG_PTR)addr & 3) + size <= sizeof(LONG))
+    {
+        InterlockedIncrement( &queue->futex_waiters );
+        ret = unix_funcs->fast_RtlWaitOnAddress( addr, cmp, size, timeout );
+        InterlockedDecrement( &queue->futex_waiters );
+        if (ret != STATUS_NOT_IMPLEMENTED)
+        {
+            TRACE("returning %#x\n", ret);
+            return ret;
+        }
+    }
+
     entry.addr = addr;
     entry.tid = GetCurrentThreadId();
 
@@ -956,6 +1212,8 @@ void WINAPI RtlWakeAddressAll( const void *addr )
 
     if (!addr) return;
 
+    wake_futex_waiters( queue, addr, INT_MAX );
+
     spin_lock( &queue->lock );
 
     if (!queue->queue.next)
@@ -993,6 +1251,8 @@ void WINAPI RtlWakeAddressSingle( const void *addr )
 
     if (!addr) return;
 
+    if (wake_futex_waiters( queue, addr, 1 )) return;
+
     spin_lock( &queue->lock );
 
     if (!queue->queue.next)
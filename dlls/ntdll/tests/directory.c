@@ -843,6 +843,83 @@ done:
     pRtlFreeUnicodeString(&ntdirname);
 }
 
+static void test_case_insensitive_lookup(void)
+{
+    char testdir[MAX_PATH], buf[MAX_PATH + 32];
+    unsigned int i, pass;
+    ULARGE_INTEGER time;
+    FILETIME ft;
+    HANDLE h;
+    DWORD attr;
+    BOOL ret;
+
+    GetTempPathA(MAX_PATH, testdir);
+    strcat(testdir, "lookup.tmp");
+    ret = CreateDirectoryA(testdir, NULL);
+    ok(ret, "couldn't create dir '%s', error %u\n", testdir, GetLastError());
+
+    for (i = 0; i < 200; i++)
+    {
+        sprintf(buf, "%s\\MixedCase%03u.Txt", testdir, i);
+        h = CreateFileA(buf, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, 0);
+        ok(h != INVALID_HANDLE_VALUE, "failed to create '%s', error %u\n", buf, GetLastError());
+        CloseHandle(h);
+    }
+
+    /* move the directory modification time to the past, so that the names can be
+     * cached on the Unix side without waiting; the second pass uses the cache */
+    h = CreateFileA(testdir, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0);
+    ok(h != INVALID_HANDLE_VALUE, "failed to open '%s', error %u\n", testdir, GetLastError());
+    GetSystemTimeAsFileTime(&ft);
+    time.u.LowPart = ft.dwLowDateTime;
+    time.u.HighPart = ft.dwHighDateTime;
+    time.QuadPart -= time.QuadPart % 10000000 + 3600 * (ULONGLONG)10000000 - 1234567;
+    ft.dwLowDateTime = time.u.LowPart;
+    ft.dwHighDateTime = time.u.HighPart;
+    ret = SetFileTime(h, NULL, NULL, &ft);
+    ok(ret, "SetFileTime failed, error %u\n", GetLastError());
+    CloseHandle(h);
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < 200; i++)
+        {
+            sprintf(buf, "%s\\mixedcase%03u.TXT", testdir, i);
+            attr = GetFileAttributesA(buf);
+            ok(attr != INVALID_FILE_ATTRIBUTES, "%u: failed to find '%s', error %u\n", pass, buf, GetLastError());
+        }
+        sprintf(buf, "%s\\MIXEDCASE200.TXT", testdir);
+        SetLastError(0xdeadbeef);
+        attr = GetFileAttributesA(buf);
+        ok(attr == INVALID_FILE_ATTRIBUTES, "%u: found '%s'\n", pass, buf);
+        ok(GetLastError() == ERROR_FILE_NOT_FOUND, "%u: got error %u\n", pass, GetLastError());
+    }
+
+    /* changes to the directory must be seen right away */
+    sprintf(buf, "%s\\MixedCase200.Txt", testdir);
+    h = CreateFileA(buf, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, 0);
+    ok(h != INVALID_HANDLE_VALUE, "failed to create '%s', error %u\n", buf, GetLastError());
+    CloseHandle(h);
+    sprintf(buf, "%s\\MIXEDCASE200.TXT", testdir);
+    attr = GetFileAttributesA(buf);
+    ok(attr != INVALID_FILE_ATTRIBUTES, "failed to find '%s', error %u\n", buf, GetLastError());
+
+    sprintf(buf, "%s\\mixedCASE000.txt", testdir);
+    ret = DeleteFileA(buf);
+    ok(ret, "failed to delete '%s', error %u\n", buf, GetLastError());
+    attr = GetFileAttributesA(buf);
+    ok(attr == INVALID_FILE_ATTRIBUTES, "found deleted file '%s'\n", buf);
+
+    for (i = 1; i <= 200; i++)
+    {
+        sprintf(buf, "%s\\MixedCase%03u.Txt", testdir, i);
+        DeleteFileA(buf);
+    }
+    ret = RemoveDirectoryA(testdir);
+    ok(ret, "failed to remove '%s', error %u\n", testdir, GetLastError());
+}
+
 static NTSTATUS get_file_id( FILE_INTERNAL_INFORMATION *info, const WCHAR *root, const WCHAR *name )
 {
     OBJECT_ATTRIBUTES attr;
@@ -1036,5 +1113,6 @@ START_TEST(directory)
     test_directory_sort( sysdir );
     test_NtQueryDirectoryFile();
     test_NtQueryDirectoryFile_case();
+    test_case_insensitive_lookup();
     test_redirection();
 }
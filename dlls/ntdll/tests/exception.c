@@ -2747,6 +2747,54 @@ static void test_dynamic_unwind(void)
     pRtlDeleteGrowableFunctionTable( growable_table );
 }
 
+static void test_lookup_history_table(void)
+{
+    static const int code_offset = 1024;
+    static const ULONG offsets[] = { 0, 8, 15, 16, 24, 40, 48, 8, 24, 0 };
+    UNWIND_HISTORY_TABLE table;
+    RUNTIME_FUNCTION runtime_func[3], *func, *expect;
+    ULONG_PTR base, expect_base, pc;
+    unsigned int i;
+
+    runtime_func[0].BeginAddress = code_offset;
+    runtime_func[0].EndAddress   = code_offset + 16;
+    runtime_func[0].UnwindData   = 0;
+    runtime_func[1].BeginAddress = code_offset + 16;
+    runtime_func[1].EndAddress   = code_offset + 32;
+    runtime_func[1].UnwindData   = 0;
+    runtime_func[2].BeginAddress = code_offset + 40;
+    runtime_func[2].EndAddress   = code_offset + 48;
+    runtime_func[2].UnwindData   = 0;
+    ok( pRtlAddFunctionTable( runtime_func, 3, (ULONG_PTR)code_mem ), "RtlAddFunctionTable failed\n" );
+
+    /* lookups through a history table must give the same results, including after it's been filled */
+    memset( &table, 0, sizeof(table) );
+    for (i = 0; i < ARRAY_SIZE(offsets); i++)
+    {
+        pc = (ULONG_PTR)code_mem + code_offset + offsets[i];
+        expect_base = 0xdeadbeef;
+        expect = pRtlLookupFunctionEntry( pc, &expect_base, NULL );
+        base = 0xdeadbeef;
+        func = pRtlLookupFunctionEntry( pc, &base, &table );
+        ok( func == expect, "%u: got %p, expected %p\n", i, func, expect );
+        if (expect) ok( base == expect_base, "%u: got base %lx, expected %lx\n", i, base, expect_base );
+    }
+    ok( table.Count <= UNWIND_HISTORY_TABLE_SIZE, "got count %u\n", table.Count );
+
+    /* module functions */
+    pc = (ULONG_PTR)pRtlLookupFunctionEntry;
+    for (i = 0; i < 3; i++)
+    {
+        expect_base = base = 0;
+        expect = pRtlLookupFunctionEntry( pc, &expect_base, NULL );
+        func = pRtlLookupFunctionEntry( pc, &base, &table );
+        ok( func == expect, "%u: got %p, expected %p\n", i, func, expect );
+        ok( base == expect_base, "%u: got base %lx, expected %lx\n", i, base, expect_base );
+    }
+
+    ok( pRtlDeleteFunctionTable( runtime_func ), "RtlDeleteFunctionTable failed\n" );
+}
+
 static int termination_handler_called;
 static void WINAPI termination_handler(ULONG flags, ULONG64 frame)
 {
@@ -10743,7 +10791,10 @@ START_TEST(exception)
     test_nested_exception();
 
     if (pRtlAddFunctionTable && pRtlDeleteFunctionTable && pRtlInstallFunctionTableCallback && pRtlLookupFunctionEntry)
+    {
       test_dynamic_unwind();
+      test_lookup_history_table();
+    }
     else
       skip( "Dynamic unwind functions not found\n" );
     test_extended_context();
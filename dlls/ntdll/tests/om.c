@@ -2205,6 +2205,72 @@ static void test_duplicate_object(void)
     if (!status) pNtClose( handle );
 }
 
+static void test_handle_info(void)
+{
+    char buffer[1024];
+    OBJECT_TYPE_INFORMATION *type_info = (OBJECT_TYPE_INFORMATION *)buffer;
+    OBJECT_DATA_INFORMATION data_info;
+    HANDLE handle, handle2, sems[16];
+    NTSTATUS status;
+    ULONG len, count, i;
+
+    status = pNtCreateEvent( &handle, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
+    ok( !status, "NtCreateEvent failed %x\n", status );
+
+    status = pNtQueryObject( handle, ObjectDataInformation, &data_info, sizeof(data_info), &len );
+    ok( !status, "NtQueryObject failed %x\n", status );
+    ok( !data_info.InheritHandle, "got inherit %u\n", data_info.InheritHandle );
+    ok( !data_info.ProtectFromClose, "got protect %u\n", data_info.ProtectFromClose );
+
+    /* changes to the handle flags must be visible right away */
+    SetHandleInformation( handle, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT );
+    status = pNtQueryObject( handle, ObjectDataInformation, &data_info, sizeof(data_info), &len );
+    ok( !status, "NtQueryObject failed %x\n", status );
+    ok( data_info.InheritHandle, "got inherit %u\n", data_info.InheritHandle );
+    ok( !data_info.ProtectFromClose, "got protect %u\n", data_info.ProtectFromClose );
+
+    status = pNtQueryObject( handle, ObjectTypeInformation, buffer, sizeof(buffer), &len );
+    ok( !status, "NtQueryObject failed %x\n", status );
+    ok( !wcscmp( type_info->TypeName.Buffer, L"Event" ), "wrong type %s\n",
+        debugstr_w( type_info->TypeName.Buffer ));
+    pNtClose( handle );
+
+    /* the handle value is likely to be reused for another object type */
+    status = pNtCreateSemaphore( &handle2, SEMAPHORE_ALL_ACCESS, NULL, 0, 1 );
+    ok( !status, "NtCreateSemaphore failed %x\n", status );
+    status = pNtQueryObject( handle2, ObjectTypeInformation, buffer, sizeof(buffer), &len );
+    ok( !status, "NtQueryObject failed %x\n", status );
+    ok( !wcscmp( type_info->TypeName.Buffer, L"Semaphore" ), "wrong type %s\n",
+        debugstr_w( type_info->TypeName.Buffer ));
+
+    /* object counts must not be cached with the type information */
+    count = type_info->TotalNumberOfObjects;
+    for (i = 0; i < ARRAY_SIZE(sems); i++)
+    {
+        status = pNtCreateSemaphore( &sems[i], SEMAPHORE_ALL_ACCESS, NULL, 0, 1 );
+        ok( !status, "NtCreateSemaphore failed %x\n", status );
+    }
+    status = pNtQueryObject( handle2, ObjectTypeInformation, buffer, sizeof(buffer), &len );
+    ok( !status, "NtQueryObject failed %x\n", status );
+    ok( type_info->TotalNumberOfObjects > count, "got %u objects, expected more than %u\n",
+        type_info->TotalNumberOfObjects, count );
+    for (i = 0; i < ARRAY_SIZE(sems); i++) pNtClose( sems[i] );
+
+    status = pNtQueryObject( handle2, ObjectDataInformation, &data_info, sizeof(data_info), &len );
+    ok( !status, "NtQueryObject failed %x\n", status );
+    ok( !data_info.InheritHandle, "got inherit %u\n", data_info.InheritHandle );
+
+    status = pNtDuplicateObject( GetCurrentProcess(), handle2, GetCurrentProcess(), &handle, 0, 0,
+                                 DUPLICATE_SAME_ACCESS | DUPLICATE_CLOSE_SOURCE );
+    ok( !status, "NtDuplicateObject failed %x\n", status );
+    status = pNtQueryObject( handle2, ObjectTypeInformation, buffer, sizeof(buffer), &len );
+    ok( status == STATUS_INVALID_HANDLE, "NtQueryObject returned %x\n", status );
+    pNtClose( handle );
+
+    status = pNtQueryObject( handle, ObjectDataInformation, &data_info, sizeof(data_info), &len );
+    ok( status == STATUS_INVALID_HANDLE, "NtQueryObject returned %x\n", status );
+}
+
 static void test_object_types(void)
 {
     static const struct { const WCHAR *name; GENERIC_MAPPING mapping; ULONG mask, broken; } tests[] =
@@ -2500,6 +2566,84 @@ static void test_object_identity(void)
     pNtClose( h1 );
 }
 
+#define HANDLE_THREADS 8
+#define HANDLES_PER_THREAD 4096
+
+static HANDLE handle_test_event;
+static HANDLE handle_test_handles[HANDLE_THREADS][HANDLES_PER_THREAD];
+
+static DWORD WINAPI handle_table_thread( void *arg )
+{
+    HANDLE *handles = arg;
+    NTSTATUS status = 0;
+    unsigned int i, pass;
+
+    /* fill the table, then repeatedly punch holes in it and fill them again */
+    for (pass = 0; pass < 3; pass++)
+    {
+        for (i = pass ? pass - 1 : 0; i < HANDLES_PER_THREAD; i += pass ? 2 : 1)
+        {
+            status = pNtDuplicateObject( GetCurrentProcess(), handle_test_event, GetCurrentProcess(),
+                                         &handles[i], 0, 0, DUPLICATE_SAME_ACCESS );
+            if (status) break;
+        }
+        ok( !status, "%u: NtDuplicateObject failed %08x\n", i, status );
+        if (status || pass == 2) break;
+
+        for (i = pass; i < HANDLES_PER_THREAD; i += 2)
+        {
+            status = pNtClose( handles[i] );
+            if (status) break;
+        }
+        ok( !status, "%u: NtClose failed %08x\n", i, status );
+        if (status) break;
+    }
+    return status;
+}
+
+static int __cdecl cmp_handles( const void *a, const void *b )
+{
+    ULONG_PTR h1 = (ULONG_PTR)*(const HANDLE *)a, h2 = (ULONG_PTR)*(const HANDLE *)b;
+    return h1 < h2 ? -1 : h1 > h2;
+}
+
+static void test_handle_table(void)
+{
+    HANDLE threads[HANDLE_THREADS];
+    HANDLE *handles = &handle_test_handles[0][0];
+    NTSTATUS status;
+    unsigned int i;
+
+    handle_test_event = CreateEventA( NULL, FALSE, FALSE, NULL );
+    for (i = 0; i < HANDLE_THREADS; i++)
+        threads[i] = CreateThread( NULL, 0, handle_table_thread, handle_test_handles[i], 0, NULL );
+    WaitForMultipleObjects( HANDLE_THREADS, threads, TRUE, INFINITE );
+    for (i = 0; i < HANDLE_THREADS; i++) CloseHandle( threads[i] );
+
+    qsort( handles, HANDLE_THREADS * HANDLES_PER_THREAD, sizeof(*handles), cmp_handles );
+    for (i = 1; i < HANDLE_THREADS * HANDLES_PER_THREAD; i++)
+    {
+        if (handles[i] == handles[i - 1]) break;
+    }
+    ok( i == HANDLE_THREADS * HANDLES_PER_THREAD, "handle %p returned twice\n", handles[i] );
+
+    if (pNtCompareObjects)
+    {
+        for (i = 0; i < HANDLE_THREADS * HANDLES_PER_THREAD; i++)
+        {
+            if ((status = pNtCompareObjects( handle_test_event, handles[i] ))) break;
+        }
+        ok( !status, "handle %p: got %08x\n", handles[i], status );
+    }
+
+    for (i = 0; i < HANDLE_THREADS * HANDLES_PER_THREAD; i++)
+    {
+        if ((status = pNtClose( handles[i] ))) break;
+    }
+    ok( !status, "closing handle %p failed %08x\n", handles[i], status );
+    CloseHandle( handle_test_event );
+}
+
 START_TEST(om)
 {
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
@@ -2557,8 +2701,10 @@ START_TEST(om)
     test_process();
     test_token();
     test_duplicate_object();
+    test_handle_info();
     test_object_types();
     test_get_next_thread();
     test_globalroot();
     test_object_identity();
+    test_handle_table();
 }
@@ -136,6 +136,7 @@ static NTSTATUS (WINAPI * pNtQueryKey)(HANDLE,KEY_INFORMATION_CLASS,PVOID,ULONG,
 static NTSTATUS (WINAPI * pNtQueryLicenseValue)(const UNICODE_STRING *,ULONG *,PVOID,ULONG,ULONG *);
 static NTSTATUS (WINAPI * pNtQueryObject)(HANDLE, OBJECT_INFORMATION_CLASS, void *, ULONG, ULONG *);
 static NTSTATUS (WINAPI * pNtQueryValueKey)(HANDLE,const UNICODE_STRING *,KEY_VALUE_INFORMATION_CLASS,void *,DWORD,DWORD *);
+static NTSTATUS (WINAPI * pNtQueryMultipleValueKey)(HANDLE,KEY_MULTIPLE_VALUE_INFORMATION *,ULONG,void *,ULONG,ULONG *);
 static NTSTATUS (WINAPI * pNtSetValueKey)(HANDLE, const PUNICODE_STRING, ULONG,
                                ULONG, const void*, ULONG  );
 static NTSTATUS (WINAPI * pNtQueryInformationProcess)(HANDLE,PROCESSINFOCLASS,PVOID,ULONG,PULONG);
@@ -149,6 +150,7 @@ static NTSTATUS (WINAPI * pRtlFreeHeap)(PVOID, ULONG, PVOID);
 static LPVOID   (WINAPI * pRtlAllocateHeap)(PVOID,ULONG,ULONG);
 static NTSTATUS (WINAPI * pRtlZeroMemory)(PVOID, ULONG);
 static NTSTATUS (WINAPI * pRtlCreateRegistryKey)(ULONG, PWSTR);
+static NTSTATUS (WINAPI * pRtlWriteRegistryValue)(ULONG, PCWSTR, PCWSTR, ULONG, PVOID, ULONG);
 static NTSTATUS (WINAPI * pRtlpNtQueryValueKey)(HANDLE,ULONG*,PBYTE,DWORD*,void *);
 static NTSTATUS (WINAPI * pNtNotifyChangeKey)(HANDLE,HANDLE,PIO_APC_ROUTINE,PVOID,PIO_STATUS_BLOCK,ULONG,BOOLEAN,PVOID,ULONG,BOOLEAN);
 static NTSTATUS (WINAPI * pNtNotifyChangeMultipleKeys)(HANDLE,ULONG,OBJECT_ATTRIBUTES*,HANDLE,PIO_APC_ROUTINE,
@@ -204,6 +206,7 @@ static BOOL InitFunctionPtrs(void)
     NTDLL_GET_PROC(RtlAllocateHeap)
     NTDLL_GET_PROC(RtlZeroMemory)
     NTDLL_GET_PROC(RtlCreateRegistryKey)
+    NTDLL_GET_PROC(RtlWriteRegistryValue)
     NTDLL_GET_PROC(RtlpNtQueryValueKey)
     NTDLL_GET_PROC(RtlOpenCurrentUser)
     NTDLL_GET_PROC(NtWaitForSingleObject)
@@ -211,6 +214,7 @@ static BOOL InitFunctionPtrs(void)
     /* optional functions */
     pNtQueryLicenseValue = (void *)GetProcAddress(hntdll, "NtQueryLicenseValue");
     pNtOpenKeyEx = (void *)GetProcAddress(hntdll, "NtOpenKeyEx");
+    pNtQueryMultipleValueKey = (void *)GetProcAddress(hntdll, "NtQueryMultipleValueKey");
     pNtNotifyChangeMultipleKeys = (void *)GetProcAddress(hntdll, "NtNotifyChangeMultipleKeys");
 
     return TRUE;
@@ -724,6 +728,101 @@ static void test_NtFlushKey(void)
     pNtClose(hkey);
 }
 
+static void test_NtQueryMultipleValueKey(void)
+{
+    static const WCHAR multiW[] = L"multitest";
+    KEY_MULTIPLE_VALUE_INFORMATION info[3];
+    UNICODE_STRING names[3];
+    OBJECT_ATTRIBUTES attr;
+    NTSTATUS status;
+    DWORD data = 0x1234;
+    char buffer[64];
+    ULONG len;
+    HANDLE key;
+
+    if (!pNtQueryMultipleValueKey)
+    {
+        win_skip("NtQueryMultipleValueKey is not available\n");
+        return;
+    }
+
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_READ|KEY_SET_VALUE, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey Failed: 0x%08x\n", status);
+
+    pRtlCreateUnicodeStringFromAsciiz(&names[0], "multidword");
+    pRtlCreateUnicodeStringFromAsciiz(&names[1], "multistring");
+    pRtlCreateUnicodeStringFromAsciiz(&names[2], "multimissing");
+    status = pNtSetValueKey(key, &names[0], 0, REG_DWORD, &data, sizeof(data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey Failed: 0x%08x\n", status);
+    status = pNtSetValueKey(key, &names[1], 0, REG_SZ, (void *)multiW, sizeof(multiW));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey Failed: 0x%08x\n", status);
+
+    memset(info, 0, sizeof(info));
+    info[0].ValueName = &names[0];
+    info[1].ValueName = &names[1];
+    info[2].ValueName = &names[2];
+
+    len = 0xdeadbeef;
+    memset(buffer, 0xcc, sizeof(buffer));
+    status = pNtQueryMultipleValueKey(key, info, 2, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "NtQueryMultipleValueKey failed: 0x%08x\n", status);
+    ok(len >= sizeof(data) + sizeof(multiW), "got length %u\n", len);
+    ok(info[0].Type == REG_DWORD, "got type %u\n", info[0].Type);
+    ok(info[0].DataLength == sizeof(data), "got length %u\n", info[0].DataLength);
+    ok(*(DWORD *)(buffer + info[0].DataOffset) == data, "got data %#x\n",
+       *(DWORD *)(buffer + info[0].DataOffset));
+    ok(info[1].Type == REG_SZ, "got type %u\n", info[1].Type);
+    ok(info[1].DataLength == sizeof(multiW), "got length %u\n", info[1].DataLength);
+    ok(!memcmp(buffer + info[1].DataOffset, multiW, sizeof(multiW)), "got wrong string data\n");
+
+    len = 0xdeadbeef;
+    status = pNtQueryMultipleValueKey(key, info, 2, buffer, sizeof(data), &len);
+    ok(status == STATUS_BUFFER_OVERFLOW || status == STATUS_BUFFER_TOO_SMALL,
+       "NtQueryMultipleValueKey returned 0x%08x\n", status);
+    ok(len >= sizeof(data) + sizeof(multiW), "got length %u\n", len);
+
+    status = pNtQueryMultipleValueKey(key, info, 3, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "NtQueryMultipleValueKey returned 0x%08x\n", status);
+
+    pNtDeleteValueKey(key, &names[0]);
+    pNtDeleteValueKey(key, &names[1]);
+    pRtlFreeUnicodeString(&names[0]);
+    pRtlFreeUnicodeString(&names[1]);
+    pRtlFreeUnicodeString(&names[2]);
+    pNtClose(key);
+}
+
+static void test_RtlWriteRegistryValue(void)
+{
+    KEY_VALUE_PARTIAL_INFORMATION *info;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name;
+    NTSTATUS status;
+    DWORD data = 0xfeed;
+    char buffer[64];
+    HANDLE key;
+    ULONG len;
+
+    status = pRtlWriteRegistryValue(RTL_REGISTRY_ABSOLUTE, winetestpath.Buffer, L"writetest",
+                                    REG_DWORD, &data, sizeof(data));
+    ok(status == STATUS_SUCCESS, "RtlWriteRegistryValue failed: 0x%08x\n", status);
+
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_READ|KEY_SET_VALUE, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey Failed: 0x%08x\n", status);
+    pRtlCreateUnicodeStringFromAsciiz(&name, "writetest");
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "NtQueryValueKey failed: 0x%08x\n", status);
+    info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+    ok(info->Type == REG_DWORD, "got type %u\n", info->Type);
+    ok(info->DataLength == sizeof(data), "got length %u\n", info->DataLength);
+    ok(*(DWORD *)info->Data == data, "got data %#x\n", *(DWORD *)info->Data);
+    pNtDeleteValueKey(key, &name);
+    pRtlFreeUnicodeString(&name);
+    pNtClose(key);
+}
+
 static void test_NtQueryValueKey(void)
 {
     HANDLE key;
@@ -2119,6 +2218,8 @@ START_TEST(reg)
     test_NtQueryKey();
     test_NtQueryLicenseKey();
     test_NtQueryValueKey();
+    test_NtQueryMultipleValueKey();
+    test_RtlWriteRegistryValue();
     test_long_value_name();
     test_notify();
     test_RtlCreateRegistryKey();
@@ -3097,6 +3097,195 @@ static void test_RtlInitializeCriticalSectionEx(void)
     RtlDeleteCriticalSection(&cs);
 }
 
+static LONG dynamic_spin_counter;
+
+static DWORD WINAPI dynamic_spin_thread(void *arg)
+{
+    CRITICAL_SECTION *cs = arg;
+    unsigned int i;
+
+    for (i = 0; i < 100000; i++)
+    {
+        RtlEnterCriticalSection(cs);
+        dynamic_spin_counter++;
+        RtlLeaveCriticalSection(cs);
+    }
+    return 0;
+}
+
+struct crit_section_holder
+{
+    CRITICAL_SECTION *cs;
+    HANDLE held;
+};
+
+static DWORD WINAPI crit_section_holder_thread(void *arg)
+{
+    struct crit_section_holder *holder = arg;
+
+    RtlEnterCriticalSection(holder->cs);
+    SetEvent(holder->held);
+    Sleep(100);
+    RtlLeaveCriticalSection(holder->cs);
+    return 0;
+}
+
+/* enter a critical section while another thread holds it for longer than the spin count */
+static void enter_contended_crit_section(CRITICAL_SECTION *cs)
+{
+    struct crit_section_holder holder;
+    HANDLE thread;
+
+    holder.cs = cs;
+    holder.held = CreateEventA(NULL, FALSE, FALSE, NULL);
+    thread = CreateThread(NULL, 0, crit_section_holder_thread, &holder, 0, NULL);
+    WaitForSingleObject(holder.held, INFINITE);
+    RtlEnterCriticalSection(cs);
+    ok(cs->OwningThread == ULongToHandle(GetCurrentThreadId()), "got OwningThread %p\n", cs->OwningThread);
+    RtlLeaveCriticalSection(cs);
+    ok(!WaitForSingleObject(thread, 30000), "wait failed\n");
+    CloseHandle(thread);
+    CloseHandle(holder.held);
+}
+
+static void test_RtlInitializeCriticalSectionEx_dynamic_spin(void)
+{
+    CRITICAL_SECTION cs;
+    HANDLE threads[4];
+    NTSTATUS status;
+    unsigned int i;
+
+    if (!pRtlInitializeCriticalSectionEx)
+    {
+        win_skip("RtlInitializeCriticalSectionEx is not available\n");
+        return;
+    }
+
+    status = pRtlInitializeCriticalSectionEx(&cs, 1000, RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN);
+    ok(!status, "RtlInitializeCriticalSectionEx failed: %x\n", status);
+
+    RtlEnterCriticalSection(&cs);
+    ok(RtlTryEnterCriticalSection(&cs), "RtlTryEnterCriticalSection failed\n");
+    ok(cs.RecursionCount == 2, "expected RecursionCount == 2, got %d\n", cs.RecursionCount);
+    RtlLeaveCriticalSection(&cs);
+    RtlLeaveCriticalSection(&cs);
+    ok(cs.LockCount == -1, "expected LockCount == -1, got %d\n", cs.LockCount);
+
+    /* failing to get the section after spinning raises the average kept by Wine */
+    if (!strcmp(winetest_platform, "wine") && cs.SpinCount)
+    {
+        enter_contended_crit_section(&cs);
+        ok((cs.SpinCount & ~RTL_CRITICAL_SECTION_ALL_FLAG_BITS) > 1000, "got SpinCount %#lx\n", cs.SpinCount);
+        ok(cs.SpinCount & RTL_CRITICAL_SECTION_FLAG_DYNAMIC_SPIN, "got SpinCount %#lx\n", cs.SpinCount);
+    }
+
+    dynamic_spin_counter = 0;
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+        threads[i] = CreateThread(NULL, 0, dynamic_spin_thread, &cs, 0, NULL);
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        ok(!WaitForSingleObject(threads[i], 30000), "wait failed\n");
+        CloseHandle(threads[i]);
+    }
+    ok(dynamic_spin_counter == ARRAY_SIZE(threads) * 100000, "got counter %d\n", dynamic_spin_counter);
+    ok(cs.LockCount == -1, "expected LockCount == -1, got %d\n", cs.LockCount);
+    ok(cs.RecursionCount == 0, "expected RecursionCount == 0, got %d\n", cs.RecursionCount);
+    ok(!cs.OwningThread, "expected OwningThread == NULL, got %p\n", cs.OwningThread);
+    RtlDeleteCriticalSection(&cs);
+}
+
+static void test_RtlEnterCriticalSection_adaptive_spin(void)
+{
+    CRITICAL_SECTION cs;
+    ULONG spin;
+
+    if (strcmp(winetest_platform, "wine"))
+    {
+        skip("spin count adaptation is specific to Wine\n");
+        return;
+    }
+
+    RtlInitializeCriticalSectionAndSpinCount(&cs, 1000);
+    if (!cs.SpinCount)
+    {
+        skip("single processor, no spinning\n");
+        RtlDeleteCriticalSection(&cs);
+        return;
+    }
+    ok(!cs.DebugInfo->EntryCount, "got EntryCount %u\n", cs.DebugInfo->EntryCount);
+
+    /* the average is kept in the debug info, the visible spin count is the maximum */
+    enter_contended_crit_section(&cs);
+    ok(cs.DebugInfo->EntryCount == 1000, "got EntryCount %u\n", cs.DebugInfo->EntryCount);
+    ok(cs.SpinCount == 1000, "got SpinCount %lu\n", cs.SpinCount);
+
+    spin = RtlSetCriticalSectionSpinCount(&cs, 500);
+    ok(spin == 1000, "got old spin count %u\n", spin);
+    ok(!cs.DebugInfo->EntryCount, "got EntryCount %u\n", cs.DebugInfo->EntryCount);
+    enter_contended_crit_section(&cs);
+    ok(cs.DebugInfo->EntryCount == 500, "got EntryCount %u\n", cs.DebugInfo->EntryCount);
+    RtlDeleteCriticalSection(&cs);
+}
+
+static void test_crit_section_profiler_child(void)
+{
+    CRITICAL_SECTION cs, tmp;
+    HANDLE threads[4];
+    unsigned int i;
+
+    RtlInitializeCriticalSectionAndSpinCount(&cs, 1000);
+    dynamic_spin_counter = 0;
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+        threads[i] = CreateThread(NULL, 0, dynamic_spin_thread, &cs, 0, NULL);
+    enter_contended_crit_section(&cs);
+
+    /* more sections than the statistics table holds, to recycle the slots of deleted ones */
+    for (i = 0; i < 10000; i++)
+    {
+        RtlInitializeCriticalSection(&tmp);
+        RtlEnterCriticalSection(&tmp);
+        RtlLeaveCriticalSection(&tmp);
+        RtlDeleteCriticalSection(&tmp);
+    }
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        ok(!WaitForSingleObject(threads[i], 30000), "wait failed\n");
+        CloseHandle(threads[i]);
+    }
+    ok(dynamic_spin_counter == ARRAY_SIZE(threads) * 100000, "got counter %d\n", dynamic_spin_counter);
+    RtlDeleteCriticalSection(&cs);
+}
+
+/* the statistics are printed on the Unix stderr, which can't be redirected here,
+ * so this only checks that recording and dumping them work in a child process */
+static void test_crit_section_profiler(const char *argv0)
+{
+    char cmdline[MAX_PATH + 32], winedebug[256];
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA si = { sizeof(si) };
+    DWORD len;
+    BOOL ret;
+
+    if (strcmp(winetest_platform, "wine"))
+    {
+        skip("+critsec is specific to Wine\n");
+        return;
+    }
+
+    len = GetEnvironmentVariableA("WINEDEBUG", winedebug, sizeof(winedebug));
+    SetEnvironmentVariableA("WINEDEBUG", "+critsec");
+    sprintf(cmdline, "\"%s\" rtl critsec", argv0);
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+    ok(ret, "CreateProcess failed, error %u\n", GetLastError());
+    SetEnvironmentVariableA("WINEDEBUG", len && len < sizeof(winedebug) ? winedebug : NULL);
+    if (!ret) return;
+
+    wait_child_process(pi.hProcess);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+}
+
 static void test_RtlLeaveCriticalSection(void)
 {
     RTL_CRITICAL_SECTION cs;
@@ -3684,8 +3873,18 @@ static void test_RtlDestroyHeap(void)
 
 START_TEST(rtl)
 {
+    char **argv;
+    int argc;
+
     InitFunctionPtrs();
 
+    argc = winetest_get_mainargs(&argv);
+    if (argc > 2 && !strcmp(argv[2], "critsec"))
+    {
+        test_crit_section_profiler_child();
+        return;
+    }
+
     test_RtlQueryProcessDebugInformation();
     test_RtlCompareMemory();
     test_RtlCompareMemoryUlong();
@@ -3719,6 +3918,9 @@ START_TEST(rtl)
     test_RtlDecompressBuffer();
     test_RtlIsCriticalSectionLocked();
     test_RtlInitializeCriticalSectionEx();
+    test_RtlInitializeCriticalSectionEx_dynamic_spin();
+    test_RtlEnterCriticalSection_adaptive_spin();
+    test_crit_section_profiler(argv[0]);
     test_RtlLeaveCriticalSection();
     test_LdrEnumerateLoadedModules();
     test_RtlMakeSelfRelativeSD();
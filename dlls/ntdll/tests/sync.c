@@ -603,6 +603,63 @@ static void test_wait_on_address(void)
     ok(address == 0, "got %s\n", wine_dbgstr_longlong(address));
 }
 
+static union
+{
+    LONG l;
+    BYTE b[4];
+    USHORT w[2];
+} wait_word;
+
+static DWORD WINAPI wait_on_byte_thread(void *arg)
+{
+    BYTE compare = 0;
+
+    while (wait_word.b[0] == compare) pRtlWaitOnAddress(&wait_word.b[0], &compare, 1, NULL);
+    return 0;
+}
+
+static DWORD WINAPI wait_on_word_thread(void *arg)
+{
+    USHORT compare = 0;
+
+    while (wait_word.w[1] == compare) pRtlWaitOnAddress(&wait_word.w[1], &compare, 2, NULL);
+    return 0;
+}
+
+static void test_wait_on_address_parts(void)
+{
+    HANDLE threads[2];
+    DWORD ret;
+
+    if (!pRtlWaitOnAddress)
+    {
+        win_skip("RtlWaitOnAddress not supported, skipping test\n");
+        return;
+    }
+
+    /* waiters on different parts of the same word are independent */
+    wait_word.l = 0;
+    threads[0] = CreateThread(NULL, 0, wait_on_byte_thread, NULL, 0, NULL);
+    threads[1] = CreateThread(NULL, 0, wait_on_word_thread, NULL, 0, NULL);
+    ret = WaitForMultipleObjects(2, threads, FALSE, 100);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+
+    wait_word.w[1] = 1;
+    pRtlWakeAddressSingle(&wait_word.w[1]);
+    ret = WaitForSingleObject(threads[1], 1000);
+    ok(!ret, "got %u\n", ret);
+    ret = WaitForSingleObject(threads[0], 100);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+
+    wait_word.b[0] = 1;
+    pRtlWakeAddressAll(&wait_word.b[0]);
+    ret = WaitForSingleObject(threads[0], 1000);
+    ok(!ret, "got %u\n", ret);
+
+    CloseHandle(threads[0]);
+    CloseHandle(threads[1]);
+}
+
 static HANDLE thread_ready, thread_done;
 
 static DWORD WINAPI resource_shared_thread(void *arg)
@@ -769,6 +826,18 @@ static DWORD WINAPI tid_alert_thread( void *arg )
     return 0;
 }
 
+static DWORD WINAPI tid_alert_wait_on_address_thread( void *arg )
+{
+    LARGE_INTEGER timeout;
+    LONG address = 0, compare = 0;
+    NTSTATUS ret;
+
+    timeout.QuadPart = -5000 * 10000;
+    ret = pRtlWaitOnAddress( &address, &compare, sizeof(address), &timeout );
+    ok(!ret, "got %#x\n", ret);
+    return 0;
+}
+
 static void test_tid_alert( char **argv )
 {
     LARGE_INTEGER timeout = {{0}};
@@ -827,6 +896,17 @@ static void test_tid_alert( char **argv )
 
     CloseHandle(thread);
 
+    if (pRtlWaitOnAddress)
+    {
+        /* an alert also ends RtlWaitOnAddress() */
+        thread = CreateThread( NULL, 0, tid_alert_wait_on_address_thread, NULL, 0, &tid );
+        ret = pNtAlertThreadByThreadId( (HANDLE)(DWORD_PTR)tid );
+        ok(!ret, "got %#x\n", ret);
+        ret = WaitForSingleObject( thread, 1000 );
+        ok(!ret, "got %d\n", ret);
+        CloseHandle(thread);
+    }
+
     sprintf( cmdline, "%s %s subprocess", argv[0], argv[1] );
     ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
     ok(ret, "failed to create process, error %u\n", GetLastError());
@@ -837,6 +917,101 @@ static void test_tid_alert( char **argv )
     CloseHandle( pi.hThread );
 }
 
+static HANDLE ping_event, pong_event;
+
+static DWORD WINAPI ping_pong_thread( void *arg )
+{
+    unsigned int i, count = PtrToUlong( arg );
+
+    for (i = 0; i < count; i++)
+    {
+        WaitForSingleObject( ping_event, INFINITE );
+        pNtSetEvent( pong_event, NULL );
+    }
+    return 0;
+}
+
+static void test_unnamed_objects(void)
+{
+    EVENT_BASIC_INFORMATION event_info;
+    SEMAPHORE_BASIC_INFORMATION sem_info;
+    HANDLE event, sem, objs[2], thread;
+    unsigned int i, count = 10000;
+    LONG prev_state;
+    NTSTATUS status;
+    ULONG prev;
+    DWORD ret, start, ticks;
+
+    status = pNtCreateEvent( &event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, TRUE );
+    ok( !status, "NtCreateEvent failed %08x\n", status );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_OBJECT_0, "got %u\n", ret );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+    ret = WaitForSingleObject( event, 10 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+
+    prev_state = 0xdeadbeef;
+    status = pNtSetEvent( event, &prev_state );
+    ok( !status, "NtSetEvent failed %08x\n", status );
+    ok( !prev_state, "got state %d\n", prev_state );
+    status = pNtQueryEvent( event, EventBasicInformation, &event_info, sizeof(event_info), NULL );
+    ok( !status, "NtQueryEvent failed %08x\n", status );
+    ok( event_info.EventType == SynchronizationEvent, "got type %d\n", event_info.EventType );
+    ok( event_info.EventState == 1, "got state %d\n", event_info.EventState );
+
+    status = pNtCreateSemaphore( &sem, SEMAPHORE_ALL_ACCESS, NULL, 0, 2 );
+    ok( !status, "NtCreateSemaphore failed %08x\n", status );
+
+    /* waiting on several objects goes through the server */
+    objs[0] = sem;
+    objs[1] = event;
+    ret = WaitForMultipleObjects( 2, objs, TRUE, 0 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+    ret = WaitForMultipleObjects( 2, objs, FALSE, 0 );
+    ok( ret == WAIT_OBJECT_0 + 1, "got %u\n", ret );
+    ret = WaitForSingleObject( event, 0 );
+    ok( ret == WAIT_TIMEOUT, "got %u\n", ret );
+
+    status = pNtReleaseSemaphore( sem, 2, &prev );
+    ok( !status, "NtReleaseSemaphore failed %08x\n", status );
+    ok( !prev, "got prev %u\n", prev );
+    status = pNtReleaseSemaphore( sem, 1, &prev );
+    ok( status == STATUS_SEMAPHORE_LIMIT_EXCEEDED, "NtReleaseSemaphore failed %08x\n", status );
+    ret = WaitForSingleObject( sem, 0 );
+    ok( ret == WAIT_OBJECT_0, "got %u\n", ret );
+    status = pNtQuerySemaphore( sem, SemaphoreBasicInformation, &sem_info, sizeof(sem_info), NULL );
+    ok( !status, "NtQuerySemaphore failed %08x\n", status );
+    ok( sem_info.CurrentCount == 1, "got count %d\n", sem_info.CurrentCount );
+    ok( sem_info.MaximumCount == 2, "got max %d\n", sem_info.MaximumCount );
+
+    pNtClose( sem );
+    pNtClose( event );
+
+    status = pNtCreateEvent( &ping_event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE );
+    ok( !status, "NtCreateEvent failed %08x\n", status );
+    status = pNtCreateEvent( &pong_event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE );
+    ok( !status, "NtCreateEvent failed %08x\n", status );
+
+    thread = CreateThread( NULL, 0, ping_pong_thread, ULongToPtr( count ), 0, NULL );
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        pNtSetEvent( ping_event, NULL );
+        ret = WaitForSingleObject( pong_event, 5000 );
+        if (ret) break;
+    }
+    ticks = GetTickCount() - start;
+    ok( i == count, "ping-pong failed after %u iterations, ret %u\n", i, ret );
+    trace( "%u event round trips in %u ms\n", i, ticks );
+
+    ret = WaitForSingleObject( thread, 5000 );
+    ok( !ret, "got %u\n", ret );
+    CloseHandle( thread );
+    pNtClose( ping_event );
+    pNtClose( pong_event );
+}
+
 START_TEST(sync)
 {
     HMODULE module = GetModuleHandleA("ntdll.dll");
@@ -878,9 +1053,11 @@ START_TEST(sync)
     pRtlWakeAddressSingle           = (void *)GetProcAddress(module, "RtlWakeAddressSingle");
 
     test_wait_on_address();
+    test_wait_on_address_parts();
     test_event();
     test_mutant();
     test_semaphore();
+    test_unnamed_objects();
     test_keyed_events();
     test_resource();
     test_tid_alert( argv );
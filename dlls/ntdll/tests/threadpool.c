@@ -740,6 +740,66 @@ static void test_tp_work(void)
     pTpReleasePool(pool);
 }
 
+static void CALLBACK fanout_work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    InterlockedIncrement((LONG *)userdata);
+}
+
+struct fanout_info
+{
+    TP_POOL *pool;
+    LONG     counter;
+};
+
+static DWORD WINAPI fanout_thread(void *arg)
+{
+    struct fanout_info *info = arg;
+    TP_CALLBACK_ENVIRON environment;
+    TP_WORK *works[64];
+    NTSTATUS status;
+    int i, j;
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = info->pool;
+    for (i = 0; i < ARRAY_SIZE(works); i++)
+    {
+        works[i] = NULL;
+        status = pTpAllocWork(&works[i], fanout_work_cb, &info->counter, &environment);
+        ok(!status, "TpAllocWork failed with status %x\n", status);
+    }
+    for (j = 0; j < 64; j++)
+        for (i = 0; i < ARRAY_SIZE(works); i++) pTpPostWork(works[i]);
+    for (i = 0; i < ARRAY_SIZE(works); i++)
+    {
+        pTpWaitForWork(works[i], FALSE);
+        pTpReleaseWork(works[i]);
+    }
+    return 0;
+}
+
+static void test_tp_work_fanout(void)
+{
+    struct fanout_info info;
+    HANDLE threads[4];
+    NTSTATUS status;
+    int i;
+
+    info.pool = NULL;
+    info.counter = 0;
+    status = pTpAllocPool(&info.pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+
+    /* many small work items submitted concurrently from several threads */
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+        threads[i] = CreateThread(NULL, 0, fanout_thread, &info, 0, NULL);
+    WaitForMultipleObjects(ARRAY_SIZE(threads), threads, TRUE, INFINITE);
+    for (i = 0; i < ARRAY_SIZE(threads); i++) CloseHandle(threads[i]);
+    ok(info.counter == ARRAY_SIZE(threads) * 64 * 64, "got counter %u\n", info.counter);
+
+    pTpReleasePool(info.pool);
+}
+
 static void test_tp_work_scheduler(void)
 {
     TP_CALLBACK_ENVIRON environment;
@@ -2370,6 +2430,7 @@ START_TEST(threadpool)
     test_tp_simple();
     test_tp_work();
     test_tp_work_scheduler();
+    test_tp_work_fanout();
     test_tp_group_wait();
     test_tp_group_cancel();
     test_tp_instance();
@@ -115,6 +115,7 @@ struct threadpool
     int                     min_workers;
     int                     num_workers;
     int                     num_busy_workers;
+    int                     num_idle_workers;   /* workers sleeping on .update_event */
     HANDLE                  compl_port;
     TP_POOL_STACK_INFORMATION stack_info;
 };
@@ -1674,6 +1675,7 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     pool->min_workers             = 0;
     pool->num_workers             = 0;
     pool->num_busy_workers        = 0;
+    pool->num_idle_workers        = 0;
     pool->stack_info.StackReserve = nt->OptionalHeader.SizeOfStackReserve;
     pool->stack_info.StackCommit  = nt->OptionalHeader.SizeOfStackCommit;
 
@@ -1966,21 +1968,31 @@ static void tp_object_prio_queue( struct threadpool_object *object )
  *
  * Submits a threadpool object to the associated threadpool. This
  * function has to be VOID because TpPostWork can never fail on Windows.
+ *
+ * A new worker is only reserved under pool->cs; the thread itself is
+ * created after leaving it, since that needs a server round trip.
  */
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
 {
     struct threadpool *pool = object->pool;
-    NTSTATUS status = STATUS_UNSUCCESSFUL;
+    BOOL new_thread = FALSE;
+    HANDLE thread;
 
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
     RtlEnterCriticalSection( &pool->cs );
 
-    /* Start new worker threads if required. */
+    /* Start new worker threads if required. The thread is created after
+     * leaving the critical section, so that other threads can continue
+     * submitting and executing work items in the meantime. */
     if (pool->num_busy_workers >= pool->num_workers &&
         pool->num_workers < pool->max_workers)
-        status = tp_new_worker_thread( pool );
+    {
+        InterlockedIncrement( &pool->refcount );
+        pool->num_workers++;
+        new_thread = TRUE;
+    }
 
     /* Queue work item and increment refcount. */
     InterlockedIncrement( &object->refcount );
@@ -1991,14 +2003,28 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
         object->u.wait.signaled++;
 
-    /* No new thread started - wake up one existing thread. */
-    if (status != STATUS_SUCCESS)
+    /* No new thread started - wake up one existing thread if there is an idle one,
+     * busy threads check the queue before going to sleep. */
+    if (!new_thread)
     {
         assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
+        if (pool->num_idle_workers)
+            RtlWakeConditionVariable( &pool->update_event );
     }
 
     RtlLeaveCriticalSection( &pool->cs );
+
+    if (new_thread && RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, 0, 0, 0,
+                                           threadpool_worker_proc, pool, &thread, NULL ))
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        pool->num_workers--;
+        assert( pool->num_workers > 0 );
+        RtlWakeConditionVariable( &pool->update_event );
+        RtlLeaveCriticalSection( &pool->cs );
+        tp_threadpool_release( pool );
+    }
+    else if (new_thread) NtClose( thread );
 }
 
 /***********************************************************************
@@ -2321,6 +2347,7 @@ static void CALLBACK threadpool_worker_proc( void *param )
     struct threadpool *pool = param;
     LARGE_INTEGER timeout;
     struct list *ptr;
+    NTSTATUS status;
 
     TRACE( "starting worker thread for pool %p\n", pool );
 
@@ -2356,7 +2383,10 @@ static void CALLBACK threadpool_worker_proc( void *param )
          * min_workers == 0, then objcount is used to detect if the last thread
          * can be terminated. */
         timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
+        pool->num_idle_workers++;
+        status = RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout );
+        pool->num_idle_workers--;
+        if (status == STATUS_TIMEOUT &&
             !threadpool_get_next_item( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
         {
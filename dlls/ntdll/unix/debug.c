@@ -26,12 +26,18 @@
 
 #include <assert.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -65,6 +71,252 @@ static struct __wine_debug_channel *debug_options;
 
 static const char * const debug_classes[] = { "fixme", "err", "warn", "trace" };
 
+/* Asynchronous output, enabled with WINEDEBUGASYNC. Lines are copied into a ring
+ * of fixed-size slots shared by all threads, and written out by a separate thread.
+ * A line is split over consecutive slots, which are reserved all at once so that
+ * lines from different threads are never interleaved. Producers never block:
+ * when the ring is full the line is dropped and counted. A slot that stays reserved
+ * but unfilled for too long, because its thread was suspended or killed, is skipped
+ * by the writer and counted as dropped too. */
+
+#define DEBUG_SLOT_SIZE   248
+#define DEBUG_RING_SLOTS  16384  /* must be a power of 2 */
+#define DEBUG_SLOT_STALL  200    /* ms to wait for a reserved slot to be filled */
+
+struct debug_slot
+{
+    unsigned int seq;   /* sequence number, equals the position when the slot is free */
+    unsigned int len;   /* length of data in this slot */
+    char         data[DEBUG_SLOT_SIZE];
+};
+
+C_ASSERT( sizeof(struct debug_slot) == 256 );
+
+static struct debug_slot *debug_ring;
+static unsigned int debug_ring_head;     /* next position to reserve */
+static unsigned int debug_ring_tail;     /* next position to write out */
+static unsigned int debug_ring_dropped;  /* lines dropped because the ring was full */
+static int debug_writer_waiting;
+static pthread_mutex_t debug_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void wait_for_debug_output(void)
+{
+#ifdef __linux__
+    struct timespec timeout = { 0, 10000000 };
+
+    __atomic_store_n( &debug_writer_waiting, 1, __ATOMIC_SEQ_CST );
+    if (__atomic_load_n( &debug_ring[debug_ring_tail % DEBUG_RING_SLOTS].seq, __ATOMIC_ACQUIRE )
+        != debug_ring_tail + 1)
+        syscall( __NR_futex, &debug_writer_waiting, 0 /* FUTEX_WAIT */, 1, &timeout, 0, 0 );
+    __atomic_store_n( &debug_writer_waiting, 0, __ATOMIC_SEQ_CST );
+#else
+    usleep( 10000 );
+#endif
+}
+
+static void wake_debug_writer(void)
+{
+#ifdef __linux__
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    if (__atomic_load_n( &debug_writer_waiting, __ATOMIC_SEQ_CST ))
+        syscall( __NR_futex, &debug_writer_waiting, 1 /* FUTEX_WAKE */, 1, NULL, 0, 0 );
+#endif
+}
+
+/* write out all the complete lines currently in the ring; returns FALSE if it was empty,
+ * or if another thread is writing and we can't wait for it */
+static BOOL flush_debug_ring( BOOL wait )
+{
+    static unsigned int reported_dropped;
+    char buffer[64 * DEBUG_SLOT_SIZE];
+    unsigned int dropped, len = 0;
+    struct debug_slot *slot;
+    BOOL ret = FALSE;
+
+    if (wait) pthread_mutex_lock( &debug_writer_mutex );
+    else if (pthread_mutex_trylock( &debug_writer_mutex )) return FALSE;
+    for (;;)
+    {
+        slot = &debug_ring[debug_ring_tail % DEBUG_RING_SLOTS];
+        if (__atomic_load_n( &slot->seq, __ATOMIC_ACQUIRE ) != debug_ring_tail + 1) break;
+        if (len + slot->len > sizeof(buffer))
+        {
+            write( 2, buffer, len );
+            len = 0;
+        }
+        memcpy( buffer + len, slot->data, slot->len );
+        len += slot->len;
+        /* make the slot available for the next round */
+        __atomic_store_n( &slot->seq, debug_ring_tail + DEBUG_RING_SLOTS, __ATOMIC_RELEASE );
+        debug_ring_tail++;
+        ret = TRUE;
+    }
+    if (len) write( 2, buffer, len );
+
+    dropped = __atomic_load_n( &debug_ring_dropped, __ATOMIC_RELAXED );
+    if (dropped != reported_dropped)
+    {
+        len = snprintf( buffer, sizeof(buffer), "wine: %u debug lines dropped\n", dropped - reported_dropped );
+        write( 2, buffer, len );
+        reported_dropped = dropped;
+    }
+    pthread_mutex_unlock( &debug_writer_mutex );
+    return ret;
+}
+
+/* give up on the slot at pos, if it is still reserved but not filled */
+static BOOL skip_stalled_debug_slot( unsigned int pos )
+{
+    unsigned int seq = pos;
+    BOOL ret = FALSE;
+
+    pthread_mutex_lock( &debug_writer_mutex );
+    /* free it for the next round; the producer will then fail to fill it */
+    if (debug_ring_tail == pos &&
+        __atomic_compare_exchange_n( &debug_ring[pos % DEBUG_RING_SLOTS].seq, &seq, pos + DEBUG_RING_SLOTS,
+                                     FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ))
+    {
+        __atomic_add_fetch( &debug_ring_dropped, 1, __ATOMIC_RELAXED );
+        debug_ring_tail++;
+        ret = TRUE;
+    }
+    pthread_mutex_unlock( &debug_writer_mutex );
+    return ret;
+}
+
+static ULONGLONG get_debug_time(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    if (!clock_gettime( CLOCK_MONOTONIC, &ts )) return (ULONGLONG)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+    return (ULONGLONG)time( NULL ) * 1000;
+}
+
+static void *debug_writer_thread( void *arg )
+{
+    unsigned int pos, stalled_pos = 0;
+    ULONGLONG stalled_time = 0;
+
+    for (;;)
+    {
+        if (flush_debug_ring( TRUE )) continue;
+
+        pos = __atomic_load_n( &debug_ring_tail, __ATOMIC_RELAXED );
+        if (pos != __atomic_load_n( &debug_ring_head, __ATOMIC_RELAXED ))  /* reserved but not filled */
+        {
+            if (!stalled_time || stalled_pos != pos)
+            {
+                stalled_pos = pos;
+                stalled_time = get_debug_time();
+            }
+            else if (get_debug_time() - stalled_time >= DEBUG_SLOT_STALL && skip_stalled_debug_slot( pos ))
+            {
+                stalled_time = 0;
+                continue;
+            }
+        }
+        wait_for_debug_output();
+    }
+    return NULL;
+}
+
+/* queue a debug line; returns FALSE if it doesn't fit and should be written directly */
+static BOOL queue_debug_output( const char *str, unsigned int len )
+{
+    unsigned int pos, seq, i, count = max( 1, (len + DEBUG_SLOT_SIZE - 1) / DEBUG_SLOT_SIZE );
+    struct debug_slot *slot;
+
+    if (count > DEBUG_RING_SLOTS / 4) return FALSE;
+
+    pos = __atomic_load_n( &debug_ring_head, __ATOMIC_RELAXED );
+    for (;;)
+    {
+        /* slots are freed in order, so if the last one is free they all are */
+        slot = &debug_ring[(pos + count - 1) % DEBUG_RING_SLOTS];
+        if ((int)(__atomic_load_n( &slot->seq, __ATOMIC_ACQUIRE ) - (pos + count - 1)) < 0)
+        {
+            __atomic_add_fetch( &debug_ring_dropped, 1, __ATOMIC_RELAXED );
+            wake_debug_writer();
+            return TRUE;
+        }
+        if (__atomic_compare_exchange_n( &debug_ring_head, &pos, pos + count, TRUE,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED ))
+            break;
+    }
+
+    for (i = 0; i < count; i++, pos++)
+    {
+        slot = &debug_ring[pos % DEBUG_RING_SLOTS];
+        slot->len = min( len, DEBUG_SLOT_SIZE );
+        memcpy( slot->data, str, slot->len );
+        str += slot->len;
+        len -= slot->len;
+        /* the writer may have given up on the slot if we've been suspended for too long */
+        seq = pos;
+        __atomic_compare_exchange_n( &slot->seq, &seq, pos + 1, FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED );
+    }
+    wake_debug_writer();
+    return TRUE;
+}
+
+/***********************************************************************
+ *		dbg_flush
+ *
+ * Write out the pending asynchronous output before the process exits or execs.
+ * When aborting, the thread that was killed may have been holding the writer
+ * lock, so don't wait for it.
+ */
+void dbg_flush( BOOL wait )
+{
+    if (debug_ring) flush_debug_ring( wait );
+}
+
+static void flush_at_exit(void)
+{
+    dbg_flush( TRUE );
+}
+
+/* a forked child has no writer thread, and only execs something else, so it writes its
+ * output directly; the lines that were already queued are written out by the parent */
+static void reset_debug_ring_in_child(void)
+{
+    debug_ring = NULL;
+}
+
+static void init_debug_ring(void)
+{
+    const char *env = getenv( "WINEDEBUGASYNC" );
+    pthread_attr_t attr;
+    pthread_t thread;
+    sigset_t sigset, old_sigset;
+    unsigned int i;
+
+    if (!env || !atoi( env ) || !default_flags) return;
+    if (!(debug_ring = malloc( DEBUG_RING_SLOTS * sizeof(*debug_ring) ))) return;
+    for (i = 0; i < DEBUG_RING_SLOTS; i++) debug_ring[i].seq = i;
+
+    /* the writer thread must not receive any of our signals */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_BLOCK, &sigset, &old_sigset );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    pthread_attr_setstacksize( &attr, 0x40000 );
+    if (pthread_create( &thread, &attr, debug_writer_thread, NULL ))
+    {
+        free( debug_ring );
+        debug_ring = NULL;
+    }
+    else
+    {
+        atexit( flush_at_exit );
+        pthread_atfork( NULL, NULL, reset_debug_ring_in_child );
+    }
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+}
+
 /* get the debug info pointer for the current thread */
 static inline struct debug_info *get_info(void)
 {
@@ -81,6 +333,7 @@ static int append_output( struct debug_info *info, const char *str, size_t len )
 {
     if (len >= sizeof(info->output) - info->out_pos)
     {
+       dbg_flush( TRUE );
        fprintf( stderr, "wine_dbg_output: debugstr buffer overflow (contents: '%s')\n", info->output );
        info->out_pos = 0;
        abort();
@@ -257,6 +510,7 @@ const char * __cdecl __wine_dbg_strdup( const char *str )
  */
 int WINAPI __wine_dbg_write( const char *str, unsigned int len )
 {
+    if (debug_ring && queue_debug_output( str, len )) return len;
     return write( 2, str, len );
 }
 
@@ -330,6 +584,7 @@ void dbg_init(void)
     debug_options = options;
     options[nb_debug_options] = default_option;
     init_done = TRUE;
+    init_debug_ring();
 }
 
 
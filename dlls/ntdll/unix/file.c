@@ -41,6 +41,7 @@
 #include <mntent.h>
 #endif
 #include <poll.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #ifdef HAVE_SYS_STATVFS_H
 # include <sys/statvfs.h>
@@ -51,6 +52,9 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/ioctl.h>
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 #ifdef HAVE_SYS_ATTR_H
 #include <sys/attr.h>
 #endif
@@ -86,6 +90,9 @@
 #ifdef HAVE_LINUX_MAJOR_H
 # include <linux/major.h>
 #endif
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+#endif
 #ifdef HAVE_SYS_PARAM_H
 #include <sys/param.h>
 #endif
@@ -226,8 +233,45 @@ static mode_t start_umask;
 /* at some point we may want to allow Winelib apps to set this */
 static const BOOL is_case_sensitive = FALSE;
 
+/* case-insensitive index of the names of a directory, used by find_file_in_dir */
+struct dir_name_entry
+{
+    unsigned int            next;       /* next entry in the hash chain, or ~0u */
+    unsigned int            hash;       /* case-insensitive hash of the name */
+    unsigned int            name;       /* offset of the Unicode name in the names buffer */
+    unsigned int            unix_name;  /* offset of the Unix name in the unix_names buffer */
+    unsigned int            len;        /* length of the Unicode name */
+};
+
+struct dir_name_cache
+{
+    struct list             entry;      /* entry in the dir_name_caches list */
+    dev_t                   dev;        /* directory device */
+    ino_t                   ino;        /* directory inode */
+    time_t                  mtime;      /* directory modification time when the index was built */
+    long                    mtime_nsec;
+    time_t                  ctime;      /* directory change time when the index was built */
+    unsigned int            count;      /* count of used entries */
+    unsigned int            size;       /* size of the entries array */
+    unsigned int            hash_size;  /* size of the buckets array (power of 2) */
+    unsigned int           *buckets;    /* head of the hash chains */
+    struct dir_name_entry  *entries;
+    WCHAR                  *names;      /* Unicode names buffer */
+    unsigned int            names_size;
+    unsigned int            names_pos;
+    char                   *unix_names; /* Unix names buffer */
+    unsigned int            unix_names_size;
+    unsigned int            unix_names_pos;
+};
+
+#define MAX_DIR_NAME_CACHES 16
+
+static struct list dir_name_caches = LIST_INIT( dir_name_caches );
+static unsigned int dir_name_caches_count;
+
 static pthread_mutex_t dir_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t mnt_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t dir_name_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* check if a given Unicode char is OK in a DOS short name */
 static inline BOOL is_invalid_dos_char( WCHAR ch )
@@ -2473,6 +2517,246 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 }
 
 
+/* case-insensitive hash of a file name */
+static unsigned int hash_dir_name( const WCHAR *name, unsigned int len )
+{
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < len; i++) hash = hash * 65599 + towupper( name[i] );
+    return hash;
+}
+
+static long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/* check whether any change made to the directory from now on is certain to change its timestamps */
+static BOOL dir_times_are_settled( const struct stat *st )
+{
+    time_t now;
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_REALTIME_COARSE)
+    struct timespec ts;
+    long nsec = get_mtime_nsec( st );
+
+    /* changes are stamped with at least the coarse clock, so with sub-second timestamps it's
+     * enough for the modification time to be older than that, with some room for the
+     * timestamp granularity of the filesystem */
+    if (nsec && !clock_gettime( CLOCK_REALTIME_COARSE, &ts ))
+        return (ULONGLONG)st->st_mtime * 1000000000 + nsec + 10000000 <=
+               (ULONGLONG)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+    /* with coarse timestamps the directory could change again without its
+     * modification time changing, so the index can't be kept if it's too recent */
+    now = time( NULL );
+    return st->st_mtime < now - 1 && st->st_ctime < now - 1;
+}
+
+static void free_dir_name_cache( struct dir_name_cache *cache )
+{
+    free( cache->buckets );
+    free( cache->entries );
+    free( cache->names );
+    free( cache->unix_names );
+    free( cache );
+}
+
+/* add a file name to a directory index; helper for build_dir_name_cache */
+static BOOL add_dir_name_entry( struct dir_name_cache *cache, const char *unix_name )
+{
+    unsigned int unix_len = strlen( unix_name ) + 1;
+    struct dir_name_entry *entry;
+
+    if (cache->count == cache->size)
+    {
+        unsigned int new_size = max( cache->size * 2, 64 );
+        struct dir_name_entry *new_entries = realloc( cache->entries, new_size * sizeof(*new_entries) );
+
+        if (!new_entries) return FALSE;
+        cache->entries = new_entries;
+        cache->size = new_size;
+    }
+    if (cache->names_size - cache->names_pos < MAX_DIR_ENTRY_LEN)
+    {
+        unsigned int new_size = max( cache->names_size * 2, 4096 );
+        WCHAR *new_names = realloc( cache->names, new_size * sizeof(WCHAR) );
+
+        if (!new_names) return FALSE;
+        cache->names = new_names;
+        cache->names_size = new_size;
+    }
+    if (cache->unix_names_size - cache->unix_names_pos < unix_len)
+    {
+        unsigned int new_size = max( cache->unix_names_size * 2, 4096 );
+        char *new_unix_names;
+
+        new_size = max( new_size, cache->unix_names_pos + unix_len );
+        if (!(new_unix_names = realloc( cache->unix_names, new_size ))) return FALSE;
+        cache->unix_names = new_unix_names;
+        cache->unix_names_size = new_size;
+    }
+
+    entry = &cache->entries[cache->count++];
+    entry->name = cache->names_pos;
+    entry->len = ntdll_umbstowcs( unix_name, unix_len - 1, cache->names + entry->name, MAX_DIR_ENTRY_LEN );
+    entry->hash = hash_dir_name( cache->names + entry->name, entry->len );
+    entry->unix_name = cache->unix_names_pos;
+    memcpy( cache->unix_names + entry->unix_name, unix_name, unix_len );
+    cache->names_pos += entry->len;
+    cache->unix_names_pos += unix_len;
+    return TRUE;
+}
+
+/* read a directory and build a case-insensitive index of its names */
+static struct dir_name_cache *build_dir_name_cache( const char *unix_name, const struct stat *st )
+{
+    struct dir_name_cache *cache;
+    struct dirent *de;
+    unsigned int i;
+    DIR *dir;
+
+    if (!(dir = opendir( unix_name ))) return NULL;
+    if (!(cache = calloc( 1, sizeof(*cache) ))) goto failed;
+
+    cache->dev = st->st_dev;
+    cache->ino = st->st_ino;
+    cache->mtime = st->st_mtime;
+    cache->mtime_nsec = get_mtime_nsec( st );
+    cache->ctime = st->st_ctime;
+
+    while ((de = readdir( dir )))
+        if (!add_dir_name_entry( cache, de->d_name )) goto failed;
+
+    closedir( dir );
+    dir = NULL;
+
+    for (cache->hash_size = 16; cache->hash_size < cache->count; cache->hash_size *= 2) ;
+    if (!(cache->buckets = malloc( cache->hash_size * sizeof(*cache->buckets) ))) goto failed;
+    memset( cache->buckets, 0xff, cache->hash_size * sizeof(*cache->buckets) );
+    for (i = 0; i < cache->count; i++)
+    {
+        unsigned int bucket = cache->entries[i].hash & (cache->hash_size - 1);
+        cache->entries[i].next = cache->buckets[bucket];
+        cache->buckets[bucket] = i;
+    }
+    TRACE( "indexed %u names in %s\n", cache->count, debugstr_a(unix_name) );
+    return cache;
+
+failed:
+    if (dir) closedir( dir );
+    if (cache) free_dir_name_cache( cache );
+    return NULL;
+}
+
+/* find a name in a directory index; returns the Unix name or NULL */
+static const char *lookup_dir_name_cache( const struct dir_name_cache *cache,
+                                          const WCHAR *name, int length )
+{
+    unsigned int hash = hash_dir_name( name, length );
+    unsigned int i;
+
+    for (i = cache->buckets[hash & (cache->hash_size - 1)]; i != ~0u; i = cache->entries[i].next)
+    {
+        const struct dir_name_entry *entry = &cache->entries[i];
+
+        if (entry->hash != hash || entry->len != length) continue;
+        if (!wcsnicmp( cache->names + entry->name, name, length )) return cache->unix_names + entry->unix_name;
+    }
+    return NULL;
+}
+
+
+/***********************************************************************
+ *           find_file_in_dir_cache
+ *
+ * Look up a file name in the cached index of a directory, building it if needed.
+ * The directory name must be terminated at pos - 1; the file found is appended at pos.
+ * Returns 1 if found, 0 if not found, and -1 if the directory couldn't be indexed.
+ */
+static int find_file_in_dir_cache( char *unix_name, int pos, const WCHAR *name, int length )
+{
+    struct dir_name_cache *cache, *old;
+    const char *found;
+    struct stat st;
+    BOOL settled;
+    int ret = -1;
+
+    if (stat( unix_name, &st ) == -1) return -1;
+
+    mutex_lock( &dir_name_mutex );
+    LIST_FOR_EACH_ENTRY( cache, &dir_name_caches, struct dir_name_cache, entry )
+    {
+        if (cache->dev != st.st_dev || cache->ino != st.st_ino) continue;
+        list_remove( &cache->entry );
+        if (cache->mtime == st.st_mtime && cache->mtime_nsec == get_mtime_nsec( &st ) &&
+            cache->ctime == st.st_ctime)
+        {
+            list_add_head( &dir_name_caches, &cache->entry );
+            if ((found = lookup_dir_name_cache( cache, name, length )))
+            {
+                unix_name[pos - 1] = '/';
+                strcpy( unix_name + pos, found );
+                ret = 1;
+            }
+            else ret = 0;
+        }
+        else
+        {
+            dir_name_caches_count--;
+            free_dir_name_cache( cache );
+        }
+        break;
+    }
+    mutex_unlock( &dir_name_mutex );
+    if (ret != -1) return ret;
+
+    settled = dir_times_are_settled( &st );
+    if (!(cache = build_dir_name_cache( unix_name, &st ))) return -1;
+
+    if ((found = lookup_dir_name_cache( cache, name, length )))
+    {
+        unix_name[pos - 1] = '/';
+        strcpy( unix_name + pos, found );
+        ret = 1;
+    }
+    else ret = 0;
+
+    if (!settled)
+    {
+        free_dir_name_cache( cache );
+        return ret;
+    }
+
+    mutex_lock( &dir_name_mutex );
+    LIST_FOR_EACH_ENTRY( old, &dir_name_caches, struct dir_name_cache, entry )
+    {
+        /* another thread may have indexed the same directory in the meantime */
+        if (old->dev != cache->dev || old->ino != cache->ino) continue;
+        list_remove( &old->entry );
+        dir_name_caches_count--;
+        free_dir_name_cache( old );
+        break;
+    }
+    if (dir_name_caches_count == MAX_DIR_NAME_CACHES)
+    {
+        old = LIST_ENTRY( list_tail( &dir_name_caches ), struct dir_name_cache, entry );
+        list_remove( &old->entry );
+        dir_name_caches_count--;
+        free_dir_name_cache( old );
+    }
+    list_add_head( &dir_name_caches, &cache->entry );
+    dir_name_caches_count++;
+    mutex_unlock( &dir_name_mutex );
+    return ret;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2513,6 +2797,11 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 
     if (!is_name_8_dot_3 && !get_dir_case_sensitivity( unix_name )) goto not_found;
 
+    /* look it up in the directory index; short names are not indexed */
+
+    if ((ret = find_file_in_dir_cache( unix_name, pos, name, length )) == 1) return STATUS_SUCCESS;
+    if (!ret && !is_name_8_dot_3) goto not_found;
+
     /* now look for it through the directory */
 
 #ifdef VFAT_IOCTL_READDIR_BOTH
@@ -3864,6 +4153,20 @@ NTSTATUS WINAPI NtCreateMailslotFile( HANDLE *handle, ULONG access, OBJECT_ATTRI
 }
 
 
+/* whether byte mode pipes created by this process should pass their data through a socket pair */
+static BOOL direct_pipes_enabled(void)
+{
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINEDIRECTPIPES" );
+        enabled = env && atoi( env );
+    }
+    return enabled;
+}
+
+
 /******************************************************************
  *		NtCreateNamedPipeFile    (NTDLL.@)
  */
@@ -3898,7 +4201,8 @@ NTSTATUS WINAPI NtCreateNamedPipeFile( HANDLE *handle, ULONG access, OBJECT_ATTR
         req->flags =
             (pipe_type ? NAMED_PIPE_MESSAGE_STREAM_WRITE   : 0) |
             (read_mode ? NAMED_PIPE_MESSAGE_STREAM_READ    : 0) |
-            (completion_mode ? NAMED_PIPE_NONBLOCKING_MODE : 0);
+            (completion_mode ? NAMED_PIPE_NONBLOCKING_MODE : 0) |
+            (direct_pipes_enabled() ? NAMED_PIPE_DIRECT_MODE : 0);
         req->maxinstances = max_inst;
         req->outsize = outbound_quota;
         req->insize  = inbound_quota;
@@ -4095,6 +4399,7 @@ NTSTATUS WINAPI NtQueryInformationFile( HANDLE handle, IO_STATUS_BLOCK *io,
     int fd, needs_close = FALSE;
     ULONG attr;
     unsigned int options;
+    enum server_fd_type type;
     NTSTATUS status;
 
     TRACE( "(%p,%p,%p,0x%08x,0x%08x)\n", handle, io, ptr, len, class);
@@ -4108,11 +4413,16 @@ NTSTATUS WINAPI NtQueryInformationFile( HANDLE handle, IO_STATUS_BLOCK *io,
     if (len < info_sizes[class])
         return io->u.Status = STATUS_INFO_LENGTH_MISMATCH;
 
-    if ((status = server_get_unix_fd( handle, 0, &fd, &needs_close, NULL, &options )))
+    if ((status = server_get_unix_fd( handle, 0, &fd, &needs_close, &type, &options )))
     {
         if (status != STATUS_BAD_DEVICE_TYPE) return io->u.Status = status;
         return server_get_file_info( handle, io, ptr, len, class );
     }
+    if (type == FD_TYPE_PIPE)  /* the socket of a direct pipe doesn't have the right info */
+    {
+        if (needs_close) close( fd );
+        return server_get_file_info( handle, io, ptr, len, class );
+    }
 
     switch (class)
     {
@@ -4872,6 +5182,26 @@ static NTSTATUS server_write_file( HANDLE handle, HANDLE event, PIO_APC_ROUTINE
     return status;
 }
 
+/* write the rest of the data through the server, once the socket of a direct
+ * pipe end got shut down in the middle of a write */
+static NTSTATUS pipe_write_remainder( HANDLE handle, const void *buffer, ULONG size, ULONG *written )
+{
+    IO_STATUS_BLOCK io;
+    NTSTATUS status;
+    HANDLE event;
+
+    if ((status = NtCreateEvent( &event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE ))) return status;
+    status = server_write_file( handle, event, NULL, NULL, &io, buffer, size, NULL, NULL );
+    if (status == STATUS_PENDING)
+    {
+        NtWaitForSingleObject( event, FALSE, NULL );
+        status = io.u.Status;
+    }
+    if (!status) *written = io.Information;
+    NtClose( event );
+    return status;
+}
+
 /* do an ioctl call through the server */
 static NTSTATUS server_ioctl_file( HANDLE handle, HANDLE event,
                                    PIO_APC_ROUTINE apc, PVOID apc_context,
@@ -4986,6 +5316,7 @@ static NTSTATUS get_io_timeouts( HANDLE handle, enum server_fd_type type, ULONG
         }
         break;
     case FD_TYPE_SOCKET:
+    case FD_TYPE_PIPE:
     case FD_TYPE_CHAR:
         if (is_read) timeouts->interval = 0;  /* return as soon as we got something */
         break;
@@ -5038,6 +5369,7 @@ static NTSTATUS get_io_avail_mode( HANDLE handle, enum server_fd_type type, BOOL
     }
     case FD_TYPE_MAILSLOT:
     case FD_TYPE_SOCKET:
+    case FD_TYPE_PIPE:
     case FD_TYPE_CHAR:
         *avail_mode = TRUE;
         break;
@@ -5092,6 +5424,403 @@ void add_completion( HANDLE handle, ULONG_PTR value, NTSTATUS status, ULONG info
     SERVER_END_REQ;
 }
 
+/***********************************************************************
+ *                  io_uring file I/O
+ *
+ * When WINEIOURING is set, overlapped reads and writes on regular files are
+ * submitted to an io_uring instead of being done synchronously, so that the
+ * application can keep several of them in flight. Each request is registered
+ * with the server as an async first, so that the event, the APC and the
+ * completion port are bound when the I/O is queued, and so that it can be
+ * canceled like any other async. A dedicated thread reaps the completions,
+ * fills the I/O status block and reports the result to the server.
+ */
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+
+#define URING_ENTRIES 256
+
+struct uring_request
+{
+    struct async_fileio io;
+    client_ptr_t  iosb;
+    int           fd;        /* private copy of the unix fd */
+    BOOL          is_read;
+    ULONG         length;
+    ULONG64       offset;
+    BOOL          done;      /* set once the kernel is done with the buffers */
+    NTSTATUS      status;
+    ULONG         total;
+    unsigned int  count;
+    struct iovec  iov[1];
+};
+
+static struct
+{
+    int                  fd;
+    unsigned int         entries;
+    unsigned int        *sq_tail;
+    unsigned int        *sq_mask;
+    unsigned int        *sq_array;
+    unsigned int        *cq_head;
+    unsigned int        *cq_tail;
+    unsigned int        *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+} uring = { -1 };
+
+static pthread_mutex_t uring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t uring_cancel_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t uring_cancel_cond = PTHREAD_COND_INITIALIZER;
+static LONG uring_pending;
+static int uring_enabled = -1;
+
+static int uring_enter( unsigned int to_submit, unsigned int min_complete, unsigned int flags )
+{
+    return syscall( __NR_io_uring_enter, uring.fd, to_submit, min_complete, flags, NULL, 0 );
+}
+
+/* queue a single submission entry, return FALSE if the kernel didn't take it */
+static BOOL uring_submit_sqe( const struct io_uring_sqe *entry )
+{
+    struct io_uring_sqe *sqe;
+    unsigned int tail, idx;
+    sigset_t sigset;
+    int ret;
+
+    server_enter_uninterrupted_section( &uring_mutex, &sigset );
+    tail = *uring.sq_tail;
+    idx = tail & *uring.sq_mask;
+    sqe = &uring.sqes[idx];
+    *sqe = *entry;
+    uring.sq_array[idx] = idx;
+    __atomic_store_n( uring.sq_tail, tail + 1, __ATOMIC_RELEASE );
+    while ((ret = uring_enter( 1, 0, 0 )) == -1 && errno == EINTR);
+    /* the kernel doesn't consume anything on failure, take the entry back */
+    if (ret != 1) __atomic_store_n( uring.sq_tail, tail, __ATOMIC_RELEASE );
+    server_leave_uninterrupted_section( &uring_mutex, &sigset );
+
+    if (ret != 1) WARN( "io_uring_enter failed: %s\n", ret == -1 ? strerror( errno ) : "no entry submitted" );
+    return ret == 1;
+}
+
+/* finish a request synchronously, after the first 'done' bytes have been transferred
+ * short transfers happen because of write watches or guard pages in the buffer */
+static int uring_finish_io( struct uring_request *async, ULONG done )
+{
+    ULONG64 offset = async->offset + done;
+    ULONG total = done;
+    unsigned int i;
+    int err = 0;
+    ssize_t ret;
+
+    for (i = 0; i < async->count; i++)
+    {
+        char *ptr = async->iov[i].iov_base;
+        size_t len = async->iov[i].iov_len;
+
+        if (done >= len)
+        {
+            done -= len;
+            continue;
+        }
+        ptr += done;
+        len -= done;
+        done = 0;
+        while (len)
+        {
+            if (async->is_read) ret = virtual_locked_pread( async->fd, ptr, len, offset );
+            else ret = pwrite( async->fd, ptr, len, offset );
+            if (ret == -1 && errno == EINTR) continue;
+            if (ret == -1) err = errno;
+            if (ret <= 0) goto done;
+            ptr += ret;
+            len -= ret;
+            offset += ret;
+            total += ret;
+        }
+    }
+done:
+    return total || !err ? total : -err;
+}
+
+/* callback for canceled requests; wait until the kernel no longer uses the buffers */
+static BOOL uring_cancel_proc( void *user, ULONG_PTR *info, NTSTATUS *status )
+{
+    struct uring_request *async = user;
+    struct io_uring_sqe sqe;
+    sigset_t sigset;
+
+    TRACE( "%p: canceling with status %#x\n", async->io.handle, *status );
+
+    memset( &sqe, 0, sizeof(sqe) );
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.addr   = wine_server_client_ptr( async );
+    uring_submit_sqe( &sqe );
+
+    server_enter_uninterrupted_section( &uring_cancel_mutex, &sigset );
+    while (!async->done) pthread_cond_wait( &uring_cancel_cond, &uring_cancel_mutex );
+    server_leave_uninterrupted_section( &uring_cancel_mutex, &sigset );
+
+    /* the I/O may have completed before it could be canceled */
+    *status = async->status;
+    *info = async->total;
+    release_fileio( &async->io );
+    return TRUE;
+}
+
+/* report the result of a request to the server, which signals the event and the completion port */
+static NTSTATUS uring_report_result( struct async_fileio *io, NTSTATUS status, ULONG total )
+{
+    NTSTATUS ret;
+
+    SERVER_START_REQ( complete_async )
+    {
+        req->user        = wine_server_client_ptr( io );
+        req->status      = status;
+        req->information = total;
+        ret = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    return ret;
+}
+
+static void uring_complete( struct uring_request *async, int res )
+{
+    NTSTATUS status, ret;
+    ULONG total = 0;
+    sigset_t sigset;
+
+    if (res >= 0 && res < async->length) res = uring_finish_io( async, res );
+    else if (res == -EFAULT && async->is_read) res = uring_finish_io( async, 0 );
+
+    if (res < 0)
+    {
+        if (res == -ECANCELED || res == -EINTR) status = STATUS_CANCELLED;
+        else if (res == -EFAULT && !async->is_read) status = STATUS_INVALID_USER_BUFFER;
+        else status = errno_to_status( -res );
+    }
+    else
+    {
+        total = res;
+        status = (total || !async->length || !async->is_read) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
+    }
+    TRACE( "%p: status %#x, %u bytes\n", async->io.handle, status, total );
+
+    close( async->fd );
+    async->status = status;
+    async->total  = total;
+    set_async_iosb( async->iosb, status, total );
+
+    ret = uring_report_result( &async->io, status, total );
+    InterlockedDecrement( &uring_pending );
+
+    if (ret == STATUS_CANCELLED)
+    {
+        /* the cancel callback owns the request now */
+        server_enter_uninterrupted_section( &uring_cancel_mutex, &sigset );
+        async->done = TRUE;
+        pthread_cond_broadcast( &uring_cancel_cond );
+        server_leave_uninterrupted_section( &uring_cancel_mutex, &sigset );
+    }
+    else release_fileio( &async->io );
+}
+
+static void CALLBACK uring_completion_thread( void *arg )
+{
+    for (;;)
+    {
+        unsigned int head = *uring.cq_head;
+        unsigned int tail = __atomic_load_n( uring.cq_tail, __ATOMIC_ACQUIRE );
+
+        if (head == tail)
+        {
+            if (uring_enter( 0, 1, IORING_ENTER_GETEVENTS ) < 0 && errno != EINTR)
+                ERR( "io_uring_enter failed: %s\n", strerror( errno ));
+            continue;
+        }
+        while (head != tail)
+        {
+            struct io_uring_cqe *cqe = &uring.cqes[head & *uring.cq_mask];
+            struct uring_request *async = wine_server_get_ptr( cqe->user_data );
+            int res = cqe->res;
+
+            __atomic_store_n( uring.cq_head, ++head, __ATOMIC_RELEASE );
+            if (async) uring_complete( async, res );  /* cancel requests have no user data */
+        }
+    }
+}
+
+static BOOL uring_init(void)
+{
+    struct io_uring_params params;
+    size_t sq_size, cq_size;
+    char *sq_ptr = MAP_FAILED, *cq_ptr = MAP_FAILED;
+    void *sqes = MAP_FAILED;
+    const char *env;
+    HANDLE thread;
+
+    if (!(env = getenv( "WINEIOURING" )) || !atoi( env )) return FALSE;
+
+    memset( &params, 0, sizeof(params) );
+    if ((uring.fd = syscall( __NR_io_uring_setup, URING_ENTRIES, &params )) == -1)
+    {
+        WARN( "io_uring_setup failed: %s\n", strerror( errno ));
+        return FALSE;
+    }
+    if (!(params.features & IORING_FEAT_NODROP)) goto failed;
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) sq_size = cq_size = max( sq_size, cq_size );
+
+    sq_ptr = mmap( NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_SQ_RING );
+    if (sq_ptr == MAP_FAILED) goto failed;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        cq_ptr = mmap( NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_CQ_RING );
+        if (cq_ptr == MAP_FAILED) goto failed;
+    }
+    sqes = mmap( NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_SQES );
+    if (sqes == MAP_FAILED) goto failed;
+
+    uring.entries  = params.sq_entries;
+    uring.sq_tail  = (unsigned int *)(sq_ptr + params.sq_off.tail);
+    uring.sq_mask  = (unsigned int *)(sq_ptr + params.sq_off.ring_mask);
+    uring.sq_array = (unsigned int *)(sq_ptr + params.sq_off.array);
+    if (cq_ptr == MAP_FAILED) cq_ptr = sq_ptr;
+    uring.cq_head  = (unsigned int *)(cq_ptr + params.cq_off.head);
+    uring.cq_tail  = (unsigned int *)(cq_ptr + params.cq_off.tail);
+    uring.cq_mask  = (unsigned int *)(cq_ptr + params.cq_off.ring_mask);
+    uring.cqes     = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+    uring.sqes     = sqes;
+
+    if (NtCreateThreadEx( &thread, THREAD_ALL_ACCESS, NULL, GetCurrentProcess(),
+                          uring_completion_thread, NULL, 0, 0, 0, 0, NULL ))
+        goto failed;
+    NtClose( thread );
+    TRACE( "using io_uring with %u entries\n", uring.entries );
+    return TRUE;
+
+failed:
+    if (sqes != MAP_FAILED) munmap( sqes, params.sq_entries * sizeof(struct io_uring_sqe) );
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap( cq_ptr, cq_size );
+    if (sq_ptr != MAP_FAILED) munmap( sq_ptr, sq_size );
+    close( uring.fd );
+    uring.fd = -1;
+    return FALSE;
+}
+
+/***********************************************************************
+ *           uring_submit_io
+ *
+ * Submit an overlapped read or write of a regular file, either to a single
+ * buffer or to page-sized segments.
+ */
+static BOOL uring_submit_io( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
+                             IO_STATUS_BLOCK *io, int fd, BOOL is_read, void *buffer,
+                             const FILE_SEGMENT_ELEMENT *segments, ULONG length, ULONG64 offset )
+{
+    unsigned int i, count = segments ? (length + page_size - 1) / page_size : 1;
+    struct uring_request *async;
+    struct io_uring_sqe sqe;
+    NTSTATUS status;
+    sigset_t sigset;
+
+    /* the completion thread can't tell if the I/O status block is a 32-bit one */
+    if (in_wow64_call()) return FALSE;
+
+    if (uring_enabled == -1)
+    {
+        server_enter_uninterrupted_section( &uring_mutex, &sigset );
+        if (uring_enabled == -1) uring_enabled = uring_init();
+        server_leave_uninterrupted_section( &uring_mutex, &sigset );
+    }
+    if (!uring_enabled) return FALSE;
+
+    if (InterlockedIncrement( &uring_pending ) > uring.entries) goto failed;
+    if (!(async = (struct uring_request *)alloc_fileio( offsetof( struct uring_request, iov[count] ),
+                                                         uring_cancel_proc, handle )))
+        goto failed;
+    /* the handle may be closed before the I/O completes */
+    if ((async->fd = dup( fd )) == -1)
+    {
+        free( async );
+        goto failed;
+    }
+    async->iosb    = iosb_client_ptr( io );
+    async->is_read = is_read;
+    async->length  = length;
+    async->offset  = offset;
+    async->done    = FALSE;
+    async->count   = count;
+    if (segments)
+    {
+        for (i = 0; i < count; i++)
+        {
+            async->iov[i].iov_base = segments[i].Buffer;
+            async->iov[i].iov_len  = min( length - i * page_size, page_size );
+        }
+    }
+    else
+    {
+        async->iov[0].iov_base = buffer;
+        async->iov[0].iov_len  = length;
+    }
+
+    /* a cancel callback running on this thread before the submission would wait forever */
+    pthread_sigmask( SIG_BLOCK, &server_block_set, &sigset );
+
+    SERVER_START_REQ( register_file_async )
+    {
+        req->type  = is_read ? ASYNC_TYPE_READ : ASYNC_TYPE_WRITE;
+        req->async = server_async( handle, &async->io, event, apc, apc_user, async->iosb );
+        status = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+
+    if (status != STATUS_PENDING)
+    {
+        pthread_sigmask( SIG_SETMASK, &sigset, NULL );
+        close( async->fd );
+        free( async );
+        goto failed;
+    }
+
+    io->u.Status = STATUS_PENDING;
+    io->Information = 0;
+
+    memset( &sqe, 0, sizeof(sqe) );
+    sqe.opcode    = is_read ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe.fd        = async->fd;
+    sqe.addr      = wine_server_client_ptr( async->iov );
+    sqe.len       = count;
+    sqe.off       = offset;
+    sqe.user_data = wine_server_client_ptr( async );
+    /* the async is already queued on the server, so it has to be completed either way */
+    if (!uring_submit_sqe( &sqe )) uring_complete( async, uring_finish_io( async, 0 ));
+    else TRACE( "%p: submitted %s of %u bytes at %s\n", handle, is_read ? "read" : "write",
+                length, wine_dbgstr_longlong( offset ));
+    pthread_sigmask( SIG_SETMASK, &sigset, NULL );
+    return TRUE;
+
+failed:
+    InterlockedDecrement( &uring_pending );
+    return FALSE;
+}
+
+#else  /* HAVE_LINUX_IO_URING_H */
+
+static BOOL uring_submit_io( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
+                             IO_STATUS_BLOCK *io, int fd, BOOL is_read, void *buffer,
+                             const FILE_SEGMENT_ELEMENT *segments, ULONG length, ULONG64 offset )
+{
+    return FALSE;
+}
+
+#endif  /* HAVE_LINUX_IO_URING_H */
+
 static NTSTATUS set_pending_write( HANDLE device )
 {
     NTSTATUS status;
@@ -5122,20 +5851,25 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
     client_ptr_t iosb_ptr = iosb_client_ptr(io);
     enum server_fd_type type;
     ULONG_PTR cvalue = apc ? 0 : (ULONG_PTR)apc_user;
-    BOOL send_completion = FALSE, async_read, timeout_init_done = FALSE;
+    BOOL send_completion = FALSE, async_read, timeout_init_done = FALSE, refreshed = FALSE;
 
     TRACE( "(%p,%p,%p,%p,%p,%p,0x%08x,%p,%p)\n",
            handle, event, apc, apc_user, io, buffer, length, offset, key );
 
     if (!io) return STATUS_ACCESS_VIOLATION;
 
+retry:
     status = server_get_unix_fd( handle, FILE_READ_DATA, &unix_handle, &needs_close, &type, &options );
     if (status && status != STATUS_BAD_DEVICE_TYPE) return status;
 
     if (!virtual_check_buffer_for_write( buffer, length )) return STATUS_ACCESS_VIOLATION;
 
     if (status == STATUS_BAD_DEVICE_TYPE)
-        return server_read_file( handle, event, apc, apc_user, io, buffer, length, offset, key );
+    {
+        status = server_read_file( handle, event, apc, apc_user, io, buffer, length, offset, key );
+        if (status == STATUS_RETRY && !refreshed) goto refresh;
+        return status;
+    }
 
     async_read = !(options & (FILE_SYNCHRONOUS_IO_ALERT | FILE_SYNCHRONOUS_IO_NONALERT));
 
@@ -5149,6 +5883,13 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
 
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
+            if (async_read && uring_submit_io( handle, event, apc, apc_user, io, unix_handle,
+                                               TRUE, buffer, NULL, length, offset->QuadPart ))
+            {
+                if (needs_close) close( unix_handle );
+                return STATUS_PENDING;
+            }
+
             /* async I/O doesn't make sense on regular files */
             while ((result = virtual_locked_pread( unix_handle, buffer, length, offset->QuadPart )) == -1)
             {
@@ -5215,6 +5956,13 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
                         goto done;
                     }
                     break;
+                case FD_TYPE_PIPE:
+                    if (!length)
+                    {
+                        status = STATUS_SUCCESS;
+                        goto done;
+                    }
+                    goto stale_pipe;
                 default:
                     status = STATUS_PIPE_BROKEN;
                     goto err;
@@ -5225,6 +5973,7 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
         else if (errno != EAGAIN)
         {
             if (errno == EINTR) continue;
+            if (!total && type == FD_TYPE_PIPE && errno == ECONNRESET) goto stale_pipe;
             if (!total) status = errno_to_status( errno );
             goto err;
         }
@@ -5241,6 +5990,8 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
             }
             status = register_async_file_read( handle, event, apc, apc_user, iosb_ptr,
                                                buffer, total, length, avail_mode );
+            if (type == FD_TYPE_PIPE && (status == STATUS_RETRY || status == STATUS_BAD_DEVICE_TYPE))
+                goto stale_pipe;
             goto err;
         }
         else  /* synchronous read, wait for the fd to become ready */
@@ -5276,6 +6027,17 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
         }
     }
 
+stale_pipe:
+    /* the socket of a direct pipe end got shut down, the server knows where the data is now */
+    if (needs_close) close( unix_handle );
+    status = server_read_file( handle, event, apc, apc_user, io, buffer, length, offset, key );
+    if (status != STATUS_RETRY || refreshed) return status;
+refresh:
+    /* the server attached a new socket to the pipe end */
+    server_refresh_unix_fd( handle );
+    refreshed = TRUE;
+    goto retry;
+
 done:
     send_completion = cvalue != 0;
 
@@ -5336,6 +6098,14 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         goto error;
     }
 
+    if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION &&
+        uring_submit_io( file, event, apc, apc_user, io, unix_handle, TRUE, NULL, segments,
+                         length, offset->QuadPart ))
+    {
+        if (needs_close) close( unix_handle );
+        return STATUS_PENDING;
+    }
+
     while (length)
     {
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
@@ -5398,13 +6168,16 @@ NTSTATUS WINAPI NtWriteFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, v
     enum server_fd_type type;
     ULONG_PTR cvalue = apc ? 0 : (ULONG_PTR)apc_user;
     BOOL send_completion = FALSE, async_write, append_write = FALSE, timeout_init_done = FALSE;
+    BOOL refreshed = FALSE;
     LARGE_INTEGER offset_eof;
+    ULONG written;
 
     TRACE( "(%p,%p,%p,%p,%p,%p,0x%08x,%p,%p)\n",
            handle, event, apc, apc_user, io, buffer, length, offset, key );
 
     if (!io) return STATUS_ACCESS_VIOLATION;
 
+retry:
     status = server_get_unix_fd( handle, FILE_WRITE_DATA, &unix_handle, &needs_close, &type, &options );
     if (status == STATUS_ACCESS_DENIED)
     {
@@ -5423,7 +6196,11 @@ NTSTATUS WINAPI NtWriteFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, v
     }
 
     if (status == STATUS_BAD_DEVICE_TYPE)
-        return server_write_file( handle, event, apc, apc_user, io, buffer, length, offset, key );
+    {
+        status = server_write_file( handle, event, apc, apc_user, io, buffer, length, offset, key );
+        if (status == STATUS_RETRY && !refreshed) goto refresh;
+        return status;
+    }
 
     if (type == FD_TYPE_FILE)
     {
@@ -5461,6 +6238,13 @@ NTSTATUS WINAPI NtWriteFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, v
                 goto done;
             }
 
+            if (async_write && uring_submit_io( handle, event, apc, apc_user, io, unix_handle,
+                                                FALSE, (void *)buffer, NULL, length, off ))
+            {
+                if (needs_close) close( unix_handle );
+                return STATUS_PENDING;
+            }
+
             /* async I/O doesn't make sense on regular files */
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
             {
@@ -5511,6 +6295,7 @@ NTSTATUS WINAPI NtWriteFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, v
         else if (errno != EAGAIN)
         {
             if (errno == EINTR) continue;
+            if (type == FD_TYPE_PIPE && (errno == EPIPE || errno == ECONNRESET)) goto stale_pipe;
             if (!total)
             {
                 if (errno == EFAULT) status = STATUS_INVALID_USER_BUFFER;
@@ -5543,6 +6328,8 @@ NTSTATUS WINAPI NtWriteFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, v
             SERVER_END_REQ;
 
             if (status != STATUS_PENDING) free( fileio );
+            if (type == FD_TYPE_PIPE && (status == STATUS_RETRY || status == STATUS_BAD_DEVICE_TYPE))
+                goto stale_pipe;
             goto err;
         }
         else  /* synchronous write, wait for the fd to become ready */
@@ -5577,6 +6364,24 @@ NTSTATUS WINAPI NtWriteFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, v
         }
     }
 
+stale_pipe:
+    /* the socket of a direct pipe end got shut down, the server knows where the data goes now */
+    if (total)
+    {
+        if (!pipe_write_remainder( handle, (const char *)buffer + total, length - total, &written ))
+            total += written;
+        status = STATUS_SUCCESS;
+        goto done;
+    }
+    if (needs_close) close( unix_handle );
+    status = server_write_file( handle, event, apc, apc_user, io, buffer, length, offset, key );
+    if (status != STATUS_RETRY || refreshed) return status;
+refresh:
+    /* the server attached a new socket to the pipe end */
+    server_refresh_unix_fd( handle );
+    refreshed = TRUE;
+    goto retry;
+
 done:
     send_completion = cvalue != 0;
 
@@ -5639,6 +6444,14 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         goto done;
     }
 
+    if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION &&
+        uring_submit_io( file, event, apc, apc_user, io, unix_handle, FALSE, NULL, segments,
+                         length, offset->QuadPart ))
+    {
+        if (needs_close) close( unix_handle );
+        return STATUS_PENDING;
+    }
+
     while (length)
     {
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
@@ -6390,11 +7203,17 @@ NTSTATUS WINAPI NtQueryVolumeInformationFile( HANDLE handle, IO_STATUS_BLOCK *io
                                               void *buffer, ULONG length,
                                               FS_INFORMATION_CLASS info_class )
 {
+    enum server_fd_type type;
     int fd, needs_close;
     struct stat st;
     NTSTATUS status;
 
-    status = server_get_unix_fd( handle, 0, &fd, &needs_close, NULL, NULL );
+    status = server_get_unix_fd( handle, 0, &fd, &needs_close, &type, NULL );
+    if (!status && type == FD_TYPE_PIPE)
+    {
+        if (needs_close) close( fd );
+        status = STATUS_BAD_DEVICE_TYPE;
+    }
     if (status == STATUS_BAD_DEVICE_TYPE)
     {
         struct async_irp *async;
@@ -6688,7 +7507,7 @@ NTSTATUS WINAPI NtSetEaFile( HANDLE handle, IO_STATUS_BLOCK *io, void *buffer, U
 
 
 /* convert type information from server format; helper for NtQueryObject */
-static void *put_object_type_info( OBJECT_TYPE_INFORMATION *p, struct object_type_info *info )
+static void *put_object_type_info( OBJECT_TYPE_INFORMATION *p, const struct object_type_info *info )
 {
     const ULONG align = sizeof(DWORD_PTR) - 1;
 
@@ -6882,22 +7701,16 @@ NTSTATUS WINAPI NtQueryObject( HANDLE handle, OBJECT_INFORMATION_CLASS info_clas
     {
         OBJECT_DATA_INFORMATION* p = ptr;
 
+        unsigned int flags;
+
         if (len < sizeof(*p)) return STATUS_INVALID_BUFFER_SIZE;
 
-        SERVER_START_REQ( set_handle_info )
+        if (!(status = server_get_handle_info( handle, &flags )))
         {
-            req->handle = wine_server_obj_handle( handle );
-            req->flags  = 0;
-            req->mask   = 0;
-            status = wine_server_call( req );
-            if (status == STATUS_SUCCESS)
-            {
-                p->InheritHandle = (reply->old_flags & HANDLE_FLAG_INHERIT) != 0;
-                p->ProtectFromClose = (reply->old_flags & HANDLE_FLAG_PROTECT_FROM_CLOSE) != 0;
-                if (used_len) *used_len = sizeof(*p);
-            }
+            p->InheritHandle = (flags & HANDLE_FLAG_INHERIT) != 0;
+            p->ProtectFromClose = (flags & HANDLE_FLAG_PROTECT_FROM_CLOSE) != 0;
+            if (used_len) *used_len = sizeof(*p);
         }
-        SERVER_END_REQ;
         break;
     }
 
@@ -6937,6 +7750,7 @@ NTSTATUS WINAPI NtSetInformationObject( HANDLE handle, OBJECT_INFORMATION_CLASS
             status = wine_server_call( req );
         }
         SERVER_END_REQ;
+        server_invalidate_handle_info( handle );
     break;
     }
 
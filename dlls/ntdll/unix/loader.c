@@ -649,6 +649,7 @@ static void init_paths( char *argv[] )
 
 static void preloader_exec( char **argv )
 {
+    dbg_flush( TRUE );  /* the output queued for the writer thread would be lost */
     if (use_preloader)
     {
         static const char *preloader = "wine-preloader";
@@ -2139,6 +2140,9 @@ static struct unix_funcs unix_funcs =
     init_builtin_dll,
     unwind_builtin_dll,
     RtlGetSystemTimePrecise,
+    fast_RtlWaitOnAddress,
+    fast_RtlWakeAddress,
+    set_registry_value,
 #ifdef __aarch64__
     NtCurrentTeb,
 #endif
@@ -526,8 +526,76 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
 NTSTATUS WINAPI NtQueryMultipleValueKey( HANDLE key, KEY_MULTIPLE_VALUE_INFORMATION *info,
                                          ULONG count, void *buffer, ULONG length, ULONG *retlen )
 {
-    FIXME( "(%p,%p,0x%08x,%p,0x%08x,%p) stub!\n", key, info, count, buffer, length, retlen );
-    return STATUS_SUCCESS;
+    struct __server_request_info *reqs;
+    NTSTATUS ret;
+    ULONG i, total = 0;
+
+    TRACE( "(%p,%p,0x%08x,%p,0x%08x,%p)\n", key, info, count, buffer, length, retlen );
+
+    for (i = 0; i < count; i++)
+        if (info[i].ValueName->Length > MAX_VALUE_LENGTH) return STATUS_OBJECT_NAME_NOT_FOUND;
+
+    if (!(reqs = malloc( count * sizeof(*reqs) ))) return STATUS_NO_MEMORY;
+
+    /* first retrieve the types and sizes of all the values in a single round trip */
+    for (i = 0; i < count; i++)
+    {
+        struct get_key_value_request *req = &reqs[i].u.req.get_key_value_request;
+
+        memset( &reqs[i].u.req, 0, sizeof(reqs[i].u.req) );
+        reqs[i].u.req.request_header.req = REQ_get_key_value;
+        reqs[i].data_count = 0;
+        reqs[i].reply_data = NULL;
+        req->hkey = wine_server_obj_handle( key );
+        wine_server_add_data( req, info[i].ValueName->Buffer, info[i].ValueName->Length );
+    }
+    if ((ret = server_call_batch( reqs, count, 0 ))) goto done;
+
+    for (i = 0; i < count; i++)
+    {
+        const struct get_key_value_reply *reply = &reqs[i].u.reply.get_key_value_reply;
+
+        if ((ret = reply->__header.error)) goto done;
+        info[i].Type = reply->type;
+        info[i].DataLength = reply->total;
+        info[i].DataOffset = total;
+        total += reply->total;
+    }
+    if (retlen) *retlen = total;
+    if (total > length)
+    {
+        ret = STATUS_BUFFER_OVERFLOW;
+        goto done;
+    }
+
+    /* then fetch the data straight into the buffer */
+    for (i = 0; i < count; i++)
+    {
+        struct get_key_value_request *req = &reqs[i].u.req.get_key_value_request;
+
+        memset( &reqs[i].u.req, 0, sizeof(reqs[i].u.req) );
+        reqs[i].u.req.request_header.req = REQ_get_key_value;
+        reqs[i].data_count = 0;
+        req->hkey = wine_server_obj_handle( key );
+        wine_server_add_data( req, info[i].ValueName->Buffer, info[i].ValueName->Length );
+        wine_server_set_reply( req, (char *)buffer + info[i].DataOffset, info[i].DataLength );
+    }
+    if ((ret = server_call_batch( reqs, count, 0 ))) goto done;
+
+    for (i = 0; i < count; i++)
+    {
+        const struct get_key_value_reply *reply = &reqs[i].u.reply.get_key_value_reply;
+
+        if ((ret = reply->__header.error)) break;
+        info[i].Type = reply->type;
+        /* the value may have changed in the meantime */
+        if (reply->total > info[i].DataLength) ret = STATUS_BUFFER_OVERFLOW;
+        else info[i].DataLength = reply->total;
+    }
+
+done:
+    free( reqs );
+    return ret;
 }
 
 
@@ -557,6 +625,55 @@ NTSTATUS WINAPI NtSetValueKey( HANDLE key, const UNICODE_STRING *name, ULONG ind
 }
 
 
+/******************************************************************************
+ *              set_registry_value
+ *
+ * Open a key, set a value and close the key again in a single server round trip.
+ */
+NTSTATUS CDECL set_registry_value( const OBJECT_ATTRIBUTES *attr, const UNICODE_STRING *name,
+                                   ULONG type, const void *data, ULONG count )
+{
+    struct __server_request_info reqs[3];
+    struct open_key_request *open_req = &reqs[0].u.req.open_key_request;
+    struct set_key_value_request *set_req = &reqs[1].u.req.set_key_value_request;
+    NTSTATUS ret;
+    unsigned int i;
+
+    if (attr->Length != sizeof(*attr)) return STATUS_INVALID_PARAMETER;
+    if (attr->ObjectName->Length & 1) return STATUS_OBJECT_NAME_INVALID;
+    if (name->Length > MAX_VALUE_LENGTH) return STATUS_INVALID_PARAMETER;
+
+    TRACE( "(%p,%s,%s,%d,%p,%d)\n", attr->RootDirectory, debugstr_us(attr->ObjectName),
+           debugstr_us(name), type, data, count );
+
+    for (i = 0; i < ARRAY_SIZE(reqs); i++)
+    {
+        memset( &reqs[i].u.req, 0, sizeof(reqs[i].u.req) );
+        reqs[i].data_count = 0;
+        reqs[i].reply_data = NULL;
+    }
+
+    reqs[0].u.req.request_header.req = REQ_open_key;
+    open_req->parent     = wine_server_obj_handle( attr->RootDirectory );
+    open_req->access     = KEY_SET_VALUE;
+    open_req->attributes = attr->Attributes;
+    wine_server_add_data( open_req, attr->ObjectName->Buffer, attr->ObjectName->Length );
+
+    /* the next requests use the key returned by open_key */
+    reqs[1].u.req.request_header.req = REQ_set_key_value;
+    set_req->type    = type;
+    set_req->namelen = name->Length;
+    wine_server_add_data( set_req, name->Buffer, name->Length );
+    wine_server_add_data( set_req, data, count );
+
+    reqs[2].u.req.request_header.req = REQ_close_handle;
+
+    if ((ret = server_call_batch( reqs, ARRAY_SIZE(reqs), (1 << 1) | (1 << 2) ))) return ret;
+    if ((ret = reqs[0].u.reply.reply_header.error)) return ret;
+    return reqs[1].u.reply.reply_header.error;
+}
+
+
 /******************************************************************************
  *              NtDeleteValueKey  (NTDLL.@)
  */
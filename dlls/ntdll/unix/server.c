@@ -82,6 +82,7 @@
 #include "ddk/wdm.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(server);
+WINE_DECLARE_DEBUG_CHANNEL(handle);
 
 #ifndef MSG_CMSG_CLOEXEC
 #define MSG_CMSG_CLOEXEC 0
@@ -286,6 +287,72 @@ unsigned int CDECL wine_server_call( void *req_ptr )
 }
 
 
+/***********************************************************************
+ *           server_call_batch
+ *
+ * Perform several server calls in a single round trip.
+ * The status of each call is returned in its reply header. Calls whose bit is
+ * set in the chain mask use the key returned by the last preceding open_key or
+ * create_key call of the batch, and fail with its status if that one failed.
+ */
+unsigned int server_call_batch( struct __server_request_info *reqs, unsigned int count,
+                                unsigned int chain )
+{
+    data_size_t req_size = 0, reply_size = 0;
+    unsigned int i, j, done = 0, ret;
+    char *buffer, *ptr, *next;
+
+    if (!count) return STATUS_SUCCESS;
+
+    for (i = 0; i < count; i++)
+    {
+        req_size += sizeof(reqs[i].u.req) + BATCH_ALIGN( reqs[i].u.req.request_header.request_size );
+        reply_size += sizeof(reqs[i].u.reply) + BATCH_ALIGN( reqs[i].u.req.request_header.reply_size );
+    }
+    if (!(buffer = malloc( max( req_size, reply_size )))) return STATUS_NO_MEMORY;
+
+    for (i = 0, ptr = buffer; i < count; i++)
+    {
+        memcpy( ptr, &reqs[i].u.req, sizeof(reqs[i].u.req) );
+        ptr += sizeof(reqs[i].u.req);
+        for (j = 0; j < reqs[i].data_count; j++)
+        {
+            memcpy( ptr, reqs[i].data[j].ptr, reqs[i].data[j].size );
+            ptr += reqs[i].data[j].size;
+        }
+        next = buffer + BATCH_ALIGN( ptr - buffer );
+        memset( ptr, 0, next - ptr );
+        ptr = next;
+    }
+
+    SERVER_START_REQ( batch )
+    {
+        req->chain = chain;
+        wine_server_add_data( req, buffer, req_size );
+        wine_server_set_reply( req, buffer, reply_size );
+        if (!(ret = wine_server_call( req ))) done = reply->count;
+    }
+    SERVER_END_REQ;
+
+    for (i = 0, ptr = buffer; i < done; i++)
+    {
+        memcpy( &reqs[i].u.reply, ptr, sizeof(reqs[i].u.reply) );
+        ptr += sizeof(reqs[i].u.reply);
+        if (reqs[i].u.reply.reply_header.reply_size)
+            memcpy( reqs[i].reply_data, ptr, reqs[i].u.reply.reply_header.reply_size );
+        ptr += BATCH_ALIGN( reqs[i].u.reply.reply_header.reply_size );
+    }
+    for ( ; i < count; i++)
+    {
+        memset( &reqs[i].u.reply, 0, sizeof(reqs[i].u.reply) );
+        reqs[i].u.reply.reply_header.error = ret ? ret : STATUS_INTERNAL_ERROR;
+    }
+
+    free( buffer );
+    return ret;
+}
+
+
 /***********************************************************************
  *           server_enter_uninterrupted_section
  */
@@ -1038,6 +1105,232 @@ done:
 }
 
 
+/***********************************************************************
+ *           server_refresh_unix_fd
+ *
+ * Update the cached unix fd of a handle after the server attached a new one to
+ * the object, like for a direct pipe end that got connected again. A stale fd
+ * is replaced in place, so that its number stays valid for other threads.
+ */
+void server_refresh_unix_fd( HANDLE handle )
+{
+    sigset_t sigset;
+    obj_handle_t fd_handle;
+    int fd, old_fd = -1;
+
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+    SERVER_START_REQ( get_handle_fd )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        if (!wine_server_call( req ) && (fd = receive_fd( &fd_handle )) != -1)
+        {
+            assert( wine_server_ptr_handle(fd_handle) == handle );
+            if (!get_cached_fd( handle, &old_fd, NULL, NULL, NULL ))
+            {
+                dup2( fd, old_fd );
+                close( fd );
+            }
+            else
+            {
+                remove_fd_from_cache( handle );
+                if (!reply->cacheable ||
+                    !add_fd_to_cache( handle, fd, reply->type, reply->access, reply->options ))
+                    close( fd );
+            }
+        }
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+}
+
+
+/***********************************************************************/
+/* handle info cache support */
+
+union handle_info_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int cached : 1;  /* set if the entry is valid */
+        unsigned int flags  : 2;  /* HANDLE_FLAG_* flags */
+    } s;
+};
+
+C_ASSERT( sizeof(union handle_info_entry) == sizeof(union fd_cache_entry) );
+
+static union handle_info_entry *handle_info_cache[FD_CACHE_ENTRIES];
+static unsigned int handle_info_hits, handle_info_misses;
+
+
+/***********************************************************************
+ *           add_handle_info_to_cache
+ *
+ * Caller must hold fd_cache_mutex.
+ */
+static void add_handle_info_to_cache( HANDLE handle, union handle_info_entry cache )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+
+    if (entry >= FD_CACHE_ENTRIES) return;
+    if (!handle_info_cache[entry])
+    {
+        void *ptr = anon_mmap_alloc( FD_CACHE_BLOCK_SIZE * sizeof(union handle_info_entry),
+                                     PROT_READ | PROT_WRITE );
+        if (ptr == MAP_FAILED) return;
+        handle_info_cache[entry] = ptr;
+    }
+    interlocked_xchg64( &handle_info_cache[entry][idx].data, cache.data );
+}
+
+
+/***********************************************************************
+ *           get_cached_handle_info
+ */
+static inline union handle_info_entry get_cached_handle_info( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union handle_info_entry cache = { 0 };
+
+    if (entry < FD_CACHE_ENTRIES && handle_info_cache[entry])
+        cache.data = InterlockedCompareExchange64( &handle_info_cache[entry][idx].data, 0, 0 );
+    return cache;
+}
+
+
+/***********************************************************************
+ *           remove_handle_info_from_cache
+ *
+ * Caller must hold fd_cache_mutex.
+ */
+static void remove_handle_info_from_cache( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+
+    if (entry < FD_CACHE_ENTRIES && handle_info_cache[entry])
+        interlocked_xchg64( &handle_info_cache[entry][idx].data, 0 );
+}
+
+
+/***********************************************************************
+ *           update_handle_info_stats
+ */
+static void update_handle_info_stats( BOOL hit )
+{
+    unsigned int hits, total;
+
+    if (hit) hits = InterlockedIncrement( (LONG *)&handle_info_hits );
+    else hits = handle_info_hits;
+    total = hits + (hit ? handle_info_misses : InterlockedIncrement( (LONG *)&handle_info_misses ));
+    if (!(total % 1024))
+        TRACE_(handle)( "%u lookups, %u hits (%u%%)\n", total, hits, hits * 100 / total );
+}
+
+
+/***********************************************************************
+ *           server_get_handle_info
+ *
+ * Retrieve the flags of a handle. They only change through NtSetInformationObject,
+ * so they can be cached until the handle is closed.
+ */
+NTSTATUS server_get_handle_info( HANDLE handle, unsigned int *flags )
+{
+    union handle_info_entry cache;
+    BOOL cacheable = (LONG_PTR)handle > 0;  /* pseudo-handles depend on the caller */
+    NTSTATUS ret = STATUS_SUCCESS;
+    sigset_t sigset;
+
+    if (cacheable)
+    {
+        cache = get_cached_handle_info( handle );
+        if (TRACE_ON(handle)) update_handle_info_stats( cache.s.cached );
+        if (cache.s.cached) goto done;
+    }
+
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+    cache.data = 0;
+    if (cacheable) cache = get_cached_handle_info( handle );
+    if (!cache.s.cached)
+    {
+        SERVER_START_REQ( set_handle_info )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            req->flags  = 0;
+            req->mask   = 0;
+            if (!(ret = wine_server_call( req )))
+            {
+                cache.s.cached = 1;
+                cache.s.flags  = reply->old_flags;
+                if (cacheable) add_handle_info_to_cache( handle, cache );
+            }
+        }
+        SERVER_END_REQ;
+    }
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+    if (ret) return ret;
+
+done:
+    *flags = cache.s.flags;
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************
+ *           server_invalidate_handle_info
+ */
+void server_invalidate_handle_info( HANDLE handle )
+{
+    sigset_t sigset;
+
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+    remove_handle_info_from_cache( handle );
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+}
+
+
+/***********************************************************************
+ *           server_get_fast_sync_shm
+ *
+ * Map the shared memory holding the state of in-process synchronization objects.
+ */
+void *server_get_fast_sync_shm(void)
+{
+    static void *shm = (void *)-1;
+    obj_handle_t fd_handle;
+    data_size_t size = 0;
+    sigset_t sigset;
+    void *ptr = NULL;
+    int fd = -1;
+
+    if (shm != (void *)-1) return shm;
+
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+    if (shm == (void *)-1)
+    {
+        SERVER_START_REQ( get_fast_sync_shm )
+        {
+            if (!wine_server_call( req ))
+            {
+                size = reply->size;
+                fd = receive_fd( &fd_handle );
+                assert( !fd_handle );
+            }
+        }
+        SERVER_END_REQ;
+
+        if (fd != -1)
+        {
+            ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+            if (ptr == MAP_FAILED) ptr = NULL;
+            close( fd );
+        }
+        shm = ptr;
+    }
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+    return shm;
+}
+
+
 /***********************************************************************
  *           wine_server_fd_to_handle
  */
@@ -1651,7 +1944,11 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     if (options & DUPLICATE_CLOSE_SOURCE)
+    {
         fd = remove_fd_from_cache( source );
+        remove_handle_info_from_cache( source );
+        fast_sync_close_handle( source );
+    }
 
     SERVER_START_REQ( dup_handle )
     {
@@ -1709,6 +2006,8 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     fd = remove_fd_from_cache( handle );
+    remove_handle_info_from_cache( handle );
+    fast_sync_close_handle( handle );
 
     SERVER_START_REQ( close_handle )
     {
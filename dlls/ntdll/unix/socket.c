@@ -27,6 +27,9 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 #include <unistd.h>
 #ifdef HAVE_IFADDRS_H
 # include <ifaddrs.h>
@@ -130,24 +133,30 @@ struct async_send_ioctl
     struct iovec iov[1];
 };
 
+struct transmit_element
+{
+    HANDLE file;                /* file to send data from, or NULL for a memory buffer */
+    const char *buffer;         /* memory buffer */
+    LARGE_INTEGER offset;       /* file offset, or FILE_USE_FILE_POINTER_POSITION */
+    unsigned int len;           /* length to send, 0 for the rest of the file */
+    DWORD flags;                /* TP_ELEMENT_* flags */
+};
+
 struct async_transmit_ioctl
 {
     struct async_fileio io;
-    HANDLE file;
-    char *buffer;
-    unsigned int buffer_size;   /* allocated size of buffer */
+    char *buffer;               /* buffer for file data that can't be sent directly */
+    unsigned int buffer_size;   /* size of buffer */
     unsigned int read_len;      /* amount of valid data currently in the buffer */
-    unsigned int head_cursor;   /* amount of header data already sent */
-    unsigned int file_cursor;   /* amount of file data already sent */
     unsigned int buffer_cursor; /* amount of data currently in the buffer already sent */
-    unsigned int tail_cursor;   /* amount of tail data already sent */
-    unsigned int file_len;      /* total file length to send */
+    unsigned int cursor;        /* amount of data of the current element already sent */
+    BOOL file_end;              /* reached the end of the current file */
+    BOOL corked;                /* data may be held back by MSG_MORE or sendfile() */
+    ULONG_PTR sent;             /* total amount of data sent */
     DWORD flags;
-    const char *head;
-    const char *tail;
-    unsigned int head_len;
-    unsigned int tail_len;
-    LARGE_INTEGER offset;
+    unsigned int element;       /* current element */
+    unsigned int count;         /* number of elements */
+    struct transmit_element elements[1];
 };
 
 static NTSTATUS sock_errno_to_status( int err )
@@ -737,9 +746,23 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
         }
     }
 
+    /* If the server has no reads queued, receive the data directly so that
+     * the server only has to be told about the result. */
+    status = STATUS_DEVICE_NOT_READY;
+    information = 0;
+    if (fast_sync_socket_can_recv( handle ))
+    {
+        status = try_recv( fd, async, &information );
+        TRACE( "got status %#x, %#lx bytes read\n", status, information );
+    }
+
+    if (status == STATUS_DEVICE_NOT_READY && force_async)
+        status = STATUS_PENDING;
+
     SERVER_START_REQ( recv_socket )
     {
-        req->force_async = force_async;
+        req->status = status;
+        req->total  = information;
         req->async  = server_async( handle, &async->io, event, apc, apc_user, iosb_client_ptr(io) );
         req->oob    = !!(unix_flags & MSG_OOB);
         status = wine_server_call( req );
@@ -947,155 +970,253 @@ static ssize_t do_send( int fd, const void *buffer, size_t len, int flags )
     return ret;
 }
 
-static NTSTATUS try_transmit( int sock_fd, int file_fd, struct async_transmit_ioctl *async )
+/* whether more data may follow the current element */
+static BOOL transmit_has_more_data( const struct async_transmit_ioctl *async )
+{
+    unsigned int i;
+
+    if (async->elements[async->element].flags & TP_ELEMENT_EOP) return FALSE;
+    for (i = async->element + 1; i < async->count; i++)
+        if (async->elements[i].file || async->elements[i].len) return TRUE;
+    return FALSE;
+}
+
+/* push out the data held back once the transmission is complete */
+static void transmit_uncork( int sock_fd, struct async_transmit_ioctl *async )
+{
+#ifdef TCP_CORK
+    int value = 0;
+
+    /* clearing TCP_CORK pushes the pending frames, even if it wasn't set */
+    if (async->corked) setsockopt( sock_fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value) );
+#endif
+    async->corked = FALSE;
+}
+
+static NTSTATUS transmit_buffer( int sock_fd, struct async_transmit_ioctl *async,
+                                 const struct transmit_element *element )
 {
+    int flags = 0;
     ssize_t ret;
 
-    while (async->head_cursor < async->head_len)
-    {
-        TRACE( "sending %u bytes of header data\n", async->head_len - async->head_cursor );
-        ret = do_send( sock_fd, async->head + async->head_cursor,
-                       async->head_len - async->head_cursor, 0 );
-        if (ret < 0) return sock_errno_to_status( errno );
-        TRACE( "send returned %zd\n", ret );
-        async->head_cursor += ret;
-    }
+#ifdef MSG_MORE
+    if (transmit_has_more_data( async )) flags |= MSG_MORE;
+#endif
 
-    while (async->buffer_cursor < async->read_len)
+    while (async->cursor < element->len)
     {
-        TRACE( "sending %u bytes of file data\n", async->read_len - async->buffer_cursor );
-        ret = do_send( sock_fd, async->buffer + async->buffer_cursor,
-                       async->read_len - async->buffer_cursor, 0 );
+        TRACE( "sending %u bytes of buffer data\n", element->len - async->cursor );
+        ret = do_send( sock_fd, element->buffer + async->cursor, element->len - async->cursor, flags );
         if (ret < 0) return sock_errno_to_status( errno );
         TRACE( "send returned %zd\n", ret );
-        async->buffer_cursor += ret;
-        async->file_cursor += ret;
+        async->corked = (flags != 0);
+        async->cursor += ret;
+        async->sent += ret;
     }
+    return STATUS_SUCCESS;
+}
 
-    if (async->file && async->buffer_cursor == async->read_len)
+static NTSTATUS transmit_file( int sock_fd, int file_fd, struct async_transmit_ioctl *async,
+                               struct transmit_element *element )
+{
+    unsigned int size;
+    ssize_t ret;
+
+    for (;;)
     {
-        unsigned int read_size = async->buffer_size;
+        while (async->buffer_cursor < async->read_len)
+        {
+            TRACE( "sending %u bytes of file data\n", async->read_len - async->buffer_cursor );
+            ret = do_send( sock_fd, async->buffer + async->buffer_cursor,
+                           async->read_len - async->buffer_cursor, 0 );
+            if (ret < 0) return sock_errno_to_status( errno );
+            TRACE( "send returned %zd\n", ret );
+            async->corked = FALSE;
+            async->buffer_cursor += ret;
+            async->cursor += ret;
+            async->sent += ret;
+        }
+
+        if (async->file_end || (element->len && async->cursor == element->len)) return STATUS_SUCCESS;
+        size = element->len ? element->len - async->cursor : 0x40000000;
+
+#ifdef HAVE_SYS_SENDFILE_H
+        /* the buffer is only allocated once sendfile() failed for this file */
+        if (!async->buffer)
+        {
+            off_t offset = element->offset.QuadPart;
+            BOOL use_pos = (element->offset.QuadPart == FILE_USE_FILE_POINTER_POSITION);
+
+            TRACE( "sending %u bytes of file data with sendfile\n", size );
+            do
+            {
+                ret = sendfile( sock_fd, file_fd, use_pos ? NULL : &offset, size );
+            } while (ret < 0 && errno == EINTR);
+            TRACE( "sendfile returned %zd\n", ret );
+
+            if (ret > 0)
+            {
+                async->corked = TRUE;
+                async->cursor += ret;
+                async->sent += ret;
+                if (!use_pos) element->offset.QuadPart += ret;
+                continue;
+            }
+            if (!ret) return STATUS_SUCCESS;  /* end of file */
+            if (errno != EINVAL && errno != ENOSYS) return sock_errno_to_status( errno );
+        }
+#endif
 
-        if (async->file_len)
-            read_size = min( read_size, async->file_len - async->file_cursor );
+        if (!async->buffer && !(async->buffer = malloc( async->buffer_size ))) return STATUS_NO_MEMORY;
+        size = min( size, async->buffer_size );
 
-        TRACE( "reading %u bytes of file data\n", read_size );
+        TRACE( "reading %u bytes of file data\n", size );
         do
         {
-            if (async->offset.QuadPart == FILE_USE_FILE_POINTER_POSITION)
-                ret = read( file_fd, async->buffer, read_size );
+            if (element->offset.QuadPart == FILE_USE_FILE_POINTER_POSITION)
+                ret = read( file_fd, async->buffer, size );
             else
-                ret = pread( file_fd, async->buffer, read_size, async->offset.QuadPart );
+                ret = pread( file_fd, async->buffer, size, element->offset.QuadPart );
         } while (ret < 0 && errno == EINTR);
         if (ret < 0) return errno_to_status( errno );
         TRACE( "read returned %zd\n", ret );
 
         async->read_len = ret;
         async->buffer_cursor = 0;
-        if (async->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
-            async->offset.QuadPart += ret;
-
-        if (ret < read_size || (async->file_len && async->file_cursor == async->file_len))
-            async->file = NULL;
-        return STATUS_DEVICE_NOT_READY; /* still more data to send */
+        if (element->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            element->offset.QuadPart += ret;
+        if (ret < size) async->file_end = TRUE;
     }
+}
+
+static NTSTATUS try_transmit( int sock_fd, struct async_transmit_ioctl *async )
+{
+    int file_fd, file_needs_close;
+    NTSTATUS status;
 
-    while (async->tail_cursor < async->tail_len)
+    for (; async->element < async->count; async->element++)
     {
-        TRACE( "sending %u bytes of tail data\n", async->tail_len - async->tail_cursor );
-        ret = do_send( sock_fd, async->tail + async->tail_cursor,
-                       async->tail_len - async->tail_cursor, 0 );
-        if (ret < 0) return sock_errno_to_status( errno );
-        TRACE( "send returned %zd\n", ret );
-        async->tail_cursor += ret;
-    }
+        struct transmit_element *element = &async->elements[async->element];
+
+        if (element->file)
+        {
+            if ((status = server_get_unix_fd( element->file, 0, &file_fd, &file_needs_close, NULL, NULL )))
+                return status;
+            status = transmit_file( sock_fd, file_fd, async, element );
+            if (file_needs_close) close( file_fd );
+        }
+        else status = transmit_buffer( sock_fd, async, element );
+
+        if (status)
+        {
+            /* no more data follows a failed transmission */
+            if (status != STATUS_DEVICE_NOT_READY) transmit_uncork( sock_fd, async );
+            return status;
+        }
 
+        free( async->buffer );
+        async->buffer = NULL;
+        async->cursor = 0;
+        async->read_len = 0;
+        async->buffer_cursor = 0;
+        async->file_end = FALSE;
+    }
+    transmit_uncork( sock_fd, async );
     return STATUS_SUCCESS;
 }
 
 static BOOL async_transmit_proc( void *user, ULONG_PTR *info, NTSTATUS *status )
 {
-    int sock_fd, file_fd = -1, sock_needs_close = FALSE, file_needs_close = FALSE;
+    int sock_fd, sock_needs_close = FALSE;
     struct async_transmit_ioctl *async = user;
 
     TRACE( "%#x\n", *status );
 
     if (*status == STATUS_ALERTED)
     {
-        if ((*status = server_get_unix_fd( async->io.handle, 0, &sock_fd, &sock_needs_close, NULL, NULL )))
-            return TRUE;
-
-        if (async->file && (*status = server_get_unix_fd( async->file, 0, &file_fd, &file_needs_close, NULL, NULL )))
+        if (!(*status = server_get_unix_fd( async->io.handle, 0, &sock_fd, &sock_needs_close, NULL, NULL )))
         {
-            if (sock_needs_close) close( sock_fd );
-            return TRUE;
-        }
+            *status = try_transmit( sock_fd, async );
+            TRACE( "got status %#x\n", *status );
 
-        *status = try_transmit( sock_fd, file_fd, async );
-        TRACE( "got status %#x\n", *status );
+            if (sock_needs_close) close( sock_fd );
 
+            if (*status == STATUS_DEVICE_NOT_READY)
+                return FALSE;
+        }
+    }
+    else if (async->corked && !server_get_unix_fd( async->io.handle, 0, &sock_fd, &sock_needs_close, NULL, NULL ))
+    {
+        /* the transmission was canceled, push out what was already sent */
+        transmit_uncork( sock_fd, async );
         if (sock_needs_close) close( sock_fd );
-        if (file_needs_close) close( file_fd );
-
-        if (*status == STATUS_DEVICE_NOT_READY)
-            return FALSE;
     }
-    *info = async->head_cursor + async->file_cursor + async->tail_cursor;
+    *info = async->sent;
+    free( async->buffer );
     release_fileio( &async->io );
     return TRUE;
 }
 
-static NTSTATUS sock_transmit( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
-                               IO_STATUS_BLOCK *io, int fd, const struct afd_transmit_params *params )
+/* only regular files can be transmitted */
+static NTSTATUS check_transmit_file( HANDLE file )
 {
-    int file_fd, file_needs_close = FALSE;
-    struct async_transmit_ioctl *async;
     enum server_fd_type file_type;
-    union unix_sockaddr addr;
-    socklen_t addr_len;
-    HANDLE wait_handle;
+    int file_fd, file_needs_close;
     NTSTATUS status;
-    ULONG options;
 
-    addr_len = sizeof(addr);
-    if (getpeername( fd, &addr.addr, &addr_len ) != 0)
-        return STATUS_INVALID_CONNECTION;
+    if ((status = server_get_unix_fd( file, 0, &file_fd, &file_needs_close, &file_type, NULL )))
+        return status;
+    if (file_needs_close) close( file_fd );
 
-    if (params->file)
+    if (file_type != FD_TYPE_FILE)
     {
-        if ((status = server_get_unix_fd( ULongToHandle( params->file ), 0, &file_fd, &file_needs_close, &file_type, NULL )))
-            return status;
-        if (file_needs_close) close( file_fd );
-
-        if (file_type != FD_TYPE_FILE)
-        {
-            FIXME( "unsupported file type %#x\n", file_type );
-            return STATUS_NOT_IMPLEMENTED;
-        }
+        FIXME( "unsupported file type %#x\n", file_type );
+        return STATUS_NOT_IMPLEMENTED;
     }
+    return STATUS_SUCCESS;
+}
 
-    if (!(async = (struct async_transmit_ioctl *)alloc_fileio( sizeof(*async), async_transmit_proc, handle )))
-        return STATUS_NO_MEMORY;
+static struct async_transmit_ioctl *alloc_transmit_async( HANDLE handle, unsigned int count,
+                                                          DWORD buffer_size, DWORD flags )
+{
+    struct async_transmit_ioctl *async;
 
-    async->file = ULongToHandle( params->file );
-    async->buffer_size = params->buffer_size ? params->buffer_size : 65536;
-    if (!(async->buffer = malloc( async->buffer_size )))
-    {
-        release_fileio( &async->io );
-        return STATUS_NO_MEMORY;
-    }
+    if (!(async = (struct async_transmit_ioctl *)alloc_fileio( offsetof( struct async_transmit_ioctl, elements[count] ),
+                                                               async_transmit_proc, handle )))
+        return NULL;
+
+    async->buffer = NULL;
+    async->buffer_size = buffer_size ? buffer_size : 65536;
     async->read_len = 0;
-    async->head_cursor = 0;
-    async->file_cursor = 0;
     async->buffer_cursor = 0;
-    async->tail_cursor = 0;
-    async->file_len = params->file_len;
-    async->flags = params->flags;
-    async->head = u64_to_user_ptr(params->head_ptr);
-    async->head_len = params->head_len;
-    async->tail = u64_to_user_ptr(params->tail_ptr);
-    async->tail_len = params->tail_len;
-    async->offset = params->offset;
+    async->cursor = 0;
+    async->file_end = FALSE;
+    async->corked = FALSE;
+    async->sent = 0;
+    async->flags = flags;
+    async->element = 0;
+    async->count = 0;
+    return async;
+}
+
+static void add_transmit_element( struct async_transmit_ioctl *async, HANDLE file, const void *buffer,
+                                  LARGE_INTEGER offset, unsigned int len, DWORD flags )
+{
+    struct transmit_element *element = &async->elements[async->count++];
+
+    element->file = file;
+    element->buffer = buffer;
+    element->offset = offset;
+    element->len = len;
+    element->flags = flags;
+}
+
+static NTSTATUS queue_transmit( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
+                                IO_STATUS_BLOCK *io, struct async_transmit_ioctl *async )
+{
+    HANDLE wait_handle;
+    NTSTATUS status;
+    ULONG options;
 
     SERVER_START_REQ( send_socket )
     {
@@ -1119,6 +1240,83 @@ static NTSTATUS sock_transmit( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc,
     return status;
 }
 
+static NTSTATUS sock_transmit( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
+                               IO_STATUS_BLOCK *io, int fd, const struct afd_transmit_params *params )
+{
+    struct async_transmit_ioctl *async;
+    union unix_sockaddr addr;
+    socklen_t addr_len;
+    NTSTATUS status;
+
+    addr_len = sizeof(addr);
+    if (getpeername( fd, &addr.addr, &addr_len ) != 0)
+        return STATUS_INVALID_CONNECTION;
+
+    if (params->file && (status = check_transmit_file( ULongToHandle( params->file ) )))
+        return status;
+
+    if (!(async = alloc_transmit_async( handle, 3, params->buffer_size, params->flags )))
+        return STATUS_NO_MEMORY;
+
+    add_transmit_element( async, NULL, u64_to_user_ptr(params->head_ptr), params->offset,
+                          params->head_len, TP_ELEMENT_MEMORY );
+    if (params->file)
+        add_transmit_element( async, ULongToHandle( params->file ), NULL, params->offset,
+                              params->file_len, TP_ELEMENT_FILE );
+    add_transmit_element( async, NULL, u64_to_user_ptr(params->tail_ptr), params->offset,
+                          params->tail_len, TP_ELEMENT_MEMORY );
+
+    return queue_transmit( handle, event, apc, apc_user, io, async );
+}
+
+static NTSTATUS sock_transmit_packets( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
+                                       IO_STATUS_BLOCK *io, int fd,
+                                       const struct afd_transmit_packets_params *params )
+{
+    struct async_transmit_ioctl *async;
+    union unix_sockaddr addr;
+    socklen_t addr_len;
+    NTSTATUS status;
+    unsigned int i;
+
+    addr_len = sizeof(addr);
+    if (getpeername( fd, &addr.addr, &addr_len ) != 0)
+        return STATUS_INVALID_CONNECTION;
+
+    for (i = 0; i < params->count; i++)
+    {
+        const struct afd_transmit_element *element = &params->elements[i];
+
+        switch (element->flags & (TP_ELEMENT_MEMORY | TP_ELEMENT_FILE))
+        {
+        case TP_ELEMENT_MEMORY:
+            break;
+        case TP_ELEMENT_FILE:
+            if ((status = check_transmit_file( ULongToHandle( element->file ) ))) return status;
+            break;
+        default:
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    if (!(async = alloc_transmit_async( handle, params->count, params->send_size, params->flags )))
+        return STATUS_NO_MEMORY;
+
+    for (i = 0; i < params->count; i++)
+    {
+        const struct afd_transmit_element *element = &params->elements[i];
+
+        if (element->flags & TP_ELEMENT_FILE)
+            add_transmit_element( async, ULongToHandle( element->file ), NULL, element->offset,
+                                  element->len, element->flags );
+        else
+            add_transmit_element( async, NULL, u64_to_user_ptr(element->buffer_ptr), element->offset,
+                                  element->len, element->flags );
+    }
+
+    return queue_transmit( handle, event, apc, apc_user, io, async );
+}
+
 static void complete_async( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
                             IO_STATUS_BLOCK *io, NTSTATUS status, ULONG_PTR information )
 {
@@ -1375,6 +1573,25 @@ NTSTATUS sock_ioctl( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc
             return status;
         }
 
+        case IOCTL_AFD_WINE_TRANSMIT_PACKETS:
+        {
+            const struct afd_transmit_packets_params *params = in_buffer;
+
+            if ((status = server_get_unix_fd( handle, 0, &fd, &needs_close, NULL, NULL )))
+                return status;
+
+            if (in_size < offsetof( struct afd_transmit_packets_params, elements ) ||
+                params->count > (in_size - offsetof( struct afd_transmit_packets_params, elements ))
+                                / sizeof(params->elements[0]))
+            {
+                status = STATUS_BUFFER_TOO_SMALL;
+                break;
+            }
+            status = sock_transmit_packets( handle, event, apc, apc_user, io, fd, params );
+            if (needs_close) close( fd );
+            return status;
+        }
+
         case IOCTL_AFD_WINE_COMPLETE_ASYNC:
         {
             if (in_size != sizeof(NTSTATUS))
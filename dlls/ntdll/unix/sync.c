@@ -106,6 +106,8 @@ static inline ULONGLONG monotonic_counter(void)
 
 #define FUTEX_WAIT 0
 #define FUTEX_WAKE 1
+#define FUTEX_WAIT_BITSET 9
+#define FUTEX_WAKE_BITSET 10
 
 static int futex_private = 128;
 
@@ -119,6 +121,45 @@ static inline int futex_wake( const int *addr, int val )
     return syscall( __NR_futex, addr, FUTEX_WAKE | futex_private, val, NULL, 0, 0 );
 }
 
+static inline int futex_wait_bitset( const int *addr, int val, struct timespec *end, int mask )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAIT_BITSET | futex_private, val, end, 0, mask );
+}
+
+static inline int futex_wake_bitset( const int *addr, int val, int mask )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAKE_BITSET | futex_private, val, NULL, 0, mask );
+}
+
+#ifndef __NR_futex_waitv
+#define __NR_futex_waitv 449
+#endif
+#define FUTEX_32 2
+
+struct futex_waitv
+{
+    ULONG64 val;
+    ULONG64 uaddr;
+    unsigned int flags;
+    unsigned int reserved;
+};
+
+/* returns the index of the futex that was woken */
+static inline int futex_waitv( const int *addr1, int val1, const int *addr2, int val2, struct timespec *end )
+{
+    struct futex_waitv waiters[2];
+
+    waiters[0].val = (unsigned int)val1;
+    waiters[0].uaddr = (ULONG_PTR)addr1;
+    waiters[0].flags = FUTEX_32 | futex_private;
+    waiters[0].reserved = 0;
+    waiters[1].val = (unsigned int)val2;
+    waiters[1].uaddr = (ULONG_PTR)addr2;
+    waiters[1].flags = FUTEX_32 | futex_private;
+    waiters[1].reserved = 0;
+    return syscall( __NR_futex_waitv, waiters, 2, 0, end, CLOCK_MONOTONIC );
+}
+
 static inline int use_futexes(void)
 {
     static int supported = -1;
@@ -248,6 +289,389 @@ static NTSTATUS validate_open_object_attributes( const OBJECT_ATTRIBUTES *attr )
 }
 
 
+/***********************************************************************
+ * In-process synchronization objects
+ *
+ * Unnamed events and semaphores may keep their state in memory shared with
+ * the server (see server/fast_sync.c); operations on a single such object
+ * are then done directly on the shared state, using futexes for waiting.
+ * Sockets use it to tell whether reads can bypass the server.
+ */
+
+#ifdef __linux__
+
+#define FAST_SYNC_ACCESS_WAIT    1
+#define FAST_SYNC_ACCESS_MODIFY  2
+#define FAST_SYNC_ACCESS_QUERY   4
+
+union fast_sync_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int index;
+        unsigned int type   : 4;
+        unsigned int access : 3;
+        unsigned int cached : 1;
+        unsigned int serial : 24;  /* low bits of the entry serial number */
+    } s;
+};
+
+C_ASSERT( sizeof(union fast_sync_cache_entry) == sizeof(LONG64) );
+
+#define FAST_SYNC_SERIAL_MASK       0xffffff
+#define FAST_SYNC_CACHE_BLOCK_SIZE  (65536 / sizeof(union fast_sync_cache_entry))
+#define FAST_SYNC_CACHE_ENTRIES     128
+
+static union fast_sync_cache_entry *fast_sync_cache[FAST_SYNC_CACHE_ENTRIES];
+static pthread_mutex_t fast_sync_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline unsigned int fast_sync_handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / FAST_SYNC_CACHE_BLOCK_SIZE;
+    return idx % FAST_SYNC_CACHE_BLOCK_SIZE;
+}
+
+/* the memory is shared between processes, so these can't be private futexes */
+static inline int fast_sync_futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAIT, val, timeout, 0, 0 );
+}
+
+static inline int fast_sync_futex_wake( int *addr, int val )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAKE, val, NULL, 0, 0 );
+}
+
+/* caller must hold fast_sync_mutex */
+static void add_fast_sync_to_cache( HANDLE handle, union fast_sync_cache_entry cache )
+{
+    unsigned int entry, idx = fast_sync_handle_to_index( handle, &entry );
+
+    if (entry >= FAST_SYNC_CACHE_ENTRIES) return;
+    if (!fast_sync_cache[entry])
+    {
+        void *ptr = anon_mmap_alloc( FAST_SYNC_CACHE_BLOCK_SIZE * sizeof(union fast_sync_cache_entry),
+                                     PROT_READ | PROT_WRITE );
+        if (ptr == MAP_FAILED) return;
+        fast_sync_cache[entry] = ptr;
+    }
+    __atomic_store_n( &fast_sync_cache[entry][idx].data, cache.data, __ATOMIC_SEQ_CST );
+}
+
+static inline union fast_sync_cache_entry get_cached_fast_sync( HANDLE handle )
+{
+    unsigned int entry, idx = fast_sync_handle_to_index( handle, &entry );
+    union fast_sync_cache_entry cache = { 0 };
+
+    if (entry < FAST_SYNC_CACHE_ENTRIES && fast_sync_cache[entry])
+        cache.data = InterlockedCompareExchange64( &fast_sync_cache[entry][idx].data, 0, 0 );
+    return cache;
+}
+
+/***********************************************************************
+ *           fast_sync_close_handle
+ *
+ * Remove a handle from the cache. Called with signals blocked.
+ */
+void fast_sync_close_handle( HANDLE handle )
+{
+    unsigned int entry, idx = fast_sync_handle_to_index( handle, &entry );
+
+    if (entry >= FAST_SYNC_CACHE_ENTRIES || !fast_sync_cache[entry]) return;
+    pthread_mutex_lock( &fast_sync_mutex );
+    __atomic_store_n( &fast_sync_cache[entry][idx].data, 0, __ATOMIC_SEQ_CST );
+    pthread_mutex_unlock( &fast_sync_mutex );
+}
+
+/* drop a cache entry that refers to a destroyed object */
+static void remove_cached_fast_sync( HANDLE handle, union fast_sync_cache_entry cache )
+{
+    unsigned int entry, idx = fast_sync_handle_to_index( handle, &entry );
+
+    InterlockedCompareExchange64( &fast_sync_cache[entry][idx].data, 0, cache.data );
+}
+
+/* return the shared state of the object, or NULL if it has to go through the server */
+static struct fast_sync_object *get_fast_sync( HANDLE handle, enum fast_sync_type type, unsigned int access )
+{
+    struct fast_sync_object *objects;
+    union fast_sync_cache_entry cache;
+    sigset_t sigset;
+
+    if ((LONG_PTR)handle <= 0) return NULL;  /* null or pseudo-handle */
+    if (!(objects = server_get_fast_sync_shm())) return NULL;
+
+    cache = get_cached_fast_sync( handle );
+    if (!cache.s.cached)
+    {
+        server_enter_uninterrupted_section( &fast_sync_mutex, &sigset );
+        cache = get_cached_fast_sync( handle );
+        if (!cache.s.cached)
+        {
+            SERVER_START_REQ( get_fast_sync_obj )
+            {
+                req->handle = wine_server_obj_handle( handle );
+                if (!wine_server_call( req ))
+                {
+                    cache.s.index = reply->index;
+                    cache.s.serial = reply->serial & FAST_SYNC_SERIAL_MASK;
+                    cache.s.type = reply->type;
+                    cache.s.access = 0;
+                    if (reply->access & SYNCHRONIZE) cache.s.access |= FAST_SYNC_ACCESS_WAIT;
+                    /* EVENT_* and SEMAPHORE_* access rights have the same values */
+                    if (reply->access & EVENT_MODIFY_STATE) cache.s.access |= FAST_SYNC_ACCESS_MODIFY;
+                    if (reply->access & EVENT_QUERY_STATE) cache.s.access |= FAST_SYNC_ACCESS_QUERY;
+                    cache.s.cached = 1;
+                    add_fast_sync_to_cache( handle, cache );
+                }
+            }
+            SERVER_END_REQ;
+        }
+        server_leave_uninterrupted_section( &fast_sync_mutex, &sigset );
+    }
+
+    if (!cache.s.cached || cache.s.type == FAST_SYNC_NONE) return NULL;
+    if (type == FAST_SYNC_NONE)
+    {
+        /* sockets can't be waited on in-process */
+        if (cache.s.type == FAST_SYNC_SOCKET) return NULL;
+    }
+    else if (type != cache.s.type)
+    {
+        /* FAST_SYNC_MANUAL_EVENT matches both event types */
+        if (type != FAST_SYNC_MANUAL_EVENT || cache.s.type != FAST_SYNC_AUTO_EVENT) return NULL;
+    }
+    /* let the server report access errors */
+    if ((cache.s.access & access) != access) return NULL;
+    /* the handle may have been closed from another process, and the entry reused */
+    if ((__atomic_load_n( &objects[cache.s.index].serial, __ATOMIC_SEQ_CST ) & FAST_SYNC_SERIAL_MASK)
+        != cache.s.serial)
+    {
+        remove_cached_fast_sync( handle, cache );
+        return NULL;
+    }
+    return &objects[cache.s.index];
+}
+
+/* wake up the threads waiting on a newly signaled object */
+static void fast_sync_wake( HANDLE handle, struct fast_sync_object *obj, int count )
+{
+    fast_sync_futex_wake( &obj->state, count );
+    if (!__atomic_load_n( &obj->server_waiters, __ATOMIC_SEQ_CST )) return;
+
+    SERVER_START_REQ( fast_sync_wake )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
+/* try to acquire the object; returns the state that was seen on failure */
+static BOOL fast_sync_try_wait( struct fast_sync_object *obj, int *cur )
+{
+    *cur = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+
+    switch (obj->type)
+    {
+    case FAST_SYNC_MANUAL_EVENT:
+        return *cur & FAST_SYNC_EVENT_SIGNALED;
+    case FAST_SYNC_AUTO_EVENT:
+        while (*cur & FAST_SYNC_EVENT_SIGNALED)
+        {
+            if (__atomic_compare_exchange_n( &obj->state, cur, *cur & ~FAST_SYNC_EVENT_SIGNALED, 0,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+                return TRUE;
+        }
+        return FALSE;
+    default:
+        while (*cur > 0)
+        {
+            if (__atomic_compare_exchange_n( &obj->state, cur, *cur - 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+                return TRUE;
+        }
+        return FALSE;
+    }
+}
+
+/* check whether an event was pulsed since the state was last seen */
+static BOOL fast_sync_pulsed( struct fast_sync_object *obj, int *prev, int cur )
+{
+    int pending = 1;
+
+    if (obj->type != FAST_SYNC_MANUAL_EVENT && obj->type != FAST_SYNC_AUTO_EVENT) return FALSE;
+    if (!((cur ^ *prev) & ~FAST_SYNC_EVENT_SIGNALED)) return FALSE;
+    if (obj->type == FAST_SYNC_MANUAL_EVENT) return TRUE;
+    /* pulsing an auto-reset event releases a single waiter */
+    *prev = cur;
+    return __atomic_compare_exchange_n( &obj->pulse, &pending, 0, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+}
+
+static NTSTATUS fast_wait( HANDLE handle, BOOLEAN alertable, const LARGE_INTEGER *timeout )
+{
+    struct fast_sync_object *obj;
+    unsigned int serial;
+    ULONGLONG end = 0;
+    int start, cur;
+
+    if (alertable) return STATUS_NOT_IMPLEMENTED;
+    if (!(obj = get_fast_sync( handle, FAST_SYNC_NONE, FAST_SYNC_ACCESS_WAIT ))) return STATUS_NOT_IMPLEMENTED;
+    serial = __atomic_load_n( &obj->serial, __ATOMIC_SEQ_CST );
+
+    if (timeout && timeout->QuadPart != TIMEOUT_INFINITE)
+    {
+        if (timeout->QuadPart <= 0) end = monotonic_counter() - timeout->QuadPart;
+        else
+        {
+            LARGE_INTEGER now;
+            NtQuerySystemTime( &now );
+            end = monotonic_counter() + max( timeout->QuadPart - now.QuadPart, 0 );
+        }
+    }
+    else timeout = NULL;
+
+    TRACE( "waiting on %p timeout %s\n", handle, debugstr_timeout( timeout ));
+
+    if (fast_sync_try_wait( obj, &start )) return STATUS_WAIT_0;
+    cur = start;
+    for (;;)
+    {
+        struct timespec ts;
+        ULONGLONG now;
+
+        if (!timeout) fast_sync_futex_wait( &obj->state, cur, NULL );
+        else
+        {
+            if ((now = monotonic_counter()) >= end) return STATUS_TIMEOUT;
+            ts.tv_sec = (end - now) / TICKSPERSEC;
+            ts.tv_nsec = ((end - now) % TICKSPERSEC) * 100;
+            fast_sync_futex_wait( &obj->state, cur, &ts );
+        }
+        /* the object was destroyed, let the server report the error */
+        if (__atomic_load_n( &obj->serial, __ATOMIC_SEQ_CST ) != serial) return STATUS_NOT_IMPLEMENTED;
+        if (fast_sync_try_wait( obj, &cur )) return STATUS_WAIT_0;
+        if (fast_sync_pulsed( obj, &start, cur )) return STATUS_WAIT_0;
+    }
+}
+
+static NTSTATUS fast_event_op( HANDLE handle, int state, LONG *prev_state )
+{
+    struct fast_sync_object *obj;
+    int prev;
+
+    if (!(obj = get_fast_sync( handle, FAST_SYNC_MANUAL_EVENT, FAST_SYNC_ACCESS_MODIFY )))
+        return STATUS_NOT_IMPLEMENTED;
+
+    /* preserve the pulse count */
+    prev = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+    while (!__atomic_compare_exchange_n( &obj->state, &prev,
+                                         (prev & ~FAST_SYNC_EVENT_SIGNALED) | (state ? FAST_SYNC_EVENT_SIGNALED : 0),
+                                         0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ));
+    prev &= FAST_SYNC_EVENT_SIGNALED;
+    if (state && !prev) fast_sync_wake( handle, obj, INT_MAX );
+    if (prev_state) *prev_state = prev;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_query_event( HANDLE handle, EVENT_BASIC_INFORMATION *info )
+{
+    struct fast_sync_object *obj;
+
+    if (!(obj = get_fast_sync( handle, FAST_SYNC_MANUAL_EVENT, FAST_SYNC_ACCESS_QUERY )))
+        return STATUS_NOT_IMPLEMENTED;
+
+    info->EventType  = obj->type == FAST_SYNC_MANUAL_EVENT ? NotificationEvent : SynchronizationEvent;
+    info->EventState = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST ) & FAST_SYNC_EVENT_SIGNALED;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    struct fast_sync_object *obj;
+    int cur;
+
+    if (!(obj = get_fast_sync( handle, FAST_SYNC_SEMAPHORE, FAST_SYNC_ACCESS_MODIFY )))
+        return STATUS_NOT_IMPLEMENTED;
+
+    cur = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+    do
+    {
+        if (count > (ULONG)obj->max || cur > obj->max - (int)count) return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+    } while (!__atomic_compare_exchange_n( &obj->state, &cur, cur + count, 0,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ));
+
+    if (!cur) fast_sync_wake( handle, obj, count );
+    if (previous) *previous = cur;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_query_semaphore( HANDLE handle, SEMAPHORE_BASIC_INFORMATION *info )
+{
+    struct fast_sync_object *obj;
+
+    if (!(obj = get_fast_sync( handle, FAST_SYNC_SEMAPHORE, FAST_SYNC_ACCESS_QUERY )))
+        return STATUS_NOT_IMPLEMENTED;
+
+    info->CurrentCount = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+    info->MaximumCount = obj->max;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           fast_sync_socket_can_recv
+ *
+ * Check whether data can be received directly from a socket, that is
+ * whether the server has no reads queued that the data would belong to.
+ */
+BOOL fast_sync_socket_can_recv( HANDLE handle )
+{
+    struct fast_sync_object *obj;
+
+    if (!(obj = get_fast_sync( handle, FAST_SYNC_SOCKET, 0 ))) return FALSE;
+    return !__atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+}
+
+#else  /* __linux__ */
+
+void fast_sync_close_handle( HANDLE handle )
+{
+}
+
+BOOL fast_sync_socket_can_recv( HANDLE handle )
+{
+    return FALSE;
+}
+
+static NTSTATUS fast_wait( HANDLE handle, BOOLEAN alertable, const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_event_op( HANDLE handle, int state, LONG *prev_state )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_query_event( HANDLE handle, EVENT_BASIC_INFORMATION *info )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_query_semaphore( HANDLE handle, SEMAPHORE_BASIC_INFORMATION *info )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
+
+
 /******************************************************************************
  *              NtCreateSemaphore (NTDLL.@)
  */
@@ -322,6 +746,12 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 
     if (len != sizeof(SEMAPHORE_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((ret = fast_query_semaphore( handle, out )) != STATUS_NOT_IMPLEMENTED)
+    {
+        if (!ret && ret_len) *ret_len = sizeof(SEMAPHORE_BASIC_INFORMATION);
+        return ret;
+    }
+
     SERVER_START_REQ( query_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -344,6 +774,8 @@ NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, ULONG *previous
 {
     NTSTATUS ret;
 
+    if ((ret = fast_release_semaphore( handle, count, previous )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -420,6 +852,8 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, LONG *prev_state )
 {
     NTSTATUS ret;
 
+    if ((ret = fast_event_op( handle, 1, prev_state )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -439,6 +873,8 @@ NTSTATUS WINAPI NtResetEvent( HANDLE handle, LONG *prev_state )
 {
     NTSTATUS ret;
 
+    if ((ret = fast_event_op( handle, 0, prev_state )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -500,6 +936,12 @@ NTSTATUS WINAPI NtQueryEvent( HANDLE handle, EVENT_INFORMATION_CLASS class,
 
     if (len != sizeof(EVENT_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((ret = fast_query_event( handle, out )) != STATUS_NOT_IMPLEMENTED)
+    {
+        if (!ret && ret_len) *ret_len = sizeof(EVENT_BASIC_INFORMATION);
+        return ret;
+    }
+
     SERVER_START_REQ( query_event )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -1403,6 +1845,12 @@ NTSTATUS WINAPI NtWaitForMultipleObjects( DWORD count, const HANDLE *handles, BO
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    if (count == 1)
+    {
+        NTSTATUS ret = fast_wait( handles[0], alertable, timeout );
+        if (ret != STATUS_NOT_IMPLEMENTED) return ret;
+    }
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_any ? SELECT_WAIT : SELECT_WAIT_ALL;
     for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
@@ -1841,8 +2289,9 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE handle, ULONG_PTR *key, ULONG_PTR *
 NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
                                         ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
 {
+    struct completion_packet packets[64];
     NTSTATUS status;
-    ULONG i = 0;
+    ULONG i = 0, j, wanted, nb_packets;
 
     TRACE( "%p %p %u %p %p %u\n", handle, info, count, written, timeout, alertable );
 
@@ -1850,20 +2299,25 @@ NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORM
     {
         while (i < count)
         {
-            SERVER_START_REQ( remove_completion )
+            /* fetch as many packets as we can in a single request */
+            wanted = min( count - i, ARRAY_SIZE(packets) );
+            SERVER_START_REQ( remove_completions )
             {
                 req->handle = wine_server_obj_handle( handle );
+                wine_server_set_reply( req, packets, wanted * sizeof(packets[0]) );
                 if (!(status = wine_server_call( req )))
-                {
-                    info[i].CompletionKey             = reply->ckey;
-                    info[i].CompletionValue           = reply->cvalue;
-                    info[i].IoStatusBlock.Information = reply->information;
-                    info[i].IoStatusBlock.u.Status    = reply->status;
-                }
+                    nb_packets = wine_server_reply_size( reply ) / sizeof(packets[0]);
             }
             SERVER_END_REQ;
             if (status != STATUS_SUCCESS) break;
-            ++i;
+            for (j = 0; j < nb_packets; j++, i++)
+            {
+                info[i].CompletionKey             = packets[j].ckey;
+                info[i].CompletionValue           = packets[j].cvalue;
+                info[i].IoStatusBlock.Information = packets[j].information;
+                info[i].IoStatusBlock.u.Status    = packets[j].status;
+            }
+            if (nb_packets < wanted) break;  /* queue is empty */
         }
         if (i || status != STATUS_PENDING)
         {
@@ -2511,6 +2965,97 @@ NTSTATUS WINAPI NtWaitForAlertByThreadId( const void *address, const LARGE_INTEG
 
 #endif
 
+
+/* Waits on addresses that fit in an aligned 32-bit word are done directly on a futex
+ * for that word, together with the thread alert futex, so that NtAlertThreadByThreadId
+ * still ends the wait as on Windows. This needs futex_waitv(), on older kernels the
+ * generic implementation is used instead. Wakes use the byte offset of the address in
+ * the word as futex bitset; since futex_waitv() doesn't support bitsets, waiters on other
+ * parts of the same word may get woken too, which RtlWaitOnAddress() is allowed to do. */
+
+/***********************************************************************
+ *             fast_RtlWaitOnAddress
+ */
+NTSTATUS CDECL fast_RtlWaitOnAddress( const void *addr, const void *cmp, SIZE_T size,
+                                      const LARGE_INTEGER *timeout )
+{
+#ifdef __linux__
+    static int waitv_supported = -1;
+    const int *futex = (const int *)((ULONG_PTR)addr & ~3);
+    unsigned int offset = (ULONG_PTR)addr & 3;
+    struct timespec end, *end_ptr = NULL;
+    union tid_alert_entry *alert;
+    int value, ret;
+
+    if (offset + size > sizeof(int) || !waitv_supported || !use_futexes()) return STATUS_NOT_IMPLEMENTED;
+    if (!(alert = get_tid_alert_entry( NtCurrentTeb()->ClientId.UniqueThread ))) return STATUS_NOT_IMPLEMENTED;
+
+    if (timeout && timeout->QuadPart != TIMEOUT_INFINITE)
+    {
+        LONGLONG timeleft = timeout->QuadPart < 0 ? -timeout->QuadPart : update_timeout( timeout->QuadPart );
+
+        /* futex_waitv uses an absolute timeout */
+        clock_gettime( CLOCK_MONOTONIC, &end );
+        end.tv_sec += timeleft / TICKSPERSEC;
+        end.tv_nsec += (timeleft % TICKSPERSEC) * 100;
+        if (end.tv_nsec >= 1000000000)
+        {
+            end.tv_sec++;
+            end.tv_nsec -= 1000000000;
+        }
+        end_ptr = &end;
+    }
+
+    for (;;)
+    {
+        /* a pending alert ends the wait, as in NtWaitForAlertByThreadId */
+        if (InterlockedExchange( &alert->futex, 0 )) return STATUS_SUCCESS;
+        value = *(volatile const int *)futex;
+        if (memcmp( (const char *)&value + offset, cmp, size )) return STATUS_SUCCESS;
+        if ((ret = futex_waitv( futex, value, &alert->futex, 0, end_ptr )) != -1)
+        {
+            if (ret == 1) InterlockedExchange( &alert->futex, 0 );
+            return STATUS_SUCCESS;
+        }
+        switch (errno)
+        {
+        case ETIMEDOUT:
+            return STATUS_TIMEOUT;
+        case EAGAIN:  /* one of the values changed, check again */
+        case EINTR:
+            continue;
+        case ENOSYS:
+            waitv_supported = 0;
+            /* fall through */
+        default:
+            return STATUS_NOT_IMPLEMENTED;
+        }
+    }
+#else
+    return STATUS_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/***********************************************************************
+ *             fast_RtlWakeAddress
+ *
+ * Returns the number of threads woken.
+ */
+int CDECL fast_RtlWakeAddress( const void *addr, int count )
+{
+#ifdef __linux__
+    const int *futex = (const int *)((ULONG_PTR)addr & ~3);
+    int ret;
+
+    if (!use_futexes()) return 0;
+    ret = futex_wake_bitset( futex, count, 1 << ((ULONG_PTR)addr & 3) );
+    return max( ret, 0 );
+#else
+    return 0;
+#endif
+}
+
 /* Notify direct completion of async and close the wait handle if it is no longer needed.
  * This function is a no-op (returns status as-is) if the supplied handle is NULL.
  */
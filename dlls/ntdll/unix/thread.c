@@ -1385,6 +1385,7 @@ void abort_thread( int status )
  */
 void abort_process( int status )
 {
+    dbg_flush( FALSE );
     _exit( get_unix_exit_code( status ));
 }
 
@@ -102,6 +102,11 @@ extern void     (WINAPI *pRtlUserThreadStart)( PRTL_THREAD_START_ROUTINE entry,
 extern void     (WINAPI *p__wine_ctrl_routine)(void *) DECLSPEC_HIDDEN;
 extern SYSTEM_DLL_INIT_BLOCK *pLdrSystemDllInitBlock DECLSPEC_HIDDEN;
 extern LONGLONG CDECL fast_RtlGetSystemTimePrecise(void) DECLSPEC_HIDDEN;
+extern NTSTATUS CDECL fast_RtlWaitOnAddress( const void *addr, const void *cmp, SIZE_T size,
+                                             const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
+extern int CDECL fast_RtlWakeAddress( const void *addr, int count ) DECLSPEC_HIDDEN;
+extern NTSTATUS CDECL set_registry_value( const OBJECT_ATTRIBUTES *attr, const UNICODE_STRING *name,
+                                          ULONG type, const void *data, ULONG count ) DECLSPEC_HIDDEN;
 
 extern NTSTATUS CDECL unwind_builtin_dll( ULONG type, struct _DISPATCHER_CONTEXT *dispatch,
                                           CONTEXT *context ) DECLSPEC_HIDDEN;
@@ -158,6 +163,8 @@ extern NTSTATUS load_start_exe( WCHAR **image, void **module ) DECLSPEC_HIDDEN;
 extern void start_server( BOOL debug ) DECLSPEC_HIDDEN;
 
 extern unsigned int server_call_unlocked( void *req_ptr ) DECLSPEC_HIDDEN;
+extern unsigned int server_call_batch( struct __server_request_info *reqs, unsigned int count,
+                                       unsigned int chain ) DECLSPEC_HIDDEN;
 extern void server_enter_uninterrupted_section( pthread_mutex_t *mutex, sigset_t *sigset ) DECLSPEC_HIDDEN;
 extern void server_leave_uninterrupted_section( pthread_mutex_t *mutex, sigset_t *sigset ) DECLSPEC_HIDDEN;
 extern unsigned int server_select( const select_op_t *select_op, data_size_t size, UINT flags,
@@ -168,6 +175,10 @@ extern unsigned int server_queue_process_apc( HANDLE process, const apc_call_t *
                                               apc_result_t *result ) DECLSPEC_HIDDEN;
 extern int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                                int *needs_close, enum server_fd_type *type, unsigned int *options ) DECLSPEC_HIDDEN;
+extern void server_refresh_unix_fd( HANDLE handle ) DECLSPEC_HIDDEN;
+extern NTSTATUS server_get_handle_info( HANDLE handle, unsigned int *flags ) DECLSPEC_HIDDEN;
+extern void server_invalidate_handle_info( HANDLE handle ) DECLSPEC_HIDDEN;
+extern void *server_get_fast_sync_shm(void) DECLSPEC_HIDDEN;
 extern void wine_server_send_fd( int fd ) DECLSPEC_HIDDEN;
 extern void process_exit_wrapper( int status ) DECLSPEC_HIDDEN;
 extern size_t server_init_process(void) DECLSPEC_HIDDEN;
@@ -275,8 +286,11 @@ extern void init_files(void) DECLSPEC_HIDDEN;
 extern void init_cpu_info(void) DECLSPEC_HIDDEN;
 extern void add_completion( HANDLE handle, ULONG_PTR value, NTSTATUS status, ULONG info, BOOL async ) DECLSPEC_HIDDEN;
 extern void set_async_direct_result( HANDLE *optional_handle, NTSTATUS status, ULONG_PTR information );
+extern void fast_sync_close_handle( HANDLE handle ) DECLSPEC_HIDDEN;
+extern BOOL fast_sync_socket_can_recv( HANDLE handle ) DECLSPEC_HIDDEN;
 
 extern void dbg_init(void) DECLSPEC_HIDDEN;
+extern void dbg_flush( BOOL wait ) DECLSPEC_HIDDEN;
 
 extern NTSTATUS call_user_apc_dispatcher( CONTEXT *context_ptr, ULONG_PTR arg1, ULONG_PTR arg2, ULONG_PTR arg3,
                                           PNTAPCFUNC func, NTSTATUS status ) DECLSPEC_HIDDEN;
@@ -36,6 +36,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <dirent.h>
 #ifdef HAVE_SYS_SYSINFO_H
 # include <sys/sysinfo.h>
 #endif
@@ -69,6 +70,7 @@
 #include "windef.h"
 #include "winnt.h"
 #include "winternl.h"
+#include "ddk/wdm.h"
 #include "wine/list.h"
 #include "wine/rbtree.h"
 #include "unix_private.h"
@@ -144,7 +146,16 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 };
 
 static struct wine_rb_tree views_tree;
+/* All changes to the views tree are done with virtual_mutex held, and with virtual_rwlock
+ * held exclusively by the outermost owner of the mutex. Pure lookups only need virtual_rwlock
+ * shared, so they can run in parallel. Changes to the pages of an existing view can also be
+ * made with virtual_rwlock held shared, provided the view lock is held as well; the page
+ * protection bytes of different views never overlap, so independent views can be committed
+ * and protected in parallel. */
 static pthread_mutex_t virtual_mutex;
+static pthread_rwlock_t virtual_rwlock;
+static unsigned int virtual_lock_depth;  /* recursion count of virtual_mutex, protected by it */
+static pthread_mutex_t view_locks[64];   /* hashed on the view base */
 
 static const UINT page_shift = 12;
 static const UINT_PTR page_mask = 0xfff;
@@ -220,6 +231,83 @@ static inline BOOL is_beyond_limit( const void *addr, size_t size, const void *l
     return (addr >= limit || (const char *)addr + size > (const char *)limit);
 }
 
+/***********************************************************************
+ *           enter_virtual_lock
+ *
+ * Acquire the virtual lock for modifications. The lock is recursive.
+ * sigset is NULL when called from a signal handler.
+ */
+static void enter_virtual_lock( sigset_t *sigset )
+{
+    if (sigset) server_enter_uninterrupted_section( &virtual_mutex, sigset );
+    else mutex_lock( &virtual_mutex );
+    if (!virtual_lock_depth++ && !process_exiting) pthread_rwlock_wrlock( &virtual_rwlock );
+}
+
+static void leave_virtual_lock( sigset_t *sigset )
+{
+    if (!--virtual_lock_depth && !process_exiting) pthread_rwlock_unlock( &virtual_rwlock );
+    if (sigset) server_leave_uninterrupted_section( &virtual_mutex, sigset );
+    else mutex_unlock( &virtual_mutex );
+}
+
+
+/***********************************************************************
+ *           enter_virtual_lock_shared
+ *
+ * Acquire the virtual lock for lookups that don't change anything. Callers
+ * must not access client memory while holding it, since a page fault needs
+ * the exclusive lock. Returns FALSE if the thread already holds it exclusively,
+ * in which case the exclusive lock is taken recursively instead.
+ */
+static BOOL enter_virtual_lock_shared( sigset_t *sigset )
+{
+    pthread_sigmask( SIG_BLOCK, &server_block_set, sigset );
+    if (process_exiting || !pthread_rwlock_tryrdlock( &virtual_rwlock )) return TRUE;
+    if (!pthread_mutex_trylock( &virtual_mutex ))
+    {
+        if (virtual_lock_depth++) return FALSE;
+        virtual_lock_depth--;
+        pthread_mutex_unlock( &virtual_mutex );
+    }
+    pthread_rwlock_rdlock( &virtual_rwlock );
+    return TRUE;
+}
+
+static void leave_virtual_lock_shared( sigset_t *sigset, BOOL shared )
+{
+    if (!shared)
+    {
+        virtual_lock_depth--;
+        pthread_mutex_unlock( &virtual_mutex );
+    }
+    else if (!process_exiting) pthread_rwlock_unlock( &virtual_rwlock );
+    pthread_sigmask( SIG_SETMASK, sigset, NULL );
+}
+
+
+/***********************************************************************
+ *           enter_view_lock
+ *
+ * Lock a view for changes to its pages, when the virtual lock is only held shared.
+ * Returns the mutex to pass to leave_view_lock, or NULL if nothing had to be locked.
+ */
+static pthread_mutex_t *enter_view_lock( struct file_view *view, BOOL shared )
+{
+    pthread_mutex_t *mutex;
+
+    if (!shared || process_exiting) return NULL;
+    mutex = &view_locks[((UINT_PTR)view->base >> 16) % ARRAY_SIZE(view_locks)];
+    pthread_mutex_lock( mutex );
+    return mutex;
+}
+
+static void leave_view_lock( pthread_mutex_t *mutex )
+{
+    if (mutex) pthread_mutex_unlock( mutex );
+}
+
+
 /* mmap() anonymous memory at a fixed address */
 void *anon_mmap_fixed( void *start, size_t size, int prot, int flags )
 {
@@ -619,7 +707,7 @@ void *get_builtin_so_handle( void *module )
     void *ret = NULL;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -627,7 +715,7 @@ void *get_builtin_so_handle( void *module )
         if (ret) builtin->refcount++;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return ret;
 }
 
@@ -642,7 +730,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, void **funcs )
     NTSTATUS status = STATUS_DLL_NOT_FOUND;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -653,7 +741,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, void **funcs )
         }
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return status;
 }
 
@@ -669,7 +757,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
     struct builtin_module *builtin;
 
     if (!(handle = dlopen( name, RTLD_NOW ))) return status;
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -681,7 +769,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
         else status = STATUS_IMAGE_ALREADY_LOADED;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     if (status) dlclose( handle );
     return status;
 }
@@ -1099,12 +1187,12 @@ static void VIRTUAL_Dump(void)
     struct file_view *view;
 
     TRACE( "Dump of all virtual memory views:\n" );
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
     {
         dump_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
 }
 #endif
 
@@ -1112,7 +1200,7 @@ static void VIRTUAL_Dump(void)
 /***********************************************************************
  *           find_view
  *
- * Find the view containing a given address. virtual_mutex must be held by caller.
+ * Find the view containing a given address. virtual_rwlock must be held by caller, shared is enough.
  *
  * PARAMS
  *      addr  [I] Address
@@ -1956,6 +2044,78 @@ done:
 }
 
 
+/***********************************************************************
+ *           use_huge_pages
+ *
+ * Check whether a committed private region should use transparent huge pages.
+ */
+static BOOL use_huge_pages( size_t size )
+{
+    static int huge_pages_enabled = -1;
+    const char *env;
+
+    if (huge_pages_enabled == -1)
+        huge_pages_enabled = (env = getenv( "WINEHUGEPAGES" )) && atoi( env );
+    return huge_pages_enabled && user_shared_data->LargePageMinimum &&
+           size >= user_shared_data->LargePageMinimum;
+}
+
+
+/***********************************************************************
+ *           advise_huge_pages
+ */
+static void advise_huge_pages( void *base, size_t size )
+{
+#ifdef MADV_HUGEPAGE
+    if (madvise( base, size, MADV_HUGEPAGE ))
+        WARN( "madvise failed for %p-%p: %s\n", base, (char *)base + size, strerror(errno) );
+#endif
+}
+
+
+/***********************************************************************
+ *           map_large_page_view
+ *
+ * Create a view for a MEM_LARGE_PAGES allocation. The memory is aligned on
+ * the large page size and backed by transparent huge pages when possible.
+ * virtual_mutex must be held by caller.
+ */
+static NTSTATUS map_large_page_view( struct file_view **view_ret, void *base, size_t size,
+                                     int top_down, unsigned int vprot, ULONG_PTR zero_bits )
+{
+    size_t large_page_mask = user_shared_data->LargePageMinimum - 1;
+    size_t view_size = size + large_page_mask + 1;
+    NTSTATUS status;
+    void *ptr;
+
+    if (!base && !zero_bits && (ptr = anon_mmap_alloc( view_size, get_unix_prot(vprot) )) != MAP_FAILED)
+    {
+        if (!is_beyond_limit( ptr, view_size, user_space_limit ))
+        {
+            size_t extra = -(UINT_PTR)ptr & large_page_mask;
+
+            if (extra) munmap( ptr, extra );
+            ptr = (char *)ptr + extra;
+            munmap( (char *)ptr + size, view_size - extra - size );
+            TRACE( "got large page mem %p-%p\n", ptr, (char *)ptr + size );
+            if ((status = create_view( view_ret, ptr, size, vprot )))
+            {
+                unmap_area( ptr, size );
+                return status;
+            }
+            advise_huge_pages( ptr, size );
+            return STATUS_SUCCESS;
+        }
+        munmap( ptr, view_size );
+    }
+
+    /* fall back to a normal view, huge pages will only be used for its aligned parts */
+    if (!(status = map_view( view_ret, base, size, top_down, vprot, zero_bits )))
+        advise_huge_pages( (*view_ret)->base, size );
+    return status;
+}
+
+
 /***********************************************************************
  *           map_file_into_view
  *
@@ -2029,6 +2189,8 @@ done:
  *
  * Get the size of the committed range with equal masked vprot bytes starting at base.
  * Also return the protections for the first page.
+ * The committed state of SEC_RESERVE views is cached in the page protections, so the
+ * virtual lock must be held exclusively, or shared together with the view lock.
  */
 static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vprot, BYTE vprot_mask )
 {
@@ -2173,6 +2335,320 @@ static NTSTATUS map_pe_header( void *ptr, size_t size, int fd, BOOL *removable )
 }
 
 
+/* Cache of relocated images, enabled with WINERELOCCACHE. When a dll can't
+ * be loaded at its preferred base, the relocated image is saved in the
+ * prefix, and later mapped copy-on-write from there when the dll gets
+ * loaded at the same address again. The relocated pages are then shared
+ * between processes instead of being dirtied in each of them.
+ *
+ * Each cache file starts with a page containing a header that identifies the
+ * original file, followed by the relocated image. The least recently used
+ * files are removed when the cache grows larger than RELOC_CACHE_MAX_SIZE. */
+
+#define RELOC_CACHE_MAX_SIZE (256 * 1024 * 1024)
+#define RELOC_CACHE_MAGIC    "WineRlc1"
+
+struct reloc_cache_header
+{
+    char      magic[8];
+    ULONG64   dev;
+    ULONG64   ino;
+    ULONG64   file_size;
+    ULONG64   mtime;
+    ULONG64   mtime_nsec;
+    ULONG64   ctime;
+    ULONG64   base;
+    ULONG64   image_size;
+    ULONG64   headers_sum;  /* checksum of the first page of the original image */
+    ULONG64   image_sum;    /* checksum of the relocated image, must be last */
+};
+
+struct reloc_cache_file
+{
+    char     *name;
+    time_t    mtime;
+    off_t     size;
+};
+
+static int reloc_cache_enabled = -1;
+
+static BOOL use_reloc_cache(void)
+{
+    const char *env;
+
+    if (reloc_cache_enabled == -1)
+        reloc_cache_enabled = (env = getenv( "WINERELOCCACHE" )) && atoi( env );
+    return reloc_cache_enabled;
+}
+
+static long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+static ULONG64 reloc_cache_checksum( const void *ptr, SIZE_T size )
+{
+    const ULONG64 *p = ptr, *end = p + size / sizeof(*p);
+    ULONG64 sum = 0xcbf29ce484222325ull;
+
+    while (p < end) sum = (sum ^ *p++) * 0x100000001b3ull;
+    return sum;
+}
+
+static char *get_reloc_cache_name( const struct stat *st, void *base )
+{
+    char *name;
+
+    if (asprintf( &name, "%s/relocs/%lx-%lx-%lx-%lx.%lx-%lx-%p", config_dir, (unsigned long)st->st_dev,
+                  (unsigned long)st->st_ino, (unsigned long)st->st_size, (unsigned long)st->st_mtime,
+                  get_mtime_nsec( st ), (unsigned long)st->st_ctime, base ) == -1)
+        return NULL;
+    return name;
+}
+
+/* the image must not be relocated yet */
+static void init_reloc_cache_header( struct reloc_cache_header *header, const struct stat *st,
+                                     struct file_view *view )
+{
+    memset( header, 0, sizeof(*header) );
+    memcpy( header->magic, RELOC_CACHE_MAGIC, sizeof(header->magic) );
+    header->dev         = st->st_dev;
+    header->ino         = st->st_ino;
+    header->file_size   = st->st_size;
+    header->mtime       = st->st_mtime;
+    header->mtime_nsec  = get_mtime_nsec( st );
+    header->ctime       = st->st_ctime;
+    header->base        = (ULONG_PTR)view->base;
+    header->image_size  = view->size;
+    header->headers_sum = reloc_cache_checksum( view->base, page_size );
+}
+
+/* check that a cache file matches the original image and hasn't been truncated. Files are
+ * only renamed into place once completely written, so the image itself isn't read here;
+ * its checksum is only stored to help diagnosing a corrupted cache. */
+static BOOL check_reloc_cache( int fd, const struct reloc_cache_header *expect, struct stat *st )
+{
+    struct reloc_cache_header header;
+
+    if (fstat( fd, st ) || st->st_size != page_size + expect->image_size) return FALSE;
+    if (pread( fd, &header, sizeof(header), 0 ) != sizeof(header)) return FALSE;
+    return !memcmp( &header, expect, offsetof( struct reloc_cache_header, image_sum ));
+}
+
+static int compare_reloc_cache_files( const void *p1, const void *p2 )
+{
+    const struct reloc_cache_file *file1 = p1, *file2 = p2;
+
+    if (file1->mtime == file2->mtime) return 0;
+    return file1->mtime < file2->mtime ? -1 : 1;
+}
+
+/* remove the least recently used files once the cache has grown too large */
+static void prune_reloc_cache( const char *dir )
+{
+    struct reloc_cache_file *files = NULL, *new_files;
+    unsigned int i, count = 0, alloc = 0;
+    ULONG64 total = 0;
+    struct dirent *de;
+    struct stat st;
+    char *path;
+    DIR *d;
+
+    if (!(d = opendir( dir ))) return;
+    while ((de = readdir( d )))
+    {
+        if (de->d_name[0] == '.') continue;
+        if (asprintf( &path, "%s/%s", dir, de->d_name ) == -1) break;
+        if (stat( path, &st ) || !S_ISREG( st.st_mode ))
+        {
+            free( path );
+            continue;
+        }
+        if (count == alloc)
+        {
+            alloc = alloc ? alloc * 2 : 64;
+            if (!(new_files = realloc( files, alloc * sizeof(*files) )))
+            {
+                free( path );
+                break;
+            }
+            files = new_files;
+        }
+        files[count].name  = path;
+        files[count].mtime = st.st_mtime;
+        files[count].size  = st.st_size;
+        total += st.st_size;
+        count++;
+    }
+    closedir( d );
+
+    if (total > RELOC_CACHE_MAX_SIZE)
+    {
+        /* remove more than needed, so that this doesn't happen on every new image */
+        qsort( files, count, sizeof(*files), compare_reloc_cache_files );
+        for (i = 0; i < count && total > RELOC_CACHE_MAX_SIZE / 2; i++)
+        {
+            if (unlink( files[i].name )) continue;
+            TRACE_(module)( "removed %s\n", debugstr_a(files[i].name) );
+            total -= files[i].size;
+        }
+    }
+    for (i = 0; i < count; i++) free( files[i].name );
+    free( files );
+}
+
+/* apply the base relocations of an image in the unix side; returns FALSE if it can't be done,
+ * in which case the image is left untouched and the PE loader takes care of it */
+static BOOL relocate_image( char *ptr, IMAGE_NT_HEADERS *nt, SIZE_T total_size )
+{
+    IMAGE_DATA_DIRECTORY *dir;
+    IMAGE_BASE_RELOCATION *rel, *end;
+    ULONGLONG image_base;
+    INT_PTR delta;
+    USHORT *reloc;
+    unsigned int i, count;
+    int pass;
+
+    if (nt->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+    {
+        IMAGE_NT_HEADERS64 *nt64 = (IMAGE_NT_HEADERS64 *)nt;
+        image_base = nt64->OptionalHeader.ImageBase;
+        dir = &nt64->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+    }
+    else
+    {
+        IMAGE_NT_HEADERS32 *nt32 = (IMAGE_NT_HEADERS32 *)nt;
+        image_base = nt32->OptionalHeader.ImageBase;
+        dir = &nt32->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+    }
+    if (nt->FileHeader.Characteristics & IMAGE_FILE_RELOCS_STRIPPED) return FALSE;
+    if (nt->OptionalHeader.SectionAlignment < page_size) return FALSE;
+    if (!dir->VirtualAddress || !dir->Size) return FALSE;
+    if (dir->VirtualAddress >= total_size || dir->Size > total_size - dir->VirtualAddress) return FALSE;
+    delta = ptr - (char *)(ULONG_PTR)image_base;
+
+    /* validate everything first, then apply the relocations */
+    for (pass = 0; pass < 2; pass++)
+    {
+        rel = (IMAGE_BASE_RELOCATION *)(ptr + dir->VirtualAddress);
+        end = (IMAGE_BASE_RELOCATION *)(ptr + dir->VirtualAddress + dir->Size);
+        while (rel < end - 1 && rel->SizeOfBlock)
+        {
+            char *page = ptr + rel->VirtualAddress;
+
+            if (rel->SizeOfBlock < sizeof(*rel) || rel->SizeOfBlock > (char *)end - (char *)rel) return FALSE;
+            if (rel->VirtualAddress >= total_size || total_size - rel->VirtualAddress < page_size + 8)
+                return FALSE;
+            count = (rel->SizeOfBlock - sizeof(*rel)) / sizeof(USHORT);
+            reloc = (USHORT *)(rel + 1);
+            for (i = 0; i < count; i++)
+            {
+                char *addr = page + (reloc[i] & 0xfff);
+
+                switch (reloc[i] >> 12)
+                {
+                case IMAGE_REL_BASED_ABSOLUTE:
+                    break;
+                case IMAGE_REL_BASED_HIGH:
+                    if (pass) *(short *)addr += HIWORD(delta);
+                    break;
+                case IMAGE_REL_BASED_LOW:
+                    if (pass) *(short *)addr += LOWORD(delta);
+                    break;
+                case IMAGE_REL_BASED_HIGHLOW:
+                    if (pass) *(int *)addr += delta;
+                    break;
+                case IMAGE_REL_BASED_DIR64:
+                    if (pass) *(LONGLONG *)addr += delta;
+                    break;
+                default:
+                    return FALSE;
+                }
+            }
+            rel = (IMAGE_BASE_RELOCATION *)((char *)rel + rel->SizeOfBlock);
+        }
+    }
+
+    /* the loader checks the image base to decide whether relocations are needed */
+    if (nt->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+        ((IMAGE_NT_HEADERS64 *)nt)->OptionalHeader.ImageBase = (ULONG_PTR)ptr;
+    else
+        ((IMAGE_NT_HEADERS32 *)nt)->OptionalHeader.ImageBase = (ULONG_PTR)ptr;
+    return TRUE;
+}
+
+/* map a relocated image from the cache, or relocate it and add it to the cache */
+static void map_reloc_cache( struct file_view *view, const struct stat *st, IMAGE_NT_HEADERS *nt )
+{
+    struct reloc_cache_header header;
+    char *name, *tmp, *p;
+    struct stat cache_st;
+    int fd;
+
+    if (!(name = get_reloc_cache_name( st, view->base ))) return;
+    init_reloc_cache_header( &header, st, view );
+
+    if ((fd = open( name, O_RDONLY )) != -1)
+    {
+        if (check_reloc_cache( fd, &header, &cache_st ))
+        {
+            if (map_file_into_view( view, fd, 0, view->size, page_size,
+                                    VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY, FALSE ) == STATUS_SUCCESS)
+            {
+                TRACE_(module)( "mapped relocated image %p from %s\n", view->base, debugstr_a(name) );
+#ifdef HAVE_FUTIMENS
+                /* the modification time is used to find the least recently used files */
+                if (cache_st.st_mtime + 3600 < time( NULL )) futimens( fd, NULL );
+#endif
+            }
+            close( fd );
+            free( name );
+            return;
+        }
+        /* stale or corrupted, replace it */
+        WARN_(module)( "discarding %s\n", debugstr_a(name) );
+        close( fd );
+        unlink( name );
+    }
+
+    if (view->size > RELOC_CACHE_MAX_SIZE / 4 || !relocate_image( view->base, nt, view->size ))
+    {
+        free( name );
+        return;
+    }
+    header.image_sum = reloc_cache_checksum( view->base, view->size );
+
+    /* write to a temporary file and rename it, so that other processes never see a partial image */
+    if (asprintf( &tmp, "%s.XXXXXX", name ) != -1)
+    {
+        p = strrchr( tmp, '/' );
+        *p = 0;
+        mkdir( tmp, 0777 );
+        *p = '/';
+        if ((fd = mkstemp( tmp )) != -1)
+        {
+            if (pwrite( fd, &header, sizeof(header), 0 ) == sizeof(header) &&
+                pwrite( fd, view->base, view->size, page_size ) == view->size && !rename( tmp, name ))
+            {
+                TRACE_(module)( "saved relocated image %p to %s\n", view->base, debugstr_a(name) );
+                *p = 0;
+                prune_reloc_cache( tmp );
+            }
+            else unlink( tmp );
+            close( fd );
+        }
+        free( tmp );
+    }
+    free( name );
+}
+
+
 /***********************************************************************
  *           map_image_into_view
  *
@@ -2194,6 +2670,7 @@ static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filena
     char *header_end, *header_start;
     char *ptr = view->base;
     SIZE_T total_size = view->size;
+    BOOL has_shared_sections = FALSE;
 
     TRACE_(module)( "mapping PE file %s at %p-%p\n", debugstr_w(filename), ptr, ptr + total_size );
 
@@ -2286,6 +2763,7 @@ static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filena
                 ERR_(module)( "Could not map %s shared section %.8s\n", debugstr_w(filename), sec->Name );
                 return status;
             }
+            has_shared_sections = TRUE;
 
             /* check if the import directory falls inside this section */
             if (imports && imports->VirtualAddress >= sec->VirtualAddress &&
@@ -2337,6 +2815,10 @@ static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filena
         }
     }
 
+    if (ptr != orig_base && !removable && !has_shared_sections &&
+        (nt->FileHeader.Characteristics & IMAGE_FILE_DLL) && use_reloc_cache())
+        map_reloc_cache( view, &st, nt );
+
     /* set the image protections */
 
     set_vprot( view, ptr, ROUND_SIZE( 0, header_size ), VPROT_COMMITTED | VPROT_READ );
@@ -2445,7 +2927,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     }
 
     status = STATUS_INVALID_PARAMETER;
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
 
     base = wine_server_get_ptr( image_info->base );
     if ((ULONG_PTR)base != image_info->base) base = NULL;
@@ -2480,7 +2962,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     if (needs_close) close( unix_fd );
     if (shared_needs_close) close( shared_fd );
     return status;
@@ -2574,7 +3056,7 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_PTR z
 
     if ((res = server_get_unix_fd( handle, 0, &unix_handle, &needs_close, NULL, NULL ))) return res;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
 
     res = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits );
     if (res) goto done;
@@ -2605,7 +3087,7 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_PTR z
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     if (needs_close) close( unix_handle );
     return res;
 }
@@ -2652,12 +3134,22 @@ void virtual_init(void)
     size_t size;
     int i;
     pthread_mutexattr_t attr;
+    pthread_rwlockattr_t rwlock_attr;
 
     pthread_mutexattr_init( &attr );
     pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
     pthread_mutex_init( &virtual_mutex, &attr );
     pthread_mutexattr_destroy( &attr );
 
+    pthread_rwlockattr_init( &rwlock_attr );
+#ifdef __GLIBC__
+    /* don't let a stream of queries starve allocations */
+    pthread_rwlockattr_setkind_np( &rwlock_attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP );
+#endif
+    pthread_rwlock_init( &virtual_rwlock, &rwlock_attr );
+    pthread_rwlockattr_destroy( &rwlock_attr );
+    for (i = 0; i < ARRAY_SIZE(view_locks); i++) pthread_mutex_init( &view_locks[i], NULL );
+
     if (preload_info && *preload_info)
         for (i = 0; (*preload_info)[i].size; i++)
             mmap_add_reserved_area( (*preload_info)[i].addr, (*preload_info)[i].size );
@@ -2820,7 +3312,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
     void *base = wine_server_get_ptr( info->base );
     int i;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     status = create_view( &view, base, size, SEC_IMAGE | SEC_FILE | VPROT_SYSTEM |
                           VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY | VPROT_EXEC );
     if (!status)
@@ -2859,7 +3351,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
         }
         else delete_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
 
     return status;
 }
@@ -2966,7 +3458,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
     SIZE_T block_size = signal_stack_mask + 1;
     BOOL is_wow = !!NtCurrentTeb()->WowTebOffset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     if (next_free_teb)
     {
         ptr = next_free_teb;
@@ -2982,7 +3474,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
             if ((status = NtAllocateVirtualMemory( NtCurrentProcess(), &ptr, is_win64 && is_wow ? 0x7fffffff : 0,
                                                    &total, MEM_RESERVE, PAGE_READWRITE )))
             {
-                server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                leave_virtual_lock( &sigset );
                 return status;
             }
             teb_block = ptr;
@@ -2993,14 +3485,14 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
                                  MEM_COMMIT, PAGE_READWRITE );
     }
     *ret_teb = teb = init_teb( ptr, is_wow );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
 
     if ((status = signal_alloc_thread( teb )))
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        enter_virtual_lock( &sigset );
         *(void **)ptr = next_free_teb;
         next_free_teb = ptr;
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        leave_virtual_lock( &sigset );
     }
     return status;
 }
@@ -3034,13 +3526,13 @@ void virtual_free_teb( TEB *teb )
         NtFreeVirtualMemory( GetCurrentProcess(), &ptr, &size, MEM_RELEASE );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     list_remove( &thread_data->entry );
     ptr = teb;
     if (!is_win64) ptr = (char *)ptr - teb_offset;
     *(void **)ptr = next_free_teb;
     next_free_teb = ptr;
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
 }
 
 
@@ -3054,7 +3546,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 
     if (index < TLS_MINIMUM_AVAILABLE)
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        enter_virtual_lock( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
@@ -3065,14 +3557,14 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             teb->TlsSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        leave_virtual_lock( &sigset );
     }
     else
     {
         index -= TLS_MINIMUM_AVAILABLE;
         if (index >= 8 * sizeof(peb->TlsExpansionBitmapBits)) return STATUS_INVALID_PARAMETER;
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        enter_virtual_lock( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
@@ -3087,7 +3579,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             if (teb->TlsExpansionSlots) teb->TlsExpansionSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        leave_virtual_lock( &sigset );
     }
     return STATUS_SUCCESS;
 }
@@ -3111,7 +3603,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     if (size < 1024 * 1024) size = 1024 * 1024;  /* Xlib needs a large stack */
     size = (size + 0xffff) & ~0xffff;  /* round to 64K boundary */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
 
     if ((status = map_view( &view, NULL, size + extra_size, FALSE,
                             VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, zero_bits )) != STATUS_SUCCESS)
@@ -3152,7 +3644,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     stack->StackBase = (char *)view->base + view->size;
     stack->StackLimit = (char *)view->base + 2 * page_size;
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return status;
 }
 
@@ -3260,7 +3752,7 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
     char *page = ROUND_ADDR( addr, page_mask );
     BYTE vprot;
 
-    mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+    enter_virtual_lock( NULL );  /* no need for signal masking inside signal handler */
     vprot = get_page_vprot( page );
     if (!is_inside_signal_stack( stack ) && (vprot & VPROT_GUARD))
     {
@@ -3287,7 +3779,7 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
                 ret = STATUS_SUCCESS;
         }
     }
-    mutex_unlock( &virtual_mutex );
+    leave_virtual_lock( NULL );
     return ret;
 }
 
@@ -3327,14 +3819,14 @@ void *virtual_setup_exception( void *stack_ptr, size_t size, EXCEPTION_RECORD *r
     }
     else if (stack < stack_info.limit)
     {
-        mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+        enter_virtual_lock( NULL );  /* no need for signal masking inside signal handler */
         if ((get_page_vprot( stack ) & VPROT_GUARD) &&
             grow_thread_stack( ROUND_ADDR( stack, page_mask ), &stack_info ))
         {
             rec->ExceptionCode = STATUS_STACK_OVERFLOW;
             rec->NumberParameters = 0;
         }
-        mutex_unlock( &virtual_mutex );
+        leave_virtual_lock( NULL );
     }
 #if defined(VALGRIND_MAKE_MEM_UNDEFINED)
     VALGRIND_MAKE_MEM_UNDEFINED( stack, size );
@@ -3383,14 +3875,14 @@ unsigned int virtual_locked_server_call( void *req_ptr )
 
     if (!size) return wine_server_call( req_ptr );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         ret = server_call_unlocked( req );
         if (has_write_watch) update_write_watches( addr, size, wine_server_reply_size( req ));
     }
     else memset( &req->u.reply, 0, sizeof(req->u.reply) );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return ret;
 }
 
@@ -3407,14 +3899,14 @@ ssize_t virtual_locked_read( int fd, void *addr, size_t size )
     ssize_t ret = read( fd, addr, size );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = read( fd, addr, size );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     errno = err;
     return ret;
 }
@@ -3432,14 +3924,14 @@ ssize_t virtual_locked_pread( int fd, void *addr, size_t size, off_t offset )
     ssize_t ret = pread( fd, addr, size, offset );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = pread( fd, addr, size, offset );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     errno = err;
     return ret;
 }
@@ -3458,7 +3950,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     ssize_t ret = recvmsg( fd, hdr, flags );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     for (i = 0; i < hdr->msg_iovlen; i++)
         if (check_write_access( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, &has_write_watch ))
             break;
@@ -3470,7 +3962,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     if (has_write_watch)
         while (i--) update_write_watches( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, 0 );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     errno = err;
     return ret;
 }
@@ -3482,13 +3974,13 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
 BOOL virtual_is_valid_code_address( const void *addr, SIZE_T size )
 {
     struct file_view *view;
-    BOOL ret = FALSE;
+    BOOL ret = FALSE, shared;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    shared = enter_virtual_lock_shared( &sigset );
     if ((view = find_view( addr, size )))
         ret = !(view->protect & VPROT_SYSTEM);  /* system views are not visible to the app */
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock_shared( &sigset, shared );
     return ret;
 }
 
@@ -3575,7 +4067,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
 
     if (!size) return 0;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     if ((view = find_view( addr, size )))
     {
         if (!(view->protect & VPROT_SYSTEM))
@@ -3591,7 +4083,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
             }
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return bytes_read;
 }
 
@@ -3611,13 +4103,13 @@ NTSTATUS virtual_uninterrupted_write_memory( void *addr, const void *buffer, SIZ
 
     if (!size) return STATUS_SUCCESS;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         memcpy( addr, buffer, size );
         if (has_write_watch) update_write_watches( addr, size, size );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return ret;
 }
 
@@ -3632,7 +4124,7 @@ void virtual_set_force_exec( BOOL enable )
     struct file_view *view;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     if (!force_exec_prot != !enable)  /* change all existing views */
     {
         force_exec_prot = enable;
@@ -3645,7 +4137,7 @@ void virtual_set_force_exec( BOOL enable )
             mprotect_range( view->base, view->size, commit, 0 );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
 }
 
 struct free_range
@@ -3727,9 +4219,11 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
     unsigned int vprot;
     BOOL is_dos_memory = FALSE;
     struct file_view *view;
+    pthread_mutex_t *view_lock = NULL;
     sigset_t sigset;
     SIZE_T size = *size_ptr;
     NTSTATUS status = STATUS_SUCCESS;
+    BOOL reserve, shared = FALSE;
 
     TRACE("%p %p %08lx %x %08x\n", process, *ret, size, type, protect );
 
@@ -3795,18 +4289,31 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
     /* Compute the alloc type flags */
 
     if (!(type & (MEM_COMMIT | MEM_RESERVE | MEM_RESET)) ||
-        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET)))
+        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET | MEM_LARGE_PAGES)))
     {
         WARN("called with wrong alloc type flags (%08x) !\n", type);
         return STATUS_INVALID_PARAMETER;
     }
 
-    /* Reserve the memory */
+    if (type & MEM_LARGE_PAGES)
+    {
+        SIZE_T large_page_mask = user_shared_data->LargePageMinimum - 1;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        if (!user_shared_data->LargePageMinimum) return STATUS_NOT_SUPPORTED;
+        if ((type & (MEM_COMMIT | MEM_RESERVE)) != (MEM_COMMIT | MEM_RESERVE) ||
+            (type & MEM_WRITE_WATCH) || is_dos_memory ||
+            (size & large_page_mask) || ((UINT_PTR)base & large_page_mask))
+        {
+            WARN( "invalid large page allocation %p-%p type %08x\n", base, (char *)base + size, type );
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
 
-    if ((type & MEM_RESERVE) || !base)
+    /* Reserve the memory */
+
+    if ((reserve = (type & MEM_RESERVE) || !base))
     {
+        enter_virtual_lock( &sigset );
         if (!(status = get_vprot_flags( protect, &vprot, FALSE )))
         {
             if (type & MEM_COMMIT) vprot |= VPROT_COMMITTED;
@@ -3815,36 +4322,48 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
 
             if (vprot & VPROT_WRITECOPY) status = STATUS_INVALID_PAGE_PROTECTION;
             else if (is_dos_memory) status = allocate_dos_memory( &view, vprot );
+            else if (type & MEM_LARGE_PAGES)
+                status = map_large_page_view( &view, base, size, type & MEM_TOP_DOWN, vprot, zero_bits );
             else status = map_view( &view, base, size, type & MEM_TOP_DOWN, vprot, zero_bits );
 
-            if (status == STATUS_SUCCESS) base = view->base;
+            if (status == STATUS_SUCCESS)
+            {
+                base = view->base;
+                if ((type & MEM_COMMIT) && !(type & MEM_LARGE_PAGES) && use_huge_pages( size ))
+                    advise_huge_pages( base, size );
+            }
         }
     }
-    else if (type & MEM_RESET)
-    {
-        if (!(view = find_view( base, size ))) status = STATUS_NOT_MAPPED_VIEW;
-        else madvise( base, size, MADV_DONTNEED );
-    }
-    else  /* commit the pages */
+    else
     {
+        /* the views tree isn't changed, so other views can be modified at the same time */
+        shared = enter_virtual_lock_shared( &sigset );
         if (!(view = find_view( base, size ))) status = STATUS_NOT_MAPPED_VIEW;
+        else if ((view_lock = enter_view_lock( view, shared )), (type & MEM_RESET))
+            madvise( base, size, MADV_DONTNEED );
         else if (view->protect & SEC_FILE) status = STATUS_ALREADY_COMMITTED;
-        else if (!(status = set_protection( view, base, size, protect )) && (view->protect & SEC_RESERVE))
+        else if (!(status = set_protection( view, base, size, protect )))  /* commit the pages */
         {
-            SERVER_START_REQ( add_mapping_committed_range )
+            if (view->protect & SEC_RESERVE)
             {
-                req->base   = wine_server_client_ptr( view->base );
-                req->offset = (char *)base - (char *)view->base;
-                req->size   = size;
-                wine_server_call( req );
+                SERVER_START_REQ( add_mapping_committed_range )
+                {
+                    req->base   = wine_server_client_ptr( view->base );
+                    req->offset = (char *)base - (char *)view->base;
+                    req->size   = size;
+                    wine_server_call( req );
+                }
+                SERVER_END_REQ;
             }
-            SERVER_END_REQ;
+            else if (use_huge_pages( size )) advise_huge_pages( base, size );
         }
     }
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_view_lock( view_lock );
+    if (reserve) leave_virtual_lock( &sigset );
+    else leave_virtual_lock_shared( &sigset, shared );
 
     if (status == STATUS_SUCCESS)
     {
@@ -3912,7 +4431,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
     if (size) size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
 
     /* avoid freeing the DOS area when a broken app passes a NULL pointer */
     if (!base)
@@ -3954,7 +4473,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
         status = STATUS_INVALID_PARAMETER;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return status;
 }
 
@@ -3973,6 +4492,8 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
     BYTE vprot;
     SIZE_T size = *size_ptr;
     LPVOID addr = *addr_ptr;
+    pthread_mutex_t *view_lock;
+    BOOL shared;
     DWORD old;
 
     TRACE("%p %p %08lx %08x\n", process, addr, size, new_prot );
@@ -4008,10 +4529,12 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
     size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    /* the views tree isn't changed, so other views can be protected at the same time */
+    shared = enter_virtual_lock_shared( &sigset );
 
     if ((view = find_view( base, size )))
     {
+        view_lock = enter_view_lock( view, shared );
         /* Make sure all the pages are committed */
         if (get_committed_size( view, base, &vprot, VPROT_COMMITTED ) >= size && (vprot & VPROT_COMMITTED))
         {
@@ -4019,12 +4542,12 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
             status = set_protection( view, base, size, new_prot );
         }
         else status = STATUS_NOT_COMMITTED;
+        if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
+        leave_view_lock( view_lock );
     }
     else status = STATUS_INVALID_PARAMETER;
 
-    if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
-
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock_shared( &sigset, shared );
 
     if (status == STATUS_SUCCESS)
     {
@@ -4085,10 +4608,12 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
                                        MEMORY_BASIC_INFORMATION *info,
                                        SIZE_T len, SIZE_T *res_len )
 {
+    MEMORY_BASIC_INFORMATION basic_info;
     struct file_view *view;
     char *base, *alloc_base = 0, *alloc_end = working_set_limit;
     struct wine_rb_entry *ptr;
     sigset_t sigset;
+    BOOL shared;
 
     if (len < sizeof(MEMORY_BASIC_INFORMATION))
         return STATUS_INFO_LENGTH_MISMATCH;
@@ -4128,7 +4653,7 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
 
     /* Find the view containing the address */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    shared = enter_virtual_lock_shared( &sigset );
     ptr = views_tree.root;
     while (ptr)
     {
@@ -4151,49 +4676,53 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
         }
     }
 
-    /* Fill the info structure */
+    /* Fill the info structure, client memory can't be accessed with the lock held shared */
 
-    info->AllocationBase = alloc_base;
-    info->BaseAddress    = base;
-    info->RegionSize     = alloc_end - base;
+    basic_info.AllocationBase = alloc_base;
+    basic_info.BaseAddress    = base;
+    basic_info.RegionSize     = alloc_end - base;
 
     if (!ptr)
     {
-        if (!mmap_enum_reserved_areas( get_free_mem_state_callback, info, 0 ))
+        if (!mmap_enum_reserved_areas( get_free_mem_state_callback, &basic_info, 0 ))
         {
             /* not in a reserved area at all, pretend it's allocated */
 #ifdef __i386__
             if (base >= (char *)address_space_start)
             {
-                info->State             = MEM_RESERVE;
-                info->Protect           = PAGE_NOACCESS;
-                info->AllocationProtect = PAGE_NOACCESS;
-                info->Type              = MEM_PRIVATE;
+                basic_info.State             = MEM_RESERVE;
+                basic_info.Protect           = PAGE_NOACCESS;
+                basic_info.AllocationProtect = PAGE_NOACCESS;
+                basic_info.Type              = MEM_PRIVATE;
             }
             else
 #endif
             {
-                info->State             = MEM_FREE;
-                info->Protect           = PAGE_NOACCESS;
-                info->AllocationBase    = 0;
-                info->AllocationProtect = 0;
-                info->Type              = 0;
+                basic_info.State             = MEM_FREE;
+                basic_info.Protect           = PAGE_NOACCESS;
+                basic_info.AllocationBase    = 0;
+                basic_info.AllocationProtect = 0;
+                basic_info.Type              = 0;
             }
         }
     }
     else
     {
+        pthread_mutex_t *view_lock = enter_view_lock( view, shared );
         BYTE vprot;
 
-        info->RegionSize = get_committed_size( view, base, &vprot, ~VPROT_WRITEWATCH );
-        info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
-        info->Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
-        info->AllocationProtect = get_win32_prot( view->protect, view->protect );
-        if (view->protect & SEC_IMAGE) info->Type = MEM_IMAGE;
-        else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
-        else info->Type = MEM_PRIVATE;
+        basic_info.RegionSize = get_committed_size( view, base, &vprot, ~VPROT_WRITEWATCH );
+        leave_view_lock( view_lock );
+        basic_info.State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
+        basic_info.Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
+        basic_info.AllocationProtect = get_win32_prot( view->protect, view->protect );
+        if (view->protect & SEC_IMAGE) basic_info.Type = MEM_IMAGE;
+        else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) basic_info.Type = MEM_MAPPED;
+        else basic_info.Type = MEM_PRIVATE;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock_shared( &sigset, shared );
+
+    *info = basic_info;
 
     if (res_len) *res_len = sizeof(*info);
     return STATUS_SUCCESS;
@@ -4229,7 +4758,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
         if (vmentries == NULL)
             WARN( "couldn't get process vmmap, errno %d\n", errno );
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        enter_virtual_lock( &sigset );
         for (p = info; (UINT_PTR)(p + 1) <= (UINT_PTR)info + len; p++)
         {
              int i;
@@ -4255,7 +4784,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                      p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
              }
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        leave_virtual_lock( &sigset );
 
         if (vmentries)
             procstat_freevmmap( pstat, vmentries );
@@ -4272,7 +4801,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
         if (!once++) WARN( "unable to open /proc/self/pagemap\n" );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     for (p = info; (UINT_PTR)(p + 1) <= (UINT_PTR)info + len; p++)
     {
         BYTE vprot;
@@ -4300,7 +4829,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                 p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
 #endif
 
     if (f)
@@ -4561,7 +5090,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
         return status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     if ((view = find_view( addr, 0 )) && !is_view_valloc( view ))
     {
         if (view->protect & VPROT_SYSTEM)
@@ -4575,7 +5104,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
                 {
                     TRACE( "not freeing in-use builtin %p\n", view->base );
                     builtin->refcount--;
-                    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                    leave_virtual_lock( &sigset );
                     return STATUS_SUCCESS;
                 }
             }
@@ -4594,7 +5123,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
         }
         else FIXME( "failed to unmap %p %x\n", view->base, status );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return status;
 }
 
@@ -4720,7 +5249,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         return result.virtual_flush.status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
     if (!(view = find_view( addr, *size_ptr ))) status = STATUS_INVALID_PARAMETER;
     else
     {
@@ -4730,7 +5259,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         if (msync( addr, *size_ptr, MS_ASYNC )) status = STATUS_NOT_MAPPED_DATA;
 #endif
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return status;
 }
 
@@ -4757,7 +5286,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     TRACE( "%p %x %p-%p %p %lu\n", process, flags, base, (char *)base + size,
            addresses, *count );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
 
     if (is_write_watch_range( base, size ))
     {
@@ -4776,7 +5305,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     }
     else status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return status;
 }
 
@@ -4797,14 +5326,14 @@ NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 
     if (!size) return STATUS_INVALID_PARAMETER;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_lock( &sigset );
 
     if (is_write_watch_range( base, size ))
         reset_write_watches( base, size );
     else
         status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock( &sigset );
     return status;
 }
 
@@ -4878,10 +5407,11 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
     struct file_view *view1, *view2;
     NTSTATUS status;
     sigset_t sigset;
+    BOOL shared;
 
     TRACE("%p %p\n", addr1, addr2);
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    shared = enter_virtual_lock_shared( &sigset );
 
     view1 = find_view( addr1, 0 );
     view2 = find_view( addr2, 0 );
@@ -4905,7 +5435,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
         SERVER_END_REQ;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_lock_shared( &sigset, shared );
     return status;
 }
 
@@ -26,7 +26,7 @@
 struct _DISPATCHER_CONTEXT;
 
 /* increment this when you change the function table */
-#define NTDLL_UNIXLIB_VERSION 134
+#define NTDLL_UNIXLIB_VERSION 136
 
 struct unix_funcs
 {
@@ -37,6 +37,12 @@ struct unix_funcs
                                                CONTEXT *context );
     /* other Win32 API functions */
     LONGLONG      (WINAPI *RtlGetSystemTimePrecise)(void);
+    NTSTATUS      (CDECL *fast_RtlWaitOnAddress)( const void *addr, const void *cmp, SIZE_T size,
+                                                  const LARGE_INTEGER *timeout );
+    int           (CDECL *fast_RtlWakeAddress)( const void *addr, int count );
+    /* registry functions */
+    NTSTATUS      (CDECL *set_registry_value)( const OBJECT_ATTRIBUTES *attr, const UNICODE_STRING *name,
+                                               ULONG type, const void *data, ULONG count );
 #ifdef __aarch64__
     TEB *         (WINAPI *NtCurrentTeb)(void);
 #endif
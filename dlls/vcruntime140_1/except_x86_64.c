@@ -674,7 +674,7 @@ static inline void find_catch_block4(EXCEPTION_RECORD *rec, CONTEXT *context,
                 catch_record.ExceptionInformation[9] = (ULONG_PTR)rva_to_ptr(
                         ci.ret_addr[1], dispatch->ImageBase);
             }
-            RtlUnwindEx((void*)frame, (void*)dispatch->ControlPc, &catch_record, NULL, &ctx, NULL);
+            RtlUnwindEx((void*)frame, (void*)dispatch->ControlPc, &catch_record, NULL, &ctx, dispatch->HistoryTable);
         }
     }
 
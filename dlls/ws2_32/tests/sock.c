@@ -8414,6 +8414,113 @@ static void test_TransmitFile(void)
     closesocket(server);
 }
 
+static void recv_all(SOCKET s, char *buffer, int len)
+{
+    int ret, total = 0;
+
+    while (total < len)
+    {
+        ret = recv(s, buffer + total, len - total, 0);
+        ok(ret > 0, "got %d, error %u\n", ret, WSAGetLastError());
+        if (ret <= 0) break;
+        total += ret;
+    }
+}
+
+static void test_TransmitPackets(void)
+{
+    GUID transmit_packets_guid = WSAID_TRANSMITPACKETS;
+    LPFN_TRANSMITPACKETS pTransmitPackets = NULL;
+    static const char head[] = "head", tail[] = "tail";
+    char temp_path[MAX_PATH], file_name[MAX_PATH];
+    TRANSMIT_PACKETS_ELEMENT elements[4];
+    char *data, *buffer;
+    SOCKET client, server;
+    OVERLAPPED overlapped;
+    DWORD size, i;
+    HANDLE file;
+    BOOL ret;
+    int len;
+
+    tcp_socketpair(&client, &server);
+
+    ret = WSAIoctl(client, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmit_packets_guid,
+                   sizeof(transmit_packets_guid), &pTransmitPackets, sizeof(pTransmitPackets), &size, NULL, NULL);
+    ok(!ret, "failed to get TransmitPackets, error %u\n", WSAGetLastError());
+    if (!pTransmitPackets)
+    {
+        closesocket(client);
+        closesocket(server);
+        return;
+    }
+
+    data = malloc(20000);
+    for (i = 0; i < 20000; i++) data[i] = i * 7;
+
+    GetTempPathA(sizeof(temp_path), temp_path);
+    GetTempFileNameA(temp_path, "wst", 0, file_name);
+    file = CreateFileA(file_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create file, error %u\n", GetLastError());
+    ret = WriteFile(file, data, 20000, &size, NULL);
+    ok(ret && size == 20000, "failed to write file, error %u\n", GetLastError());
+
+    len = sizeof(head) + 20000 + 100 + sizeof(tail);
+    buffer = malloc(len);
+
+    memset(elements, 0, sizeof(elements));
+    elements[0].dwElFlags = TP_ELEMENT_MEMORY;
+    elements[0].cLength = sizeof(head);
+    elements[0].pBuffer = (void *)head;
+    elements[1].dwElFlags = TP_ELEMENT_FILE;
+    elements[1].cLength = 0;
+    elements[1].nFileOffset.QuadPart = 0;
+    elements[1].hFile = file;
+    elements[2].dwElFlags = TP_ELEMENT_FILE;
+    elements[2].cLength = 100;
+    elements[2].nFileOffset.QuadPart = 1000;
+    elements[2].hFile = file;
+    elements[3].dwElFlags = TP_ELEMENT_MEMORY | TP_ELEMENT_EOP;
+    elements[3].cLength = sizeof(tail);
+    elements[3].pBuffer = (void *)tail;
+
+    ret = pTransmitPackets(client, elements, 4, 0, NULL, 0);
+    ok(ret, "TransmitPackets failed, error %u\n", WSAGetLastError());
+
+    memset(buffer, 0, len);
+    recv_all(server, buffer, len);
+    ok(!memcmp(buffer, head, sizeof(head)), "head didn't match\n");
+    ok(!memcmp(buffer + sizeof(head), data, 20000), "file data didn't match\n");
+    ok(!memcmp(buffer + sizeof(head) + 20000, data + 1000, 100), "file range didn't match\n");
+    ok(!memcmp(buffer + sizeof(head) + 20100, tail, sizeof(tail)), "tail didn't match\n");
+
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ret = pTransmitPackets(client, elements, 4, 1000, &overlapped, 0);
+    ok(ret || WSAGetLastError() == ERROR_IO_PENDING, "TransmitPackets failed, error %u\n", WSAGetLastError());
+
+    memset(buffer, 0, len);
+    recv_all(server, buffer, len);
+    ok(!memcmp(buffer, head, sizeof(head)), "head didn't match\n");
+    ok(!memcmp(buffer + sizeof(head), data, 20000), "file data didn't match\n");
+    ok(!memcmp(buffer + sizeof(head) + 20000, data + 1000, 100), "file range didn't match\n");
+    ok(!memcmp(buffer + sizeof(head) + 20100, tail, sizeof(tail)), "tail didn't match\n");
+
+    ret = WaitForSingleObject(overlapped.hEvent, 1000);
+    ok(!ret, "wait timed out\n");
+    size = 0xdeadbeef;
+    ret = GetOverlappedResult((HANDLE)client, &overlapped, &size, FALSE);
+    ok(ret, "got error %u\n", GetLastError());
+    ok(size == len, "got size %u\n", size);
+
+    CloseHandle(overlapped.hEvent);
+    CloseHandle(file);
+    free(buffer);
+    free(data);
+    closesocket(client);
+    closesocket(server);
+}
+
 static void test_getpeername(void)
 {
     SOCKET sock;
@@ -11594,6 +11701,32 @@ static void test_simultaneous_async_recv(void)
         ok(!memcmp(expect, actual, stride), "expected %s, got %s\n", debugstr_an(expect, stride), debugstr_an(actual, stride));
     }
 
+    /* data which is already available is received in order as well */
+    ret = send(server, msgstr, sizeof(msgstr), 0);
+    ok(ret == sizeof(msgstr), "got %d\n", ret);
+    memset(resbuf, 0, sizeof(resbuf));
+
+    /* wait for the data to arrive */
+    ret = recv(client, resbuf, 1, MSG_PEEK);
+    ok(ret == 1, "got %d\n", ret);
+
+    for (i = 0; i < num_io; i++)
+    {
+        const void *expect = msgstr + i * stride;
+        const void *actual = resbuf + i * stride;
+        DWORD size;
+
+        ResetEvent(events[i]);
+        size = 0xdeadbeef;
+        ret = WSARecv(client, &wsabufs[i], 1, &size, &flags[i], &overlappeds[i], NULL);
+        ok(!ret, "got error %u\n", WSAGetLastError());
+        ok(size == stride, "got size %u\n", size);
+
+        ret = WaitForSingleObject(events[i], 1000);
+        ok(!ret, "wait timed out\n");
+        ok(!memcmp(expect, actual, stride), "expected %s, got %s\n", debugstr_an(expect, stride), debugstr_an(actual, stride));
+    }
+
     closesocket(client);
     closesocket(server);
 
@@ -12146,6 +12279,7 @@ START_TEST( sock )
 
     test_ipv6only();
     test_TransmitFile();
+    test_TransmitPackets();
     test_AcceptEx();
     test_connect();
     test_shutdown();
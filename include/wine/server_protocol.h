@@ -832,6 +832,31 @@ typedef struct
 } cursor_pos_t;
 
 
+struct fast_sync_object
+{
+    int          state;
+    int          max;
+    unsigned int type;
+    unsigned int server_waiters;
+    unsigned int serial;
+    int          pulse;
+    int          next_free;
+    int          __pad;
+};
+#define FAST_SYNC_EVENT_SIGNALED 0x1
+#define FAST_SYNC_EVENT_PULSE    0x2
+enum fast_sync_type
+{
+    FAST_SYNC_NONE,
+    FAST_SYNC_MANUAL_EVENT,
+    FAST_SYNC_AUTO_EVENT,
+    FAST_SYNC_SEMAPHORE,
+    FAST_SYNC_SOCKET
+};
+#define FAST_SYNC_MAX_OBJECTS 0x10000
+#define FAST_SYNC_MAX_SOCKETS 0x20000
+
+
 
 
 
@@ -1351,6 +1376,23 @@ struct select_reply
 
 
 
+struct batch_request
+{
+    struct request_header __header;
+    unsigned int chain;
+    /* VARARG(requests,bytes); */
+};
+struct batch_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    /* VARARG(replies,bytes); */
+    char __pad_12[4];
+};
+#define BATCH_ALIGN(size) (((size) + 7) & ~7)
+
+
+
 struct create_event_request
 {
     struct request_header __header;
@@ -1551,6 +1593,48 @@ struct query_semaphore_reply
 };
 
 
+struct get_fast_sync_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_fast_sync_shm_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
+struct get_fast_sync_obj_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_fast_sync_obj_reply
+{
+    struct reply_header __header;
+    unsigned int index;
+    unsigned int serial;
+    unsigned int type;
+    unsigned int access;
+};
+
+
+
+struct fast_sync_wake_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct fast_sync_wake_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct open_semaphore_request
 {
     struct request_header __header;
@@ -1764,8 +1848,8 @@ struct recv_socket_request
     struct request_header __header;
     int          oob;
     async_data_t async;
-    int          force_async;
-    char __pad_60[4];
+    unsigned int status;
+    unsigned int total;
 };
 struct recv_socket_reply
 {
@@ -2878,6 +2962,33 @@ struct register_async_reply
 
 
 
+struct register_file_async_request
+{
+    struct request_header __header;
+    int          type;
+    async_data_t async;
+};
+struct register_file_async_reply
+{
+    struct reply_header __header;
+};
+
+
+
+struct complete_async_request
+{
+    struct request_header __header;
+    unsigned int   status;
+    client_ptr_t   user;
+    apc_param_t    information;
+};
+struct complete_async_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct cancel_async_request
 {
     struct request_header __header;
@@ -3018,6 +3129,7 @@ struct create_named_pipe_reply
 #define NAMED_PIPE_MESSAGE_STREAM_WRITE 0x0001
 #define NAMED_PIPE_MESSAGE_STREAM_READ  0x0002
 #define NAMED_PIPE_NONBLOCKING_MODE     0x0004
+#define NAMED_PIPE_DIRECT_MODE          0x0008
 #define NAMED_PIPE_SERVER_END           0x8000
 
 
@@ -5032,6 +5144,28 @@ struct remove_completion_reply
 };
 
 
+struct completion_packet
+{
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    unsigned int  __pad;
+};
+
+
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(packets,completion_packets); */
+};
+
+
 
 struct query_completion_request
 {
@@ -5472,6 +5606,7 @@ enum request
     REQ_open_process,
     REQ_open_thread,
     REQ_select,
+    REQ_batch,
     REQ_create_event,
     REQ_event_op,
     REQ_query_event,
@@ -5485,6 +5620,9 @@ enum request
     REQ_create_semaphore,
     REQ_release_semaphore,
     REQ_query_semaphore,
+    REQ_get_fast_sync_shm,
+    REQ_get_fast_sync_obj,
+    REQ_fast_sync_wake,
     REQ_open_semaphore,
     REQ_create_file,
     REQ_open_file_object,
@@ -5564,6 +5702,8 @@ enum request
     REQ_get_serial_info,
     REQ_set_serial_info,
     REQ_register_async,
+    REQ_register_file_async,
+    REQ_complete_async,
     REQ_cancel_async,
     REQ_get_async_result,
     REQ_set_async_direct_result,
@@ -5691,6 +5831,7 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
@@ -5754,6 +5895,7 @@ union generic_request
     struct open_process_request open_process_request;
     struct open_thread_request open_thread_request;
     struct select_request select_request;
+    struct batch_request batch_request;
     struct create_event_request create_event_request;
     struct event_op_request event_op_request;
     struct query_event_request query_event_request;
@@ -5767,6 +5909,9 @@ union generic_request
     struct create_semaphore_request create_semaphore_request;
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
+    struct get_fast_sync_shm_request get_fast_sync_shm_request;
+    struct get_fast_sync_obj_request get_fast_sync_obj_request;
+    struct fast_sync_wake_request fast_sync_wake_request;
     struct open_semaphore_request open_semaphore_request;
     struct create_file_request create_file_request;
     struct open_file_object_request open_file_object_request;
@@ -5846,6 +5991,8 @@ union generic_request
     struct get_serial_info_request get_serial_info_request;
     struct set_serial_info_request set_serial_info_request;
     struct register_async_request register_async_request;
+    struct register_file_async_request register_file_async_request;
+    struct complete_async_request complete_async_request;
     struct cancel_async_request cancel_async_request;
     struct get_async_result_request get_async_result_request;
     struct set_async_direct_result_request set_async_direct_result_request;
@@ -5973,6 +6120,7 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
@@ -6034,6 +6182,7 @@ union generic_reply
     struct open_process_reply open_process_reply;
     struct open_thread_reply open_thread_reply;
     struct select_reply select_reply;
+    struct batch_reply batch_reply;
     struct create_event_reply create_event_reply;
     struct event_op_reply event_op_reply;
     struct query_event_reply query_event_reply;
@@ -6047,6 +6196,9 @@ union generic_reply
     struct create_semaphore_reply create_semaphore_reply;
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
+    struct get_fast_sync_shm_reply get_fast_sync_shm_reply;
+    struct get_fast_sync_obj_reply get_fast_sync_obj_reply;
+    struct fast_sync_wake_reply fast_sync_wake_reply;
     struct open_semaphore_reply open_semaphore_reply;
     struct create_file_reply create_file_reply;
     struct open_file_object_reply open_file_object_reply;
@@ -6126,6 +6278,8 @@ union generic_reply
     struct get_serial_info_reply get_serial_info_reply;
     struct set_serial_info_reply set_serial_info_reply;
     struct register_async_reply register_async_reply;
+    struct register_file_async_reply register_file_async_reply;
+    struct complete_async_reply complete_async_reply;
     struct cancel_async_reply cancel_async_reply;
     struct get_async_result_reply get_async_result_reply;
     struct set_async_direct_result_reply set_async_direct_result_reply;
@@ -6253,6 +6407,7 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
@@ -6284,7 +6439,7 @@ union generic_reply
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 746
+#define SERVER_PROTOCOL_VERSION 757
 
 /* ### protocol_version end ### */
 
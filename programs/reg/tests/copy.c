@@ -357,7 +357,7 @@ static void test_copy_value_order(void)
 
     run_reg_exe("reg export HKCU\\" KEY_BASE " file.reg /y", &r);
     ok(r == REG_EXIT_SUCCESS, "got exit code %ld, expected 0\n", r);
-    ok(compare_export("file.reg", value_order_test, TODO_REG_COMPARE), "compare_export() failed\n");
+    ok(compare_export("file.reg", value_order_test, 0), "compare_export() failed\n");
 }
 
 static void test_copy_hex_data(void)
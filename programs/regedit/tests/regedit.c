@@ -3637,15 +3637,15 @@ static void test_export(void)
     delete_key(hkey, "Subkey1");
     delete_key(hkey, "Subkey2");
 
-    /* Test the export order of registry values. Windows exports registry values
-     * in order of creation; Wine uses alphabetical order.
+    /* Test the export order of registry values. Registry values are exported
+     * in order of creation.
      */
     add_value(hkey, "Value 2", REG_SZ, "I was added first!", 19);
     add_value(hkey, "Value 1", REG_SZ, "I was added second!", 20);
     close_key(hkey);
 
     run_regedit_exe("regedit.exe /e file.reg HKEY_CURRENT_USER\\" KEY_BASE);
-    ok(compare_export("file.reg", value_order_test, TODO_REG_COMPARE), "compare_export() failed\n");
+    ok(compare_export("file.reg", value_order_test, 0), "compare_export() failed\n");
     delete_key(HKEY_CURRENT_USER, KEY_BASE);
 
     /* Test registry export with empty hex data */
@@ -642,7 +642,7 @@ static void iosb_destroy( struct object *obj )
 }
 
 /* allocate iosb struct */
-static struct iosb *create_iosb( const void *in_data, data_size_t in_size, data_size_t out_size )
+struct iosb *create_iosb( const void *in_data, data_size_t in_size, data_size_t out_size )
 {
     struct iosb *iosb;
 
@@ -754,6 +754,27 @@ DECL_HANDLER(get_async_result)
     set_error( iosb->status );
 }
 
+/* complete an async I/O performed by the client */
+DECL_HANDLER(complete_async)
+{
+    struct async *async;
+
+    LIST_FOR_EACH_ENTRY( async, &current->process->asyncs, struct async, process_entry )
+    {
+        if (async->data.user != req->user) continue;
+        /* if it was canceled, the result is reported by the client callback instead */
+        if (async->terminated)
+        {
+            set_error( STATUS_CANCELLED );
+            return;
+        }
+        async->terminated = 1;
+        async_set_result( &async->obj, req->status, req->information );
+        return;
+    }
+    set_error( STATUS_INVALID_PARAMETER );
+}
+
 /* notify direct completion of async and close the wait handle if not blocking */
 DECL_HANDLER(set_async_direct_result)
 {
@@ -56,21 +56,27 @@ struct event
     struct list    kernel_object;   /* list of kernel object pointers */
     int            manual_reset;    /* is it a manual reset event? */
     int            signaled;        /* event has been signaled */
+    struct fast_sync_object *fast;  /* state shared with the clients, if any */
+    int            reserved;        /* auto-reset state taken from the shared memory by a server wait */
+    int            pulsing;         /* signaled for the server waiters during a pulse */
 };
 
 static void event_dump( struct object *obj, int verbose );
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static int event_signal( struct object *obj, unsigned int access);
 static struct list *event_get_kernel_obj_list( struct object *obj );
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     &event_type,               /* type */
     event_dump,                /* dump */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    event_add_queue,           /* add_queue */
+    event_remove_queue,        /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
     event_signal,              /* signal */
@@ -85,7 +91,7 @@ static const struct object_ops event_ops =
     no_open_file,              /* open_file */
     event_get_kernel_obj_list, /* get_kernel_obj_list */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -150,11 +156,58 @@ struct event *create_event( struct object *root, const struct unicode_str *name,
             list_init( &event->kernel_object );
             event->manual_reset = manual_reset;
             event->signaled     = initial_state;
+            event->reserved     = 0;
+            event->pulsing      = 0;
+            event->fast         = NULL;
+            /* named events may be opened by other processes, keep them in the server */
+            if (!name || !name->len)
+                event->fast = alloc_fast_sync_object( manual_reset ? FAST_SYNC_MANUAL_EVENT : FAST_SYNC_AUTO_EVENT,
+                                                      !!initial_state, 0 );
         }
     }
     return event;
 }
 
+struct fast_sync_object *get_event_fast_sync( struct object *obj )
+{
+    if (obj->ops != &event_ops) return NULL;
+    return ((struct event *)obj)->fast;
+}
+
+static int get_event_state( struct event *event )
+{
+    if (!event->fast) return event->signaled;
+    if (event->reserved) return 1;
+    return __atomic_load_n( &event->fast->state, __ATOMIC_SEQ_CST ) & FAST_SYNC_EVENT_SIGNALED;
+}
+
+static void set_event_state( struct event *event, int state )
+{
+    int cur;
+
+    if (!event->fast)
+    {
+        event->signaled = state;
+        return;
+    }
+    event->reserved = 0;
+    /* preserve the pulse count */
+    cur = __atomic_load_n( &event->fast->state, __ATOMIC_SEQ_CST );
+    while (!__atomic_compare_exchange_n( &event->fast->state, &cur,
+                                         (cur & ~FAST_SYNC_EVENT_SIGNALED) | (state ? FAST_SYNC_EVENT_SIGNALED : 0),
+                                         0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ));
+    if (state && !(cur & FAST_SYNC_EVENT_SIGNALED)) fast_sync_wake_clients( event->fast );
+}
+
+/* give back a reservation taken by a wait that ended up not being satisfied */
+void release_event_reservation( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+
+    if (obj->ops != &event_ops || !event->reserved) return;
+    set_event_state( event, 1 );
+}
+
 struct event *get_event_obj( struct process *process, obj_handle_t handle, unsigned int access )
 {
     return (struct event *)get_handle_obj( process, handle, access, &event_ops );
@@ -162,37 +215,91 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
 
 static void pulse_event( struct event *event )
 {
-    event->signaled = 1;
-    /* wake up all waiters if manual reset, a single one otherwise */
+    unsigned int cur, pulse;
+
+    if (!event->fast)
+    {
+        set_event_state( event, 1 );
+        /* wake up all waiters if manual reset, a single one otherwise */
+        wake_up( &event->obj, !event->manual_reset );
+        set_event_state( event, 0 );
+        return;
+    }
+
+    /* signal the server waiters without exposing the state to the clients */
+    event->pulsing = 1;
     wake_up( &event->obj, !event->manual_reset );
-    event->signaled = 0;
+    /* then the client waiters, unless a server wait consumed an auto-reset pulse */
+    pulse = event->pulsing || event->manual_reset;
+    event->pulsing = 0;
+    event->reserved = 0;
+    if (pulse && !event->manual_reset) __atomic_store_n( &event->fast->pulse, 1, __ATOMIC_SEQ_CST );
+    /* the clients see the pulse count change even if they were not woken in time */
+    cur = __atomic_load_n( &event->fast->state, __ATOMIC_SEQ_CST );
+    while (!__atomic_compare_exchange_n( &event->fast->state, (int *)&cur,
+                                         (cur & ~FAST_SYNC_EVENT_SIGNALED) + (pulse ? FAST_SYNC_EVENT_PULSE : 0),
+                                         0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ));
+    if (pulse) fast_sync_wake_clients( event->fast );
 }
 
 void set_event( struct event *event )
 {
-    event->signaled = 1;
+    set_event_state( event, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
 }
 
 void reset_event( struct event *event )
 {
-    event->signaled = 0;
+    set_event_state( event, 0 );
 }
 
 static void event_dump( struct object *obj, int verbose )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    fprintf( stderr, "Event manual=%d signaled=%d\n",
-             event->manual_reset, event->signaled );
+    fprintf( stderr, "Event manual=%d signaled=%d%s\n",
+             event->manual_reset, get_event_state( event ), event->fast ? " (shared)" : "" );
+}
+
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->fast) fast_sync_add_waiter( event->fast );
+    return add_queue( obj, entry );
+}
+
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    remove_queue( obj, entry );
+    if (event->fast) fast_sync_remove_waiter( event->fast );
 }
 
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
+    int cur;
+
     assert( obj->ops == &event_ops );
-    return event->signaled;
+    if (!event->fast) return event->signaled;
+    if (event->reserved || event->pulsing) return 1;
+    cur = __atomic_load_n( &event->fast->state, __ATOMIC_SEQ_CST );
+    if (event->manual_reset) return cur & FAST_SYNC_EVENT_SIGNALED;
+    /* take the state now so that no client thread can consume it before event_satisfied;
+     * check_wait() gives it back if the wait is not satisfied */
+    while (cur & FAST_SYNC_EVENT_SIGNALED)
+    {
+        if (__atomic_compare_exchange_n( &event->fast->state, &cur, cur & ~FAST_SYNC_EVENT_SIGNALED, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+        {
+            event->reserved = 1;
+            break;
+        }
+    }
+    return event->reserved;
 }
 
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry )
@@ -200,7 +307,10 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     /* Reset if it's an auto-reset event */
-    if (!event->manual_reset) event->signaled = 0;
+    if (event->manual_reset) return;
+    if (event->pulsing) event->pulsing = 0;
+    else if (event->fast) event->reserved = 0;
+    else event->signaled = 0;
 }
 
 static int event_signal( struct object *obj, unsigned int access )
@@ -223,6 +333,13 @@ static struct list *event_get_kernel_obj_list( struct object *obj )
     return &event->kernel_object;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->fast) free_fast_sync_object( event->fast );
+}
+
 struct keyed_event *create_keyed_event( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -316,7 +433,7 @@ DECL_HANDLER(event_op)
     struct event *event;
 
     if (!(event = get_event_obj( current->process, req->handle, EVENT_MODIFY_STATE ))) return;
-    reply->state = event->signaled;
+    reply->state = get_event_state( event );
     switch(req->op)
     {
     case PULSE_EVENT:
@@ -343,7 +460,7 @@ DECL_HANDLER(query_event)
     if (!(event = get_event_obj( current->process, req->handle, EVENT_QUERY_STATE ))) return;
 
     reply->manual_reset = event->manual_reset;
-    reply->state = event->signaled;
+    reply->state = get_event_state( event );
 
     release_object( event );
 }
@@ -0,0 +1,235 @@
+/*
+ * Synchronization object state shared with the clients
+ *
+ * Copyright 2022 The Wine Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Unnamed events and semaphores keep their state in a shared memory
+ * area instead of in the server object, so that the clients can set,
+ * reset and wait on them using futexes without a server round trip.
+ * The server remains the authority for waits involving several objects;
+ * it takes a reservation on the shared state when it finds the object
+ * signaled, and gives it back if the wait ends up not being satisfied.
+ *
+ * Entries are reused once the object is destroyed; the clients check the
+ * serial number against the one they cached along with the index.
+ *
+ * Sockets use an entry from a separate range to tell the clients whether
+ * reads have to go through the server, or can be done directly on the
+ * Unix socket; the entry is only allocated once a client asks for it.
+ *
+ * This is only enabled when WINEFASTSYNC is set in the server environment,
+ * since the mapping is writable by all the clients.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "handle.h"
+#include "thread.h"
+#include "request.h"
+
+#define FAST_SYNC_SHM_SIZE ((FAST_SYNC_MAX_OBJECTS + FAST_SYNC_MAX_SOCKETS) * sizeof(struct fast_sync_object))
+
+/* sockets have their own range of entries, so that they can't starve the other objects */
+struct fast_sync_pool
+{
+    unsigned int first;      /* index of the first entry */
+    unsigned int count;      /* number of entries */
+    unsigned int used;       /* entries ever handed out */
+    int          free_list;  /* free entries are linked through the next_free field */
+};
+
+static struct fast_sync_pool object_pool = { 0, FAST_SYNC_MAX_OBJECTS, 0, -1 };
+static struct fast_sync_pool socket_pool = { FAST_SYNC_MAX_OBJECTS, FAST_SYNC_MAX_SOCKETS, 0, -1 };
+
+static int fast_sync_enabled = -1;
+static int fast_sync_fd = -1;
+static struct fast_sync_object *fast_sync_objects;
+
+static int fast_sync_init(void)
+{
+#ifdef __linux__
+    static int failed;
+    void *ptr;
+
+    if (fast_sync_objects) return 1;
+    if (failed) return 0;
+    failed = 1;
+
+    if ((fast_sync_fd = create_temp_file( FAST_SYNC_SHM_SIZE )) == -1) return 0;
+    ptr = mmap( NULL, FAST_SYNC_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fast_sync_fd, 0 );
+    if (ptr == MAP_FAILED)
+    {
+        close( fast_sync_fd );
+        fast_sync_fd = -1;
+        return 0;
+    }
+    fast_sync_objects = ptr;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+static int fast_sync_allowed(void)
+{
+    const char *env;
+
+    if (fast_sync_enabled == -1)
+        fast_sync_enabled = (env = getenv( "WINEFASTSYNC" )) && atoi( env );
+    return fast_sync_enabled;
+}
+
+/* allocate an entry in the shared memory; returns NULL if not available */
+struct fast_sync_object *alloc_fast_sync_object( enum fast_sync_type type, int state, int max )
+{
+    struct fast_sync_pool *pool = type == FAST_SYNC_SOCKET ? &socket_pool : &object_pool;
+    struct fast_sync_object *fast;
+
+    if (!fast_sync_allowed() || !fast_sync_init()) return NULL;
+
+    if (pool->free_list != -1)
+    {
+        fast = &fast_sync_objects[pool->free_list];
+        pool->free_list = fast->next_free;
+    }
+    else if (pool->used < pool->count)
+        fast = &fast_sync_objects[pool->first + pool->used++];
+    else
+        return NULL;
+
+    fast->max = max;
+    fast->type = type;
+    fast->server_waiters = 0;
+    fast->pulse = 0;
+    fast->next_free = -1;
+    __atomic_store_n( &fast->state, state, __ATOMIC_SEQ_CST );
+    __atomic_add_fetch( &fast->serial, 1, __ATOMIC_SEQ_CST );
+    return fast;
+}
+
+/* release an entry; clients may still have it cached through a stale handle */
+void free_fast_sync_object( struct fast_sync_object *fast )
+{
+    unsigned int index = fast - fast_sync_objects;
+    struct fast_sync_pool *pool = index >= socket_pool.first ? &socket_pool : &object_pool;
+
+    __atomic_store_n( &fast->type, FAST_SYNC_NONE, __ATOMIC_SEQ_CST );
+    __atomic_add_fetch( &fast->serial, 1, __ATOMIC_SEQ_CST );
+    __atomic_store_n( &fast->state, 0, __ATOMIC_SEQ_CST );
+    /* let client waiters notice that the entry is gone */
+    fast_sync_wake_clients( fast );
+    fast->next_free = pool->free_list;
+    pool->free_list = index;
+}
+
+void fast_sync_add_waiter( struct fast_sync_object *fast )
+{
+    __atomic_add_fetch( &fast->server_waiters, 1, __ATOMIC_SEQ_CST );
+}
+
+void fast_sync_remove_waiter( struct fast_sync_object *fast )
+{
+    __atomic_sub_fetch( &fast->server_waiters, 1, __ATOMIC_SEQ_CST );
+}
+
+/* wake the client threads waiting on the futex */
+void fast_sync_wake_clients( struct fast_sync_object *fast )
+{
+#ifdef __linux__
+    /* the memory is shared between processes, so this can't be a private futex */
+    syscall( __NR_futex, &fast->state, 1 /* FUTEX_WAKE */, INT_MAX, NULL, 0, 0 );
+#endif
+}
+
+/* give back the state reserved by the objects of a wait-all that is not satisfied */
+void fast_sync_release_reservation( struct object *obj )
+{
+    release_event_reservation( obj );
+    release_semaphore_reservation( obj );
+}
+
+static struct fast_sync_object *get_fast_sync_object( struct object *obj )
+{
+    struct fast_sync_object *fast;
+
+    if ((fast = get_event_fast_sync( obj ))) return fast;
+    if ((fast = get_semaphore_fast_sync( obj ))) return fast;
+    return get_sock_fast_sync( obj );
+}
+
+/* retrieve the shared memory for in-process synchronization objects */
+DECL_HANDLER(get_fast_sync_shm)
+{
+    if (!fast_sync_allowed() || !fast_sync_init())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    reply->size = FAST_SYNC_SHM_SIZE;
+    send_client_fd( current->process, fast_sync_fd, 0 );
+}
+
+/* retrieve the in-process state of a synchronization object */
+DECL_HANDLER(get_fast_sync_obj)
+{
+    struct fast_sync_object *fast;
+    struct object *obj;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    if ((fast = get_fast_sync_object( obj )))
+    {
+        reply->index  = fast - fast_sync_objects;
+        reply->serial = fast->serial;
+        reply->type   = fast->type;
+        reply->access = get_handle_access( current->process, req->handle );
+    }
+    else reply->type = FAST_SYNC_NONE;
+
+    release_object( obj );
+}
+
+/* wake up the server-side waiters of an in-process synchronization object */
+DECL_HANDLER(fast_sync_wake)
+{
+    struct object *obj;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+    if (get_fast_sync_object( obj )) wake_up( obj, 0 );
+    else set_error( STATUS_OBJECT_TYPE_MISMATCH );
+    release_object( obj );
+}
@@ -1750,6 +1750,28 @@ struct fd *alloc_pseudo_fd( const struct fd_ops *fd_user_ops, struct object *use
     return fd;
 }
 
+/* attach a Unix fd to a pseudo-fd, closing the previous one, or detach it if unix_fd is -1;
+ * the fd object takes ownership of unix_fd, even on failure */
+int set_pseudo_fd_unix_fd( struct fd *fd, int unix_fd )
+{
+    assert( !fd->inode );
+
+    if (fd->poll_index != -1) remove_poll_user( fd, fd->poll_index );
+    fd->poll_index = -1;
+    if (fd->unix_fd != -1) close( fd->unix_fd );
+    fd->unix_fd = unix_fd;
+    if (unix_fd == -1) return 1;
+
+    if ((fd->poll_index = add_poll_user( fd )) == -1)
+    {
+        close( fd->unix_fd );
+        fd->unix_fd = -1;
+        set_error( STATUS_NO_MEMORY );
+        return 0;
+    }
+    return 1;
+}
+
 /* duplicate an fd object for a different user */
 struct fd *dup_fd_object( struct fd *orig, unsigned int access, unsigned int sharing, unsigned int options )
 {
@@ -2233,6 +2255,22 @@ void fd_async_wake_up( struct fd *fd, int type, unsigned int status )
     }
 }
 
+int fd_async_queued( struct fd *fd, int type )
+{
+    switch (type)
+    {
+    case ASYNC_TYPE_READ:
+        return async_queued( &fd->read_q );
+    case ASYNC_TYPE_WRITE:
+        return async_queued( &fd->write_q );
+    case ASYNC_TYPE_WAIT:
+        return async_queued( &fd->wait_q );
+    default:
+        assert(0);
+        return 0;
+    }
+}
+
 void fd_cancel_async( struct fd *fd, struct async *async )
 {
     fd->fd_ops->cancel_async( fd, async );
@@ -2895,6 +2933,27 @@ DECL_HANDLER(register_async)
     }
 }
 
+/* register an async I/O on a regular file that the client performs itself */
+DECL_HANDLER(register_file_async)
+{
+    unsigned int access = req->type == ASYNC_TYPE_WRITE ? FILE_WRITE_DATA : FILE_READ_DATA;
+    struct async *async;
+    struct fd *fd;
+
+    if ((fd = get_handle_fd_obj( current->process, req->async.handle, access )))
+    {
+        /* the async stays queued until the client completes it or it gets canceled */
+        if (!fd->inode || get_unix_fd( fd ) == -1) set_error( STATUS_OBJECT_TYPE_MISMATCH );
+        else if ((async = create_async( fd, current, &req->async, NULL )))
+        {
+            fd_queue_async( fd, async, ASYNC_TYPE_WAIT );
+            set_error( STATUS_PENDING );
+            release_object( async );
+        }
+        release_object( fd );
+    }
+}
+
 /* attach completion object to a fd */
 DECL_HANDLER(set_completion_info)
 {
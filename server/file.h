@@ -93,6 +93,7 @@ extern void set_fd_user( struct fd *fd, const struct fd_ops *ops, struct object
 extern unsigned int get_fd_options( struct fd *fd );
 extern unsigned int get_fd_comp_flags( struct fd *fd );
 extern int is_fd_overlapped( struct fd *fd );
+extern int set_pseudo_fd_unix_fd( struct fd *fd, int unix_fd );
 extern int get_unix_fd( struct fd *fd );
 extern int is_same_file_fd( struct fd *fd1, struct fd *fd2 );
 extern int is_fd_removable( struct fd *fd );
@@ -111,6 +112,7 @@ extern void default_poll_event( struct fd *fd, int event );
 extern void fd_cancel_async( struct fd *fd, struct async *async );
 extern void fd_queue_async( struct fd *fd, struct async *async, int type );
 extern void fd_async_wake_up( struct fd *fd, int type, unsigned int status );
+extern int fd_async_queued( struct fd *fd, int type );
 extern void fd_reselect_async( struct fd *fd, struct async_queue *queue );
 extern void no_fd_read( struct fd *fd, struct async *async, file_pos_t pos );
 extern void no_fd_write( struct fd *fd, struct async *async, file_pos_t pos );
@@ -173,6 +175,7 @@ extern int is_file_executable( const char *name );
 struct memory_view;
 
 extern int grow_file( int unix_fd, file_pos_t new_size );
+extern int create_temp_file( file_pos_t size );
 extern struct memory_view *find_mapped_view( struct process *process, client_ptr_t base );
 extern struct memory_view *get_exe_view( struct process *process );
 extern struct file *get_view_file( const struct memory_view *view, unsigned int access, unsigned int sharing );
@@ -241,6 +244,7 @@ extern void async_request_complete_alloc( struct async *async, unsigned int stat
 extern void async_wake_up( struct async_queue *queue, unsigned int status );
 extern struct completion *fd_get_completion( struct fd *fd, apc_param_t *p_key );
 extern void fd_copy_completion( struct fd *src, struct fd *dst );
+extern struct iosb *create_iosb( const void *in_data, data_size_t in_size, data_size_t out_size );
 extern struct iosb *async_get_iosb( struct async *async );
 extern struct thread *async_get_thread( struct async *async );
 extern struct async *find_pending_async( struct async_queue *queue );
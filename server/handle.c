@@ -45,6 +45,18 @@ struct handle_entry
     unsigned int   access;    /* access rights */
 };
 
+/* entries are allocated in pages that never move, so growing the table
+ * only requires reallocating the array of page pointers */
+#define HANDLE_PAGE_SHIFT   8
+#define HANDLE_PAGE_SIZE    (1 << HANDLE_PAGE_SHIFT)
+#define HANDLE_PAGE_MASK    (HANDLE_PAGE_SIZE - 1)
+
+struct handle_page
+{
+    unsigned int         used;        /* number of used entries in the page */
+    struct handle_entry  entries[HANDLE_PAGE_SIZE];
+};
+
 struct handle_table
 {
     struct object        obj;         /* object header */
@@ -52,7 +64,8 @@ struct handle_table
     int                  count;       /* number of allocated entries */
     int                  last;        /* last used entry */
     int                  free;        /* first entry that may be free */
-    struct handle_entry *entries;     /* handle entries */
+    int                  pages_size;  /* size of the pages array */
+    struct handle_page **pages;       /* pages of handle entries */
 };
 
 static struct handle_table *global_table;
@@ -63,8 +76,8 @@ static struct handle_table *global_table;
 #define RESERVED_CLOSE_PROTECT (HANDLE_FLAG_PROTECT_FROM_CLOSE << RESERVED_SHIFT)
 #define RESERVED_ALL           (RESERVED_INHERIT | RESERVED_CLOSE_PROTECT)
 
-#define MIN_HANDLE_ENTRIES  32
 #define MAX_HANDLE_ENTRIES  0x00ffffff
+#define MAX_HANDLE_PAGES    (MAX_HANDLE_ENTRIES / HANDLE_PAGE_SIZE)
 
 
 /* handle to table index conversion */
@@ -79,6 +92,15 @@ static inline int handle_to_index( obj_handle_t handle )
     return (handle >> 2) - 1;
 }
 
+static inline struct handle_page *get_page( struct handle_table *table, int index )
+{
+    return table->pages[index >> HANDLE_PAGE_SHIFT];
+}
+static inline struct handle_entry *get_entry( struct handle_table *table, int index )
+{
+    return &get_page( table, index )->entries[index & HANDLE_PAGE_MASK];
+}
+
 /* global handle conversion */
 
 #define HANDLE_OBFUSCATOR 0x544a4def
@@ -154,9 +176,9 @@ static void handle_table_dump( struct object *obj, int verbose )
     fprintf( stderr, "Handle table last=%d count=%d process=%p\n",
              table->last, table->count, table->process );
     if (!verbose) return;
-    entry = table->entries;
-    for (i = 0; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
+        entry = get_entry( table, i );
         if (!entry->ptr) continue;
         fprintf( stderr, "    %04x: %p %08x ",
                  index_to_handle(i), entry->ptr, entry->access );
@@ -174,9 +196,12 @@ static void handle_table_destroy( struct object *obj )
 
     assert( obj->ops == &handle_table_ops );
 
-    for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
-        struct object *obj = entry->ptr;
+        struct object *obj;
+
+        entry = get_entry( table, i );
+        obj = entry->ptr;
         entry->ptr = NULL;
         if (obj)
         {
@@ -185,7 +210,8 @@ static void handle_table_destroy( struct object *obj )
             release_object_from_handle( obj );
         }
     }
-    free( table->entries );
+    for (i = 0; i < table->count / HANDLE_PAGE_SIZE; i++) free( table->pages[i] );
+    free( table->pages );
 }
 
 /* close all the process handles and free the handle table */
@@ -197,55 +223,86 @@ void close_process_handles( struct process *process )
     if (table) release_object( table );
 }
 
+/* add a page of entries at the end of the table */
+static int add_handle_page( struct handle_table *table )
+{
+    int index = table->count / HANDLE_PAGE_SIZE;
+
+    if (index >= MAX_HANDLE_PAGES) return 0;
+    if (index == table->pages_size)
+    {
+        int size = max( table->pages_size * 2, 4 );
+        struct handle_page **new_pages = realloc( table->pages, size * sizeof(*new_pages) );
+
+        if (!new_pages) return 0;
+        table->pages = new_pages;
+        table->pages_size = size;
+    }
+    if (!(table->pages[index] = calloc( 1, sizeof(struct handle_page) ))) return 0;
+    table->count += HANDLE_PAGE_SIZE;
+    return 1;
+}
+
 /* allocate a new handle table */
 struct handle_table *alloc_handle_table( struct process *process, int count )
 {
     struct handle_table *table;
 
-    if (count < MIN_HANDLE_ENTRIES) count = MIN_HANDLE_ENTRIES;
     if (!(table = alloc_object( &handle_table_ops )))
         return NULL;
-    table->process = process;
-    table->count   = count;
-    table->last    = -1;
-    table->free    = 0;
-    if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
-    release_object( table );
-    return NULL;
+    table->process    = process;
+    table->count      = 0;
+    table->last       = -1;
+    table->free       = 0;
+    table->pages_size = 0;
+    table->pages      = NULL;
+    do
+    {
+        if (!add_handle_page( table ))
+        {
+            set_error( STATUS_NO_MEMORY );
+            release_object( table );
+            return NULL;
+        }
+    } while (table->count < count);
+    return table;
 }
 
 /* grow a handle table */
 static int grow_handle_table( struct handle_table *table )
 {
-    struct handle_entry *new_entries;
-    int count = min( table->count * 2, MAX_HANDLE_ENTRIES );
-
-    if (count == table->count ||
-        !(new_entries = realloc( table->entries, count * sizeof(struct handle_entry) )))
+    if (!add_handle_page( table ))
     {
         set_error( STATUS_INSUFFICIENT_RESOURCES );
         return 0;
     }
-    table->entries = new_entries;
-    table->count   = count;
     return 1;
 }
 
 /* allocate the first free entry in the handle table */
 static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned int access )
 {
-    struct handle_entry *entry = table->entries + table->free;
-    int i;
+    struct handle_page *page;
+    struct handle_entry *entry;
+    int i = table->free;
 
-    for (i = table->free; i <= table->last; i++, entry++) if (!entry->ptr) goto found;
-    if (i >= table->count)
+    while (i <= table->last)
     {
-        if (!grow_handle_table( table )) return 0;
-        entry = table->entries + i;  /* the entries may have moved */
+        page = get_page( table, i );
+        if (page->used == HANDLE_PAGE_SIZE)  /* skip full pages */
+            i = (i | HANDLE_PAGE_MASK) + 1;
+        else if (!page->entries[i & HANDLE_PAGE_MASK].ptr)
+            goto found;
+        else
+            i++;
     }
+    if (i >= table->count && !grow_handle_table( table )) return 0;
     table->last = i;
  found:
     table->free = i + 1;
+    page = get_page( table, i );
+    page->used++;
+    entry = &page->entries[i & HANDLE_PAGE_MASK];
     entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
     return index_to_handle(i);
@@ -326,7 +383,7 @@ static struct handle_entry *get_handle( struct process *process, obj_handle_t ha
     index = handle_to_index( handle );
     if (index < 0) return NULL;
     if (index > table->last) return NULL;
-    entry = table->entries + index;
+    entry = get_entry( table, index );
     if (!entry->ptr) return NULL;
     return entry;
 }
@@ -334,22 +391,23 @@ static struct handle_entry *get_handle( struct process *process, obj_handle_t ha
 /* attempt to shrink a table */
 static void shrink_handle_table( struct handle_table *table )
 {
-    struct handle_entry *entry = table->entries + table->last;
-    struct handle_entry *new_entries;
-    int count = table->count;
+    struct handle_page *page;
+    int pages;
 
     while (table->last >= 0)
     {
-        if (entry->ptr) break;
-        table->last--;
-        entry--;
+        page = get_page( table, table->last );
+        if (!page->used) table->last = (table->last & ~HANDLE_PAGE_MASK) - 1;
+        else if (!page->entries[table->last & HANDLE_PAGE_MASK].ptr) table->last--;
+        else break;
+    }
+    /* keep a spare page to avoid freeing and reallocating it repeatedly */
+    pages = (table->last + HANDLE_PAGE_SIZE) / HANDLE_PAGE_SIZE + 1;
+    while (table->count > pages * HANDLE_PAGE_SIZE)
+    {
+        table->count -= HANDLE_PAGE_SIZE;
+        free( table->pages[table->count / HANDLE_PAGE_SIZE] );
     }
-    if (table->last >= count / 4) return;  /* no need to shrink */
-    if (count < MIN_HANDLE_ENTRIES * 2) return;  /* too small to shrink */
-    count /= 2;
-    if (!(new_entries = realloc( table->entries, count * sizeof(*new_entries) ))) return;
-    table->count   = count;
-    table->entries = new_entries;
 }
 
 static void inherit_handle( struct process *parent, const obj_handle_t handle, struct handle_table *table )
@@ -357,14 +415,15 @@ static void inherit_handle( struct process *parent, const obj_handle_t handle, s
     struct handle_entry *dst, *src;
     int index;
 
-    dst = table->entries;
-
     src = get_handle( parent, handle );
     if (!src || !(src->access & RESERVED_INHERIT)) return;
     index = handle_to_index( handle );
-    if (dst[index].ptr) return;
+    if (index >= table->count) return;
+    dst = get_entry( table, index );
+    if (dst->ptr) return;
     grab_object_for_handle( src->ptr );
-    dst[index] = *src;
+    *dst = *src;
+    get_page( table, index )->used++;
     table->last = max( table->last, index );
 }
 
@@ -386,8 +445,6 @@ struct handle_table *copy_handle_table( struct process *process, struct process
 
     if (handles)
     {
-        memset( table->entries, 0, parent_table->count * sizeof(*table->entries) );
-
         for (i = 0; i < handle_count; i++)
         {
             inherit_handle( parent, handles[i], table );
@@ -400,16 +457,15 @@ struct handle_table *copy_handle_table( struct process *process, struct process
     }
     else
     {
-        if ((table->last = parent_table->last) >= 0)
+        table->last = parent_table->last;
+        for (i = 0; i <= table->last; i++)
         {
-            struct handle_entry *ptr = table->entries;
-            memcpy( ptr, parent_table->entries, (table->last + 1) * sizeof(struct handle_entry) );
-            for (i = 0; i <= table->last; i++, ptr++)
-            {
-                if (!ptr->ptr) continue;
-                if (ptr->access & RESERVED_INHERIT) grab_object_for_handle( ptr->ptr );
-                else ptr->ptr = NULL; /* don't inherit this entry */
-            }
+            struct handle_entry *ptr = get_entry( parent_table, i );
+
+            if (!ptr->ptr || !(ptr->access & RESERVED_INHERIT)) continue; /* don't inherit this entry */
+            *get_entry( table, i ) = *ptr;
+            grab_object_for_handle( ptr->ptr );
+            get_page( table, i )->used++;
         }
     }
     /* attempt to shrink the table */
@@ -423,15 +479,26 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     struct handle_table *table;
     struct handle_entry *entry;
     struct object *obj;
+    int index;
 
     if (!(entry = get_handle( process, handle ))) return STATUS_INVALID_HANDLE;
     if (entry->access & RESERVED_CLOSE_PROTECT) return STATUS_HANDLE_NOT_CLOSABLE;
     obj = entry->ptr;
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
     entry->ptr = NULL;
-    table = handle_is_global(handle) ? global_table : process->handles;
-    if (entry < table->entries + table->free) table->free = entry - table->entries;
-    if (entry == table->entries + table->last) shrink_handle_table( table );
+    if (handle_is_global(handle))
+    {
+        table = global_table;
+        index = handle_to_index( handle_global_to_local(handle) );
+    }
+    else
+    {
+        table = process->handles;
+        index = handle_to_index( handle );
+    }
+    get_page( table, index )->used--;
+    if (index < table->free) table->free = index;
+    if (index == table->last) shrink_handle_table( table );
     release_object_from_handle( obj );
     return STATUS_SUCCESS;
 }
@@ -511,8 +578,9 @@ obj_handle_t find_inherited_handle( struct process *process, const struct object
 
     if (!table) return 0;
 
-    for (i = 0, ptr = table->entries; i <= table->last; i++, ptr++)
+    for (i = 0; i <= table->last; i++)
     {
+        ptr = get_entry( table, i );
         if (!ptr->ptr) continue;
         if (ptr->ptr->ops != ops) continue;
         if (ptr->access & RESERVED_INHERIT) return index_to_handle(i);
@@ -823,8 +891,9 @@ static int enum_handles( struct process *process, void *user )
     if (!table)
         return 0;
 
-    for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
+        entry = get_entry( table, i );
         if (!entry->ptr) continue;
         if (!info->handle)
         {
@@ -39,6 +39,7 @@
 int debug_level = 0;
 int foreground = 0;
 timeout_t master_socket_timeout = 3 * -TICKS_PER_SEC;  /* master socket timeout, default is 3 seconds */
+unsigned int request_stats_interval = 0;  /* interval between request stats dumps, in seconds */
 const char *server_argv0;
 
 /* parse-line args */
@@ -52,6 +53,7 @@ static void usage( FILE *fh )
     fprintf(fh, "   -h,    --help            display this help message\n");
     fprintf(fh, "   -k[n], --kill[=n]        kill the current wineserver, optionally with signal n\n");
     fprintf(fh, "   -p[n], --persistent[=n]  make server persistent, optionally for n seconds\n");
+    fprintf(fh, "   -s[n], --stats[=n]       print request throughput every n seconds (default 10)\n");
     fprintf(fh, "   -v,    --version         display version information and exit\n");
     fprintf(fh, "   -w,    --wait            wait until the current wineserver terminates\n");
     fprintf(fh, "\n");
@@ -88,6 +90,12 @@ static void option_callback( int optc, char *optarg )
         else
             master_socket_timeout = TIMEOUT_INFINITE;
         break;
+    case 's':
+        if (optarg && isdigit(*optarg))
+            request_stats_interval = atoi( optarg );
+        else
+            request_stats_interval = 10;
+        break;
     case 'v':
         fprintf( stderr, "%s\n", PACKAGE_STRING );
         exit(0);
@@ -112,6 +120,7 @@ static struct long_option
     {"help",        0, 'h'},
     {"kill",        2, 'k'},
     {"persistent",  2, 'p'},
+    {"stats",       2, 's'},
     {"version",     0, 'v'},
     {"wait",        0, 'w'},
     { NULL }
@@ -216,7 +225,7 @@ int main( int argc, char *argv[] )
 {
     setvbuf( stderr, NULL, _IOLBF, 0 );
     server_argv0 = argv[0];
-    parse_options( argc, argv, "d::fhk::p::vw", long_options, option_callback );
+    parse_options( argc, argv, "d::fhk::p::s::vw", long_options, option_callback );
 
     /* setup temporary handlers before the real signal initialization is done */
     signal( SIGPIPE, SIG_IGN );
@@ -234,6 +243,7 @@ int main( int argc, char *argv[] )
     init_signals();
     init_directories( load_intl_file() );
     init_registry();
+    init_request_stats();
     main_loop();
     return 0;
 }
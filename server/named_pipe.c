@@ -23,11 +23,18 @@
 #include "config.h"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_SYS_FILIO_H
+# include <sys/filio.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -66,6 +73,8 @@ struct pipe_end
     struct list          message_queue;
     struct async_queue   read_q;     /* read queue */
     struct async_queue   write_q;    /* write queue */
+    int                  direct;     /* a socket of a socket pair is attached to the fd */
+    int                  direct_read;/* data from the other end comes through the socket */
 };
 
 struct pipe_server
@@ -80,6 +89,7 @@ struct named_pipe
 {
     struct object       obj;         /* object header */
     int                 message_mode;
+    int                 direct_mode; /* byte mode data may go through a socket pair */
     unsigned int        sharing;
     unsigned int        maxinstances;
     unsigned int        outsize;
@@ -147,6 +157,7 @@ static void pipe_end_read( struct fd *fd, struct async *async, file_pos_t pos );
 static void pipe_end_write( struct fd *fd, struct async *async_data, file_pos_t pos );
 static void pipe_end_flush( struct fd *fd, struct async *async );
 static void pipe_end_get_volume_info( struct fd *fd, struct async *async, unsigned int info_class );
+static void pipe_end_queue_async( struct fd *fd, struct async *async, int type, int count );
 static void pipe_end_reselect_async( struct fd *fd, struct async_queue *queue );
 static void pipe_end_get_file_info( struct fd *fd, obj_handle_t handle, unsigned int info_class );
 
@@ -195,7 +206,7 @@ static const struct fd_ops pipe_server_fd_ops =
     pipe_end_get_volume_info,     /* get_volume_info */
     pipe_server_ioctl,            /* ioctl */
     default_fd_cancel_async,      /* cancel_async */
-    no_fd_queue_async,            /* queue_async */
+    pipe_end_queue_async,         /* queue_async */
     pipe_end_reselect_async       /* reselect_async */
 };
 
@@ -239,7 +250,7 @@ static const struct fd_ops pipe_client_fd_ops =
     pipe_end_get_volume_info,     /* get_volume_info */
     pipe_client_ioctl,            /* ioctl */
     default_fd_cancel_async,      /* cancel_async */
-    no_fd_queue_async,            /* queue_async */
+    pipe_end_queue_async,         /* queue_async */
     pipe_end_reselect_async       /* reselect_async */
 };
 
@@ -404,6 +415,131 @@ static void free_message( struct pipe_message *message )
     free( message );
 }
 
+/* Byte mode pipes can pass their data through a Unix socket pair instead of
+ * the server message queues when WINEDIRECTPIPES is set in the server
+ * environment, or in the environment of the process creating the pipe. The
+ * sockets are attached to the pipe end fds, so that the clients read and
+ * write them directly; the server only keeps track of the connection state. */
+static int direct_pipes_enabled(void)
+{
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        const char *env = getenv( "WINEDIRECTPIPES" );
+        enabled = env && atoi( env );
+    }
+    return enabled;
+}
+
+/* set up the socket pair once a byte mode pipe got connected */
+static void pipe_end_connect_direct( struct pipe_end *server, struct pipe_end *client )
+{
+    int fds[2];
+
+    if (server->pipe->message_mode) return;
+    if (!server->pipe->direct_mode && !direct_pipes_enabled()) return;
+    if ((server->flags | client->flags) & (NAMED_PIPE_NONBLOCKING_MODE | NAMED_PIPE_MESSAGE_STREAM_READ))
+        return;
+
+    if (socketpair( PF_UNIX, SOCK_STREAM, 0, fds ) == -1) return;
+    fcntl( fds[0], F_SETFL, O_NONBLOCK );
+    fcntl( fds[1], F_SETFL, O_NONBLOCK );
+
+    if (!set_pseudo_fd_unix_fd( server->fd, fds[0] ))
+    {
+        close( fds[1] );
+        clear_error();
+        return;
+    }
+    if (!set_pseudo_fd_unix_fd( client->fd, fds[1] ))
+    {
+        set_pseudo_fd_unix_fd( server->fd, -1 );
+        clear_error();
+        return;
+    }
+    server->direct = client->direct = 1;
+    server->direct_read = client->direct_read = 1;
+}
+
+/* detach the socket of a direct pipe end; pending direct I/O is terminated with the given status */
+static void pipe_end_stop_direct( struct pipe_end *pipe_end, unsigned int status )
+{
+    if (!pipe_end->direct) return;
+
+    pipe_end->direct = pipe_end->direct_read = 0;
+    shutdown( get_unix_fd( pipe_end->fd ), SHUT_RDWR );
+    set_pseudo_fd_unix_fd( pipe_end->fd, -1 );
+    fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_READ, status );
+    fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WRITE, status );
+}
+
+/* amount of data waiting to be read from the socket of a direct pipe end */
+static data_size_t pipe_end_socket_avail( struct pipe_end *pipe_end )
+{
+    int avail;
+
+    if (ioctl( get_unix_fd( pipe_end->fd ), FIONREAD, &avail ) == -1 || avail < 0) return 0;
+    return avail;
+}
+
+/* move the data still buffered in the socket of a direct pipe end to its message queue */
+static void pipe_end_drain_socket( struct pipe_end *pipe_end )
+{
+    data_size_t avail = pipe_end_socket_avail( pipe_end );
+    struct iosb *iosb;
+    ssize_t size;
+    void *data;
+
+    if (!avail || !(data = mem_alloc( avail ))) return;
+    if ((size = recv( get_unix_fd( pipe_end->fd ), data, avail, MSG_DONTWAIT )) > 0 &&
+        (iosb = create_iosb( data, size, 0 )))
+    {
+        queue_message( pipe_end, iosb );
+        release_object( iosb );
+    }
+    free( data );
+}
+
+/* whether the clients have I/O queued on the sockets carrying the data to a direct pipe end;
+ * the server can't move that I/O to the message queue */
+static int pipe_end_direct_read_busy( struct pipe_end *pipe_end )
+{
+    return fd_async_queued( pipe_end->fd, ASYNC_TYPE_READ ) ||
+           (pipe_end->connection && fd_async_queued( pipe_end->connection->fd, ASYNC_TYPE_WRITE ));
+}
+
+/* make the data sent to a direct pipe end go through its message queue from now on; the other
+ * end gets EPIPE from its socket, and its client then writes the rest through the server */
+static void pipe_end_undirect_read( struct pipe_end *pipe_end )
+{
+    struct pipe_end *connection = pipe_end->connection;
+
+    if (!pipe_end->direct_read) return;
+
+    if (connection) shutdown( get_unix_fd( connection->fd ), SHUT_WR );
+    pipe_end->direct_read = 0;
+    pipe_end_drain_socket( pipe_end );
+}
+
+/* there is no notification when the other end reads from its socket, so a flush moves the
+ * unread data to the message queue of the other end, where reading it wakes the flush */
+static void pipe_end_check_flush( struct pipe_end *pipe_end )
+{
+    struct pipe_end *connection = pipe_end->connection;
+
+    if (!connection || !connection->direct_read || !fd_async_queued( pipe_end->fd, ASYNC_TYPE_WAIT ))
+        return;
+
+    if (pipe_end_socket_avail( connection ))
+    {
+        if (pipe_end_direct_read_busy( connection )) return;  /* retried once the I/O is done */
+        pipe_end_undirect_read( connection );
+        if (!list_empty( &connection->message_queue )) return;
+    }
+    fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WAIT, STATUS_SUCCESS );
+}
+
 static void pipe_end_disconnect( struct pipe_end *pipe_end, unsigned int status )
 {
     struct pipe_end *connection = pipe_end->connection;
@@ -415,6 +551,7 @@ static void pipe_end_disconnect( struct pipe_end *pipe_end, unsigned int status
     pipe_end->state = status == STATUS_PIPE_DISCONNECTED
         ? FILE_PIPE_DISCONNECTED_STATE : FILE_PIPE_CLOSING_STATE;
     fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WAIT, status );
+    if (status == STATUS_PIPE_DISCONNECTED) pipe_end_stop_direct( pipe_end, status );
     async_wake_up( &pipe_end->read_q, status );
     LIST_FOR_EACH_ENTRY_SAFE( message, next, &pipe_end->message_queue, struct pipe_message, entry )
     {
@@ -438,6 +575,8 @@ static void pipe_end_destroy( struct object *obj )
     struct pipe_end *pipe_end = (struct pipe_end *)obj;
     struct pipe_message *message;
 
+    /* the other end keeps its socket, and reads the remaining data before getting EOF */
+    pipe_end_stop_direct( pipe_end, STATUS_PIPE_BROKEN );
     pipe_end_disconnect( pipe_end, STATUS_PIPE_BROKEN );
 
     while (!list_empty( &pipe_end->message_queue ))
@@ -591,7 +730,14 @@ static void pipe_end_flush( struct fd *fd, struct async *async )
         return;
     }
 
-    if (pipe_end->connection && !list_empty( &pipe_end->connection->message_queue ))
+    if (pipe_end->connection && pipe_end->connection->direct_read)
+    {
+        if (!pipe_end_socket_avail( pipe_end->connection )) return;
+        fd_queue_async( pipe_end->fd, async, ASYNC_TYPE_WAIT );
+        pipe_end_check_flush( pipe_end );
+        set_error( STATUS_PENDING );
+    }
+    else if (pipe_end->connection && !list_empty( &pipe_end->connection->message_queue ))
     {
         fd_queue_async( pipe_end->fd, async, ASYNC_TYPE_WAIT );
         set_error( STATUS_PENDING );
@@ -709,7 +855,8 @@ static void pipe_end_get_file_info( struct fd *fd, obj_handle_t handle, unsigned
             pipe_info->CurrentInstances    = pipe->instances;
             pipe_info->InboundQuota        = pipe->insize;
 
-            LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
+            if (pipe_end->direct_read) avail = pipe_end_socket_avail( pipe_end );
+            else LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
                 avail += message->iosb->in_size - message->read_pos;
             pipe_info->ReadDataAvailable   = avail;
 
@@ -905,6 +1052,14 @@ static void pipe_end_read( struct fd *fd, struct async *async, file_pos_t pos )
 {
     struct pipe_end *pipe_end = get_fd_user( fd );
 
+    /* the client reads the socket of a direct pipe end itself, it must have used a stale one */
+    if (pipe_end->direct_read &&
+        (pipe_end->state != FILE_PIPE_CLOSING_STATE || pipe_end_socket_avail( pipe_end )))
+    {
+        set_error( STATUS_RETRY );
+        return;
+    }
+
     switch (pipe_end->state)
     {
     case FILE_PIPE_CONNECTED_STATE:
@@ -952,6 +1107,12 @@ static void pipe_end_write( struct fd *fd, struct async *async, file_pos_t pos )
         return;
     }
 
+    if (pipe_end->connection->direct_read)
+    {
+        set_error( STATUS_RETRY );  /* the client writes to the socket itself */
+        return;
+    }
+
     if (!pipe_end->pipe->message_mode && !get_req_data_size()) return;
 
     iosb = async_get_iosb( async );
@@ -965,6 +1126,18 @@ static void pipe_end_write( struct fd *fd, struct async *async, file_pos_t pos )
     set_error( STATUS_PENDING );
 }
 
+static void pipe_end_queue_async( struct fd *fd, struct async *async, int type, int count )
+{
+    struct pipe_end *pipe_end = get_fd_user( fd );
+
+    if (!pipe_end->direct) no_fd_queue_async( fd, async, type, count );
+    /* the socket was shut down for that direction, the client has to go through the server */
+    else if ((type == ASYNC_TYPE_READ && !pipe_end->direct_read) ||
+             (type == ASYNC_TYPE_WRITE && (!pipe_end->connection || !pipe_end->connection->direct_read)))
+        set_error( STATUS_RETRY );
+    else default_fd_queue_async( fd, async, type, count );
+}
+
 static void pipe_end_reselect_async( struct fd *fd, struct async_queue *queue )
 {
     struct pipe_end *pipe_end = get_fd_user( fd );
@@ -975,6 +1148,13 @@ static void pipe_end_reselect_async( struct fd *fd, struct async_queue *queue )
         reselect_write_queue( pipe_end );
     else if (&pipe_end->read_q == queue)
         reselect_read_queue( pipe_end, 0 );
+    else if (pipe_end->direct)
+    {
+        default_fd_reselect_async( fd, queue );
+        /* client I/O in the way of a flush may be done */
+        pipe_end_check_flush( pipe_end );
+        if (pipe_end->connection) pipe_end_check_flush( pipe_end->connection );
+    }
 }
 
 static enum server_fd_type pipe_end_get_fd_type( struct fd *fd )
@@ -989,6 +1169,7 @@ static void pipe_end_peek( struct pipe_end *pipe_end )
     struct pipe_message *message;
     data_size_t avail = 0;
     data_size_t message_length = 0;
+    char *data = NULL;
 
     if (reply_size < offsetof( FILE_PIPE_PEEK_BUFFER, Data ))
     {
@@ -997,12 +1178,14 @@ static void pipe_end_peek( struct pipe_end *pipe_end )
     }
     reply_size -= offsetof( FILE_PIPE_PEEK_BUFFER, Data );
 
+    if (pipe_end->direct_read) avail = pipe_end_socket_avail( pipe_end );
+
     switch (pipe_end->state)
     {
     case FILE_PIPE_CONNECTED_STATE:
         break;
     case FILE_PIPE_CLOSING_STATE:
-        if (!list_empty( &pipe_end->message_queue )) break;
+        if (avail || !list_empty( &pipe_end->message_queue )) break;
         set_error( STATUS_PIPE_BROKEN );
         return;
     default:
@@ -1014,6 +1197,15 @@ static void pipe_end_peek( struct pipe_end *pipe_end )
         avail += message->iosb->in_size - message->read_pos;
     reply_size = min( reply_size, avail );
 
+    if (pipe_end->direct_read && reply_size)
+    {
+        ssize_t size;
+
+        if (!(data = mem_alloc( reply_size ))) return;
+        size = recv( get_unix_fd( pipe_end->fd ), data, reply_size, MSG_PEEK | MSG_DONTWAIT );
+        reply_size = max( size, 0 );
+    }
+
     if (avail && pipe_end->pipe->message_mode)
     {
         message = LIST_ENTRY( list_head(&pipe_end->message_queue), struct pipe_message, entry );
@@ -1021,13 +1213,22 @@ static void pipe_end_peek( struct pipe_end *pipe_end )
         reply_size = min( reply_size, message_length );
     }
 
-    if (!(buffer = set_reply_data_size( offsetof( FILE_PIPE_PEEK_BUFFER, Data[reply_size] )))) return;
+    if (!(buffer = set_reply_data_size( offsetof( FILE_PIPE_PEEK_BUFFER, Data[reply_size] ))))
+    {
+        free( data );
+        return;
+    }
     buffer->NamedPipeState    = pipe_end->state;
     buffer->ReadDataAvailable = avail;
     buffer->NumberOfMessages  = 0;  /* FIXME */
     buffer->MessageLength     = message_length;
 
-    if (reply_size)
+    if (data)
+    {
+        memcpy( buffer->Data, data, reply_size );
+        free( data );
+    }
+    else if (reply_size)
     {
         data_size_t write_pos = 0, writing;
         LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
@@ -1226,6 +1427,8 @@ static void init_pipe_end( struct pipe_end *pipe_end, struct named_pipe *pipe,
     pipe_end->flags = pipe_flags;
     pipe_end->connection = NULL;
     pipe_end->buffer_size = buffer_size;
+    pipe_end->direct = 0;
+    pipe_end->direct_read = 0;
     init_async_queue( &pipe_end->read_q );
     init_async_queue( &pipe_end->write_q );
     list_init( &pipe_end->message_queue );
@@ -1328,6 +1531,7 @@ static struct object *named_pipe_open_file( struct object *obj, unsigned int acc
         server->pipe_end.client_pid = client->client_pid;
         client->server_pid = server->pipe_end.server_pid;
         list_remove( &server->entry );
+        pipe_end_connect_direct( &server->pipe_end, client );
     }
     return &client->obj;
 }
@@ -1419,6 +1623,7 @@ DECL_HANDLER(create_named_pipe)
         pipe->maxinstances = req->maxinstances;
         pipe->timeout = req->timeout;
         pipe->message_mode = (req->flags & NAMED_PIPE_MESSAGE_STREAM_WRITE) != 0;
+        pipe->direct_mode = (req->flags & NAMED_PIPE_DIRECT_MODE) != 0;
         pipe->sharing = req->sharing;
         if (sd) default_set_sd( &pipe->obj, sd, OWNER_SECURITY_INFORMATION |
                                                 GROUP_SECURITY_INFORMATION |
@@ -1442,7 +1647,7 @@ DECL_HANDLER(create_named_pipe)
         clear_error(); /* clear the name collision */
     }
 
-    server = create_pipe_server( pipe, req->options, req->flags );
+    server = create_pipe_server( pipe, req->options, req->flags & ~NAMED_PIPE_DIRECT_MODE );
     if (server)
     {
         reply->handle = alloc_handle( current->process, server, req->access, objattr->attributes );
@@ -1479,8 +1684,20 @@ DECL_HANDLER(set_named_pipe_info)
     {
         set_error( STATUS_INVALID_PARAMETER );
     }
+    else if ((req->flags & NAMED_PIPE_NONBLOCKING_MODE) && pipe_end->direct &&
+             (pipe_end_direct_read_busy( pipe_end ) ||
+              (pipe_end->connection && pipe_end_direct_read_busy( pipe_end->connection ))))
+    {
+        /* nonblocking mode needs the message queues, the queued client I/O can't be moved there */
+        set_error( STATUS_PIPE_BUSY );
+    }
     else
     {
+        if (req->flags & NAMED_PIPE_NONBLOCKING_MODE)
+        {
+            pipe_end_undirect_read( pipe_end );
+            if (pipe_end->connection) pipe_end_undirect_read( pipe_end->connection );
+        }
         pipe_end->flags = req->flags;
     }
 
@@ -214,6 +214,22 @@ extern struct event *get_event_obj( struct process *process, obj_handle_t handle
 extern struct keyed_event *get_keyed_event_obj( struct process *process, obj_handle_t handle, unsigned int access );
 extern void set_event( struct event *event );
 extern void reset_event( struct event *event );
+extern struct fast_sync_object *get_event_fast_sync( struct object *obj );
+extern void release_event_reservation( struct object *obj );
+
+/* semaphore functions */
+
+extern struct fast_sync_object *get_semaphore_fast_sync( struct object *obj );
+extern void release_semaphore_reservation( struct object *obj );
+
+/* fast synchronization functions */
+
+extern struct fast_sync_object *alloc_fast_sync_object( enum fast_sync_type type, int state, int max );
+extern void free_fast_sync_object( struct fast_sync_object *fast );
+extern void fast_sync_add_waiter( struct fast_sync_object *fast );
+extern void fast_sync_remove_waiter( struct fast_sync_object *fast );
+extern void fast_sync_wake_clients( struct fast_sync_object *fast );
+extern void fast_sync_release_reservation( struct object *obj );
 
 /* mutex functions */
 
@@ -226,6 +242,7 @@ int get_serial_async_timeout(struct object *obj, int type, int count);
 /* socket functions */
 
 extern void sock_init(void);
+extern struct fast_sync_object *get_sock_fast_sync( struct object *obj );
 
 /* debugger functions */
 
@@ -83,12 +83,18 @@ struct key
     unsigned short    namelen;     /* length of key name */
     unsigned short    classlen;    /* length of class name */
     struct key       *parent;      /* parent key */
+    struct key       *hash_next;   /* next key in the parent hash chain */
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
+    int               sorted_subkeys; /* count of subkeys already sorted at the start of the array */
     struct key      **subkeys;     /* subkeys array */
+    unsigned int      subkey_hash_size; /* size of the subkeys hash table */
+    struct key      **subkey_hash; /* subkeys hash table, or NULL if there are few subkeys */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
-    struct key_value *values;      /* values array */
+    struct key_value *values;      /* values array, in creation order */
+    unsigned int      value_hash_size; /* size of the values hash table */
+    int              *value_hash;  /* values hash table, or NULL if there are few values */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
@@ -102,6 +108,7 @@ struct key
 #define KEY_WOW64    0x0010  /* key contains a Wow6432Node subkey */
 #define KEY_WOWSHARE 0x0020  /* key is a Wow64 shared key (used for Software\Classes) */
 #define KEY_PREDEF   0x0040  /* key is marked as predefined */
+#define KEY_CHANGED  0x0080  /* key values or options have been modified since the last save */
 
 /* a key value */
 struct key_value
@@ -111,10 +118,13 @@ struct key_value
     unsigned int      type;    /* value type */
     data_size_t       len;     /* value data length in bytes */
     void             *data;    /* pointer to value data */
+    int               hash_next; /* index of the next value in the hash chain */
 };
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_HASHED_SUBKEYS 32  /* number of subkeys from which a hash table is used */
+#define MIN_HASHED_VALUES  32  /* number of values from which a hash table is used */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -133,6 +143,7 @@ static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n
 static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_value) };
 
 static void set_periodic_save_timer(void);
+static void sort_subkeys( struct key *key );
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
 
 /* information about where to save a registry branch */
@@ -140,12 +151,31 @@ struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    char        *journal;       /* journal of the changes made since the file was saved */
+    off_t        journal_size;  /* size of the journal, 0 if there is none */
+    struct stat  hive;          /* state of the file when the journal was started */
+    timeout_t    last_save;     /* time of the last save */
+    int          full_save;     /* the next save needs to rewrite the whole file */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
 
+/* a key deleted since its branch was last saved */
+struct deleted_key
+{
+    struct list              entry;
+    struct save_branch_info *branch;   /* branch containing the key */
+    struct key              *parent;   /* parent of the deleted key */
+    WCHAR                   *name;     /* name of the deleted key */
+    data_size_t              namelen;
+};
+
+static struct list deleted_keys = LIST_INIT( deleted_keys );
+
+#define MIN_JOURNAL_SIZE (1024 * 1024)  /* journal size below which the file is never rewritten */
+
 unsigned int supported_machines_count = 0;
 unsigned short supported_machines[8];
 unsigned short native_machine = 0;
@@ -155,6 +185,8 @@ struct file_load_info
 {
     const char *filename; /* input file name */
     FILE       *file;     /* input file */
+    const struct stat *hive; /* for a journal, the file that it applies to */
+    int         hive_ok;  /* whether the journal has been checked against the file */
     char       *buffer;   /* line buffer */
     int         len;      /* buffer length */
     int         line;     /* current input line */
@@ -274,32 +306,66 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
+/* save the name and modification time of a key */
+static void dump_key_header( const struct key *key, const struct key *base, FILE *f )
+{
+    fprintf( f, "\n[" );
+    if (key != base) dump_path( key, base, f );
+    fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
+    fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
+}
+
+/* save the options and values of a key */
+static void dump_key_contents( const struct key *key, FILE *f )
+{
+    int i;
+
+    if (key->class)
+    {
+        fprintf( f, "#class=\"" );
+        dump_strW( key->class, key->classlen, f, "\"\"" );
+        fprintf( f, "\"\n" );
+    }
+    if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
+    for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
+}
+
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    sort_subkeys( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
     {
-        fprintf( f, "\n[" );
-        if (key != base) dump_path( key, base, f );
-        fprintf( f, "] %u\n", (unsigned int)((key->modif - ticks_1601_to_1970) / TICKS_PER_SEC) );
-        fprintf( f, "#time=%x%08x\n", (unsigned int)(key->modif >> 32), (unsigned int)key->modif );
-        if (key->class)
-        {
-            fprintf( f, "#class=\"" );
-            dump_strW( key->class, key->classlen, f, "\"\"" );
-            fprintf( f, "\"\n" );
-        }
-        if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
-        for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
+        dump_key_header( key, base, f );
+        dump_key_contents( key, f );
     }
     for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
 }
 
+/* save the keys of a registry branch that have been modified since a given time */
+static void save_changed_subkeys( struct key *key, const struct key *base, timeout_t since, FILE *f )
+{
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    if (!(key->flags & KEY_DIRTY)) return;  /* nothing modified in this subtree */
+
+    if (key->flags & KEY_CHANGED)
+    {
+        dump_key_header( key, base, f );
+        fputs( "#replace\n", f );
+        dump_key_contents( key, f );
+    }
+    else if (key->modif >= since) dump_key_header( key, base, f );
+
+    for (i = 0; i <= key->last_subkey; i++) save_changed_subkeys( key->subkeys[i], base, since, f );
+}
+
 static void dump_operation( const struct key *key, const struct key_value *value, const char *op )
 {
     fprintf( stderr, "%s key ", op );
@@ -343,13 +409,15 @@ static void do_notification( struct key *key, struct notify *notify, int del )
     }
 }
 
-static inline struct notify *find_notify( struct key *key, struct process *process, obj_handle_t hkey )
+static inline struct notify *find_notify( struct key *key, struct process *process, obj_handle_t hkey,
+                                          int subtree, unsigned int filter )
 {
     struct notify *notify;
 
     LIST_FOR_EACH_ENTRY( notify, &key->notify_list, struct notify, entry )
     {
-        if (notify->process == process && notify->hkey == hkey) return notify;
+        if (notify->process == process && notify->hkey == hkey &&
+            notify->subtree == subtree && notify->filter == filter) return notify;
     }
     return NULL;
 }
@@ -427,12 +495,16 @@ static WCHAR *key_get_full_name( struct object *obj, data_size_t *ret_len )
     return (WCHAR *)ret;
 }
 
-/* close the notification associated with a handle */
+/* close the notifications associated with a handle */
 static int key_close_handle( struct object *obj, struct process *process, obj_handle_t handle )
 {
-    struct key * key = (struct key *) obj;
-    struct notify *notify = find_notify( key, process, handle );
-    if (notify) do_notification( key, notify, 1 );
+    struct key *key = (struct key *) obj;
+    struct notify *notify, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( notify, next, &key->notify_list, struct notify, entry )
+    {
+        if (notify->process == process && notify->hkey == handle) do_notification( key, notify, 1 );
+    }
     return 1;  /* ok to close */
 }
 
@@ -451,12 +523,14 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free( key->value_hash );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->parent = NULL;
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free( key->subkey_hash );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -518,12 +592,18 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->flags       = 0;
         key->last_subkey = -1;
         key->nb_subkeys  = 0;
+        key->sorted_subkeys = 0;
         key->subkeys     = NULL;
+        key->subkey_hash_size = 0;
+        key->subkey_hash = NULL;
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
+        key->value_hash_size = 0;
+        key->value_hash  = NULL;
         key->modif       = modif;
         key->parent      = NULL;
+        key->hash_next   = NULL;
         list_init( &key->notify_list );
         if (name->len && !(key->name = memdup( name->str, name->len )))
         {
@@ -552,7 +632,7 @@ static void make_clean( struct key *key )
 
     if (key->flags & KEY_VOLATILE) return;
     if (!(key->flags & KEY_DIRTY)) return;
-    key->flags &= ~KEY_DIRTY;
+    key->flags &= ~(KEY_DIRTY | KEY_CHANGED);
     for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
 }
 
@@ -608,11 +688,74 @@ static int grow_subkeys( struct key *key )
     return 1;
 }
 
-/* allocate a subkey for a given key, and return its index */
+/* compare the names of two subkeys, for sorting the subkeys array */
+static int compare_subkeys( const void *p1, const void *p2 )
+{
+    const struct key *key1 = *(struct key * const *)p1;
+    const struct key *key2 = *(struct key * const *)p2;
+    int res = memicmp_strW( key1->name, key2->name, min( key1->namelen, key2->namelen ));
+
+    if (!res) res = key1->namelen - key2->namelen;
+    return res;
+}
+
+/* build the hash table of subkeys with a given size; return 1 if OK, 0 on error */
+static int hash_subkeys( struct key *key, unsigned int size )
+{
+    struct key **hash;
+    unsigned int bucket;
+    int i;
+
+    if (!(hash = mem_alloc( size * sizeof(*hash) ))) return 0;
+    memset( hash, 0, size * sizeof(*hash) );
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        bucket = hash_strW( key->subkeys[i]->name, key->subkeys[i]->namelen, size );
+        key->subkeys[i]->hash_next = hash[bucket];
+        hash[bucket] = key->subkeys[i];
+    }
+    free( key->subkey_hash );
+    key->subkey_hash = hash;
+    key->subkey_hash_size = size;
+    return 1;
+}
+
+/* sort the subkeys appended since the last sort and merge them with the sorted ones */
+static void sort_subkeys( struct key *key )
+{
+    int count = key->last_subkey + 1, sorted = key->sorted_subkeys;
+    struct key **merged;
+    int i, j, k;
+
+    if (sorted == count) return;
+    qsort( key->subkeys + sorted, count - sorted, sizeof(*key->subkeys), compare_subkeys );
+    if (sorted)
+    {
+        if (!(merged = malloc( key->nb_subkeys * sizeof(*merged) )))
+        {
+            qsort( key->subkeys, count, sizeof(*key->subkeys), compare_subkeys );
+            key->sorted_subkeys = count;
+            return;
+        }
+        for (i = k = 0, j = sorted; k < count; k++)
+        {
+            if (j == count || (i < sorted && compare_subkeys( &key->subkeys[i], &key->subkeys[j] ) < 0))
+                merged[k] = key->subkeys[i++];
+            else
+                merged[k] = key->subkeys[j++];
+        }
+        free( key->subkeys );
+        key->subkeys = merged;
+    }
+    key->sorted_subkeys = count;
+}
+
+/* allocate a subkey for a given key; the index must have been returned by find_subkey */
 static struct key *alloc_subkey( struct key *parent, const struct unicode_str *name,
                                  int index, timeout_t modif )
 {
     struct key *key;
+    unsigned int bucket;
     int i;
 
     if (name->len > MAX_NAME_LEN * sizeof(WCHAR))
@@ -625,12 +768,29 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
         /* need to grow the array */
         if (!grow_subkeys( parent )) return NULL;
     }
+    if (parent->last_subkey + 1 >= MIN_HASHED_SUBKEYS && parent->last_subkey + 1 >= parent->subkey_hash_size)
+    {
+        /* need to grow the hash table */
+        if (!hash_subkeys( parent, max( 2 * parent->subkey_hash_size, 2 * MIN_HASHED_SUBKEYS ))) return NULL;
+    }
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
-        for (i = ++parent->last_subkey; i > index; i--)
-            parent->subkeys[i] = parent->subkeys[i-1];
-        parent->subkeys[index] = key;
+        if (parent->subkey_hash)
+        {
+            /* append it, it will get sorted when the subkeys are enumerated */
+            parent->subkeys[++parent->last_subkey] = key;
+            bucket = hash_strW( key->name, key->namelen, parent->subkey_hash_size );
+            key->hash_next = parent->subkey_hash[bucket];
+            parent->subkey_hash[bucket] = key;
+        }
+        else
+        {
+            for (i = ++parent->last_subkey; i > index; i--)
+                parent->subkeys[i] = parent->subkeys[i-1];
+            parent->subkeys[index] = key;
+            parent->sorted_subkeys++;
+        }
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -638,19 +798,31 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
 }
 
 /* free a subkey of a given key */
-static void free_subkey( struct key *parent, int index )
+static void free_subkey( struct key *parent, struct key *key )
 {
-    struct key *key;
-    int i, nb_subkeys;
+    struct notify *notify;
+    struct key **ptr;
+    int i, index, nb_subkeys;
 
+    /* recently created subkeys are more likely to be deleted, so start from the end */
+    for (index = parent->last_subkey; index >= 0; index--)
+        if (parent->subkeys[index] == key) break;
     assert( index >= 0 );
-    assert( index <= parent->last_subkey );
 
-    key = parent->subkeys[index];
     for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
     parent->last_subkey--;
+    if (index < parent->sorted_subkeys) parent->sorted_subkeys--;
+    if (parent->subkey_hash)
+    {
+        ptr = &parent->subkey_hash[hash_strW( key->name, key->namelen, parent->subkey_hash_size )];
+        while (*ptr != key) ptr = &(*ptr)->hash_next;
+        *ptr = key->hash_next;
+        key->hash_next = NULL;
+    }
     key->flags |= KEY_DELETED;
     key->parent = NULL;
+    /* handles to the deleted key watching it must notice */
+    LIST_FOR_EACH_ENTRY( notify, &key->notify_list, struct notify, entry ) do_notification( key, notify, 0 );
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
     release_object( key );
 
@@ -667,12 +839,24 @@ static void free_subkey( struct key *parent, int index )
     }
 }
 
-/* find the named child of a given key and return its index */
+/* find the named child of a given key */
+/* if not found, index is set to the position where it should be inserted */
 static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
 {
+    struct key *subkey;
     int i, min, max, res;
     data_size_t len;
 
+    if (key->subkey_hash)
+    {
+        subkey = key->subkey_hash[hash_strW( name->str, name->len, key->subkey_hash_size )];
+        for ( ; subkey; subkey = subkey->hash_next)
+            if (subkey->namelen == name->len && !memicmp_strW( subkey->name, name->str, name->len ))
+                return subkey;
+        *index = key->last_subkey + 1;
+        return NULL;
+    }
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -850,7 +1034,7 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
 
     if (options & REG_OPTION_CREATE_LINK) key->flags |= KEY_SYMLINK;
     if (options & REG_OPTION_VOLATILE) key->flags |= KEY_VOLATILE;
-    else key->flags |= KEY_DIRTY;
+    else key->flags |= KEY_DIRTY | KEY_CHANGED;
 
     if (sd) default_set_sd( &key->obj, sd, OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION |
                             DACL_SECURITY_INFORMATION | SACL_SECURITY_INFORMATION );
@@ -870,7 +1054,7 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
 /* recursively create a subkey (for internal use only) */
 static struct key *create_key_recursive( struct key *key, const struct unicode_str *name, timeout_t modif )
 {
-    struct key *base;
+    struct key *base, *parent;
     int index;
     struct unicode_str token;
 
@@ -891,6 +1075,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
 
     if (token.len)
     {
+        parent = key;
         if (!(key = alloc_subkey( key, &token, index, modif ))) return NULL;
         base = key;
         for (;;)
@@ -900,7 +1085,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
             /* we know the index is always 0 in a new key */
             if (!(key = alloc_subkey( key, &token, 0, modif )))
             {
-                free_subkey( base, index );
+                free_subkey( parent, base );
                 return NULL;
             }
         }
@@ -933,6 +1118,7 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_subkeys( key );
         key = key->subkeys[index];
     }
 
@@ -1007,10 +1193,52 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
     if (debug_level > 1) dump_operation( key, NULL, "Enum" );
 }
 
+/* find the saved registry branch containing a key */
+static struct save_branch_info *get_key_branch( const struct key *key )
+{
+    int i;
+
+    for ( ; key; key = key->parent)
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch_info[i].key == key) return &save_branch_info[i];
+    return NULL;
+}
+
+static void free_deleted_key( struct deleted_key *deleted )
+{
+    list_remove( &deleted->entry );
+    release_object( deleted->parent );
+    free( deleted->name );
+    free( deleted );
+}
+
+/* remember a deleted key until the deletion is saved to the branch journal */
+static void record_deleted_key( struct key *key )
+{
+    struct save_branch_info *branch;
+    struct deleted_key *deleted;
+
+    if (key->flags & KEY_VOLATILE) return;
+    if (!(branch = get_key_branch( key->parent ))) return;
+    if (branch->full_save) return;  /* the whole file is going to be rewritten anyway */
+
+    /* don't use mem_alloc, failing here must not fail the deletion */
+    if (!(deleted = malloc( sizeof(*deleted) )) || !(deleted->name = malloc( key->namelen + 1 )))
+    {
+        free( deleted );
+        branch->full_save = 1;
+        return;
+    }
+    memcpy( deleted->name, key->name, key->namelen );
+    deleted->branch  = branch;
+    deleted->parent  = (struct key *)grab_object( key->parent );
+    deleted->namelen = key->namelen;
+    list_add_tail( &deleted_keys, &deleted->entry );
+}
+
 /* delete a key and its values */
 static int delete_key( struct key *key, int recurse )
 {
-    int index;
     struct key *parent = key->parent;
 
     /* must find parent and index */
@@ -1031,10 +1259,6 @@ static int delete_key( struct key *key, int recurse )
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
-    for (index = 0; index <= parent->last_subkey; index++)
-        if (parent->subkeys[index] == key) break;
-    assert( index <= parent->last_subkey );
-
     /* we can only delete a key that has no subkeys */
     if (key->last_subkey >= 0)
     {
@@ -1043,7 +1267,8 @@ static int delete_key( struct key *key, int recurse )
     }
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
-    free_subkey( parent, index );
+    record_deleted_key( key );
+    free_subkey( parent, key );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
     return 0;
 }
@@ -1073,29 +1298,54 @@ static int grow_values( struct key *key )
     return 1;
 }
 
+/* link the values into the hash table chains */
+static void link_values( struct key *key )
+{
+    unsigned int bucket;
+    int i;
+
+    memset( key->value_hash, 0xff, key->value_hash_size * sizeof(*key->value_hash) );
+    for (i = 0; i <= key->last_value; i++)
+    {
+        bucket = hash_strW( key->values[i].name, key->values[i].namelen, key->value_hash_size );
+        key->values[i].hash_next = key->value_hash[bucket];
+        key->value_hash[bucket] = i;
+    }
+}
+
+/* build the hash table of values with a given size; return 1 if OK, 0 on error */
+static int hash_values( struct key *key, unsigned int size )
+{
+    int *hash;
+
+    if (!(hash = mem_alloc( size * sizeof(*hash) ))) return 0;
+    free( key->value_hash );
+    key->value_hash = hash;
+    key->value_hash_size = size;
+    link_values( key );
+    return 1;
+}
+
 /* find the named value of a given key and return its index in the array */
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
 {
-    int i, min, max, res;
-    data_size_t len;
+    int i;
 
-    min = 0;
-    max = key->last_value;
-    while (min <= max)
+    if (key->value_hash)
+        i = key->value_hash[hash_strW( name->str, name->len, key->value_hash_size )];
+    else
+        i = key->last_value;
+
+    while (i != -1)
     {
-        i = (min + max) / 2;
-        len = min( key->values[i].namelen, name->len );
-        res = memicmp_strW( key->values[i].name, name->str, len );
-        if (!res) res = key->values[i].namelen - name->len;
-        if (!res)
+        if (key->values[i].namelen == name->len && !memicmp_strW( key->values[i].name, name->str, name->len ))
         {
             *index = i;
             return &key->values[i];
         }
-        if (res > 0) max = i - 1;
-        else min = i + 1;
+        i = key->value_hash ? key->values[i].hash_next : i - 1;
     }
-    *index = min;  /* this is where we should insert it */
+    *index = key->last_value + 1;  /* this is where we should insert it */
     return NULL;
 }
 
@@ -1104,7 +1354,7 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
 {
     struct key_value *value;
     WCHAR *new_name = NULL;
-    int i;
+    unsigned int bucket;
 
     if (name->len > MAX_VALUE_LEN * sizeof(WCHAR))
     {
@@ -1115,13 +1365,24 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     {
         if (!grow_values( key )) return NULL;
     }
+    if (key->last_value + 1 >= MIN_HASHED_VALUES && key->last_value + 1 >= key->value_hash_size)
+    {
+        if (!hash_values( key, max( 2 * key->value_hash_size, 2 * MIN_HASHED_VALUES ))) return NULL;
+    }
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
-    for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
-    value = &key->values[index];
+    assert( index == key->last_value + 1 );
+    value = &key->values[++key->last_value];
     value->name    = new_name;
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    value->hash_next = -1;
+    if (key->value_hash)
+    {
+        bucket = hash_strW( value->name, value->namelen, key->value_hash_size );
+        value->hash_next = key->value_hash[bucket];
+        key->value_hash[bucket] = index;
+    }
     return value;
 }
 
@@ -1175,6 +1436,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
     value->type  = type;
     value->len   = len;
     value->data  = ptr;
+    key->flags |= KEY_CHANGED;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
     if (debug_level > 1) dump_operation( key, value, "Set" );
 }
@@ -1284,6 +1546,8 @@ static void delete_value( struct key *key, const struct unicode_str *name )
     free( value->data );
     for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
     key->last_value--;
+    if (key->value_hash) link_values( key );
+    key->flags |= KEY_CHANGED;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
     /* try to shrink the array */
@@ -1299,6 +1563,24 @@ static void delete_value( struct key *key, const struct unicode_str *name )
     }
 }
 
+/* remove all the values and options of a key, before loading them again from a journal */
+static void clear_key_contents( struct key *key )
+{
+    int i;
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        free( key->values[i].name );
+        free( key->values[i].data );
+    }
+    key->last_value = -1;
+    if (key->value_hash) link_values( key );
+    free( key->class );
+    key->class = NULL;
+    key->classlen = 0;
+    key->flags &= ~KEY_SYMLINK;
+}
+
 /* get the registry key corresponding to an hkey handle */
 static struct key *get_hkey_obj( obj_handle_t hkey, unsigned int access )
 {
@@ -1451,6 +1733,34 @@ static struct key *load_key( struct key *base, const char *buffer, int prefix_le
     return create_key_recursive( base, &name, 0 );
 }
 
+/* delete a key listed in a journal */
+static void load_deleted_key( struct key *base, const char *buffer, struct file_load_info *info )
+{
+    struct unicode_str name, token;
+    struct key *key = base;
+    data_size_t len;
+    int index;
+
+    if (!get_file_tmp_space( info, strlen(buffer) * sizeof(WCHAR) )) return;
+
+    len = info->tmplen;
+    if (parse_strW( info->tmp, &len, buffer, ']' ) == -1)
+    {
+        file_read_error( "Malformed key", info );
+        return;
+    }
+    name.str = info->tmp;
+    name.len = len - sizeof(WCHAR);
+    token.str = NULL;
+    if (!get_path_token( &name, &token )) return;
+    while (token.len)
+    {
+        if (!(key = find_subkey( key, &token, &index ))) return;  /* already gone */
+        get_path_token( &name, &token );
+    }
+    if (key != base) delete_key( key, 1 );
+}
+
 /* update the modification time of a key (and its parents) after it has been loaded from a file */
 static void update_key_time( struct key *key, timeout_t modif )
 {
@@ -1486,6 +1796,15 @@ static int load_global_option( const char *buffer, struct file_load_info *info )
             return 0;
         }
     }
+    if (info->hive && !strncmp( buffer, "#hive=", 6 ))
+    {
+        unsigned long ino, size, mtime;
+
+        info->hive_ok = (sscanf( buffer + 6, "%lx,%lx,%lx", &ino, &size, &mtime ) == 3 &&
+                         ino == (unsigned long)info->hive->st_ino &&
+                         size == (unsigned long)info->hive->st_size &&
+                         mtime == (unsigned long)info->hive->st_mtime);
+    }
     /* ignore unknown options */
     return 1;
 }
@@ -1506,8 +1825,10 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
             else if (*p >= 'a' && *p <= 'f') modif = (modif << 4) | (*p - 'a' + 10);
             else break;
         }
-        update_key_time( key, modif );
+        if (info->hive) key->modif = modif;
+        else update_key_time( key, modif );
     }
+    if (info->hive && !strcmp( buffer, "#replace" )) clear_key_contents( key );
     if (!strncmp( buffer, "#class=", 7 ))
     {
         p = buffer + 7;
@@ -1678,7 +1999,9 @@ static int get_prefix_len( struct key *key, const char *name, struct file_load_i
 
 /* load all the keys from the input file */
 /* prefix_len is the number of key name prefixes to skip, or -1 for autodetection */
-static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len )
+/* hive is set when loading the journal of the file it points to */
+static void load_keys( struct key *key, const char *filename, FILE *f, int prefix_len,
+                       const struct stat *hive )
 {
     struct key *subkey = NULL;
     struct file_load_info info;
@@ -1687,6 +2010,8 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
 
     info.filename = filename;
     info.file   = f;
+    info.hive   = hive;
+    info.hive_ok = 0;
     info.len    = 4;
     info.tmplen = 4;
     info.line   = 0;
@@ -1715,6 +2040,20 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
             {
                 update_key_time( subkey, modif );
                 release_object( subkey );
+                subkey = NULL;
+            }
+            if (hive)
+            {
+                if (!info.hive_ok)
+                {
+                    file_read_error( "Journal doesn't match the registry file", &info );
+                    goto done;
+                }
+                if (p[1] == '-')
+                {
+                    load_deleted_key( key, p + 2, &info );
+                    break;
+                }
             }
             if (prefix_len == -1) prefix_len = get_prefix_len( key, p + 1, &info );
             if (!(subkey = load_key( key, p + 1, prefix_len, &info, &modif )))
@@ -1762,21 +2101,52 @@ static void load_registry( struct key *key, obj_handle_t handle )
         FILE *f = fdopen( fd, "r" );
         if (f)
         {
-            load_keys( key, NULL, f, -1 );
+            load_keys( key, NULL, f, -1, NULL );
             fclose( f );
         }
         else file_set_error();
     }
 }
 
+/* replay the changes saved in the journal of a registry file; return 1 if there were any */
+static int load_journal( struct key *key, const char *filename, const struct stat *hive )
+{
+    char buffer[256];
+    off_t pos = 0, end = 0;
+    int line_start = 1;
+    size_t len;
+    FILE *f;
+
+    if (!(f = fopen( filename, "r+" ))) return 0;
+
+    /* drop the last batch of changes if it wasn't completely written */
+    while (fgets( buffer, sizeof(buffer), f ))
+    {
+        len = strlen( buffer );
+        pos += len;
+        if (line_start && !strcmp( buffer, "#commit\n" )) end = pos;
+        line_start = (len && buffer[len - 1] == '\n');
+    }
+    if (end && end < pos && ftruncate( fileno( f ), end ) == -1) end = 0;
+    if (end)
+    {
+        rewind( f );
+        load_keys( key, filename, f, 0, hive );
+    }
+    fclose( f );
+    clear_error();
+    return (end != 0);
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
+    struct save_branch_info *branch;
     FILE *f;
 
     if ((f = fopen( filename, "r" )))
     {
-        load_keys( key, filename, f, 0 );
+        load_keys( key, filename, f, 0, NULL );
         fclose( f );
         if (get_error() == STATUS_NOT_REGISTRY_FILE)
         {
@@ -1787,8 +2157,22 @@ static int load_init_registry_from_file( const char *filename, struct key *key )
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    branch = &save_branch_info[save_branch_count];
+    branch->path = filename;
+    if (!(branch->journal = malloc( strlen( filename ) + sizeof(".journal") )))
+        fatal_error( "out of memory\n" );
+    sprintf( branch->journal, "%s.journal", filename );
+    branch->journal_size = 0;
+    branch->last_save = current_time;
+    branch->full_save = 0;
+    memset( &branch->hive, 0, sizeof(branch->hive) );
+
+    /* a journal left behind by a server that didn't exit cleanly is merged on the next save */
+    if (f && !stat( filename, &branch->hive ))
+        branch->full_save = load_journal( key, branch->journal, &branch->hive );
+
+    branch->key = (struct key *)grab_object( key );
+    save_branch_count++;
     make_object_permanent( &key->obj );
     return (f != NULL);
 }
@@ -2008,20 +2392,105 @@ static void save_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/* append the changes made to a registry branch since the last save to its journal */
+static int save_branch_journal( struct save_branch_info *branch )
+{
+    struct deleted_key *deleted, *next;
+    struct key *key = branch->key;
+    struct stat st;
+    int fd, ret;
+    FILE *f;
+
+    if ((fd = open( branch->journal, O_WRONLY | O_APPEND | O_CREAT, 0666 )) == -1) return 0;
+    if (!(f = fdopen( fd, "a" )))
+    {
+        close( fd );
+        return 0;
+    }
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", branch->journal );
+        dump_operation( key, NULL, "saving changes" );
+    }
+
+    if (!branch->journal_size)
+    {
+        /* discard any leftover from a previous session */
+        if (ftruncate( fd, 0 ) == -1)
+        {
+            fclose( f );
+            return 0;
+        }
+        fprintf( f, "WINE REGISTRY Version 2\n" );
+        fprintf( f, ";; Changes to %s since it was last saved\n", branch->path );
+        fprintf( f, "#hive=%lx,%lx,%lx\n", (unsigned long)branch->hive.st_ino,
+                 (unsigned long)branch->hive.st_size, (unsigned long)branch->hive.st_mtime );
+    }
+
+    LIST_FOR_EACH_ENTRY_SAFE( deleted, next, &deleted_keys, struct deleted_key, entry )
+    {
+        if (deleted->branch != branch) continue;
+        /* if the parent is gone too, its own deletion covers this one */
+        if (!(deleted->parent->flags & KEY_DELETED))
+        {
+            fprintf( f, "\n[-" );
+            if (deleted->parent != key)
+            {
+                dump_path( deleted->parent, key, f );
+                fprintf( f, "\\\\" );
+            }
+            dump_strW( deleted->name, deleted->namelen, f, "[]" );
+            fprintf( f, "]\n" );
+        }
+        free_deleted_key( deleted );
+    }
+    save_changed_subkeys( key, key, branch->last_save, f );
+    fprintf( f, "#commit\n" );
+
+    ret = !fclose( f );
+    if (ret && !stat( branch->journal, &st )) branch->journal_size = st.st_size;
+    else ret = 0;
+    return ret;
+}
+
 /* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+/* if compact is set, the whole file is rewritten instead of saving the changes to the journal */
+static int save_branch( struct save_branch_info *branch, int compact )
 {
+    struct deleted_key *deleted, *next;
+    struct key *key = branch->key;
+    const char *path = branch->path;
     struct stat st;
     char *p, *tmp = NULL;
     int fd, count = 0, ret = 0;
     FILE *f;
 
-    if (!(key->flags & KEY_DIRTY))
+    if (!(key->flags & KEY_DIRTY) && !branch->full_save && !(compact && branch->journal_size))
     {
         if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
         return 1;
     }
 
+    /* only write the changes as long as they are small compared to the whole file, and the
+     * file is still the one the journal applies to */
+
+    if (!compact && !branch->full_save &&
+        branch->journal_size < max( MIN_JOURNAL_SIZE, branch->hive.st_size / 2 ) &&
+        !lstat( path, &st ) && S_ISREG(st.st_mode) && st.st_nlink == 1 &&
+        st.st_ino == branch->hive.st_ino && st.st_size == branch->hive.st_size &&
+        st.st_mtime == branch->hive.st_mtime)
+    {
+        if ((ret = save_branch_journal( branch )))
+        {
+            make_clean( key );
+            branch->last_save = current_time;
+            return ret;
+        }
+        /* the journal may be corrupted now, so make sure to get rid of it */
+        branch->full_save = 1;
+    }
+
     /* test the file type */
 
     if ((fd = open( path, O_WRONLY )) != -1)
@@ -2078,7 +2547,17 @@ static int save_branch( struct key *key, const char *path )
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
+    if (ret)
+    {
+        make_clean( key );
+        LIST_FOR_EACH_ENTRY_SAFE( deleted, next, &deleted_keys, struct deleted_key, entry )
+            if (deleted->branch == branch) free_deleted_key( deleted );
+        unlink( branch->journal );
+        if (stat( path, &branch->hive )) memset( &branch->hive, 0, sizeof(branch->hive) );
+        branch->journal_size = 0;
+        branch->last_save = current_time;
+        branch->full_save = 0;
+    }
     return ret;
 }
 
@@ -2090,7 +2569,7 @@ static void periodic_save( void *arg )
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+        save_branch( &save_branch_info[i], 0 );
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2110,7 +2589,7 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!save_branch( &save_branch_info[i], 1 ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
@@ -2288,6 +2767,7 @@ DECL_HANDLER(delete_key_value)
 /* load a registry branch from a file */
 DECL_HANDLER(load_registry)
 {
+    struct save_branch_info *branch;
     struct key *key, *parent;
     struct unicode_str name;
     const struct security_descriptor *sd;
@@ -2314,6 +2794,8 @@ DECL_HANDLER(load_registry)
         if ((key = create_key( parent, &name, NULL, 0, KEY_WOW64_64KEY, 0, sd, &dummy )))
         {
             load_registry( key, req->file );
+            /* the loaded keys are not tracked as changes, so the file has to be rewritten */
+            if ((branch = get_key_branch( key ))) branch->full_save = 1;
             release_object( key );
         }
         release_object( parent );
@@ -2380,7 +2862,7 @@ DECL_HANDLER(set_registry_notification)
         event = get_event_obj( current->process, req->event, SYNCHRONIZE );
         if (event)
         {
-            notify = find_notify( key, current->process, req->hkey );
+            notify = find_notify( key, current->process, req->hkey, req->subtree, req->filter );
             if (!notify)
             {
                 notify = mem_alloc( sizeof(*notify) );
@@ -72,6 +72,8 @@
 static const char * const server_socket_name = "socket";   /* name of the socket file */
 static const char * const server_lock_name = "lock";       /* name of the server lock file */
 
+static unsigned int request_counts[REQ_NB_REQUESTS];  /* requests since the last stats dump */
+
 struct master_socket
 {
     struct object        obj;        /* object header */
@@ -288,6 +290,50 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
 }
 
+/* dump the request throughput since the last call */
+static void dump_request_stats( void *private )
+{
+    static timeout_t last_time;
+    unsigned int i, j, top[8], nb_top = 0;
+    unsigned long long total = 0;
+    timeout_t elapsed;
+
+    for (i = 0; i < REQ_NB_REQUESTS; i++)
+    {
+        if (!request_counts[i]) continue;
+        total += request_counts[i];
+        /* keep the most frequent requests sorted in top[] */
+        if (nb_top < ARRAY_SIZE(top)) j = nb_top++;
+        else if (request_counts[i] <= request_counts[top[nb_top - 1]]) continue;
+        else j = nb_top - 1;
+        for ( ; j > 0 && request_counts[top[j - 1]] < request_counts[i]; j--) top[j] = top[j - 1];
+        top[j] = i;
+    }
+
+    elapsed = last_time ? monotonic_time - last_time : request_stats_interval * TICKS_PER_SEC;
+    if (elapsed <= 0) elapsed = 1;
+    last_time = monotonic_time;
+
+    fprintf( stderr, "wineserver: %llu requests in %u.%03us (%llu/s)",
+             total, (unsigned int)(elapsed / TICKS_PER_SEC),
+             (unsigned int)(elapsed % TICKS_PER_SEC / 10000),
+             total * TICKS_PER_SEC / elapsed );
+    for (i = 0; i < nb_top; i++)
+        fprintf( stderr, "%s %s=%u", i ? "," : ":", get_req_name( top[i] ), request_counts[top[i]] );
+    fputc( '\n', stderr );
+
+    memset( request_counts, 0, sizeof(request_counts) );
+    add_timeout_user( -(timeout_t)request_stats_interval * TICKS_PER_SEC, dump_request_stats, NULL );
+}
+
+/* start dumping the request throughput periodically */
+void init_request_stats(void)
+{
+    if (!request_stats_interval) return;
+    memset( request_counts, 0, sizeof(request_counts) );
+    add_timeout_user( -(timeout_t)request_stats_interval * TICKS_PER_SEC, dump_request_stats, NULL );
+}
+
 /* call a request handler */
 static void call_req_handler( struct thread *thread )
 {
@@ -302,7 +348,10 @@ static void call_req_handler( struct thread *thread )
     if (debug_level) trace_request();
 
     if (req < REQ_NB_REQUESTS)
+    {
+        request_counts[req]++;
         req_handlers[req]( &current->req, &reply );
+    }
     else
         set_error( STATUS_NOT_IMPLEMENTED );
 
@@ -324,15 +373,171 @@ static void call_req_handler( struct thread *thread )
     current = NULL;
 }
 
+/* requests that can be part of a batch: they never block and don't transfer fds */
+static int is_batch_request( enum request req )
+{
+    switch (req)
+    {
+    case REQ_close_handle:
+    case REQ_create_key:
+    case REQ_open_key:
+    case REQ_enum_key:
+    case REQ_set_key_value:
+    case REQ_get_key_value:
+    case REQ_enum_key_value:
+    case REQ_delete_key_value:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* batched requests returning a handle as the first field of their reply */
+static int batch_request_returns_handle( enum request req )
+{
+    return req == REQ_create_key || req == REQ_open_key;
+}
+
+/* batched requests taking a handle as the first field of their request */
+static int batch_request_takes_handle( enum request req )
+{
+    return is_batch_request( req ) && req != REQ_create_key;
+}
+
+C_ASSERT( FIELD_OFFSET(struct open_key_request, parent) == FIELD_OFFSET(struct close_handle_request, handle) );
+C_ASSERT( FIELD_OFFSET(struct enum_key_request, hkey) == FIELD_OFFSET(struct close_handle_request, handle) );
+C_ASSERT( FIELD_OFFSET(struct set_key_value_request, hkey) == FIELD_OFFSET(struct close_handle_request, handle) );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_request, hkey) == FIELD_OFFSET(struct close_handle_request, handle) );
+C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, hkey) == FIELD_OFFSET(struct close_handle_request, handle) );
+C_ASSERT( FIELD_OFFSET(struct delete_key_value_request, hkey) == FIELD_OFFSET(struct close_handle_request, handle) );
+C_ASSERT( FIELD_OFFSET(struct create_key_reply, hkey) == FIELD_OFFSET(struct open_key_reply, hkey) );
+
+/* perform several requests in a single round trip */
+DECL_HANDLER(batch)
+{
+    struct thread *thread = current;
+    union generic_request batch_req = thread->req;
+    const char *ptr = get_req_data(), *end = ptr + get_req_data_size();
+    void *batch_data = thread->req_data;
+    unsigned int chain = req->chain;
+    obj_handle_t last_handle = 0;
+    unsigned int last_error = STATUS_INVALID_HANDLE;
+    data_size_t total = 0;
+    unsigned int count = 0;
+    char *replies, *out;
+
+    /* validate the requests and compute the size of the replies */
+    while (ptr < end)
+    {
+        const union generic_request *sub = (const union generic_request *)ptr;
+
+        if (end - ptr < sizeof(*sub) ||
+            end - ptr - sizeof(*sub) < sub->request_header.request_size ||
+            sub->request_header.reply_size > get_reply_max_size() ||
+            !is_batch_request( sub->request_header.req ) ||
+            (count < 32 && (chain & (1u << count)) && !batch_request_takes_handle( sub->request_header.req )))
+        {
+            set_error( STATUS_INVALID_PARAMETER );
+            return;
+        }
+        total += sizeof(union generic_reply) + BATCH_ALIGN( sub->request_header.reply_size );
+        if (total > get_reply_max_size())
+        {
+            set_error( STATUS_BUFFER_TOO_SMALL );
+            return;
+        }
+        ptr += sizeof(*sub) + BATCH_ALIGN( sub->request_header.request_size );
+        count++;
+    }
+    if (!total) return;
+    count = 0;
+    if (!(out = replies = mem_alloc( total ))) return;
+
+    ptr = get_req_data();
+    while (ptr < end)
+    {
+        union generic_reply *sub_reply = (union generic_reply *)out;
+        int chained = count < 32 && (chain & (1u << count));
+        enum request req;
+
+        memcpy( &thread->req, ptr, sizeof(thread->req) );
+        thread->req_data = (void *)(ptr + sizeof(thread->req));
+        thread->reply_size = 0;
+        thread->reply_data = NULL;
+        req = thread->req.request_header.req;
+        clear_error();
+        memset( sub_reply, 0, sizeof(*sub_reply) );
+
+        /* chained requests use the key returned by the last open or create, the handle
+         * is at the same offset in all the requests taking one */
+        if (chained) thread->req.close_handle_request.handle = last_error ? 0 : last_handle;
+
+        if (debug_level) trace_request();
+
+        if (chained && last_error) set_error( last_error );
+        else
+        {
+            request_counts[req]++;
+            req_handlers[req]( &thread->req, sub_reply );
+        }
+
+        thread->req_data = batch_data;
+        if (!current)  /* the thread got killed */
+        {
+            free( thread->reply_data );
+            thread->reply_data = NULL;
+            free( replies );
+            return;
+        }
+
+        sub_reply->reply_header.error = current->error;
+        sub_reply->reply_header.reply_size = current->reply_size;
+        if (batch_request_returns_handle( req ))
+        {
+            last_error = current->error;
+            last_handle = sub_reply->open_key_reply.hkey;
+        }
+        if (debug_level) trace_reply( req, sub_reply );
+        if (current->reply_size) memcpy( sub_reply + 1, current->reply_data, current->reply_size );
+        free( current->reply_data );
+
+        out += sizeof(*sub_reply) + BATCH_ALIGN( sub_reply->reply_header.reply_size );
+        ptr += sizeof(thread->req) + BATCH_ALIGN( thread->req.request_header.request_size );
+        count++;
+    }
+
+    current->req = batch_req;
+    current->reply_size = 0;
+    current->reply_data = NULL;
+    clear_error();
+    reply->count = count;
+    set_reply_data_ptr( replies, out - replies );
+}
+
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
+    static char buffer[4096];
+    struct iovec vec[2];
     int ret;
 
     if (!thread->req_toread)  /* no pending request */
     {
-        if ((ret = read( get_unix_fd( thread->request_fd ), &thread->req,
-                         sizeof(thread->req) )) != sizeof(thread->req)) goto error;
+        /* the client waits for the reply before sending another request, so anything
+         * read past the header belongs to this request; this saves a read() in most cases */
+        vec[0].iov_base = &thread->req;
+        vec[0].iov_len  = sizeof(thread->req);
+        vec[1].iov_base = buffer;
+        vec[1].iov_len  = sizeof(buffer);
+        if ((ret = readv( get_unix_fd( thread->request_fd ), vec, 2 )) < (int)sizeof(thread->req))
+            goto error;
+        ret -= sizeof(thread->req);
+        if (ret > thread->req.request_header.request_size)
+        {
+            fatal_protocol_error( thread, "request %d too long (%d bytes)\n",
+                                  thread->req.request_header.req, ret );
+            return;
+        }
         if (!(thread->req_toread = thread->req.request_header.request_size))
         {
             /* no data, handle request at once */
@@ -345,6 +550,14 @@ void read_request( struct thread *thread )
                                   thread->req_toread, thread->req.request_header.req );
             return;
         }
+        memcpy( thread->req_data, buffer, ret );
+        if (!(thread->req_toread -= ret))
+        {
+            call_req_handler( thread );
+            free( thread->req_data );
+            thread->req_data = NULL;
+            return;
+        }
     }
 
     /* read the variable sized data */
@@ -65,6 +65,9 @@ extern int server_dir_fd, config_dir_fd;
 
 extern void trace_request(void);
 extern void trace_reply( enum request req, const union generic_reply *reply );
+extern const char *get_req_name( enum request req );
+extern void init_request_stats(void);
+extern unsigned int request_stats_interval;
 
 /* get current tick count to return to client */
 static inline unsigned int get_tick_count(void)
@@ -148,6 +151,7 @@ DECL_HANDLER(make_temporary);
 DECL_HANDLER(open_process);
 DECL_HANDLER(open_thread);
 DECL_HANDLER(select);
+DECL_HANDLER(batch);
 DECL_HANDLER(create_event);
 DECL_HANDLER(event_op);
 DECL_HANDLER(query_event);
@@ -161,6 +165,9 @@ DECL_HANDLER(query_mutex);
 DECL_HANDLER(create_semaphore);
 DECL_HANDLER(release_semaphore);
 DECL_HANDLER(query_semaphore);
+DECL_HANDLER(get_fast_sync_shm);
+DECL_HANDLER(get_fast_sync_obj);
+DECL_HANDLER(fast_sync_wake);
 DECL_HANDLER(open_semaphore);
 DECL_HANDLER(create_file);
 DECL_HANDLER(open_file_object);
@@ -240,6 +247,8 @@ DECL_HANDLER(is_window_hung);
 DECL_HANDLER(get_serial_info);
 DECL_HANDLER(set_serial_info);
 DECL_HANDLER(register_async);
+DECL_HANDLER(register_file_async);
+DECL_HANDLER(complete_async);
 DECL_HANDLER(cancel_async);
 DECL_HANDLER(get_async_result);
 DECL_HANDLER(set_async_direct_result);
@@ -367,6 +376,7 @@ DECL_HANDLER(create_completion);
 DECL_HANDLER(open_completion);
 DECL_HANDLER(add_completion);
 DECL_HANDLER(remove_completion);
+DECL_HANDLER(remove_completions);
 DECL_HANDLER(query_completion);
 DECL_HANDLER(set_completion_info);
 DECL_HANDLER(add_fd_completion);
@@ -429,6 +439,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_process,
     (req_handler)req_open_thread,
     (req_handler)req_select,
+    (req_handler)req_batch,
     (req_handler)req_create_event,
     (req_handler)req_event_op,
     (req_handler)req_query_event,
@@ -442,6 +453,9 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_create_semaphore,
     (req_handler)req_release_semaphore,
     (req_handler)req_query_semaphore,
+    (req_handler)req_get_fast_sync_shm,
+    (req_handler)req_get_fast_sync_obj,
+    (req_handler)req_fast_sync_wake,
     (req_handler)req_open_semaphore,
     (req_handler)req_create_file,
     (req_handler)req_open_file_object,
@@ -521,6 +535,8 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_serial_info,
     (req_handler)req_set_serial_info,
     (req_handler)req_register_async,
+    (req_handler)req_register_file_async,
+    (req_handler)req_complete_async,
     (req_handler)req_cancel_async,
     (req_handler)req_get_async_result,
     (req_handler)req_set_async_direct_result,
@@ -648,6 +664,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_completion,
     (req_handler)req_add_completion,
     (req_handler)req_remove_completion,
+    (req_handler)req_remove_completions,
     (req_handler)req_query_completion,
     (req_handler)req_set_completion_info,
     (req_handler)req_add_fd_completion,
@@ -903,6 +920,10 @@ C_ASSERT( FIELD_OFFSET(struct select_reply, call) == 8 );
 C_ASSERT( FIELD_OFFSET(struct select_reply, apc_handle) == 56 );
 C_ASSERT( FIELD_OFFSET(struct select_reply, signaled) == 60 );
 C_ASSERT( sizeof(struct select_reply) == 64 );
+C_ASSERT( FIELD_OFFSET(struct batch_request, chain) == 12 );
+C_ASSERT( sizeof(struct batch_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct batch_reply, count) == 8 );
+C_ASSERT( sizeof(struct batch_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_event_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_event_request, manual_reset) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_event_request, initial_state) == 20 );
@@ -972,6 +993,18 @@ C_ASSERT( sizeof(struct query_semaphore_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_semaphore_reply, current) == 8 );
 C_ASSERT( FIELD_OFFSET(struct query_semaphore_reply, max) == 12 );
 C_ASSERT( sizeof(struct query_semaphore_reply) == 16 );
+C_ASSERT( sizeof(struct get_fast_sync_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_shm_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_fast_sync_shm_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_obj_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_fast_sync_obj_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_obj_reply, index) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_obj_reply, serial) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_obj_reply, type) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_obj_reply, access) == 20 );
+C_ASSERT( sizeof(struct get_fast_sync_obj_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct fast_sync_wake_request, handle) == 12 );
+C_ASSERT( sizeof(struct fast_sync_wake_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, rootdir) == 20 );
@@ -1044,7 +1077,8 @@ C_ASSERT( FIELD_OFFSET(struct unlock_file_request, count) == 24 );
 C_ASSERT( sizeof(struct unlock_file_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct recv_socket_request, oob) == 12 );
 C_ASSERT( FIELD_OFFSET(struct recv_socket_request, async) == 16 );
-C_ASSERT( FIELD_OFFSET(struct recv_socket_request, force_async) == 56 );
+C_ASSERT( FIELD_OFFSET(struct recv_socket_request, status) == 56 );
+C_ASSERT( FIELD_OFFSET(struct recv_socket_request, total) == 60 );
 C_ASSERT( sizeof(struct recv_socket_request) == 64 );
 C_ASSERT( FIELD_OFFSET(struct recv_socket_reply, wait) == 8 );
 C_ASSERT( FIELD_OFFSET(struct recv_socket_reply, options) == 12 );
@@ -1391,6 +1425,13 @@ C_ASSERT( FIELD_OFFSET(struct register_async_request, type) == 12 );
 C_ASSERT( FIELD_OFFSET(struct register_async_request, async) == 16 );
 C_ASSERT( FIELD_OFFSET(struct register_async_request, count) == 56 );
 C_ASSERT( sizeof(struct register_async_request) == 64 );
+C_ASSERT( FIELD_OFFSET(struct register_file_async_request, type) == 12 );
+C_ASSERT( FIELD_OFFSET(struct register_file_async_request, async) == 16 );
+C_ASSERT( sizeof(struct register_file_async_request) == 56 );
+C_ASSERT( FIELD_OFFSET(struct complete_async_request, status) == 12 );
+C_ASSERT( FIELD_OFFSET(struct complete_async_request, user) == 16 );
+C_ASSERT( FIELD_OFFSET(struct complete_async_request, information) == 24 );
+C_ASSERT( sizeof(struct complete_async_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct cancel_async_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct cancel_async_request, iosb) == 16 );
 C_ASSERT( FIELD_OFFSET(struct cancel_async_request, only_thread) == 24 );
@@ -2135,6 +2176,9 @@ C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, status) == 32 );
 C_ASSERT( sizeof(struct remove_completion_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct remove_completions_request, handle) == 12 );
+C_ASSERT( sizeof(struct remove_completions_request) == 16 );
+C_ASSERT( sizeof(struct remove_completions_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_request, handle) == 12 );
 C_ASSERT( sizeof(struct query_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_reply, depth) == 8 );
@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -55,20 +56,25 @@ struct semaphore
     struct object  obj;    /* object header */
     unsigned int   count;  /* current count */
     unsigned int   max;    /* maximum possible count */
+    struct fast_sync_object *fast;  /* count shared with the clients, if any */
+    unsigned int   reserved;        /* count taken from the shared memory by server waits */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     &semaphore_type,               /* type */
     semaphore_dump,                /* dump */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -83,7 +89,7 @@ static const struct object_ops semaphore_ops =
     no_open_file,                  /* open_file */
     no_kernel_obj_list,            /* get_kernel_obj_list */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -103,16 +109,77 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
         if (get_error() != STATUS_OBJECT_NAME_EXISTS)
         {
             /* initialize it if it didn't already exist */
-            sem->count = initial;
-            sem->max   = max;
+            sem->count    = initial;
+            sem->max      = max;
+            sem->reserved = 0;
+            sem->fast     = NULL;
+            /* named semaphores may be opened by other processes, keep them in the server */
+            if ((!name || !name->len) && max <= INT_MAX)
+                sem->fast = alloc_fast_sync_object( FAST_SYNC_SEMAPHORE, initial, max );
         }
     }
     return sem;
 }
 
+struct fast_sync_object *get_semaphore_fast_sync( struct object *obj )
+{
+    if (obj->ops != &semaphore_ops) return NULL;
+    return ((struct semaphore *)obj)->fast;
+}
+
+static unsigned int get_semaphore_count( struct semaphore *sem )
+{
+    if (!sem->fast) return sem->count;
+    return sem->reserved + __atomic_load_n( &sem->fast->state, __ATOMIC_SEQ_CST );
+}
+
+/* return the reserved count to the shared memory */
+static void unreserve_semaphore( struct semaphore *sem )
+{
+    if (!sem->reserved) return;
+    if (!__atomic_fetch_add( &sem->fast->state, sem->reserved, __ATOMIC_SEQ_CST ))
+        fast_sync_wake_clients( sem->fast );
+    sem->reserved = 0;
+}
+
+/* give back a reservation taken by a wait that ended up not being satisfied */
+void release_semaphore_reservation( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+
+    if (obj->ops != &semaphore_ops || !sem->fast) return;
+    unreserve_semaphore( sem );
+}
+
+static int release_fast_semaphore( struct semaphore *sem, unsigned int count,
+                                   unsigned int *prev )
+{
+    int cur = __atomic_load_n( &sem->fast->state, __ATOMIC_SEQ_CST );
+
+    do
+    {
+        if (prev) *prev = cur + sem->reserved;
+        if (cur + sem->reserved + count < cur + sem->reserved || cur + sem->reserved + count > sem->max)
+        {
+            set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n( &sem->fast->state, &cur, cur + count, 0,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ));
+
+    /* there cannot be any thread to wake up if the count is != 0 */
+    if (!cur)
+    {
+        fast_sync_wake_clients( sem->fast );
+        wake_up( &sem->obj, count );
+    }
+    return 1;
+}
+
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
+    if (sem->fast) return release_fast_semaphore( sem, count, prev );
     if (prev) *prev = sem->count;
     if (sem->count + count < sem->count || sem->count + count > sem->max)
     {
@@ -136,20 +203,59 @@ static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    fprintf( stderr, "Semaphore count=%d max=%d\n", sem->count, sem->max );
+    fprintf( stderr, "Semaphore count=%d max=%d%s\n", get_semaphore_count( sem ), sem->max,
+             sem->fast ? " (shared)" : "" );
+}
+
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->fast) fast_sync_add_waiter( sem->fast );
+    return add_queue( obj, entry );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    remove_queue( obj, entry );
+    if (sem->fast) fast_sync_remove_waiter( sem->fast );
 }
 
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
+    int cur;
+
     assert( obj->ops == &semaphore_ops );
-    return (sem->count > 0);
+    if (!sem->fast) return (sem->count > 0);
+    if (sem->reserved) return 1;
+    /* take one count now so that no client thread can consume it before semaphore_satisfied;
+     * check_wait() gives it back if the wait is not satisfied */
+    cur = __atomic_load_n( &sem->fast->state, __ATOMIC_SEQ_CST );
+    while (cur > 0)
+    {
+        if (__atomic_compare_exchange_n( &sem->fast->state, &cur, cur - 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+        {
+            sem->reserved = 1;
+            return 1;
+        }
+    }
+    return 0;
 }
 
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    if (sem->fast)
+    {
+        assert( sem->reserved );
+        sem->reserved--;
+        return;
+    }
     assert( sem->count );
     sem->count--;
 }
@@ -167,6 +273,13 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->fast) free_fast_sync_object( sem->fast );
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -221,7 +334,7 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
-        reply->current = sem->count;
+        reply->current = get_semaphore_count( sem );
         reply->max = sem->max;
         release_object( sem );
     }
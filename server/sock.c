@@ -217,6 +217,7 @@ struct sock
     unsigned int        aborted : 1; /* did we get a POLLERR or irregular POLLHUP? */
     unsigned int        nonblocking : 1; /* is the socket nonblocking? */
     unsigned int        bound : 1;   /* is the socket bound? */
+    struct fast_sync_object *fast;   /* read state shared with the clients, if any */
 };
 
 static void sock_dump( struct object *obj, int verbose );
@@ -535,6 +536,14 @@ void sock_init(void)
     }
 }
 
+/* let the clients receive directly as long as doing so can't overtake a queued read */
+static void sock_update_fast_sync( struct sock *sock )
+{
+    int state = sock->rd_shutdown || sock->accept_recv_req || async_queued( &sock->read_q );
+
+    if (sock->fast) __atomic_store_n( &sock->fast->state, state, __ATOMIC_SEQ_CST );
+}
+
 static int sock_reselect( struct sock *sock )
 {
     int ev = sock_get_poll_events( sock->fd );
@@ -542,6 +551,7 @@ static int sock_reselect( struct sock *sock )
     if (debug_level)
         fprintf(stderr,"sock_reselect(%p): new mask %x\n", sock, ev);
 
+    sock_update_fast_sync( sock );
     set_fd_events( sock->fd, ev );
     return ev;
 }
@@ -616,6 +626,7 @@ static void free_accept_req( void *private )
     if (req->acceptsock)
     {
         req->acceptsock->accept_recv_req = NULL;
+        sock_update_fast_sync( req->acceptsock );
         release_object( req->acceptsock );
     }
     release_object( req->async );
@@ -1376,6 +1387,17 @@ static void sock_reselect_async( struct fd *fd, struct async_queue *queue )
         sock_reselect( sock );
 }
 
+/* the entry is allocated on first use, most sockets never need one */
+struct fast_sync_object *get_sock_fast_sync( struct object *obj )
+{
+    struct sock *sock = (struct sock *)obj;
+
+    if (obj->ops != &sock_ops) return NULL;
+    if (!sock->fast && (sock->fast = alloc_fast_sync_object( FAST_SYNC_SOCKET, 1, 0 )))
+        sock_update_fast_sync( sock );
+    return sock->fast;
+}
+
 static struct fd *sock_get_fd( struct object *obj )
 {
     struct sock *sock = (struct sock *)obj;
@@ -1445,6 +1467,7 @@ static void sock_destroy( struct object *obj )
     free_async_queue( &sock->connect_q );
     free_async_queue( &sock->poll_q );
     if (sock->event) release_object( sock->event );
+    if (sock->fast) free_fast_sync_object( sock->fast );
     if (sock->fd)
     {
         /* shut the socket down to force pending poll() calls in the client to return */
@@ -1490,6 +1513,7 @@ static struct sock *create_socket(void)
     sock->sndbuf = 0;
     sock->rcvtimeo = 0;
     sock->sndtimeo = 0;
+    sock->fast = NULL;
     init_async_queue( &sock->read_q );
     init_async_queue( &sock->write_q );
     init_async_queue( &sock->ifchange_q );
@@ -3396,7 +3420,8 @@ struct object *create_socket_device( struct object *root, const struct unicode_s
 DECL_HANDLER(recv_socket)
 {
     struct sock *sock = (struct sock *)get_handle_obj( current->process, req->async.handle, 0, &sock_ops );
-    unsigned int status = STATUS_PENDING;
+    unsigned int status = req->status;
+    int force_async = req->status == STATUS_PENDING;
     timeout_t timeout = 0;
     struct async *async;
     struct fd *fd;
@@ -3404,37 +3429,51 @@ DECL_HANDLER(recv_socket)
     if (!sock) return;
     fd = sock->fd;
 
-    if (!req->force_async && !sock->nonblocking && is_fd_overlapped( fd ))
-        timeout = (timeout_t)sock->rcvtimeo * -10000;
-
-    if (sock->rd_shutdown) status = STATUS_PIPE_DISCONNECTED;
-    else if (!async_queued( &sock->read_q ))
+    /* The client may already have received the data itself, in which case
+     * we only need to store the result; otherwise it tells us whether the
+     * request should be asynchronous, as for send_socket. */
+    if (status == STATUS_PENDING || status == STATUS_DEVICE_NOT_READY)
     {
-        /* If read_q is not empty, we cannot really tell if the already queued
-         * asyncs will not consume all available data; if there's no data
-         * available, the current request won't be immediately satiable.
-         */
-        struct pollfd pollfd;
-        pollfd.fd = get_unix_fd( sock->fd );
-        pollfd.events = req->oob ? POLLPRI : POLLIN;
-        pollfd.revents = 0;
-        if (poll(&pollfd, 1, 0) >= 0 && pollfd.revents)
-        {
-            /* Give the client opportunity to complete synchronously.
-             * If it turns out that the I/O request is not actually immediately satiable,
-             * the client may then choose to re-queue the async (with STATUS_PENDING). */
-            status = STATUS_ALERTED;
+        if (!force_async && !sock->nonblocking && is_fd_overlapped( fd ))
+            timeout = (timeout_t)sock->rcvtimeo * -10000;
+
+        status = STATUS_PENDING;
+
+        if (sock->rd_shutdown) status = STATUS_PIPE_DISCONNECTED;
+        else if (!async_queued( &sock->read_q ))
+        {
+            /* If read_q is not empty, we cannot really tell if the already queued
+             * asyncs will not consume all available data; if there's no data
+             * available, the current request won't be immediately satiable.
+             */
+            struct pollfd pollfd;
+            pollfd.fd = get_unix_fd( sock->fd );
+            pollfd.events = req->oob ? POLLPRI : POLLIN;
+            pollfd.revents = 0;
+            if (poll(&pollfd, 1, 0) >= 0 && pollfd.revents)
+            {
+                /* Give the client opportunity to complete synchronously.
+                 * If it turns out that the I/O request is not actually immediately satiable,
+                 * the client may then choose to re-queue the async (with STATUS_PENDING). */
+                status = STATUS_ALERTED;
+            }
         }
-    }
 
-    if (status == STATUS_PENDING && !req->force_async && sock->nonblocking)
-        status = STATUS_DEVICE_NOT_READY;
+        if (status == STATUS_PENDING && !force_async && sock->nonblocking)
+            status = STATUS_DEVICE_NOT_READY;
+    }
 
     sock->pending_events &= ~(req->oob ? AFD_POLL_OOB : AFD_POLL_READ);
     sock->reported_events &= ~(req->oob ? AFD_POLL_OOB : AFD_POLL_READ);
 
     if ((async = create_request_async( fd, get_fd_comp_flags( fd ), &req->async )))
     {
+        if (!NT_ERROR( status ) && status != STATUS_PENDING && status != STATUS_ALERTED)
+        {
+            struct iosb *iosb = async_get_iosb( async );
+            iosb->result = req->total;
+            release_object( iosb );
+        }
         set_error( status );
 
         if (timeout)
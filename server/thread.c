@@ -851,6 +851,9 @@ static int check_wait( struct thread *thread )
         for (i = 0, entry = wait->queues; i < wait->count; i++, entry++)
             not_ok |= !entry->obj->ops->signaled( entry->obj, entry );
         if (!not_ok) return STATUS_WAIT_0;
+        /* don't hide the state of the signaled objects from the clients while we keep waiting */
+        for (i = 0, entry = wait->queues; i < wait->count; i++, entry++)
+            fast_sync_release_reservation( entry->obj );
     }
     else
     {
@@ -1349,6 +1349,25 @@ static void dump_varargs_handle_infos( const char *prefix, data_size_t size )
     fputc( '}', stderr );
 }
 
+static void dump_varargs_completion_packets( const char *prefix, data_size_t size )
+{
+    const struct completion_packet *packet;
+
+    fprintf( stderr, "%s{", prefix );
+    while (size >= sizeof(*packet))
+    {
+        packet = cur_data;
+        dump_uint64( "{ckey=", &packet->ckey );
+        dump_uint64( ",cvalue=", &packet->cvalue );
+        dump_uint64( ",information=", &packet->information );
+        fprintf( stderr, ",status=%s}", get_status_name( packet->status ) );
+        size -= sizeof(*packet);
+        remove_data( sizeof(*packet) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
 typedef void (*dump_func)( const void *req );
 
 /* Everything below this line is generated automatically by tools/make_requests */
@@ -1727,6 +1746,18 @@ static void dump_select_reply( const struct select_reply *req )
     dump_varargs_contexts( ", contexts=", cur_size );
 }
 
+static void dump_batch_request( const struct batch_request *req )
+{
+    fprintf( stderr, " chain=%08x", req->chain );
+    dump_varargs_bytes( ", requests=", cur_size );
+}
+
+static void dump_batch_reply( const struct batch_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    dump_varargs_bytes( ", replies=", cur_size );
+}
+
 static void dump_create_event_request( const struct create_event_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -1881,6 +1912,33 @@ static void dump_query_semaphore_reply( const struct query_semaphore_reply *req
     fprintf( stderr, ", max=%08x", req->max );
 }
 
+static void dump_get_fast_sync_shm_request( const struct get_fast_sync_shm_request *req )
+{
+}
+
+static void dump_get_fast_sync_shm_reply( const struct get_fast_sync_shm_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
+static void dump_get_fast_sync_obj_request( const struct get_fast_sync_obj_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_fast_sync_obj_reply( const struct get_fast_sync_obj_reply *req )
+{
+    fprintf( stderr, " index=%08x", req->index );
+    fprintf( stderr, ", serial=%08x", req->serial );
+    fprintf( stderr, ", type=%08x", req->type );
+    fprintf( stderr, ", access=%08x", req->access );
+}
+
+static void dump_fast_sync_wake_request( const struct fast_sync_wake_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_open_semaphore_request( const struct open_semaphore_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -2032,7 +2090,8 @@ static void dump_recv_socket_request( const struct recv_socket_request *req )
 {
     fprintf( stderr, " oob=%d", req->oob );
     dump_async_data( ", async=", &req->async );
-    fprintf( stderr, ", force_async=%d", req->force_async );
+    fprintf( stderr, ", status=%08x", req->status );
+    fprintf( stderr, ", total=%08x", req->total );
 }
 
 static void dump_recv_socket_reply( const struct recv_socket_reply *req )
@@ -2741,6 +2800,19 @@ static void dump_register_async_request( const struct register_async_request *re
     fprintf( stderr, ", count=%d", req->count );
 }
 
+static void dump_register_file_async_request( const struct register_file_async_request *req )
+{
+    fprintf( stderr, " type=%d", req->type );
+    dump_async_data( ", async=", &req->async );
+}
+
+static void dump_complete_async_request( const struct complete_async_request *req )
+{
+    fprintf( stderr, " status=%08x", req->status );
+    dump_uint64( ", user=", &req->user );
+    dump_uint64( ", information=", &req->information );
+}
+
 static void dump_cancel_async_request( const struct cancel_async_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4243,6 +4315,16 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_remove_completions_request( const struct remove_completions_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_remove_completions_reply( const struct remove_completions_reply *req )
+{
+    dump_varargs_completion_packets( " packets=", cur_size );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4513,6 +4595,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_process_request,
     (dump_func)dump_open_thread_request,
     (dump_func)dump_select_request,
+    (dump_func)dump_batch_request,
     (dump_func)dump_create_event_request,
     (dump_func)dump_event_op_request,
     (dump_func)dump_query_event_request,
@@ -4526,6 +4609,9 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_semaphore_request,
     (dump_func)dump_release_semaphore_request,
     (dump_func)dump_query_semaphore_request,
+    (dump_func)dump_get_fast_sync_shm_request,
+    (dump_func)dump_get_fast_sync_obj_request,
+    (dump_func)dump_fast_sync_wake_request,
     (dump_func)dump_open_semaphore_request,
     (dump_func)dump_create_file_request,
     (dump_func)dump_open_file_object_request,
@@ -4605,6 +4691,8 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_serial_info_request,
     (dump_func)dump_set_serial_info_request,
     (dump_func)dump_register_async_request,
+    (dump_func)dump_register_file_async_request,
+    (dump_func)dump_complete_async_request,
     (dump_func)dump_cancel_async_request,
     (dump_func)dump_get_async_result_request,
     (dump_func)dump_set_async_direct_result_request,
@@ -4732,6 +4820,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_remove_completions_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
@@ -4791,6 +4880,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_process_reply,
     (dump_func)dump_open_thread_reply,
     (dump_func)dump_select_reply,
+    (dump_func)dump_batch_reply,
     (dump_func)dump_create_event_reply,
     (dump_func)dump_event_op_reply,
     (dump_func)dump_query_event_reply,
@@ -4804,6 +4894,9 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_semaphore_reply,
     (dump_func)dump_release_semaphore_reply,
     (dump_func)dump_query_semaphore_reply,
+    (dump_func)dump_get_fast_sync_shm_reply,
+    (dump_func)dump_get_fast_sync_obj_reply,
+    NULL,
     (dump_func)dump_open_semaphore_reply,
     (dump_func)dump_create_file_reply,
     (dump_func)dump_open_file_object_reply,
@@ -4884,6 +4977,8 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     NULL,
     NULL,
+    NULL,
+    NULL,
     (dump_func)dump_get_async_result_reply,
     (dump_func)dump_set_async_direct_result_reply,
     (dump_func)dump_read_reply,
@@ -5010,6 +5105,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_remove_completions_reply,
     (dump_func)dump_query_completion_reply,
     NULL,
     NULL,
@@ -5069,6 +5165,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_process",
     "open_thread",
     "select",
+    "batch",
     "create_event",
     "event_op",
     "query_event",
@@ -5082,6 +5179,9 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "create_semaphore",
     "release_semaphore",
     "query_semaphore",
+    "get_fast_sync_shm",
+    "get_fast_sync_obj",
+    "fast_sync_wake",
     "open_semaphore",
     "create_file",
     "open_file_object",
@@ -5161,6 +5261,8 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_serial_info",
     "set_serial_info",
     "register_async",
+    "register_file_async",
+    "complete_async",
     "cancel_async",
     "get_async_result",
     "set_async_direct_result",
@@ -5288,6 +5390,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "remove_completions",
     "query_completion",
     "set_completion_info",
     "add_fd_completion",
@@ -5438,6 +5541,7 @@ static const struct
     { "PROCESS_IS_TERMINATING",      STATUS_PROCESS_IS_TERMINATING },
     { "PROCESS_NOT_IN_JOB",          STATUS_PROCESS_NOT_IN_JOB },
     { "REPARSE_POINT_NOT_RESOLVED",  STATUS_REPARSE_POINT_NOT_RESOLVED },
+    { "RETRY",                       STATUS_RETRY },
     { "SECTION_TOO_BIG",             STATUS_SECTION_TOO_BIG },
     { "SEMAPHORE_LIMIT_EXCEEDED",    STATUS_SEMAPHORE_LIMIT_EXCEEDED },
     { "SHARING_VIOLATION",           STATUS_SHARING_VIOLATION },
@@ -5530,6 +5634,12 @@ void trace_request(void)
     else fprintf( stderr, "%04x: %d(?)\n", current->id, req );
 }
 
+const char *get_req_name( enum request req )
+{
+    if (req < REQ_NB_REQUESTS) return req_names[req];
+    return "?";
+}
+
 void trace_reply( enum request req, const union generic_reply *reply )
 {
     if (req < REQ_NB_REQUESTS)